@@ -0,0 +1,32 @@
+/*
+* @file           config.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the config of MCU2. Its include path goes before
+*                 p205_fw/application, so the libs built for MCU2 take the
+*                 config of the uSD firmware instead of the one of MCU1.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef HOST_MCU2_CONFIG_H
+#define HOST_MCU2_CONFIG_H
+
+/*********************************** Includes ***********************************/
+#include "config_uSD_content.h"
+
+/********************************** Definitions ***********************************/
+/* SPI pins, not in the uSD config. The simulated buses do not use them */
+#define SPI_MNGR_CONFIG1_SCK_PIN          NRF_GPIO_PIN_MAP(0, 14)
+#define SPI_MNGR_CONFIG1_MOSI_PIN         NRF_GPIO_PIN_MAP(0, 15)
+#define SPI_MNGR_CONFIG1_MISO_PIN         NRF_GPIO_PIN_MAP(0, 13)
+#define SPI_MNGR_CONFIG2_SCK_PIN          NRF_GPIO_PIN_MAP(0, 14)
+#define SPI_MNGR_CONFIG2_MOSI_PIN         NRF_GPIO_PIN_MAP(0, 15)
+#define SPI_MNGR_CONFIG2_MISO_PIN         NRF_GPIO_PIN_MAP(0, 13)
+#define SPI_MNGR_CONFIG3_SCK_PIN          NRF_GPIO_PIN_MAP(0, 7)
+#define SPI_MNGR_CONFIG3_MOSI_PIN         NRF_GPIO_PIN_MAP(0, 6)
+#define SPI_MNGR_CONFIG3_MISO_PIN         NRF_GPIO_PIN_MAP(0, 8)
+
+#endif /* HOST_MCU2_CONFIG_H */
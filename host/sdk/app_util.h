@@ -0,0 +1,27 @@
+/*
+* @file           app_util.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the utility macros of the nRF5 SDK used by the libs.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef APP_UTIL_H__
+#define APP_UTIL_H__
+
+/*********************************** Includes ***********************************/
+#include "sdk_common.h"
+
+/********************************** Definitions ***********************************/
+#define STATIC_ASSERT(expr, ...)      _Static_assert(expr, "" __VA_ARGS__)
+
+#define IS_SET(W, B)                  (((W) >> (B)) & 1)
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(array)             (sizeof(array) / sizeof((array)[0]))
+#endif
+
+#endif /* APP_UTIL_H__ */
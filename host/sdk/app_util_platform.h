@@ -0,0 +1,24 @@
+/*
+* @file           app_util_platform.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the critical regions of the nRF5 SDK. The host
+*                 has no interrupts, the DRDY and SPI events run from the loop
+*                 of the host tools, so the regions are empty.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+/*********************************** Includes ***********************************/
+#include "app_util.h"
+
+/********************************** Definitions ***********************************/
+#define CRITICAL_REGION_ENTER()       {
+#define CRITICAL_REGION_EXIT()        }
+
+#endif /* APP_UTIL_PLATFORM_H__ */
@@ -0,0 +1,29 @@
+/*
+* @file           crc16.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the CRC-16-CCITT of the nRF5 SDK, same algorithm.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+#include "crc16.h"
+
+/********************************** Public ************************************/
+uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc) {
+
+  uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+
+  for(uint32_t i = 0 ; i < size ; i++) {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= p_data[i];
+    crc ^= (uint8_t)(crc & 0xFF) >> 4;
+    crc ^= (crc << 8) << 4;
+    crc ^= ((crc & 0xFF) << 4) << 1;
+  }
+  return crc;
+
+}
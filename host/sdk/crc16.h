@@ -0,0 +1,21 @@
+/*
+* @file           crc16.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the CRC-16-CCITT of the nRF5 SDK.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef CRC16_H__
+#define CRC16_H__
+
+/*********************************** Includes ***********************************/
+#include "sdk_common.h"
+
+/********************************** Functions ***********************************/
+uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc);
+
+#endif /* CRC16_H__ */
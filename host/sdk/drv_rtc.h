@@ -0,0 +1,22 @@
+/*
+* @file           drv_rtc.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the RTC definitions used by rtc.h.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef DRV_RTC_H__
+#define DRV_RTC_H__
+
+/*********************************** Includes ***********************************/
+#include "sdk_common.h"
+
+/********************************** Definitions ***********************************/
+#define RTC_COUNTER_COUNTER_Msk       (0xFFFFFFUL)
+#define DRV_RTC_US_TO_TICKS(us, freq) (((us) * (freq)) / 1000000U)
+
+#endif /* DRV_RTC_H__ */
@@ -0,0 +1,377 @@
+/*
+* @file           host_bus.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the GPIO, GPIOTE and SPI transaction manager of
+*                 the nRF5 SDK on the simulated boards of host_bus.h.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "host_bus.h"
+
+/* SDK */
+#include "nrf_gpio.h"
+
+/********************************** Private ************************************/
+/*
+ * MCU of the threads that did not bind one
+ */
+static host_mcu _default_mcu;
+static bool _default_init;
+
+/*
+ * MCU of the thread
+ */
+static __thread host_mcu *_mcu;
+
+/* Private functions list */
+static void _host_pin_write(uint32_t pin, uint8_t level);
+static ret_code_t _host_spi_transfers(host_spi_queue *queue, nrf_spi_mngr_transfer_t const *transfers, uint8_t count);
+static void _host_spi_run(host_spi_queue *queue);
+
+/********************************** Boards ************************************/
+/*
+ * @brief Function to initialize an MCU, pins low, no handlers and no devices
+ *
+ * @param[out] mcu          MCU
+ */
+void host_mcu_init(host_mcu *mcu) {
+  memset(mcu, 0, sizeof(host_mcu));
+}
+
+
+/*
+ * @brief Function to run the SDK calls of the thread on an MCU
+ *
+ * @param[in] mcu           MCU
+ */
+void host_mcu_bind(host_mcu *mcu) {
+  _mcu = mcu;
+}
+
+
+/*
+ * @brief Function to get the MCU of the thread
+ *
+ * @retval                  MCU bound to the thread, or the default one
+ */
+host_mcu *host_mcu_get(void) {
+
+  if(!_mcu) {
+    if(!_default_init) {
+      host_mcu_init(&_default_mcu);
+      _default_init = true;
+    }
+    _mcu = &_default_mcu;
+  }
+  return _mcu;
+
+}
+
+
+/*
+ * @brief Function to connect a device to a chip select of the MCU of the thread
+ *
+ * @param[in] cs_pin        Chip select, active low, set high
+ * @param[in] device        Device, must stay valid
+ */
+void host_bus_attach(uint32_t cs_pin, host_spi_device const *device) {
+
+  host_mcu *mcu = host_mcu_get();
+
+  mcu->devices[cs_pin] = device;
+  mcu->levels[cs_pin] = 1;
+
+}
+
+
+/*
+ * @brief Function to run the scheduled SPI transactions, as the SPI interrupt
+ *
+ * @retval                  Number of transactions run
+ * @note                    The transactions scheduled by the end callbacks also run
+ */
+uint32_t host_spi_process(void) {
+
+  host_mcu *mcu = host_mcu_get();
+  uint32_t count = 0;
+
+  for(uint8_t i = 0 ; i < HOST_SPI_INSTANCES ; i++) {
+    while(mcu->queues[i].count) {
+      _host_spi_run(&mcu->queues[i]);
+      count++;
+    }
+  }
+  return count;
+
+}
+
+
+/*
+ * @brief Function to get the queue of an SPI manager instance, with its statistics
+ */
+host_spi_queue *host_spi_get_queue(uint8_t instance) {
+  return &host_mcu_get()->queues[instance];
+}
+
+
+/********************************** GPIO ************************************/
+void nrf_gpio_cfg(uint32_t pin_number, nrf_gpio_pin_dir_t dir, nrf_gpio_pin_input_t input,
+                  nrf_gpio_pin_pull_t pull, nrf_gpio_pin_drive_t drive, nrf_gpio_pin_sense_t sense) {
+  (void)pin_number; (void)dir; (void)input; (void)pull; (void)drive; (void)sense;
+}
+
+
+void nrf_gpio_cfg_output(uint32_t pin_number) {
+  (void)pin_number;
+}
+
+
+void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config) {
+  (void)pin_number; (void)pull_config;
+}
+
+
+void nrf_gpio_pin_set(uint32_t pin_number) {
+  _host_pin_write(pin_number, 1);
+}
+
+
+void nrf_gpio_pin_clear(uint32_t pin_number) {
+  _host_pin_write(pin_number, 0);
+}
+
+
+uint32_t nrf_gpio_pin_read(uint32_t pin_number) {
+  return host_mcu_get()->levels[pin_number];
+}
+
+
+uint32_t nrf_gpio_pin_out_read(uint32_t pin_number) {
+  return host_mcu_get()->levels[pin_number];
+}
+
+
+/********************************** GPIOTE ************************************/
+ret_code_t nrf_drv_gpiote_init(void) {
+  return NRF_SUCCESS;
+}
+
+
+bool nrf_drv_gpiote_is_init(void) {
+  return true;
+}
+
+
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const *p_config,
+                                  nrf_drv_gpiote_evt_handler_t evt_handler) {
+
+  host_mcu *mcu = host_mcu_get();
+
+  if(mcu->handlers[pin]) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  mcu->handlers[pin] = evt_handler;
+  mcu->senses[pin] = p_config->sense;
+  mcu->levels[pin] = (p_config->pull == NRF_GPIO_PIN_PULLUP);
+  return NRF_SUCCESS;
+
+}
+
+
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin) {
+  host_mcu_get()->handlers[pin] = NULL;
+  host_mcu_get()->events[pin] = false;
+}
+
+
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable) {
+  host_mcu_get()->events[pin] = int_enable;
+}
+
+
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin) {
+  host_mcu_get()->events[pin] = false;
+}
+
+
+bool nrf_drv_gpiote_in_is_set(nrf_drv_gpiote_pin_t pin) {
+  return host_mcu_get()->levels[pin];
+}
+
+
+/*
+ * @brief Function to raise an edge of an input pin
+ *
+ * @param[in] pin           Pin
+ * @param[in] action        NRF_GPIOTE_POLARITY_HITOLO or NRF_GPIOTE_POLARITY_LOTOHI
+ * @retval                  Returns true if the handler of the pin was called, only on the edges it senses
+ */
+bool host_gpiote_event(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+
+  host_mcu *mcu = host_mcu_get();
+
+  mcu->levels[pin] = (action == NRF_GPIOTE_POLARITY_LOTOHI);
+  if(!mcu->events[pin] || !mcu->handlers[pin] ||
+     (mcu->senses[pin] != NRF_GPIOTE_POLARITY_TOGGLE && mcu->senses[pin] != action)) {
+    return false;
+  }
+  mcu->handlers[pin](pin, action);
+  return true;
+
+}
+
+
+/********************************** SPI manager ************************************/
+ret_code_t nrf_spi_mngr_init(nrf_spi_mngr_t const *p_nrf_spi_mngr, nrf_drv_spi_config_t const *p_default_spi_config) {
+
+  host_spi_queue *queue = &host_mcu_get()->queues[p_nrf_spi_mngr->instance];
+
+  if(queue->size) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  memset(queue, 0, sizeof(host_spi_queue));
+  queue->size = (p_nrf_spi_mngr->queue_size < HOST_SPI_QUEUE_SIZE) ? p_nrf_spi_mngr->queue_size : HOST_SPI_QUEUE_SIZE;
+  queue->orc = p_default_spi_config->orc;
+  return NRF_SUCCESS;
+
+}
+
+
+void nrf_spi_mngr_uninit(nrf_spi_mngr_t const *p_nrf_spi_mngr) {
+  host_mcu_get()->queues[p_nrf_spi_mngr->instance].size = 0;
+}
+
+
+ret_code_t nrf_spi_mngr_schedule(nrf_spi_mngr_t const *p_nrf_spi_mngr, nrf_spi_mngr_transaction_t const *p_transaction) {
+
+  host_spi_queue *queue = &host_mcu_get()->queues[p_nrf_spi_mngr->instance];
+
+  if(!queue->size) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  if(queue->count == queue->size) {
+    queue->overflows++;
+    return NRF_ERROR_NO_MEM;
+  }
+  queue->transactions[(queue->head + queue->count) % HOST_SPI_QUEUE_SIZE] = p_transaction;
+  queue->count++;
+  return NRF_SUCCESS;
+
+}
+
+
+/*
+ * @note                    Blocking, as in the SDK the transactions scheduled before it run first
+ */
+ret_code_t nrf_spi_mngr_perform(nrf_spi_mngr_t const *p_nrf_spi_mngr, nrf_drv_spi_config_t const *p_config,
+                                nrf_spi_mngr_transfer_t const *p_transfers, uint8_t number_of_transfers,
+                                void (*user_function)(void)) {
+
+  host_spi_queue *queue = &host_mcu_get()->queues[p_nrf_spi_mngr->instance];
+  ret_code_t result;
+
+  (void)p_config;
+  if(!queue->size) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  while(queue->count) {
+    _host_spi_run(queue);
+  }
+  result = _host_spi_transfers(queue, p_transfers, number_of_transfers);
+  if(user_function) {
+    user_function();
+  }
+  return result;
+
+}
+
+
+bool nrf_spi_mngr_is_idle(nrf_spi_mngr_t const *p_nrf_spi_mngr) {
+  return !host_mcu_get()->queues[p_nrf_spi_mngr->instance].count;
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to drive a pin, a chip select selects or deselects its device on its edges
+ */
+static void _host_pin_write(uint32_t pin, uint8_t level) {
+
+  host_mcu *mcu = host_mcu_get();
+  host_spi_device const *device = mcu->devices[pin];
+
+  if(device && mcu->levels[pin] != level) {
+    mcu->levels[pin] = level;
+    if(level) {
+      device->deselect(device->context);
+    } else {
+      device->select(device->context);
+    }
+    return;
+  }
+  mcu->levels[pin] = level;
+
+}
+
+
+/*
+ * @brief Function to clock the bytes of transfers through the selected devices
+ *
+ * @retval                  NRF_SUCCESS, or NRF_ERROR_INTERNAL without any device selected
+ */
+static ret_code_t _host_spi_transfers(host_spi_queue *queue, nrf_spi_mngr_transfer_t const *transfers, uint8_t count) {
+
+  host_mcu *mcu = host_mcu_get();
+  bool selected = false;
+  uint16_t length;
+  uint8_t mosi;
+  uint8_t miso;
+
+  for(uint8_t t = 0 ; t < count ; t++) {
+    length = (transfers[t].tx_length > transfers[t].rx_length) ? transfers[t].tx_length : transfers[t].rx_length;
+    for(uint16_t i = 0 ; i < length ; i++) {
+      mosi = (i < transfers[t].tx_length) ? transfers[t].p_tx_data[i] : queue->orc;
+      miso = 0xFF;
+      for(uint32_t pin = 0 ; pin < HOST_GPIO_PINS ; pin++) {
+        if(mcu->devices[pin] && !mcu->levels[pin]) {
+          miso &= mcu->devices[pin]->exchange(mcu->devices[pin]->context, mosi);
+          selected = true;
+        }
+      }
+      if(i < transfers[t].rx_length) {
+        transfers[t].p_rx_data[i] = miso;
+      }
+    }
+    queue->bytes += length;
+  }
+  return (selected || !count) ? NRF_SUCCESS : NRF_ERROR_INTERNAL;
+
+}
+
+
+/*
+ * @brief Function to run the oldest scheduled transaction of a queue
+ */
+static void _host_spi_run(host_spi_queue *queue) {
+
+  nrf_spi_mngr_transaction_t const *transaction = queue->transactions[queue->head];
+  ret_code_t result;
+
+  queue->head = (queue->head + 1) % HOST_SPI_QUEUE_SIZE;
+  queue->count--;
+
+  if(transaction->begin_callback) {
+    transaction->begin_callback(transaction->p_user_data);
+  }
+  result = _host_spi_transfers(queue, transaction->p_transfers, transaction->number_of_transfers);
+  if(transaction->callback) {
+    transaction->callback(result, transaction->p_user_data);
+  }
+
+}
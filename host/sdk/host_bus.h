@@ -0,0 +1,66 @@
+/*
+* @file           host_bus.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the boards of the simulations. An MCU has the
+*                 levels of its pins, its GPIOTE handlers, the queues of its
+*                 SPI manager instances and the devices on its chip selects.
+*                 Each thread runs one MCU, the first one by default, so two
+*                 firmwares can share a device from two threads.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef HOST_BUS_H
+#define HOST_BUS_H
+
+/*********************************** Includes ***********************************/
+#include "nrf_spi_mngr.h"
+#include "nrf_drv_gpiote.h"
+
+/********************************** Definitions ***********************************/
+#define HOST_SPI_QUEUE_SIZE           16        /* Largest queue of NRF_SPI_MNGR_DEF */
+
+/* SPI device, selected while its chip select is low. MISO is the AND of the selected devices */
+typedef struct {
+  void      (*select)(void *context);
+  uint8_t   (*exchange)(void *context, uint8_t mosi);
+  void      (*deselect)(void *context);
+  void      *context;
+} host_spi_device;
+
+/* Queue of an SPI manager instance */
+typedef struct {
+  nrf_spi_mngr_transaction_t const  *transactions[HOST_SPI_QUEUE_SIZE];
+  uint8_t                           size;       /* Queue size of NRF_SPI_MNGR_DEF, 0 before nrf_spi_mngr_init */
+  uint8_t                           head;
+  uint8_t                           count;
+  uint8_t                           orc;
+  uint32_t                          overflows;  /* Schedules refused on a full queue */
+  uint32_t                          bytes;      /* Bytes clocked */
+} host_spi_queue;
+
+/* MCU */
+typedef struct {
+  uint8_t                       levels[HOST_GPIO_PINS];
+  nrf_drv_gpiote_evt_handler_t  handlers[HOST_GPIO_PINS];
+  nrf_gpiote_polarity_t         senses[HOST_GPIO_PINS];
+  bool                          events[HOST_GPIO_PINS];
+  host_spi_device const         *devices[HOST_GPIO_PINS];
+  host_spi_queue                queues[HOST_SPI_INSTANCES];
+} host_mcu;
+
+/********************************** Functions ***********************************/
+/* Boards */
+void host_mcu_init(host_mcu *mcu);
+void host_mcu_bind(host_mcu *mcu);
+host_mcu *host_mcu_get(void);
+void host_bus_attach(uint32_t cs_pin, host_spi_device const *device);
+
+/* SPI interrupt, runs the scheduled transactions, returns how many */
+uint32_t host_spi_process(void);
+host_spi_queue *host_spi_get_queue(uint8_t instance);
+
+#endif /* HOST_BUS_H */
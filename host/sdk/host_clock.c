@@ -0,0 +1,154 @@
+/*
+* @file           host_clock.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the simulated time of the board with the RTC of
+*                 rtc.h and the busy waits, and the DWT cycle counter on the
+*                 host monotonic clock or on the CPU time of the thread.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "host_clock.h"
+
+/* SDK */
+#include "nrf.h"
+#include "nrf_delay.h"
+
+/* Sense library */
+#include "sense_library/periph/rtc.h"
+
+/* Standard library */
+#include <time.h>
+
+/********************************** Private ************************************/
+/*
+ * Simulated time in microseconds, shared by the MCUs of all the threads
+ */
+static uint64_t _clock_us;
+
+/*
+ * RTC ticks set by rtc_set_timer() at _rtc_base_us
+ */
+static uint64_t _rtc_base_ticks;
+static uint64_t _rtc_base_us;
+
+/*
+ * Core registers, CYCCNT is refreshed on every access
+ */
+static __thread DWT_Type _dwt;
+static __thread bool _dwt_cpu_time;
+static CoreDebug_Type _core_debug;
+
+/********************************** Public ************************************/
+/*
+ * @brief Function to get the simulated time
+ *
+ * @retval                  Microseconds since the start of the run
+ */
+uint64_t host_clock_get_us(void) {
+  return __atomic_load_n(&_clock_us, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * @brief Function to move the simulated time forward
+ *
+ * @param[in] us            Microseconds
+ */
+void host_clock_advance_us(uint64_t us) {
+  __atomic_add_fetch(&_clock_us, us, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * @brief Function to get the time of the host
+ *
+ * @retval                  Nanoseconds of the host monotonic clock
+ */
+uint64_t host_clock_get_host_ns(void) {
+
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+
+}
+
+
+/*
+ * @brief Function to count the CPU time of the calling thread in its DWT, instead of the host time
+ *
+ * @param[in] cpu_time      True for the CPU time, without the time the host scheduler gave to other threads
+ * @note                    The cycles of a code section are then the ones it would take on the MCU without
+ *                          preemption, as an interrupt at its priority
+ */
+void host_clock_set_dwt_cpu_time(bool cpu_time) {
+  _dwt_cpu_time = cpu_time;
+}
+
+
+/*
+ * @brief Function to get the DWT, CYCCNT counts the host time or the CPU time of the thread in cycles of SystemCoreClock
+ */
+DWT_Type *host_dwt(void) {
+
+  struct timespec now;
+  uint64_t ns;
+
+  if(_dwt_cpu_time) {
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+  } else {
+    ns = host_clock_get_host_ns();
+  }
+  _dwt.CYCCNT = (uint32_t)(ns * (SystemCoreClock / 1000000UL) / 1000ULL);
+  return &_dwt;
+
+}
+
+
+CoreDebug_Type *host_core_debug(void) {
+  return &_core_debug;
+}
+
+
+/********************************** SDK ************************************/
+void nrf_delay_us(uint32_t us) {
+  host_clock_advance_us(us);
+}
+
+
+void nrf_delay_ms(uint32_t ms) {
+  host_clock_advance_us(1000ULL * ms);
+}
+
+
+/********************************** RTC ************************************/
+void rtc_init(void) {
+}
+
+
+void rtc_set_timer(uint64_t ts_now) {
+  _rtc_base_ticks = ts_now * RTC_TICKS_PER_SECOND / 1000;
+  _rtc_base_us = host_clock_get_us();
+}
+
+
+uint64_t rtc_get_ticks(void) {
+  return _rtc_base_ticks + (host_clock_get_us() - _rtc_base_us) * RTC_TICKS_PER_SECOND / 1000000;
+}
+
+
+uint64_t rtc_get_milliseconds(void) {
+  return rtc_get_ticks() * 1000 / RTC_TICKS_PER_SECOND;
+}
+
+
+uint64_t rtc_get_seconds(void) {
+  return rtc_get_ticks() / RTC_TICKS_PER_SECOND;
+}
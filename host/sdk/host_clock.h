@@ -0,0 +1,30 @@
+/*
+* @file           host_clock.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the simulated time of the board. It only moves
+*                 with host_clock_advance_us() and the busy waits, so a run
+*                 takes the same path at any speed. The RTC of rtc.h counts
+*                 it, the DWT cycle counter counts the host time instead, or
+*                 the CPU time of the thread.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Functions ***********************************/
+uint64_t host_clock_get_us(void);
+void host_clock_advance_us(uint64_t us);
+uint64_t host_clock_get_host_ns(void);
+void host_clock_set_dwt_cpu_time(bool cpu_time);
+
+#endif /* HOST_CLOCK_H */
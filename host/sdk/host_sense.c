@@ -0,0 +1,42 @@
+/*
+* @file           host_sense.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the externs of the sense library that the
+*                 firmware provides, and the Gama measurements queue, which
+*                 counts the measurements and takes them all.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "sense_library/sensoroid/measurements_v2_manager.h"
+
+/* Standard library */
+#include <stdlib.h>
+
+/********************************** Private ************************************/
+static uint32_t _measurements;
+
+/********************************** Public ************************************/
+const uint8_t GAMA_QUEUE_ADD_MAX_ATTEMPTS = 3;
+
+
+uint8_t utils_random_generate(void) {
+  return (uint8_t)rand();
+}
+
+
+bool measurements_v2_manager_add_measurement(gama_measure_format_v2_fields_t *fields) {
+  (void)fields;
+  _measurements++;
+  return true;
+}
+
+
+uint32_t host_gama_get_measurements(void) {
+  return _measurements;
+}
@@ -0,0 +1,46 @@
+/*
+* @file           nrf.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the Cortex-M4 core registers used by the libs.
+*                 The DWT cycle counter follows the host monotonic clock, or
+*                 the CPU time of the thread, in cycles of the nRF52832 core
+*                 clock, and the barriers are full memory barriers of the host.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef NRF_H
+#define NRF_H
+
+/*********************************** Includes ***********************************/
+#include "sdk_common.h"
+
+/********************************** Definitions ***********************************/
+#define SystemCoreClock               64000000UL
+
+/* Data Watchpoint and Trace, CYCCNT is updated on every access of DWT */
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk        (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk    (1UL << 24)
+
+#define DWT                           (host_dwt())
+#define CoreDebug                     (host_core_debug())
+
+#define __DMB()                       __sync_synchronize()
+
+/********************************** Functions ***********************************/
+DWT_Type *host_dwt(void);
+CoreDebug_Type *host_core_debug(void);
+
+#endif /* NRF_H */
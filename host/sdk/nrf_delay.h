@@ -0,0 +1,23 @@
+/*
+* @file           nrf_delay.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the busy waits of the nRF5 SDK advance the host
+*                 clock, see host_clock.h.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef NRF_DELAY_H
+#define NRF_DELAY_H
+
+/*********************************** Includes ***********************************/
+#include "sdk_common.h"
+
+/********************************** Functions ***********************************/
+void nrf_delay_us(uint32_t us);
+void nrf_delay_ms(uint32_t ms);
+
+#endif /* NRF_DELAY_H */
@@ -0,0 +1,52 @@
+/*
+* @file           nrf_drv_gpiote.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the GPIOTE input events of the nRF5 SDK. The
+*                 simulated devices raise the events of their pins with
+*                 host_gpiote_event().
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef NRF_DRV_GPIOTE_H__
+#define NRF_DRV_GPIOTE_H__
+
+/*********************************** Includes ***********************************/
+#include "nrf_gpio.h"
+
+/********************************** Definitions ***********************************/
+typedef uint32_t nrf_drv_gpiote_pin_t;
+
+typedef enum {
+  NRF_GPIOTE_POLARITY_LOTOHI = 1,
+  NRF_GPIOTE_POLARITY_HITOLO,
+  NRF_GPIOTE_POLARITY_TOGGLE
+} nrf_gpiote_polarity_t;
+
+typedef struct {
+  nrf_gpiote_polarity_t sense;
+  nrf_gpio_pin_pull_t   pull;
+  bool                  is_watcher;
+  bool                  hi_accuracy;
+  bool                  skip_gpio_setup;
+} nrf_drv_gpiote_in_config_t;
+
+typedef void (*nrf_drv_gpiote_evt_handler_t)(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+/********************************** Functions ***********************************/
+ret_code_t nrf_drv_gpiote_init(void);
+bool nrf_drv_gpiote_is_init(void);
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const *p_config,
+                                  nrf_drv_gpiote_evt_handler_t evt_handler);
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin);
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable);
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin);
+bool nrf_drv_gpiote_in_is_set(nrf_drv_gpiote_pin_t pin);
+
+/* Host, an edge of an input pin, calls the handler if its event is enabled */
+bool host_gpiote_event(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+#endif /* NRF_DRV_GPIOTE_H__ */
@@ -0,0 +1,17 @@
+/*
+* @file           nrf_drv_saadc.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, included by mc_23k640.c, nothing of it is used.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef NRF_DRV_SAADC_H__
+#define NRF_DRV_SAADC_H__
+
+#include "sdk_common.h"
+
+#endif /* NRF_DRV_SAADC_H__ */
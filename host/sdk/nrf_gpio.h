@@ -0,0 +1,62 @@
+/*
+* @file           nrf_gpio.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the GPIO of the nRF5 SDK. The pins keep their
+*                 levels, and the chip selects of the simulated SPI devices
+*                 select them, see host_bus.h.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+/*********************************** Includes ***********************************/
+#include "sdk_common.h"
+
+/********************************** Definitions ***********************************/
+#define HOST_GPIO_PINS                64
+
+typedef enum {
+  NRF_GPIO_PIN_DIR_INPUT,
+  NRF_GPIO_PIN_DIR_OUTPUT
+} nrf_gpio_pin_dir_t;
+
+typedef enum {
+  NRF_GPIO_PIN_INPUT_CONNECT,
+  NRF_GPIO_PIN_INPUT_DISCONNECT
+} nrf_gpio_pin_input_t;
+
+typedef enum {
+  NRF_GPIO_PIN_NOPULL,
+  NRF_GPIO_PIN_PULLDOWN,
+  NRF_GPIO_PIN_PULLUP
+} nrf_gpio_pin_pull_t;
+
+typedef enum {
+  NRF_GPIO_PIN_S0S1,
+  NRF_GPIO_PIN_H0S1,
+  NRF_GPIO_PIN_S0H1,
+  NRF_GPIO_PIN_H0H1
+} nrf_gpio_pin_drive_t;
+
+typedef enum {
+  NRF_GPIO_PIN_NOSENSE,
+  NRF_GPIO_PIN_SENSE_LOW,
+  NRF_GPIO_PIN_SENSE_HIGH
+} nrf_gpio_pin_sense_t;
+
+/********************************** Functions ***********************************/
+void nrf_gpio_cfg(uint32_t pin_number, nrf_gpio_pin_dir_t dir, nrf_gpio_pin_input_t input,
+                  nrf_gpio_pin_pull_t pull, nrf_gpio_pin_drive_t drive, nrf_gpio_pin_sense_t sense);
+void nrf_gpio_cfg_output(uint32_t pin_number);
+void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config);
+void nrf_gpio_pin_set(uint32_t pin_number);
+void nrf_gpio_pin_clear(uint32_t pin_number);
+uint32_t nrf_gpio_pin_read(uint32_t pin_number);
+uint32_t nrf_gpio_pin_out_read(uint32_t pin_number);
+
+#endif /* NRF_GPIO_H__ */
@@ -0,0 +1,119 @@
+/*
+* @file           nrf_spi_mngr.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the SPI transaction manager of the nRF5 SDK. The
+*                 bytes go to the simulated devices selected by their chip
+*                 selects, see host_bus.h. Scheduled transactions wait in the
+*                 queue of the instance until host_spi_process(), which plays
+*                 the SPI interrupt.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef NRF_SPI_MNGR_H__
+#define NRF_SPI_MNGR_H__
+
+/*********************************** Includes ***********************************/
+#include "sdk_common.h"
+
+/********************************** Definitions ***********************************/
+/* Instances, SPI0 is not used by the firmware */
+#ifndef SPI0_ENABLED
+#define SPI0_ENABLED                  0
+#endif
+#ifndef SPI1_ENABLED
+#define SPI1_ENABLED                  1
+#endif
+#ifndef SPI2_ENABLED
+#define SPI2_ENABLED                  1
+#endif
+#define HOST_SPI_INSTANCES            3
+
+/* Driver configuration, only kept */
+#define NRF_DRV_SPI_PIN_NOT_USED      0xFF
+#define SPI_DEFAULT_CONFIG_IRQ_PRIORITY 6
+
+typedef enum {
+  NRF_DRV_SPI_FREQ_125K,
+  NRF_DRV_SPI_FREQ_250K,
+  NRF_DRV_SPI_FREQ_500K,
+  NRF_DRV_SPI_FREQ_1M,
+  NRF_DRV_SPI_FREQ_2M,
+  NRF_DRV_SPI_FREQ_4M,
+  NRF_DRV_SPI_FREQ_8M
+} nrf_drv_spi_frequency_t;
+
+typedef enum {
+  NRF_DRV_SPI_MODE_0,
+  NRF_DRV_SPI_MODE_1,
+  NRF_DRV_SPI_MODE_2,
+  NRF_DRV_SPI_MODE_3
+} nrf_drv_spi_mode_t;
+
+typedef enum {
+  NRF_DRV_SPI_BIT_ORDER_MSB_FIRST,
+  NRF_DRV_SPI_BIT_ORDER_LSB_FIRST
+} nrf_drv_spi_bit_order_t;
+
+typedef struct {
+  uint8_t                 sck_pin;
+  uint8_t                 mosi_pin;
+  uint8_t                 miso_pin;
+  uint8_t                 ss_pin;
+  uint8_t                 irq_priority;
+  uint8_t                 orc;                      /* Sent when there is nothing more to send */
+  nrf_drv_spi_frequency_t frequency;
+  nrf_drv_spi_mode_t      mode;
+  nrf_drv_spi_bit_order_t bit_order;
+} nrf_drv_spi_config_t;
+
+/* Transfers, max(tx_length, rx_length) bytes are clocked */
+typedef struct {
+  uint8_t const           *p_tx_data;
+  uint8_t                 tx_length;
+  uint8_t                 *p_rx_data;
+  uint8_t                 rx_length;
+} nrf_spi_mngr_transfer_t;
+
+#define NRF_SPI_MNGR_TRANSFER(_p_tx_data, _tx_length, _p_rx_data, _rx_length) \
+  {                                                                           \
+    .p_tx_data = (uint8_t const *)(_p_tx_data),                               \
+    .tx_length = (uint8_t)(_tx_length),                                       \
+    .p_rx_data = (uint8_t *)(_p_rx_data),                                     \
+    .rx_length = (uint8_t)(_rx_length),                                       \
+  }
+
+typedef void (*nrf_spi_mngr_callback_begin_t)(void *p_user_data);
+typedef void (*nrf_spi_mngr_callback_end_t)(ret_code_t result, void *p_user_data);
+
+typedef struct {
+  nrf_spi_mngr_callback_begin_t begin_callback;
+  nrf_spi_mngr_callback_end_t   callback;
+  void                          *p_user_data;
+  nrf_spi_mngr_transfer_t const *p_transfers;
+  uint8_t                       number_of_transfers;
+  nrf_drv_spi_config_t const    *p_required_spi_cfg;
+} nrf_spi_mngr_transaction_t;
+
+/* Instance, the queue is kept by the host bus */
+typedef struct {
+  uint8_t                 instance;
+  uint8_t                 queue_size;
+} nrf_spi_mngr_t;
+
+#define NRF_SPI_MNGR_DEF(_nrf_spi_mngr_name, _queue_size, _spi_idx) \
+  static const nrf_spi_mngr_t _nrf_spi_mngr_name = { .instance = (_spi_idx), .queue_size = (_queue_size) }
+
+/********************************** Functions ***********************************/
+ret_code_t nrf_spi_mngr_init(nrf_spi_mngr_t const *p_nrf_spi_mngr, nrf_drv_spi_config_t const *p_default_spi_config);
+void nrf_spi_mngr_uninit(nrf_spi_mngr_t const *p_nrf_spi_mngr);
+ret_code_t nrf_spi_mngr_schedule(nrf_spi_mngr_t const *p_nrf_spi_mngr, nrf_spi_mngr_transaction_t const *p_transaction);
+ret_code_t nrf_spi_mngr_perform(nrf_spi_mngr_t const *p_nrf_spi_mngr, nrf_drv_spi_config_t const *p_config,
+                                nrf_spi_mngr_transfer_t const *p_transfers, uint8_t number_of_transfers,
+                                void (*user_function)(void));
+bool nrf_spi_mngr_is_idle(nrf_spi_mngr_t const *p_nrf_spi_mngr);
+
+#endif /* NRF_SPI_MNGR_H__ */
@@ -0,0 +1,35 @@
+/*
+* @file           sdk_common.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the part of the nRF5 SDK common definitions used
+*                 by the libs.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef SDK_COMMON_H__
+#define SDK_COMMON_H__
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/********************************** Definitions ***********************************/
+typedef uint32_t ret_code_t;
+
+/* Error codes */
+#define NRF_SUCCESS                   0
+#define NRF_ERROR_INTERNAL            3
+#define NRF_ERROR_NO_MEM              4
+#define NRF_ERROR_INVALID_STATE       8
+#define NRF_ERROR_BUSY                17
+
+#define NRF_GPIO_PIN_MAP(port, pin)   (((port) << 5) | ((pin) & 0x1F))
+
+#endif /* SDK_COMMON_H__ */
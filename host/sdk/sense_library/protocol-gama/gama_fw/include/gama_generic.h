@@ -0,0 +1,17 @@
+/*
+* @file           gama_generic.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, included by the libs, nothing of it is used.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef GAMA_GENERIC_H_
+#define GAMA_GENERIC_H_
+
+#include "sdk_common.h"
+
+#endif /* GAMA_GENERIC_H_ */
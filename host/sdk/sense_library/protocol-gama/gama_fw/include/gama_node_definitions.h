@@ -0,0 +1,17 @@
+/*
+* @file           gama_node_definitions.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, included by the libs, nothing of it is used.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef GAMA_NODE_DEFINITIONS_H_
+#define GAMA_NODE_DEFINITIONS_H_
+
+#include "sdk_common.h"
+
+#endif /* GAMA_NODE_DEFINITIONS_H_ */
@@ -0,0 +1,18 @@
+/*
+* @file           gama_node_measurement.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the Gama measure types used by the libs.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef GAMA_NODE_MEASUREMENT_H_
+#define GAMA_NODE_MEASUREMENT_H_
+
+/*********************************** Includes ***********************************/
+#include "sdk_common.h"
+
+#endif /* GAMA_NODE_MEASUREMENT_H_ */
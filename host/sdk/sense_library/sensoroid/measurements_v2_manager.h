@@ -0,0 +1,38 @@
+/*
+* @file           measurements_v2_manager.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the Gama measurements queue of the sense library,
+*                 counted by host_sense.c instead of sent.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef MEASUREMENTS_V2_MANAGER_H_
+#define MEASUREMENTS_V2_MANAGER_H_
+
+/*********************************** Includes ***********************************/
+#include "sense_library/protocol-gama/gama_fw/include/gama_node_measurement.h"
+
+/********************************** Definitions ***********************************/
+#define MEASURE_VALUE_FLOAT_TYPE      1
+#define MEASURE_VALUE_UINT32_TYPE     2
+#define MEASURE_VALUE_UINT16_TYPE     3
+#define MEASURE_VALUE_UINT8_TYPE      4
+
+typedef struct {
+  uint8_t   measure_type;
+  uint8_t   sensor;
+  uint8_t   config_byte;
+  void      *val;
+} gama_measure_format_v2_fields_t;
+
+/********************************** Functions ***********************************/
+bool measurements_v2_manager_add_measurement(gama_measure_format_v2_fields_t *fields);
+
+/* Host, measurements added since the start */
+uint32_t host_gama_get_measurements(void);
+
+#endif /* MEASUREMENTS_V2_MANAGER_H_ */
@@ -0,0 +1,317 @@
+/*
+* @file           ads129x_sim.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the ADS1298 and ADS1296R of the board on their
+*                 chip selects of the SPI bus. The commands, the registers and
+*                 the RDATAC and RDATA reads of the status word and channels,
+*                 with the frames given at each DRDY by the caller. The pace
+*                 bit of a frame given is a pulse since the last DRDY, it
+*                 sets the pace latch of the board that the status word shows.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "ads129x_sim.h"
+
+/* SDK */
+#include "app_util.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* Registers after a reset, the ID is set by the device */
+#define ADS129X_SIM_CONFIG1_RESET     0x06
+#define ADS129X_SIM_CONFIG2_RESET     0x40
+#define ADS129X_SIM_CONFIG3_RESET     0x40
+#define ADS129X_SIM_IDLE              0xFF      /* DOUT with nothing to send */
+#define ADS129X_SIM_PACE_INDEX        ((ADS129X_PACE_DEVICE == ADS129X_8) ? 0 : 1)  /* Device of the pace status */
+#define ADS129X_SIM_PACE_MASK         (1 << ADS129X_PACE_BIT)
+
+/* Private functions list */
+static void _ads129x_sim_reset(ads129x_sim *sim);
+static void _ads129x_sim_attach(ads129x_sim *sim, uint32_t cs_pin, uint8_t id);
+static void _ads129x_sim_command(ads129x_sim *sim, uint8_t command);
+static void _ads129x_sim_select(void *context);
+static uint8_t _ads129x_sim_exchange(void *context, uint8_t mosi);
+static void _ads129x_sim_deselect(void *context);
+static void _ads129x_sim_pace(ads129x_sim_board *board, uint8_t *status);
+
+/********************************** Public ************************************/
+/*
+ * @brief Function to power up the devices and connect them to their chip selects on the MCU of the thread
+ *
+ * @param[out] board        Devices
+ * @note                    As after the power-up, the registers reset and in RDATAC mode
+ */
+void ads129x_sim_init(ads129x_sim_board *board) {
+
+  _ads129x_sim_attach(&board->ads1298, ADS129X_8_CS_PIN, ADS129X_8_ID_VALUE);
+  _ads129x_sim_attach(&board->ads1296r, ADS129X_6R_CS_PIN, ADS129X_6R_ID_VALUE);
+  board->pace_latch = false;
+  board->pace_pulses = 0;
+  board->pace_missed = 0;
+  board->pace_resets = 0;
+
+}
+
+
+/*
+ * @brief Function to end a conversion, latches the frame of each device and pulls DRDY low
+ *
+ * @param[in] board         Devices
+ * @param[in] frame         ADS129X_REPLAY_FRAME_SIZE bytes, ADS1298 data followed by ADS1296R data
+ * @retval                  Returns true if the devices were converting, otherwise nothing happens
+ * @note                    Runs the DRDY interrupt of the MCU of the thread, if enabled. The pace bit of the frame
+ *                          is replaced by the pace latch
+ */
+bool ads129x_sim_drdy(ads129x_sim_board *board, const uint8_t *frame) {
+
+  ads129x_sim *sims[] = {&board->ads1298, &board->ads1296r};
+
+  if(!board->ads1298.converting || board->ads1298.standby) {
+    return false;
+  }
+
+  for(uint8_t i = 0 ; i < ARRAY_SIZE(sims) ; i++) {
+    if(sims[i]->unread) {
+      sims[i]->missed++;
+    }
+    memcpy(sims[i]->frame, &frame[i * ADS129X_SW_BUFFER_SIZE], ADS129X_SW_BUFFER_SIZE);
+    sims[i]->unread = true;
+    sims[i]->latched++;
+  }
+  _ads129x_sim_pace(board, &sims[ADS129X_SIM_PACE_INDEX]->frame[2]);
+
+  host_gpiote_event(ADS129X_DRDY_PIN, NRF_GPIOTE_POLARITY_HITOLO);
+  host_gpiote_event(ADS129X_DRDY_PIN, NRF_GPIOTE_POLARITY_LOTOHI);
+  return true;
+
+}
+
+
+/*
+ * @brief Function to get the data rate of a device
+ *
+ * @param[in] sim           Device
+ * @retval                  Samples per second of CONFIG1
+ */
+uint32_t ads129x_sim_get_rate(const ads129x_sim *sim) {
+
+  uint8_t config1 = sim->regs[ADS129X_REG_CONFIG1];
+
+  return ((config1 & ADS129X_SIM_CONFIG1_HR) ? ADS129X_SIM_HR_RATE : ADS129X_SIM_LP_RATE) >> (config1 & ADS129X_SIM_CONFIG1_DR);
+
+}
+
+
+/*
+ * @brief Function to get the time between two DRDYs
+ *
+ * @param[in] board         Devices
+ * @retval                  Microseconds, from the rate of the ADS1298 that drives DRDY
+ */
+uint32_t ads129x_sim_get_period_us(const ads129x_sim_board *board) {
+  return 1000000UL / ads129x_sim_get_rate(&board->ads1298);
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to reset the registers and the modes of a device
+ */
+static void _ads129x_sim_reset(ads129x_sim *sim) {
+
+  uint8_t id = sim->regs[ADS129X_REG_ID];
+
+  memset(sim->regs, 0, sizeof(sim->regs));
+  sim->regs[ADS129X_REG_ID] = id;
+  sim->regs[ADS129X_REG_CONFIG1] = ADS129X_SIM_CONFIG1_RESET;
+  sim->regs[ADS129X_REG_CONFIG2] = ADS129X_SIM_CONFIG2_RESET;
+  sim->regs[ADS129X_REG_CONFIG3] = ADS129X_SIM_CONFIG3_RESET;
+  sim->standby = false;
+  sim->converting = false;
+  sim->rdatac = true;
+  sim->unread = false;
+
+}
+
+
+/*
+ * @brief Function to power up a device on a chip select
+ */
+static void _ads129x_sim_attach(ads129x_sim *sim, uint32_t cs_pin, uint8_t id) {
+
+  memset(sim, 0, sizeof(ads129x_sim));
+  sim->regs[ADS129X_REG_ID] = id;
+  _ads129x_sim_reset(sim);
+
+  sim->device.select = _ads129x_sim_select;
+  sim->device.exchange = _ads129x_sim_exchange;
+  sim->device.deselect = _ads129x_sim_deselect;
+  sim->device.context = sim;
+  host_bus_attach(cs_pin, &sim->device);
+
+}
+
+
+/*
+ * @brief Function to run a one byte command, in RDATAC mode only the ones the devices take in it
+ */
+static void _ads129x_sim_command(ads129x_sim *sim, uint8_t command) {
+
+  switch(command) {
+    case ADS129X_WAKEUP_CMD:
+      sim->standby = false;
+      break;
+    case ADS129X_STANDBY_CMD:
+      sim->standby = true;
+      break;
+    case ADS129X_RESET_CMD:
+      _ads129x_sim_reset(sim);
+      break;
+    case ADS129X_START_CMD:
+      sim->converting = true;
+      break;
+    case ADS129X_STOP_CMD:
+      sim->converting = false;
+      break;
+    case ADS129X_RDATAC_CMD:
+      sim->rdatac = true;
+      break;
+    case ADS129X_SDATAC_CMD:
+      sim->rdatac = false;
+      break;
+    case ADS129X_RDATA_CMD:
+      if(!sim->rdatac) {
+        sim->reading = true;
+        sim->data = 0;
+      }
+      break;
+    default:
+      return;
+  }
+  sim->commands++;
+
+}
+
+
+/*
+ * @brief Function called on the falling edge of the chip select, in RDATAC mode the frame is clocked out from it
+ */
+static void _ads129x_sim_select(void *context) {
+
+  ads129x_sim *sim = context;
+
+  sim->state = ADS129X_SIM_COMMAND;
+  sim->reading = sim->rdatac;
+  sim->data = 0;
+
+}
+
+
+/*
+ * @brief Function to clock one byte, DOUT is the frame or the register being read
+ */
+static uint8_t _ads129x_sim_exchange(void *context, uint8_t mosi) {
+
+  ads129x_sim *sim = context;
+  uint8_t miso = ADS129X_SIM_IDLE;
+
+  if(sim->reading && sim->data < ADS129X_SW_BUFFER_SIZE) {
+    miso = sim->frame[sim->data++];
+    if(sim->data == ADS129X_SW_BUFFER_SIZE && sim->unread) {
+      sim->unread = false;
+      sim->read++;
+    }
+  }
+
+  switch(sim->state) {
+    case ADS129X_SIM_COMMAND:
+      if(!sim->rdatac && (mosi & ~ADS129X_REG_MASK) == ADS129X_RREG_1BYTE_CMD) {
+        sim->command = ADS129X_RREG_1BYTE_CMD;
+        sim->reg = mosi & ADS129X_REG_MASK;
+        sim->state = ADS129X_SIM_COUNT;
+      } else if(!sim->rdatac && (mosi & ~ADS129X_REG_MASK) == ADS129X_WREG_1BYTE_CMD) {
+        sim->command = ADS129X_WREG_1BYTE_CMD;
+        sim->reg = mosi & ADS129X_REG_MASK;
+        sim->state = ADS129X_SIM_COUNT;
+      } else if(!sim->rdatac || mosi == ADS129X_SDATAC_CMD || mosi == ADS129X_RESET_CMD || mosi == ADS129X_START_CMD ||
+                mosi == ADS129X_STOP_CMD || mosi == ADS129X_STANDBY_CMD || mosi == ADS129X_WAKEUP_CMD) {
+        _ads129x_sim_command(sim, mosi);
+      }
+      break;
+    case ADS129X_SIM_COUNT:
+      sim->count = (mosi & ADS129X_REG_MASK) + 1;
+      sim->state = (sim->command == ADS129X_RREG_1BYTE_CMD) ? ADS129X_SIM_RREG : ADS129X_SIM_WREG;
+      sim->commands++;
+      break;
+    case ADS129X_SIM_RREG:
+      miso = (sim->reg < ADS129X_SIM_REGS) ? sim->regs[sim->reg] : 0;
+      sim->reg++;
+      if(!--sim->count) {
+        sim->state = ADS129X_SIM_COMMAND;
+      }
+      break;
+    case ADS129X_SIM_WREG:
+      /* ID and the lead-off status are read only */
+      if(sim->reg < ADS129X_SIM_REGS && sim->reg != ADS129X_REG_ID &&
+         sim->reg != ADS129X_LOFF_STATP && sim->reg != ADS129X_LOFF_STAPN) {
+        sim->regs[sim->reg] = mosi;
+      }
+      sim->reg++;
+      if(!--sim->count) {
+        sim->state = ADS129X_SIM_COMMAND;
+      }
+      break;
+  }
+  return miso;
+
+}
+
+
+/*
+ * @brief Function called on the rising edge of the chip select, ends the command in progress
+ */
+static void _ads129x_sim_deselect(void *context) {
+
+  ads129x_sim *sim = context;
+
+  sim->state = ADS129X_SIM_COMMAND;
+  sim->reading = false;
+
+}
+
+
+/*
+ * @brief Function to update the pace latch at a DRDY and put it in the status word
+ *
+ * @param[in] board         Devices
+ * @param[in,out] status    Status byte of the pace bit, a pulse since the last DRDY, then the latch
+ * @note                    The reset pin is read on the MCU of the thread
+ */
+static void _ads129x_sim_pace(ads129x_sim_board *board, uint8_t *status) {
+
+  bool pulse = (*status & ADS129X_SIM_PACE_MASK) != 0;
+
+  board->pace_pulses += pulse;
+  if(nrf_gpio_pin_out_read(ADS129X_PACE_RST_PIN)) {
+    board->pace_latch = false;
+    board->pace_missed += pulse;
+    board->pace_resets++;
+  } else if(pulse) {
+    board->pace_latch = true;
+  }
+
+  if(board->pace_latch) {
+    *status |= ADS129X_SIM_PACE_MASK;
+  } else {
+    *status &= ~ADS129X_SIM_PACE_MASK;
+  }
+
+}
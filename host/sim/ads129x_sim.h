@@ -0,0 +1,86 @@
+/*
+* @file           ads129x_sim.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the ADS1298 and ADS1296R of the board on their
+*                 chip selects of the SPI bus. The commands, the registers and
+*                 the RDATAC and RDATA reads of the status word and channels,
+*                 with the frames given at each DRDY by the caller. The pace
+*                 bit of a frame given is a pulse since the last DRDY, it
+*                 sets the pace latch of the board that the status word shows.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef ADS129X_SIM_H
+#define ADS129X_SIM_H
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_bus.h"
+
+/* Drivers */
+#include "ads129x.h"
+
+/********************************** Definitions ***********************************/
+#define ADS129X_SIM_REGS              (ADS129X_WCT2 + 1)
+#define ADS129X_SIM_CONFIG1_HR        0x80      /* CONFIG1 high resolution, otherwise low power */
+#define ADS129X_SIM_CONFIG1_DR        0x07      /* CONFIG1 data rate, fMOD / 2^(DR + 4) */
+#define ADS129X_SIM_HR_RATE           32000     /* SPS with DR 0, high resolution */
+#define ADS129X_SIM_LP_RATE           16000     /* SPS with DR 0, low power */
+
+/* Decoder of the bytes of a chip select */
+typedef enum {
+  ADS129X_SIM_COMMAND,
+  ADS129X_SIM_COUNT,                            /* Second byte of RREG and WREG */
+  ADS129X_SIM_RREG,
+  ADS129X_SIM_WREG
+} ads129x_sim_state;
+
+/* Device */
+typedef struct {
+  uint8_t             regs[ADS129X_SIM_REGS];
+  uint8_t             frame[ADS129X_SW_BUFFER_SIZE];  /* Output register, the frame of the last DRDY */
+  bool                standby;
+  bool                converting;               /* START received */
+  bool                rdatac;                   /* Read data continuous, the frame is clocked out on the select */
+  bool                unread;                   /* Frame latched and not read whole yet */
+
+  /* Bytes of the chip select */
+  ads129x_sim_state   state;
+  uint8_t             command;
+  uint8_t             reg;
+  uint8_t             count;
+  uint8_t             data;                     /* Frame bytes clocked out */
+  bool                reading;
+
+  host_spi_device     device;
+
+  /* Statistics */
+  uint32_t            commands;
+  uint32_t            latched;                  /* Frames of the DRDYs while converting */
+  uint32_t            read;                     /* Frames read whole */
+  uint32_t            missed;                   /* Frames overwritten before they were read whole */
+} ads129x_sim;
+
+/* Devices of the board */
+typedef struct {
+  ads129x_sim         ads1298;
+  ads129x_sim         ads1296r;
+
+  /* Pace latch, on the status word of ADS129X_PACE_DEVICE */
+  bool                pace_latch;               /* Set by a pulse, cleared while ADS129X_PACE_RST_PIN is high */
+  uint32_t            pace_pulses;              /* Pulses of the frames given */
+  uint32_t            pace_missed;              /* Pulses while the latch was in reset */
+  uint32_t            pace_resets;              /* DRDYs with the latch in reset */
+} ads129x_sim_board;
+
+/********************************** Functions ***********************************/
+void ads129x_sim_init(ads129x_sim_board *board);
+bool ads129x_sim_drdy(ads129x_sim_board *board, const uint8_t *frame);
+uint32_t ads129x_sim_get_rate(const ads129x_sim *sim);
+uint32_t ads129x_sim_get_period_us(const ads129x_sim_board *board);
+
+#endif /* ADS129X_SIM_H */
@@ -0,0 +1,361 @@
+/*
+* @file           ecg_replay.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, MCU1 of the board with the simulated ADS129x and
+*                 23K640. Recorded frames go out of the devices at their DRDYs
+*                 through ads129x, app_ecg and meas_mngr to the RAM, where the
+*                 records are read back as MCU2 would, with the host time of
+*                 each stage.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "ecg_replay.h"
+
+/* Host */
+#include "host_clock.h"
+
+/* SDK */
+#include "nrf_drv_gpiote.h"
+
+/* Apps */
+#include "app_ecg.h"
+#include "meas_mngr.h"
+
+/* Drivers */
+#include "mc_23k640.h"
+
+/* System utilities */
+#include "cycle_counter.h"
+#include "spi_mngr.h"
+
+/* Sense library */
+#include "sense_library/utils/utils.h"
+
+/* Standard library */
+#include <string.h>
+#include <time.h>
+
+/********************************** Private ************************************/
+#define ECG_REPLAY_ECG_GAIN           1         /* Gains of the recordings, as ecg_synth */
+#define ECG_REPLAY_RESP_GAIN          1
+#define ECG_REPLAY_SRAM_STATUS        0x43      /* Sequential mode written by the init of MCU2 */
+
+static const char *_stage_names[ECG_REPLAY_STAGES] = {"DRDY + SPI", "app_ecg", "meas_mngr", "read back"};
+
+/* Private functions list */
+static bool _ecg_replay_power_save(void);
+static void _ecg_replay_mcu2_init(ecg_replay *replay);
+static void _ecg_replay_read_back(ecg_replay *replay);
+static void _ecg_replay_process_block(ecg_replay *replay, const uint8_t *block, uint16_t size);
+static void _ecg_replay_pace(ecg_replay *replay);
+static void _ecg_replay_time(ecg_replay *replay, ecg_replay_stage stage, uint64_t start_ns);
+
+/********************************** Public ************************************/
+/*
+ * @brief Function to boot MCU1 as main.c does and start sampling
+ *
+ * @param[out] replay       Replay, only one per process as the firmware modules are single instance
+ * @param[in] accuracy      True for APP_ECG_HP_RATE, otherwise APP_ECG_LP_RATE
+ * @param[in] speed         ECG_REPLAY_REAL_TIME, N times faster or ECG_REPLAY_MAX_SPEED
+ * @retval                  Returns true if the devices were found and are sampling
+ */
+bool ecg_replay_init(ecg_replay *replay, bool accuracy, uint32_t speed) {
+
+  uint32_t waited_ms = 0;
+
+  memset(replay, 0, sizeof(ecg_replay));
+  replay->speed = speed;
+  ram_record_parser_init(&replay->parser, replay->parser_buffer, sizeof(replay->parser_buffer));
+
+  /* Board, the RAM of MCU1 is the second device of its SPI bus */
+  ads129x_sim_init(&replay->board);
+  mc_23k640_sim_init(&replay->ram);
+  mc_23k640_sim_attach(&replay->ram, MC_23k640_CS1);
+  _ecg_replay_mcu2_init(replay);
+
+  /* MCU1 of main.c */
+  nrf_drv_gpiote_init();
+  spi_mngr_init(SPI_MNGR_CONFIG1);
+  spi_mngr_init(SPI_MNGR_CONFIG3);
+  app_ecg_init(_ecg_replay_power_save);
+  meas_mngr_init();
+  while(app_ecg_is_busy()) {
+    app_ecg_loop();
+    if(++waited_ms > ECG_REPLAY_BOOT_TIMEOUT_MS) {
+      return false;
+    }
+    host_clock_advance_us(1000);
+  }
+  if(!app_ecg_config(accuracy, false, ECG_REPLAY_ECG_GAIN, ECG_REPLAY_RESP_GAIN, ADS129X_NORMAL) || !app_ecg_start_sample()) {
+    return false;
+  }
+
+  replay->period_us = ads129x_sim_get_period_us(&replay->board);
+  replay->start_ns = host_clock_get_host_ns();
+  return true;
+
+}
+
+
+/*
+ * @brief Function to set a callback for every frame decoded from the RAM
+ *
+ * @param[in] replay        Replay
+ * @param[in] callback      Callback, or NULL to remove it
+ * @param[in] context       Passed to the callback
+ */
+void ecg_replay_set_frame_callback(ecg_replay *replay, ecg_replay_frame_callback_def callback, void *context) {
+
+  replay->frame_callback = callback;
+  replay->frame_context = context;
+
+}
+
+
+/*
+ * @brief Function to run one DRDY period with a frame of the recording
+ *
+ * @param[in] replay        Replay
+ * @param[in] frame         ADS129X_REPLAY_FRAME_SIZE bytes, ADS1298 data followed by ADS1296R data
+ * @retval                  Returns true if the devices were converting and took the frame
+ */
+bool ecg_replay_feed(ecg_replay *replay, const uint8_t *frame) {
+
+  uint64_t start;
+  bool converting;
+
+  host_clock_advance_us(replay->period_us);
+
+  start = host_clock_get_host_ns();
+  converting = ads129x_sim_drdy(&replay->board, frame);
+  host_spi_process();
+  _ecg_replay_time(replay, ECG_REPLAY_STAGE_DRDY, start);
+
+  /* Frames read in one loop and processed in the next */
+  start = host_clock_get_host_ns();
+  app_ecg_loop();
+  app_ecg_loop();
+  _ecg_replay_time(replay, ECG_REPLAY_STAGE_APP_ECG, start);
+
+  start = host_clock_get_host_ns();
+  meas_mngr_loop();
+  _ecg_replay_time(replay, ECG_REPLAY_STAGE_MEAS_MNGR, start);
+
+  start = host_clock_get_host_ns();
+  _ecg_replay_read_back(replay);
+  _ecg_replay_time(replay, ECG_REPLAY_STAGE_READ_BACK, start);
+
+  if(converting) {
+    replay->fed++;
+  }
+  _ecg_replay_pace(replay);
+  return converting;
+
+}
+
+
+/*
+ * @brief Function to stop sampling, the last frames are stored and read back
+ *
+ * @param[in] replay        Replay
+ * @retval                  Returns true if the sampling stopped and the staged records were written
+ */
+bool ecg_replay_finish(ecg_replay *replay) {
+
+  bool stopped;
+
+  /* Frames read and not processed yet */
+  app_ecg_loop();
+  stopped = app_ecg_stop_sample() && meas_mngr_flush();
+  _ecg_replay_read_back(replay);
+  replay->host_ns = host_clock_get_host_ns() - replay->start_ns;
+  return stopped;
+
+}
+
+
+/*
+ * @brief Function to get the frames lost on the way to app_ecg
+ *
+ * @param[in] replay        Replay
+ * @retval                  Frames overwritten in the devices or dropped by ads129x
+ */
+uint32_t ecg_replay_get_dropped_frames(const ecg_replay *replay) {
+  return replay->board.ads1298.missed + ads129x_get_dropped_frames() + ads129x_get_overruns();
+}
+
+
+/*
+ * @brief Function to print the report of the run
+ *
+ * @param[in] replay        Replay
+ * @param[in] file          Output
+ */
+void ecg_replay_print(const ecg_replay *replay, FILE *file) {
+
+  double seconds = (double)replay->host_ns / 1e9;
+  double recorded = (double)replay->fed * replay->period_us / 1e6;
+  cycle_counter_stats *isr = ads129x_get_isr_stats();
+  ram_record_parser const *parser = &replay->parser;
+
+  fprintf(file, "Frames: %u fed, %u delivered, %u dropped (devices %u, ring %u, overruns %u), %u gaps\n",
+          replay->fed, replay->delivered, ecg_replay_get_dropped_frames(replay), replay->board.ads1298.missed,
+          ads129x_get_dropped_frames(), ads129x_get_overruns(), replay->gaps);
+  fprintf(file, "Throughput: %.1f s recorded in %.3f s, %.0f frames/s, %.1fx real time\n",
+          recorded, seconds, seconds > 0 ? replay->fed / seconds : 0.0, seconds > 0 ? recorded / seconds : 0.0);
+  fprintf(file, "Records: %u, blocks %u, lost %u, CRC errors %u, stale %u, bytes skipped %u, decode errors %u\n",
+          parser->records, replay->blocks, parser->lost, parser->crc_errors, parser->stale, parser->skipped, replay->decode_errors);
+  fprintf(file, "Beats: %u, last HR %u bpm, compression %u.%02u\n",
+          replay->beats, replay->hr_bpm, app_ecg_get_compression_ratio() / 100, app_ecg_get_compression_ratio() % 100);
+
+  fprintf(file, "%-12s %10s %12s %12s\n", "Stage", "Calls", "Mean ns", "Max ns");
+  for(uint8_t i = 0 ; i < ECG_REPLAY_STAGES ; i++) {
+    ecg_replay_timing const *timing = &replay->timing[i];
+    fprintf(file, "%-12s %10u %12llu %12llu\n", _stage_names[i], timing->count,
+            timing->count ? (unsigned long long)(timing->total_ns / timing->count) : 0ULL, (unsigned long long)timing->max_ns);
+  }
+  fprintf(file, "DRDY ISR: %u calls, mean %u cycles, max %u cycles, %u over budget\n",
+          isr->count, cycle_counter_stats_mean(isr), isr->max, isr->over_budget);
+  fprintf(file, "Filter: %u cycles/sample, QRS: %u cycles/sample\n",
+          app_ecg_get_filter_cycles_per_sample(), app_ecg_get_qrs_cycles_per_sample());
+  fprintf(file, "RAM: %u bytes written and %u read by MCU1, %u B/s while it holds the bus, free min %u\n",
+          replay->ram.bytes_written, replay->ram.bytes_read, mc_23k640_get_throughput(),
+          flow_stats_get_value(meas_mngr_get_flow_stats(MEAS_MNGR_FLOW_RAM), FLOW_STATS_FREE_MIN));
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function of app_ecg to check the battery saving mode, never on the host
+ */
+static bool _ecg_replay_power_save(void) {
+  return false;
+}
+
+
+/*
+ * @brief Function to leave the RAM as the init of MCU2 does, sequential mode and an empty ring
+ */
+static void _ecg_replay_mcu2_init(ecg_replay *replay) {
+
+  replay->ram.status = ECG_REPLAY_SRAM_STATUS;
+  utils_save_uint16_t_to_array(&replay->ram.memory[TAIL_INDEX_MEMORY_ADDR], 0);
+  utils_save_uint16_t_to_array(&replay->ram.memory[HEAD_INDEX_MEMORY_ADDR], 0);
+
+}
+
+
+/*
+ * @brief Function to read the published records from the RAM and free them, as the drain of MCU2
+ */
+static void _ecg_replay_read_back(ecg_replay *replay) {
+
+  uint8_t *memory = replay->ram.memory;
+  uint16_t head = utils_get_uint16_from_array(&memory[HEAD_INDEX_MEMORY_ADDR]);
+  uint16_t tail = utils_get_uint16_from_array(&memory[TAIL_INDEX_MEMORY_ADDR]);
+  ram_record record;
+
+  while(tail != head) {
+    uint16_t space;
+    uint8_t *ptr = ram_record_parser_get_space(&replay->parser, &space);
+    uint16_t nbytes = (head > tail) ? head - tail : DATA_MEMORY_SIZE - tail;
+
+    if(nbytes > space) {
+      nbytes = space;
+    }
+    memcpy(ptr, &memory[DATA_MEMORY_ADDR + tail], nbytes);
+    ram_record_parser_commit(&replay->parser, nbytes);
+    tail = (tail + nbytes) % DATA_MEMORY_SIZE;
+
+    while(ram_record_parser_next(&replay->parser, &record)) {
+      if(record.type == RAM_RECORD_ALERT && record.length && record.payload[0] == ECG_BLOCK_TYPE) {
+        _ecg_replay_process_block(replay, record.payload, record.length);
+      }
+    }
+  }
+  utils_save_uint16_t_to_array(&memory[TAIL_INDEX_MEMORY_ADDR], tail);
+
+}
+
+
+/*
+ * @brief Function to decode a block of ECG frames and check the sample index runs on
+ */
+static void _ecg_replay_process_block(ecg_replay *replay, const uint8_t *block, uint16_t size) {
+
+  ecg_codec_frame frame;
+
+  if(!ecg_codec_decoder_init(&replay->decoder, block, size)) {
+    replay->decode_errors++;
+    return;
+  }
+  replay->blocks++;
+  while(ecg_codec_decode(&replay->decoder, &frame)) {
+    if(replay->has_sample && frame.sample != replay->next_sample) {
+      replay->gaps++;
+    }
+    replay->next_sample = frame.sample + 1;
+    replay->has_sample = true;
+    replay->delivered++;
+
+    /* Vital signs of app_ecg_vitals, a beat has its RR interval */
+    if(frame.fields[ECG_CODEC_FIELD_RR]) {
+      replay->beats++;
+      replay->hr_bpm = frame.fields[ECG_CODEC_FIELD_HR];
+    }
+    if(replay->frame_callback) {
+      replay->frame_callback(&frame, replay->frame_context);
+    }
+  }
+  if(replay->decoder.error) {
+    replay->decode_errors++;
+  }
+
+}
+
+
+/*
+ * @brief Function to wait for the host time of the fed frames at the speed of the replay
+ */
+static void _ecg_replay_pace(ecg_replay *replay) {
+
+  uint64_t target;
+  uint64_t now;
+  struct timespec wait;
+
+  if(replay->speed == ECG_REPLAY_MAX_SPEED) {
+    return;
+  }
+  target = replay->start_ns + (uint64_t)replay->fed * replay->period_us * 1000 / replay->speed;
+  now = host_clock_get_host_ns();
+  if(now < target) {
+    wait.tv_sec = (time_t)((target - now) / 1000000000ULL);
+    wait.tv_nsec = (long)((target - now) % 1000000000ULL);
+    nanosleep(&wait, NULL);
+  }
+
+}
+
+
+/*
+ * @brief Function to add the host time of a stage
+ */
+static void _ecg_replay_time(ecg_replay *replay, ecg_replay_stage stage, uint64_t start_ns) {
+
+  ecg_replay_timing *timing = &replay->timing[stage];
+  uint64_t ns = host_clock_get_host_ns() - start_ns;
+
+  timing->count++;
+  timing->total_ns += ns;
+  if(ns > timing->max_ns) {
+    timing->max_ns = ns;
+  }
+
+}
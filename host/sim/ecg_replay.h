@@ -0,0 +1,95 @@
+/*
+* @file           ecg_replay.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, MCU1 of the board with the simulated ADS129x and
+*                 23K640. Recorded frames go out of the devices at their DRDYs
+*                 through ads129x, app_ecg and meas_mngr to the RAM, where the
+*                 records are read back as MCU2 would, with the host time of
+*                 each stage.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef ECG_REPLAY_H
+#define ECG_REPLAY_H
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "ads129x_sim.h"
+#include "mc_23k640_sim.h"
+
+/* DSP */
+#include "ecg_codec.h"
+
+/* System utilities */
+#include "ram_record.h"
+
+/* Standard library */
+#include <stdio.h>
+
+/********************************** Definitions ***********************************/
+#define ECG_REPLAY_REAL_TIME          1         /* Speed of the recording sampling rate */
+#define ECG_REPLAY_MAX_SPEED          0         /* Frames fed as fast as the host runs them */
+#define ECG_REPLAY_BOOT_TIMEOUT_MS    2000      /* Power-up of the devices by app_ecg */
+#define ECG_REPLAY_PARSER_SIZE        2048      /* Records read back, RAM_RECORD_PARSER_BUFFER_SIZE of MCU2 */
+
+/* Stages of a DRDY period */
+typedef enum {
+  ECG_REPLAY_STAGE_DRDY,                        /* DRDY interrupt and the SPI read of the frame */
+  ECG_REPLAY_STAGE_APP_ECG,                     /* app_ecg_loop, with the RAM writes of meas_mngr */
+  ECG_REPLAY_STAGE_MEAS_MNGR,                   /* meas_mngr_loop, the staged records flush */
+  ECG_REPLAY_STAGE_READ_BACK,                   /* Records read from the RAM, as MCU2 */
+  ECG_REPLAY_STAGES
+} ecg_replay_stage;
+
+/* Host time of a stage */
+typedef struct {
+  uint32_t  count;
+  uint64_t  total_ns;
+  uint64_t  max_ns;
+} ecg_replay_timing;
+
+/* Frame decoded from a block read back, for the checks of the caller */
+typedef void (*ecg_replay_frame_callback_def)(const ecg_codec_frame *frame, void *context);
+
+/* Replay */
+typedef struct {
+  ads129x_sim_board             board;
+  mc_23k640_sim                 ram;
+  uint32_t                      speed;          /* ECG_REPLAY_REAL_TIME, N times faster or ECG_REPLAY_MAX_SPEED */
+  uint32_t                      period_us;      /* DRDY period of the configured rate */
+
+  /* Read back, MCU2 side */
+  ram_record_parser             parser;
+  uint8_t                       parser_buffer[ECG_REPLAY_PARSER_SIZE];
+  ecg_codec                     decoder;
+  ecg_replay_frame_callback_def frame_callback;
+  void                          *frame_context;
+  uint32_t                      next_sample;
+  bool                          has_sample;
+
+  /* Results */
+  uint32_t                      fed;            /* Frames given to the devices */
+  uint32_t                      delivered;      /* Frames decoded from the RAM */
+  uint32_t                      blocks;
+  uint32_t                      gaps;           /* Jumps in the sample index of the frames decoded */
+  uint32_t                      decode_errors;
+  uint32_t                      beats;          /* Frames with an RR interval */
+  uint16_t                      hr_bpm;         /* Heart rate of the last beat */
+  uint64_t                      start_ns;
+  uint64_t                      host_ns;        /* Host time of the whole run */
+  ecg_replay_timing             timing[ECG_REPLAY_STAGES];
+} ecg_replay;
+
+/********************************** Functions ***********************************/
+bool ecg_replay_init(ecg_replay *replay, bool accuracy, uint32_t speed);
+void ecg_replay_set_frame_callback(ecg_replay *replay, ecg_replay_frame_callback_def callback, void *context);
+bool ecg_replay_feed(ecg_replay *replay, const uint8_t *frame);
+bool ecg_replay_finish(ecg_replay *replay);
+uint32_t ecg_replay_get_dropped_frames(const ecg_replay *replay);
+void ecg_replay_print(const ecg_replay *replay, FILE *file);
+
+#endif /* ECG_REPLAY_H */
@@ -0,0 +1,230 @@
+/*
+* @file           ecg_synth.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, synthetic recordings for the simulated ADS129x,
+*                 beats of P, QRS and T waves on every lead, a respiration on
+*                 RESP and noise, as the frames read from the devices.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "ecg_synth.h"
+
+/* SDK */
+#include "app_util.h"
+
+/* Standard library */
+#include <math.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define ECG_SYNTH_FIRST_BEAT_MS       400       /* First R peak, after a whole P wave */
+#define ECG_SYNTH_RESP_UV             2000      /* Peak of the respiration on RESP */
+#define ECG_SYNTH_STATUS              ADS129X_DATA_ID   /* Status word, no lead-off and no pace */
+
+/* Waves of a beat on lead II, time from the R peak, amplitude and width */
+typedef struct {
+  double    seconds;
+  double    uv;
+  double    width;
+} ecg_synth_wave;
+
+static const ecg_synth_wave _waves[] = {
+  {-0.200,   150.0, 0.025},                     /* P */
+  {-0.025,  -100.0, 0.008},                     /* Q */
+  { 0.000,  1200.0, 0.010},                     /* R */
+  { 0.025,  -300.0, 0.008},                     /* S */
+  { 0.300,   350.0, 0.040}                      /* T */
+};
+
+/* Channel and amplitude against lead II in percent of V2 to V6 */
+static const struct {
+  uint8_t   channel;
+  int32_t   percent;
+} _chest_leads[] = {
+  { ADS129X_LEAD_V2_CHANNEL,  80 },
+  { ADS129X_LEAD_V3_CHANNEL, 100 },
+  { ADS129X_LEAD_V4_CHANNEL, 120 },
+  { ADS129X_LEAD_V5_CHANNEL, 110 },
+  { ADS129X_LEAD_V6_CHANNEL,  90 },
+};
+
+/* Private functions list */
+static double _ecg_synth_beat(double seconds);
+static uint32_t _ecg_synth_random(ecg_synth *synth);
+static int32_t _ecg_synth_noise(ecg_synth *synth);
+static uint32_t _ecg_synth_rr(ecg_synth *synth);
+static void _ecg_synth_put(uint8_t *bytes, int32_t uv, uint8_t gain);
+
+/********************************** Public ************************************/
+/*
+ * @brief Function to start a recording
+ *
+ * @param[out] synth        Generator, the gains are 1 and the noise 10 uV, they can be changed before the first frame
+ * @param[in] rate          Samples per second, of the CONFIG1 the devices are configured with
+ * @param[in] hr_bpm        Mean heart rate
+ * @param[in] resp_bpm      Respiration rate
+ */
+void ecg_synth_init(ecg_synth *synth, uint32_t rate, uint16_t hr_bpm, uint16_t resp_bpm) {
+
+  memset(synth, 0, sizeof(ecg_synth));
+  synth->rate = rate;
+  synth->hr_bpm = hr_bpm;
+  synth->resp_bpm = resp_bpm;
+  synth->ecg_gain = ADS129X_GAIN1;
+  synth->resp_gain = ADS129X_GAIN1;
+  synth->noise_uv = 10;
+  synth->seed = 0x2545F491;
+
+  synth->next_beat = (int32_t)(rate * ECG_SYNTH_FIRST_BEAT_MS / 1000);
+  synth->last_beat = synth->next_beat - (int32_t)_ecg_synth_rr(synth);
+
+}
+
+
+/*
+ * @brief Function to get the next frame
+ *
+ * @param[in] synth         Generator
+ * @param[out] frame        ADS129X_REPLAY_FRAME_SIZE bytes, ADS1298 data followed by ADS1296R data
+ * @retval                  Returns true if the frame is the R peak of a beat
+ */
+bool ecg_synth_next(ecg_synth *synth, uint8_t *frame) {
+
+  double t = (double)synth->sample / synth->rate;
+  double wave = _ecg_synth_beat((double)((int32_t)synth->sample - synth->last_beat) / synth->rate) +
+                _ecg_synth_beat((double)((int32_t)synth->sample - synth->next_beat) / synth->rate);
+  int32_t lead_ii = (int32_t)lround(wave);
+  int32_t lead_i = lead_ii * 6 / 10;
+  int32_t channels[ADS129X_CHANNELS] = {0};
+  uint8_t *ads1298 = frame;
+  uint8_t *ads1296r = &frame[ADS129X_SW_BUFFER_SIZE];
+  bool peak = ((int32_t)synth->sample == synth->next_beat);
+
+  /* Inputs of the devices, the powered down and shorted channels give only noise */
+  channels[ADS129X_LEAD_I_CHANNEL] = lead_i;
+  channels[ADS129X_LEAD_II_CHANNEL] = lead_ii;
+  for(uint8_t i = 0 ; i < ARRAY_SIZE(_chest_leads) ; i++) {
+    channels[_chest_leads[i].channel] = lead_ii * _chest_leads[i].percent / 100;
+  }
+  channels[ADS129X_RESP_CHANNEL] = (int32_t)lround(ECG_SYNTH_RESP_UV * sin(2 * M_PI * synth->resp_bpm * t / 60));
+
+  /* Status words and channels of each device */
+  memset(frame, 0, ADS129X_REPLAY_FRAME_SIZE);
+  ads1298[0] = ECG_SYNTH_STATUS;
+  ads1296r[0] = ECG_SYNTH_STATUS;
+  for(uint8_t ch = 0 ; ch < ADS129X_CHANNELS ; ch++) {
+    uint8_t *bytes = (ch < ADS129X_8_CHANNELS) ? &ads1298[ADS129X_CH1_IDX + ch * ADS129X_3BYTE] :
+                                                 &ads1296r[ADS129X_CH1_IDX + (ch - ADS129X_8_CHANNELS) * ADS129X_3BYTE];
+    _ecg_synth_put(bytes, channels[ch] + _ecg_synth_noise(synth), (ch == ADS129X_RESP_CHANNEL) ? synth->resp_gain : synth->ecg_gain);
+  }
+
+  /* Next beat */
+  if(peak) {
+    synth->last_beat = synth->next_beat;
+    synth->next_beat += (int32_t)_ecg_synth_rr(synth);
+    synth->beats++;
+  }
+  synth->sample++;
+  return peak;
+
+}
+
+
+/*
+ * @brief Function to get the code of the devices for a voltage, the inverse of ADS129X_CONVERT_UV
+ *
+ * @param[in] uv            Microvolts at the input
+ * @param[in] gain          PGA gain, 1,2,3,4,6,8 or 12
+ * @retval                  24-bit two's complement code, in an int32
+ */
+int32_t ecg_synth_to_code(int32_t uv, uint8_t gain) {
+
+  int64_t code = ((int64_t)uv * gain * ADS129X_FULL_SCALE_CODES + ADS129X_REF_UV) / (2 * ADS129X_REF_UV);
+
+  if(code > 0x7FFFFF) {
+    code = 0x7FFFFF;
+  } else if(code < -0x800000) {
+    code = -0x800000;
+  }
+  return (int32_t)code;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to get lead II of one beat
+ *
+ * @param[in] seconds       Time from the R peak of the beat
+ * @retval                  Microvolts
+ */
+static double _ecg_synth_beat(double seconds) {
+
+  double uv = 0;
+
+  for(uint8_t i = 0 ; i < ARRAY_SIZE(_waves) ; i++) {
+    double x = (seconds - _waves[i].seconds) / _waves[i].width;
+    uv += _waves[i].uv * exp(-0.5 * x * x);
+  }
+  return uv;
+
+}
+
+
+/*
+ * @brief Function to get the next number of the random generator, xorshift32 so the recordings are the same on every run
+ */
+static uint32_t _ecg_synth_random(ecg_synth *synth) {
+
+  synth->seed ^= synth->seed << 13;
+  synth->seed ^= synth->seed >> 17;
+  synth->seed ^= synth->seed << 5;
+  return synth->seed;
+
+}
+
+
+/*
+ * @brief Function to get the noise of a sample
+ */
+static int32_t _ecg_synth_noise(ecg_synth *synth) {
+
+  if(!synth->noise_uv) {
+    return 0;
+  }
+  return (int32_t)(_ecg_synth_random(synth) % (uint32_t)(2 * synth->noise_uv + 1)) - synth->noise_uv;
+
+}
+
+
+/*
+ * @brief Function to get the RR interval of the next beat, the mean of hr_bpm with ECG_SYNTH_RR_JITTER
+ */
+static uint32_t _ecg_synth_rr(ecg_synth *synth) {
+
+  uint32_t rr = synth->rate * 60 / synth->hr_bpm;
+  int32_t jitter = (int32_t)(_ecg_synth_random(synth) % (2 * ECG_SYNTH_RR_JITTER + 1)) - ECG_SYNTH_RR_JITTER;
+
+  return (uint32_t)((int32_t)rr + (int32_t)rr * jitter / 100);
+
+}
+
+
+/*
+ * @brief Function to put a channel in the frame, 24 bits big-endian
+ */
+static void _ecg_synth_put(uint8_t *bytes, int32_t uv, uint8_t gain) {
+
+  uint32_t code = (uint32_t)ecg_synth_to_code(uv, gain);
+
+  bytes[0] = (uint8_t)(code >> 16);
+  bytes[1] = (uint8_t)(code >> 8);
+  bytes[2] = (uint8_t)code;
+
+}
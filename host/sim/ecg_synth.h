@@ -0,0 +1,45 @@
+/*
+* @file           ecg_synth.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, synthetic recordings for the simulated ADS129x,
+*                 beats of P, QRS and T waves on every lead, a respiration on
+*                 RESP and noise, as the frames read from the devices.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef ECG_SYNTH_H
+#define ECG_SYNTH_H
+
+/*********************************** Includes ***********************************/
+/* Drivers */
+#include "ads129x.h"
+
+/********************************** Definitions ***********************************/
+#define ECG_SYNTH_RR_JITTER           3         /* RR intervals vary up to this percent, beat to beat */
+
+/* Generator */
+typedef struct {
+  uint32_t  rate;                               /* Samples per second */
+  uint16_t  hr_bpm;
+  uint16_t  resp_bpm;
+  uint8_t   ecg_gain;                           /* Gains the devices are configured with */
+  uint8_t   resp_gain;
+  int32_t   noise_uv;                           /* Peak of the uniform noise */
+  uint32_t  seed;
+
+  uint32_t  sample;                             /* Next sample */
+  int32_t   last_beat;                          /* Sample of the R peaks before and after the next sample */
+  int32_t   next_beat;
+  uint32_t  beats;
+} ecg_synth;
+
+/********************************** Functions ***********************************/
+void ecg_synth_init(ecg_synth *synth, uint32_t rate, uint16_t hr_bpm, uint16_t resp_bpm);
+bool ecg_synth_next(ecg_synth *synth, uint8_t *frame);
+int32_t ecg_synth_to_code(int32_t uv, uint8_t gain);
+
+#endif /* ECG_SYNTH_H */
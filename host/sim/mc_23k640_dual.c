@@ -0,0 +1,251 @@
+/*
+* @file           mc_23k640_dual.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the 23K640 shared by MCU1 and MCU2, each on its
+*                 own thread with its own build of mc_23k640. MCU1 writes
+*                 numbered records in the ring while MCU2 reads them back and
+*                 checks every byte, with the threads interleaved at random
+*                 and the faults of the simulated device.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "mc_23k640_dual.h"
+
+/* Host */
+#include "host_clock.h"
+
+/* System utilities */
+#include "cycle_counter.h"
+#include "spi_mngr.h"
+
+/* Standard library */
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define MC_23K640_DUAL_SRAM_MODE      MC_23K640_SIM_SEQUENTIAL_MODE   /* Written by the init of MCU2 */
+
+/* Private functions list */
+static uint32_t _mc_23k640_dual_hash(uint32_t x);
+static uint16_t _mc_23k640_dual_payload(const mc_23k640_dual *dual, uint16_t sequence, uint8_t *payload);
+static void _mc_23k640_dual_check(mc_23k640_dual *dual, const ram_record *record);
+static void *_mc_23k640_dual_mcu1(void *context);
+static void *_mc_23k640_dual_mcu2(void *context);
+
+/********************************** Public ************************************/
+/*
+ * @brief Function to connect the RAM to both MCUs and run their init, MCU2 first as it sets the mode and the ring
+ *
+ * @param[out] dual         Run, only one per process as the builds of mc_23k640 are single instance
+ * @param[in] seed          Lengths and contents of the records
+ * @retval                  Returns true if both inits succeeded and the RAM is in sequential mode
+ */
+bool mc_23k640_dual_init(mc_23k640_dual *dual, uint32_t seed) {
+
+  bool init;
+
+  memset(dual, 0, sizeof(mc_23k640_dual));
+  dual->seed = seed;
+  dual->payload_max = MC_23K640_DUAL_PAYLOAD_MAX;
+  ram_record_parser_init(&dual->parser, dual->parser_buffer, sizeof(dual->parser_buffer));
+  mc_23k640_sim_init(&dual->ram);
+  host_mcu_init(&dual->mcu1);
+  host_mcu_init(&dual->mcu2);
+
+  host_mcu_bind(&dual->mcu2);
+  mc_23k640_sim_attach(&dual->ram, MC_23k640_CS1);
+  mcu2_spi_mngr_init(SPI_MNGR_CONFIG3);
+  init = mcu2_mc_23k640_init();
+
+  host_mcu_bind(&dual->mcu1);
+  mc_23k640_sim_attach(&dual->ram, MC_23k640_CS1);
+  mcu1_spi_mngr_init(SPI_MNGR_CONFIG3);
+  init = mcu1_mc_23k640_init() && init;
+
+  host_mcu_bind(NULL);
+  return init && mc_23k640_sim_get_mode(&dual->ram) == MC_23K640_DUAL_SRAM_MODE;
+
+}
+
+
+/*
+ * @brief Function to write records from MCU1 until all are read back by MCU2
+ *
+ * @param[in] dual          Run, the records follow the ones of the previous runs
+ * @param[in] records       Records to write
+ * @retval                  Returns true if the threads ran
+ */
+bool mc_23k640_dual_run(mc_23k640_dual *dual, uint32_t records) {
+
+  pthread_t mcu1;
+  pthread_t mcu2;
+  uint64_t start = host_clock_get_host_ns();
+
+  dual->records = records;
+  dual->done = false;
+  if(pthread_create(&mcu2, NULL, _mc_23k640_dual_mcu2, dual)) {
+    return false;
+  }
+  if(pthread_create(&mcu1, NULL, _mc_23k640_dual_mcu1, dual)) {
+    __atomic_store_n(&dual->done, true, __ATOMIC_SEQ_CST);
+    pthread_join(mcu2, NULL);
+    return false;
+  }
+  pthread_join(mcu1, NULL);
+  pthread_join(mcu2, NULL);
+
+  dual->host_ns += host_clock_get_host_ns() - start;
+  dual->throughput[0] = mcu1_mc_23k640_get_throughput();
+  dual->throughput[1] = mcu2_mc_23k640_get_throughput();
+  dual->arb[0] = *mcu1_mc_23k640_get_arb_stats();
+  dual->arb[1] = *mcu2_mc_23k640_get_arb_stats();
+  return true;
+
+}
+
+
+/*
+ * @brief Function to print the report of the runs
+ *
+ * @param[in] dual          Run
+ * @param[in] file          Output
+ */
+void mc_23k640_dual_print(const mc_23k640_dual *dual, FILE *file) {
+
+  double seconds = (double)dual->host_ns / 1e9;
+  ram_record_parser const *parser = &dual->parser;
+
+  fprintf(file, "Records: %u written, %u verified, %u corrupted, lost %u, CRC errors %u, stale %u, bytes skipped %u\n",
+          dual->produced, dual->verified, dual->corrupted, parser->lost, parser->crc_errors, parser->stale, parser->skipped);
+  fprintf(file, "Faults: %u torn writes, %u bit flips; ring full %u times, empty %u times\n",
+          dual->ram.torn_writes, dual->ram.bit_flips, dual->full, dual->empty);
+  fprintf(file, "Throughput: %llu bytes in %.3f s, %.0f kB/s end to end, %u chip selects\n",
+          (unsigned long long)dual->bytes_consumed, seconds, seconds > 0 ? dual->bytes_consumed / seconds / 1000 : 0.0,
+          dual->ram.selects);
+  for(uint8_t i = 0 ; i < 2 ; i++) {
+    fprintf(file, "MCU%u: %u B/s while it holds the bus, hold mean %u us max %u us, wait max %u us\n", i + 1,
+            dual->throughput[i], CYCLE_COUNTER_CYCLES_TO_US(cycle_counter_stats_mean((cycle_counter_stats *)&dual->arb[i].hold)),
+            CYCLE_COUNTER_CYCLES_TO_US(dual->arb[i].hold.max), CYCLE_COUNTER_CYCLES_TO_US(dual->arb[i].wait.max));
+  }
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to mix the bits of a number, for the contents of the records
+ */
+static uint32_t _mc_23k640_dual_hash(uint32_t x) {
+
+  x ^= x >> 16;
+  x *= 0x7FEB352D;
+  x ^= x >> 15;
+  x *= 0x846CA68B;
+  x ^= x >> 16;
+  return x;
+
+}
+
+
+/*
+ * @brief Function to get the payload of a record, from its sequence number
+ *
+ * @retval                  Payload length
+ */
+static uint16_t _mc_23k640_dual_payload(const mc_23k640_dual *dual, uint16_t sequence, uint8_t *payload) {
+
+  uint32_t x = _mc_23k640_dual_hash(dual->seed ^ sequence);
+  uint16_t length = 1 + (uint16_t)(x % dual->payload_max);
+
+  for(uint16_t i = 0 ; i < length ; i++) {
+    payload[i] = (uint8_t)_mc_23k640_dual_hash(x + i);
+  }
+  return length;
+
+}
+
+
+/*
+ * @brief Function to check a record read back against the one written with its sequence number
+ */
+static void _mc_23k640_dual_check(mc_23k640_dual *dual, const ram_record *record) {
+
+  uint8_t payload[MC_23K640_DUAL_PAYLOAD_MAX];
+  uint16_t length = _mc_23k640_dual_payload(dual, record->sequence, payload);
+
+  if(record->type == RAM_RECORD_ALERT && record->length == length && !memcmp(record->payload, payload, length)) {
+    dual->verified++;
+  } else {
+    dual->corrupted++;
+  }
+
+}
+
+
+/*
+ * @brief Thread of MCU1, writes the records, each in one access, and waits on a full ring
+ */
+static void *_mc_23k640_dual_mcu1(void *context) {
+
+  mc_23k640_dual *dual = context;
+  uint8_t record[MC_23K640_MAX_TRANSFER_SIZE];
+
+  host_mcu_bind(&dual->mcu1);
+  for(uint32_t i = 0 ; i < dual->records ; i++) {
+    uint16_t length = _mc_23k640_dual_payload(dual, dual->sequence, &record[RAM_RECORD_HEADER_SIZE]);
+    uint16_t size = length + RAM_RECORD_OVERHEAD;
+
+    ram_record_get_header(record, RAM_RECORD_ALERT, dual->sequence, length);
+    ram_record_get_crc(&record[RAM_RECORD_HEADER_SIZE + length], record, &record[RAM_RECORD_HEADER_SIZE], length);
+    while(mcu1_mc_23k640_write_data(record, size) != size) {
+      dual->full++;
+      sched_yield();
+    }
+    dual->sequence++;
+    dual->produced++;
+    dual->bytes_produced += size;
+  }
+  __atomic_store_n(&dual->done, true, __ATOMIC_SEQ_CST);
+  return NULL;
+
+}
+
+
+/*
+ * @brief Thread of MCU2, reads the ring as the drain of meas_mngr until it is empty after MCU1 ended
+ */
+static void *_mc_23k640_dual_mcu2(void *context) {
+
+  mc_23k640_dual *dual = context;
+  mc_23k640_status status;
+  ram_record record;
+  uint16_t space;
+  uint16_t nbytes;
+  bool done;
+
+  host_mcu_bind(&dual->mcu2);
+  do {
+    uint8_t *ptr = ram_record_parser_get_space(&dual->parser, &space);
+
+    done = __atomic_load_n(&dual->done, __ATOMIC_SEQ_CST);
+    nbytes = mcu2_mc_23k640_read_data(ptr, (space > MC_23K640_DUAL_READ_CHUNK) ? MC_23K640_DUAL_READ_CHUNK : space, &status);
+    ram_record_parser_commit(&dual->parser, nbytes);
+    dual->bytes_consumed += nbytes;
+    while(ram_record_parser_next(&dual->parser, &record)) {
+      _mc_23k640_dual_check(dual, &record);
+    }
+    if(status == MC_23K640_EMPTY) {
+      dual->empty++;
+      sched_yield();
+    }
+  } while(!done || status != MC_23K640_EMPTY);
+  return NULL;
+
+}
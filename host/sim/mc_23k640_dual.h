@@ -0,0 +1,85 @@
+/*
+* @file           mc_23k640_dual.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the 23K640 shared by MCU1 and MCU2, each on its
+*                 own thread with its own build of mc_23k640. MCU1 writes
+*                 numbered records in the ring while MCU2 reads them back and
+*                 checks every byte, with the threads interleaved at random
+*                 and the faults of the simulated device.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef MC_23K640_DUAL_H
+#define MC_23K640_DUAL_H
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "mc_23k640_sim.h"
+
+/* Drivers */
+#include "mc_23k640.h"
+
+/* System utilities */
+#include "ram_record.h"
+
+/* Standard library */
+#include <stdio.h>
+
+/********************************** Definitions ***********************************/
+#define MC_23K640_DUAL_PAYLOAD_MAX    (MC_23K640_MAX_TRANSFER_SIZE - RAM_RECORD_OVERHEAD)
+#define MC_23K640_DUAL_PARSER_SIZE    2048      /* Records read back, RAM_PARSER_BUFFER_SIZE of meas_mngr */
+#define MC_23K640_DUAL_READ_CHUNK     500       /* Bytes per read, MEAS_MNGR_DRAIN_CHUNK of meas_mngr */
+
+/* Run */
+typedef struct {
+  mc_23k640_sim       ram;
+  host_mcu            mcu1;
+  host_mcu            mcu2;
+  uint32_t            seed;                     /* Lengths and contents of the records */
+  uint16_t            payload_max;              /* Payload of the records, 1 to MC_23K640_DUAL_PAYLOAD_MAX bytes */
+
+  /* MCU1, producer */
+  uint32_t            records;                  /* Records to write in the run */
+  uint16_t            sequence;
+  uint32_t            produced;
+  uint32_t            full;                     /* Writes refused on a full ring, tried again */
+  uint64_t            bytes_produced;
+  volatile bool       done;
+
+  /* MCU2, consumer */
+  ram_record_parser   parser;
+  uint8_t             parser_buffer[MC_23K640_DUAL_PARSER_SIZE];
+  uint32_t            verified;                 /* Records with the payload they were written with */
+  uint32_t            corrupted;                /* Records with a valid CRC and a wrong payload */
+  uint32_t            empty;                    /* Reads of an empty ring */
+  uint64_t            bytes_consumed;
+
+  /* Results */
+  uint64_t            host_ns;
+  uint32_t            throughput[2];            /* mc_23k640_get_throughput of MCU1 and MCU2 */
+  mc_23k640_arb_stats arb[2];
+} mc_23k640_dual;
+
+/********************************** Functions ***********************************/
+bool mc_23k640_dual_init(mc_23k640_dual *dual, uint32_t seed);
+bool mc_23k640_dual_run(mc_23k640_dual *dual, uint32_t records);
+void mc_23k640_dual_print(const mc_23k640_dual *dual, FILE *file);
+
+/* Builds of mc_23k640 for each MCU, with their symbols prefixed */
+bool mcu1_mc_23k640_init(void);
+uint16_t mcu1_mc_23k640_write_data(uint8_t *data, uint16_t bytes);
+uint32_t mcu1_mc_23k640_get_throughput(void);
+mc_23k640_arb_stats *mcu1_mc_23k640_get_arb_stats(void);
+void mcu1_spi_mngr_init(uint8_t spi_config);
+
+bool mcu2_mc_23k640_init(void);
+uint16_t mcu2_mc_23k640_read_data(uint8_t *data, uint16_t max_bytes, mc_23k640_status *status);
+uint32_t mcu2_mc_23k640_get_throughput(void);
+mc_23k640_arb_stats *mcu2_mc_23k640_get_arb_stats(void);
+void mcu2_spi_mngr_init(uint8_t spi_config);
+
+#endif /* MC_23K640_DUAL_H */
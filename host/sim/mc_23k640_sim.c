@@ -0,0 +1,266 @@
+/*
+* @file           mc_23k640_sim.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the 23K640 SPI SRAM of the board, 8 KB with the
+*                 READ, WRITE, RDSR and WRSR commands in byte, page and
+*                 sequential modes. The MCUs of several threads can share it,
+*                 a chip select holds the bus until it rises, with random
+*                 yields to interleave them and faults injected in a region.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "mc_23k640_sim.h"
+
+/* Drivers */
+#include "mc_23k640.h"
+
+/* Standard library */
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define MC_23K640_SIM_IDLE            0xFF      /* SO with nothing to send */
+#define MC_23K640_SIM_SEED            0x9E3779B9
+
+/*
+ * Random generator of the yields, one per thread so the bus is not needed to draw them
+ */
+static __thread uint32_t _yield_seed;
+
+/* Private functions list */
+static uint32_t _mc_23k640_sim_random(uint32_t *seed);
+static void _mc_23k640_sim_yield(mc_23k640_sim *sim);
+static void _mc_23k640_sim_fault(mc_23k640_sim *sim);
+static void _mc_23k640_sim_next(mc_23k640_sim *sim);
+static void _mc_23k640_sim_select(void *context);
+static uint8_t _mc_23k640_sim_exchange(void *context, uint8_t mosi);
+static void _mc_23k640_sim_deselect(void *context);
+
+/********************************** Public ************************************/
+/*
+ * @brief Function to power up the device, the contents are random as on a real power-up
+ *
+ * @param[out] sim          Device
+ */
+void mc_23k640_sim_init(mc_23k640_sim *sim) {
+
+  memset(sim, 0, sizeof(mc_23k640_sim));
+  for(uint16_t i = 0 ; i < MC_23K640_SIM_SIZE ; i++) {
+    sim->memory[i] = (uint8_t)rand();
+  }
+  sim->status = MC_23K640_SIM_STATUS_RESET;
+  sim->seed = MC_23K640_SIM_SEED;
+  pthread_mutex_init(&sim->bus, NULL);
+  sim->device.select = _mc_23k640_sim_select;
+  sim->device.exchange = _mc_23k640_sim_exchange;
+  sim->device.deselect = _mc_23k640_sim_deselect;
+  sim->device.context = sim;
+
+}
+
+
+/*
+ * @brief Function to connect the device to a chip select of the MCU of the thread
+ *
+ * @param[in] sim           Device
+ * @param[in] cs_pin        Chip select
+ */
+void mc_23k640_sim_attach(mc_23k640_sim *sim, uint32_t cs_pin) {
+  host_bus_attach(cs_pin, &sim->device);
+}
+
+
+/*
+ * @brief Function to get the mode of the status register
+ *
+ * @param[in] sim           Device
+ * @retval                  MC_23K640_SIM_BYTE_MODE, MC_23K640_SIM_SEQUENTIAL_MODE or MC_23K640_SIM_PAGE_MODE
+ */
+uint8_t mc_23k640_sim_get_mode(const mc_23k640_sim *sim) {
+  return sim->status >> MC_23K640_SIM_MODE_SHIFT;
+}
+
+
+/*
+ * @brief Function to inject faults in the commands starting in a region, as the fault injection of mc_23k640.h
+ *
+ * @param[in] sim           Device
+ * @param[in] start         First address of the region
+ * @param[in] end           Address after the region
+ * @param[in] torn_rate     One torn write in N commands, 0 for none
+ * @param[in] flip_rate     One bit flip in N read commands, 0 for none
+ * @note                    Set while no thread uses the device
+ */
+void mc_23k640_sim_set_faults(mc_23k640_sim *sim, uint16_t start, uint16_t end, uint32_t torn_rate, uint32_t flip_rate) {
+
+  sim->fault_start = start;
+  sim->fault_end = end;
+  sim->torn_rate = torn_rate;
+  sim->flip_rate = flip_rate;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to get the next number of a random generator, xorshift32
+ */
+static uint32_t _mc_23k640_sim_random(uint32_t *seed) {
+
+  if(!*seed) {
+    *seed = MC_23K640_SIM_SEED ^ (uint32_t)(uintptr_t)seed;
+  }
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+
+}
+
+
+/*
+ * @brief Function to let the other threads run, once in yield_rate calls
+ */
+static void _mc_23k640_sim_yield(mc_23k640_sim *sim) {
+
+  if(sim->yield_rate && !(_mc_23k640_sim_random(&_yield_seed) % sim->yield_rate)) {
+    sched_yield();
+  }
+
+}
+
+
+/*
+ * @brief Function to decide the fault of a READ or WRITE command, once its address is known
+ */
+static void _mc_23k640_sim_fault(mc_23k640_sim *sim) {
+
+  uint32_t rate = (sim->command == MC_23K640_WRITE_CMD) ? sim->torn_rate : sim->flip_rate;
+
+  sim->faulty = rate && sim->address >= sim->fault_start && sim->address < sim->fault_end &&
+                !(_mc_23k640_sim_random(&sim->seed) % rate);
+  if(sim->faulty) {
+    sim->fault_at = (uint16_t)(_mc_23k640_sim_random(&sim->seed) % MC_23K640_SIM_FAULT_SPAN);
+    sim->fault_bit = (uint8_t)(_mc_23k640_sim_random(&sim->seed) % 8);
+  }
+
+}
+
+
+/*
+ * @brief Function to move to the next data byte, as the mode of the status register says
+ */
+static void _mc_23k640_sim_next(mc_23k640_sim *sim) {
+
+  sim->data++;
+  switch(mc_23k640_sim_get_mode(sim)) {
+    case MC_23K640_SIM_SEQUENTIAL_MODE:
+      sim->address = (sim->address + 1) & MC_23K640_SIM_ADDR_MASK;
+      break;
+    case MC_23K640_SIM_PAGE_MODE:
+      sim->address = (sim->address & ~(MC_23K640_SIM_PAGE_SIZE - 1)) | ((sim->address + 1) & (MC_23K640_SIM_PAGE_SIZE - 1));
+      break;
+    default:
+      sim->state = MC_23K640_SIM_IGNORE;        /* Byte mode, one byte per command */
+      break;
+  }
+
+}
+
+
+/*
+ * @brief Function called on the falling edge of the chip select, waits for the bus of the other threads
+ */
+static void _mc_23k640_sim_select(void *context) {
+
+  mc_23k640_sim *sim = context;
+
+  _mc_23k640_sim_yield(sim);
+  pthread_mutex_lock(&sim->bus);
+  sim->state = MC_23K640_SIM_COMMAND;
+  sim->data = 0;
+  sim->selects++;
+
+}
+
+
+/*
+ * @brief Function to clock one byte, the address is sent MSB first and its 3 upper bits are ignored
+ */
+static uint8_t _mc_23k640_sim_exchange(void *context, uint8_t mosi) {
+
+  mc_23k640_sim *sim = context;
+  uint8_t miso = MC_23K640_SIM_IDLE;
+
+  _mc_23k640_sim_yield(sim);
+  switch(sim->state) {
+    case MC_23K640_SIM_COMMAND:
+      sim->command = mosi;
+      if(mosi == MC_23K640_READ_CMD || mosi == MC_23K640_WRITE_CMD) {
+        sim->state = MC_23K640_SIM_ADDRESS_HIGH;
+      } else if(mosi == MC_23K640_READ_STAT_CMD || mosi == MC_23K640_WRITE_STAT_CMD) {
+        sim->state = MC_23K640_SIM_STATUS;
+      } else {
+        sim->state = MC_23K640_SIM_IGNORE;
+      }
+      break;
+    case MC_23K640_SIM_ADDRESS_HIGH:
+      sim->address = (uint16_t)(mosi << 8);
+      sim->state = MC_23K640_SIM_ADDRESS_LOW;
+      break;
+    case MC_23K640_SIM_ADDRESS_LOW:
+      sim->address = (sim->address | mosi) & MC_23K640_SIM_ADDR_MASK;
+      sim->state = MC_23K640_SIM_DATA;
+      _mc_23k640_sim_fault(sim);
+      break;
+    case MC_23K640_SIM_DATA:
+      if(sim->command == MC_23K640_READ_CMD) {
+        miso = sim->memory[sim->address];
+        if(sim->faulty && sim->data == sim->fault_at) {
+          miso ^= 1 << sim->fault_bit;
+          sim->bit_flips++;
+        }
+        sim->bytes_read++;
+      } else if(!sim->faulty || sim->data < sim->fault_at) {
+        sim->memory[sim->address] = mosi;
+        sim->bytes_written++;
+      } else if(sim->data == sim->fault_at) {
+        sim->torn_writes++;                     /* The rest of the write is lost */
+      }
+      _mc_23k640_sim_next(sim);
+      break;
+    case MC_23K640_SIM_STATUS:
+      if(sim->command == MC_23K640_READ_STAT_CMD) {
+        miso = sim->status;
+      } else {
+        sim->status = mosi;
+        sim->state = MC_23K640_SIM_IGNORE;
+      }
+      break;
+    default:
+      break;
+  }
+  return miso;
+
+}
+
+
+/*
+ * @brief Function called on the rising edge of the chip select, gives the bus to the other threads
+ */
+static void _mc_23k640_sim_deselect(void *context) {
+
+  mc_23k640_sim *sim = context;
+
+  sim->state = MC_23K640_SIM_COMMAND;
+  sim->faulty = false;
+  pthread_mutex_unlock(&sim->bus);
+
+}
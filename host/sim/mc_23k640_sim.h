@@ -0,0 +1,90 @@
+/*
+* @file           mc_23k640_sim.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, the 23K640 SPI SRAM of the board, 8 KB with the
+*                 READ, WRITE, RDSR and WRSR commands in byte, page and
+*                 sequential modes. The MCUs of several threads can share it,
+*                 a chip select holds the bus until it rises, with random
+*                 yields to interleave them and faults injected in a region.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef MC_23K640_SIM_H
+#define MC_23K640_SIM_H
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_bus.h"
+
+/* Standard library */
+#include <pthread.h>
+
+/********************************** Definitions ***********************************/
+#define MC_23K640_SIM_SIZE            8192
+#define MC_23K640_SIM_PAGE_SIZE       32
+#define MC_23K640_SIM_ADDR_MASK       (MC_23K640_SIM_SIZE - 1)
+
+/* Modes of the status register, bits 7 and 6 */
+#define MC_23K640_SIM_MODE_SHIFT      6
+#define MC_23K640_SIM_BYTE_MODE       0
+#define MC_23K640_SIM_SEQUENTIAL_MODE 1
+#define MC_23K640_SIM_PAGE_MODE       2
+#define MC_23K640_SIM_STATUS_RESET    0x02      /* Byte mode, HOLD enabled */
+#define MC_23K640_SIM_FAULT_SPAN      512       /* Data bytes of a command where a fault can start */
+
+/* Decoder of the bytes of a chip select */
+typedef enum {
+  MC_23K640_SIM_COMMAND,
+  MC_23K640_SIM_ADDRESS_HIGH,
+  MC_23K640_SIM_ADDRESS_LOW,
+  MC_23K640_SIM_DATA,
+  MC_23K640_SIM_STATUS,                         /* RDSR answer or WRSR value */
+  MC_23K640_SIM_IGNORE                          /* Until the chip select rises */
+} mc_23k640_sim_state;
+
+/* Device */
+typedef struct {
+  uint8_t               memory[MC_23K640_SIM_SIZE];
+  uint8_t               status;
+
+  /* Bytes of the chip select */
+  mc_23k640_sim_state   state;
+  uint8_t               command;
+  uint16_t              address;
+  uint16_t              data;                   /* Data bytes of the command */
+
+  host_spi_device       device;
+  pthread_mutex_t       bus;                    /* Held from the select to the deselect */
+
+  /* Interleaving of the threads, one yield in N bytes clocked, 0 for none */
+  uint32_t              yield_rate;
+
+  /* Faults of the commands starting in [fault_start, fault_end), one in N commands, 0 for none */
+  uint16_t              fault_start;
+  uint16_t              fault_end;
+  uint32_t              torn_rate;              /* Write stores only its first bytes */
+  uint32_t              flip_rate;              /* Read has one bit of SO inverted, as noise on the bus */
+  uint32_t              seed;
+  uint16_t              fault_at;               /* Data byte of the fault in the command */
+  uint8_t               fault_bit;
+  bool                  faulty;
+
+  /* Statistics */
+  uint32_t              selects;
+  uint32_t              bytes_read;
+  uint32_t              bytes_written;
+  uint32_t              torn_writes;
+  uint32_t              bit_flips;
+} mc_23k640_sim;
+
+/********************************** Functions ***********************************/
+void mc_23k640_sim_init(mc_23k640_sim *sim);
+void mc_23k640_sim_attach(mc_23k640_sim *sim, uint32_t cs_pin);
+uint8_t mc_23k640_sim_get_mode(const mc_23k640_sim *sim);
+void mc_23k640_sim_set_faults(mc_23k640_sim *sim, uint16_t start, uint16_t end, uint32_t torn_rate, uint32_t flip_rate);
+
+#endif /* MC_23K640_SIM_H */
@@ -0,0 +1,35 @@
+/*
+* @file           host_test.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, checks of the tests. A failed check is printed
+*                 and counted, the test returns the count as its exit code.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdio.h>
+
+/********************************** Definitions ***********************************/
+/* Failed checks of the test */
+static int host_test_failures;
+
+#define HOST_TEST_CHECK(condition)                                                  \
+  do {                                                                              \
+    if(!(condition)) {                                                              \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      host_test_failures++;                                                         \
+    }                                                                               \
+  } while(0)
+
+#define HOST_TEST_RESULT(name)                                                      \
+  (printf("%s: %s\n", (name), host_test_failures ? "FAILED" : "passed"), host_test_failures)
+
+#endif /* HOST_TEST_H */
@@ -0,0 +1,96 @@
+/*
+* @file           test_ads129x_channels.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the channels of ADS129X_CHANNEL_MAP against the
+*                 CHnSET written by app_ecg to the simulated ADS1298 and
+*                 ADS1296R. Every input of a lead field must be powered and
+*                 on its electrodes, the channels of the derived leads must
+*                 be powered down, no sample of an input is overwritten.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "ecg_replay.h"
+#include "host_test.h"
+
+/* Drivers */
+#include "ads129x.h"
+
+/********************************** Private ************************************/
+#define TEST_CHNSET_PD                0x80      /* CHnSET - power-down */
+#define TEST_CHNSET_MUX               0x07      /* CHnSET - input, 0 normal electrode input, 1 shorted */
+#define TEST_WCT1_AUGMENTED           0xF0      /* WCT1 - aVF to CH6, aVL to CH5, aVR to CH7 and to CH4 */
+
+/* Lead fields and their channels */
+#define TEST_X_FIELD(field, channel)  { #field, channel },
+#define TEST_X_DERIVED(field, channel) | (1UL << (channel))
+
+typedef struct {
+  const char  *name;
+  uint8_t     channel;
+} test_field;
+
+static const test_field _fields[] = { ADS129X_CHANNEL_MAP(TEST_X_FIELD) };
+
+/* Channels of the derived leads, powered down whether the leads are stored or not */
+static const uint8_t _derived[] = {
+  ADS129X_LEAD_III_CHANNEL, ADS129X_LEAD_AVR_CHANNEL, ADS129X_LEAD_AVL_CHANNEL, ADS129X_LEAD_AVF_CHANNEL
+};
+
+/* Private functions list */
+static uint8_t _test_chnset(const ads129x_sim_board *board, uint8_t channel);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static ecg_replay replay;
+  uint32_t derived_map = 0 ADS129X_DERIVED_MAP(TEST_X_DERIVED);
+  uint8_t inputs = 0;
+
+  HOST_TEST_CHECK(ecg_replay_init(&replay, true, ECG_REPLAY_MAX_SPEED));
+
+  /* Inputs of the lead fields, powered and on their electrodes */
+  HOST_TEST_CHECK(sizeof(_fields) / sizeof(_fields[0]) == ADS129X_MAPPED_CHANNELS);
+  for(uint8_t i = 0 ; i < sizeof(_fields) / sizeof(_fields[0]) ; i++) {
+    uint8_t chnset = _test_chnset(&replay.board, _fields[i].channel);
+
+    if(derived_map & (1UL << _fields[i].channel)) {
+      continue;
+    }
+    printf("%-8s channel %2u, CHnSET 0x%02X\n", _fields[i].name, _fields[i].channel, chnset);
+    HOST_TEST_CHECK(!(chnset & TEST_CHNSET_PD));
+    HOST_TEST_CHECK((chnset & TEST_CHNSET_MUX) == 0);
+    inputs++;
+  }
+  HOST_TEST_CHECK(inputs == ADS129X_MAPPED_CHANNELS - __builtin_popcount(derived_map));
+
+  /* Channels of the derived leads, powered down and without an augmented lead routed to them */
+  for(uint8_t i = 0 ; i < sizeof(_derived) ; i++) {
+    HOST_TEST_CHECK(_test_chnset(&replay.board, _derived[i]) & TEST_CHNSET_PD);
+  }
+  HOST_TEST_CHECK(!(replay.board.ads1298.regs[ADS129X_WCT1] & TEST_WCT1_AUGMENTED));
+
+  HOST_TEST_CHECK(ecg_replay_finish(&replay));
+
+  return HOST_TEST_RESULT("test_ads129x_channels");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to get the CHnSET of a channel of the frames, ADS1298 CH1 to CH8 then ADS1296R CH1 to CH6
+ */
+static uint8_t _test_chnset(const ads129x_sim_board *board, uint8_t channel) {
+
+  if(channel < ADS129X_8_CHANNELS) {
+    return board->ads1298.regs[ADS129X_CH1SET + channel];
+  }
+  return board->ads1296r.regs[ADS129X_CH1SET + channel - ADS129X_8_CHANNELS];
+
+}
@@ -0,0 +1,156 @@
+/*
+* @file           test_ads129x_isr.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the DRDY interrupt of the ADS129x driver within
+*                 ADS129X_ISR_BUDGET_US on every frame. It must only schedule
+*                 the reads, the SPI clocks the frames of both devices after
+*                 it returns.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "ecg_replay.h"
+#include "ecg_synth.h"
+#include "host_clock.h"
+#include "host_test.h"
+
+/* Drivers */
+#include "ads129x.h"
+
+/* Apps */
+#include "app_ecg.h"
+
+/* System utilities */
+#include "cycle_counter.h"
+#include "spi_mngr.h"
+
+/* Standard library */
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/********************************** Private ************************************/
+#define TEST_SECONDS                  10
+#define TEST_FRAMES                   (TEST_SECONDS * APP_ECG_HP_RATE)
+#define TEST_RUNS                     3         /* Runs of the same recording, the cycles of a call are its least */
+
+/* Private functions list */
+static void _test_run(ecg_replay *replay, ecg_synth *synth, uint32_t *cycles);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static ecg_replay replay;
+  uint8_t frame[ADS129X_REPLAY_FRAME_SIZE];
+  cycle_counter_stats *isr = ads129x_get_isr_stats();
+  cycle_counter_stats stats;
+  host_spi_queue *queue;
+  ecg_synth synth;
+  uint32_t (*cycles)[TEST_FRAMES];
+  uint32_t over_budget = 0;
+  uint32_t max = 0;
+  uint32_t bytes;
+  uint32_t count;
+  uint32_t start;
+  int status;
+
+  /* Cycles of the CPU time, a preemption by the host is not the interrupt going over its budget */
+  host_clock_set_dwt_cpu_time(true);
+
+  /* Accounting of the budget, one call of twice the budget */
+  cycle_counter_init();
+  cycle_counter_stats_init(&stats, CYCLE_COUNTER_US_TO_CYCLES(ADS129X_ISR_BUDGET_US));
+  start = cycle_counter_get();
+  while(cycle_counter_get() - start <= CYCLE_COUNTER_US_TO_CYCLES(2 * ADS129X_ISR_BUDGET_US));
+  cycle_counter_stats_add(&stats, start);
+  HOST_TEST_CHECK(stats.count == 1 && stats.over_budget == 1);
+  HOST_TEST_CHECK(stats.max >= CYCLE_COUNTER_US_TO_CYCLES(2 * ADS129X_ISR_BUDGET_US));
+
+  /* The interrupt of every frame of the same recording in each run, the replay is single instance so the first
+   * runs are in child processes. The host may still stop a call for longer than the budget, but not the same
+   * call of every run */
+  cycles = mmap(NULL, TEST_RUNS * sizeof(*cycles), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  HOST_TEST_CHECK(cycles != MAP_FAILED);
+  if(cycles == MAP_FAILED) {
+    return HOST_TEST_RESULT("test_ads129x_isr");
+  }
+  for(uint8_t run = 0 ; run < TEST_RUNS - 1 ; run++) {
+    pid_t child = fork();
+
+    if(!child) {
+      _test_run(&replay, &synth, cycles[run]);
+      _exit(host_test_failures ? 1 : 0);
+    }
+    HOST_TEST_CHECK(child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && !WEXITSTATUS(status));
+  }
+  _test_run(&replay, &synth, cycles[TEST_RUNS - 1]);
+
+  for(uint32_t i = 0 ; i < TEST_FRAMES ; i++) {
+    uint32_t least = cycles[0][i];
+
+    for(uint8_t run = 1 ; run < TEST_RUNS ; run++) {
+      least = (cycles[run][i] < least) ? cycles[run][i] : least;
+    }
+    max = (least > max) ? least : max;
+    over_budget += (least > isr->budget);
+  }
+  printf("DRDY ISR: %u calls, mean %u cycles, max %u cycles; least of %u runs max %u cycles, %u over the budget of %u cycles\n",
+         isr->count, cycle_counter_stats_mean(isr), isr->max, TEST_RUNS, max, over_budget, isr->budget);
+  HOST_TEST_CHECK(cycle_counter_stats_mean(isr) <= isr->budget);
+  HOST_TEST_CHECK(over_budget == 0);
+  munmap(cycles, TEST_RUNS * sizeof(*cycles));
+
+  /* No byte clocked in the interrupt, both frames once the SPI runs */
+  queue = host_spi_get_queue(SPI_MNGR_CONFIG1_INSTANCE);
+  bytes = queue->bytes;
+  ecg_synth_next(&synth, frame);
+  HOST_TEST_CHECK(ads129x_sim_drdy(&replay.board, frame));
+  HOST_TEST_CHECK(queue->bytes == bytes && queue->count == 1);
+  HOST_TEST_CHECK(replay.board.ads1298.unread && replay.board.ads1296r.unread);
+  host_spi_process();
+  HOST_TEST_CHECK(queue->bytes == bytes + 2 * ADS129X_SW_BUFFER_SIZE && queue->count == 0);
+  HOST_TEST_CHECK(!replay.board.ads1298.unread && !replay.board.ads1296r.unread);
+  HOST_TEST_CHECK(ecg_replay_get_dropped_frames(&replay) == 0);
+
+  /* A DRDY with the read of the previous frame still pending drops its frame, and is not timed */
+  count = isr->count;
+  ecg_synth_next(&synth, frame);
+  HOST_TEST_CHECK(ads129x_sim_drdy(&replay.board, frame));
+  ecg_synth_next(&synth, frame);
+  HOST_TEST_CHECK(ads129x_sim_drdy(&replay.board, frame));
+  HOST_TEST_CHECK(isr->count == count + 1 && ads129x_get_dropped_frames() == 1);
+  host_spi_process();
+  HOST_TEST_CHECK(ecg_replay_finish(&replay));
+
+  return HOST_TEST_RESULT("test_ads129x_isr");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to replay the recording, with the cycles of the interrupt of each frame
+ */
+static void _test_run(ecg_replay *replay, ecg_synth *synth, uint32_t *cycles) {
+
+  uint8_t frame[ADS129X_REPLAY_FRAME_SIZE];
+  cycle_counter_stats *isr = ads129x_get_isr_stats();
+
+  HOST_TEST_CHECK(ecg_replay_init(replay, true, ECG_REPLAY_MAX_SPEED));
+  ecg_synth_init(synth, APP_ECG_HP_RATE, 72, 15);
+  for(uint32_t i = 0 ; i < TEST_FRAMES ; i++) {
+    uint32_t count = isr->count;
+
+    ecg_synth_next(synth, frame);
+    HOST_TEST_CHECK(ecg_replay_feed(replay, frame));
+    HOST_TEST_CHECK(isr->count == count + 1);
+    cycles[i] = isr->last;
+  }
+  HOST_TEST_CHECK(isr->count == replay->fed);
+
+}
@@ -0,0 +1,118 @@
+/*
+* @file           test_ads129x_pace.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the reset of the pace latch of the simulated
+*                 board by ads129x. Each pulse is held in reset for
+*                 ADS129X_PACE_RST_FRAMES DRDYs and makes one pace event of
+*                 app_ecg, also with the main loop stalled between two
+*                 pulses, and no pulse falls in a reset.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "ecg_replay.h"
+#include "ecg_synth.h"
+#include "host_bus.h"
+#include "host_clock.h"
+#include "host_test.h"
+
+/* Apps */
+#include "app_ecg.h"
+
+/********************************** Private ************************************/
+#define TEST_RATE                     APP_ECG_LP_RATE
+#define TEST_HR_BPM                   70
+#define TEST_RESP_BPM                 15
+#define TEST_PULSES                   40
+#define TEST_PULSE_FRAMES             (TEST_RATE * 60 / TEST_HR_BPM)    /* Pacing at the heart rate, past the event window */
+#define TEST_STALL_FRAMES             8         /* DRDYs without the main loop, within the raw frames ring */
+#define TEST_STALL_PULSE              4         /* Second pulse of the stall, after the reset of the first */
+#define TEST_PACE_OFFSET              ((ADS129X_PACE_DEVICE == ADS129X_8) ? 0 : ADS129X_SW_BUFFER_SIZE)
+
+/* Private functions list */
+static void _test_pulse(uint8_t *frame);
+static void _test_drdy(ecg_replay *replay, const uint8_t *frame);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static ecg_replay replay;
+  uint8_t frame[ADS129X_REPLAY_FRAME_SIZE];
+  ecg_synth synth;
+  uint32_t pulses = 0;
+  uint32_t events;
+
+  HOST_TEST_CHECK(ecg_replay_init(&replay, false, ECG_REPLAY_MAX_SPEED));
+  HOST_TEST_CHECK(ads129x_sim_get_rate(&replay.board.ads1298) == TEST_RATE);
+  HOST_TEST_CHECK(!nrf_gpio_pin_out_read(ADS129X_PACE_RST_PIN));
+  ecg_synth_init(&synth, TEST_RATE, TEST_HR_BPM, TEST_RESP_BPM);
+
+  /* Pulses with the main loop on every frame */
+  for(uint32_t i = 0 ; i < TEST_PULSES * TEST_PULSE_FRAMES ; i++) {
+    ecg_synth_next(&synth, frame);
+    if(i % TEST_PULSE_FRAMES == TEST_PULSE_FRAMES / 2) {
+      _test_pulse(frame);
+      pulses++;
+    }
+    HOST_TEST_CHECK(ecg_replay_feed(&replay, frame));
+  }
+  events = app_ecg_get_pace_events();
+  printf("Main loop on every frame: %u pulses, %u resets, %u missed, %u pace events\n", replay.board.pace_pulses,
+         replay.board.pace_resets, replay.board.pace_missed, events);
+  HOST_TEST_CHECK(replay.board.pace_pulses == pulses && replay.board.pace_missed == 0);
+  HOST_TEST_CHECK(replay.board.pace_resets == pulses * ADS129X_PACE_RST_FRAMES);
+  HOST_TEST_CHECK(events == pulses);
+
+  /* Two pulses with the main loop stalled, both reset from the reads */
+  for(uint32_t i = 0 ; i < TEST_STALL_FRAMES ; i++) {
+    ecg_synth_next(&synth, frame);
+    if(i == 0 || i == TEST_STALL_PULSE) {
+      _test_pulse(frame);
+      pulses++;
+    }
+    _test_drdy(&replay, frame);
+  }
+  printf("Main loop stalled %u frames: %u pulses, %u resets, %u missed\n", TEST_STALL_FRAMES, replay.board.pace_pulses,
+         replay.board.pace_resets, replay.board.pace_missed);
+  HOST_TEST_CHECK(replay.board.pace_pulses == pulses && replay.board.pace_missed == 0);
+  HOST_TEST_CHECK(replay.board.pace_resets == pulses * ADS129X_PACE_RST_FRAMES);
+  HOST_TEST_CHECK(!nrf_gpio_pin_out_read(ADS129X_PACE_RST_PIN));
+
+  /* The main loop catches up, one more event with the second pulse in its window */
+  for(uint32_t i = 0 ; i < TEST_PULSE_FRAMES ; i++) {
+    ecg_synth_next(&synth, frame);
+    HOST_TEST_CHECK(ecg_replay_feed(&replay, frame));
+  }
+  HOST_TEST_CHECK(ecg_replay_finish(&replay));
+  HOST_TEST_CHECK(ecg_replay_get_dropped_frames(&replay) == 0);
+  HOST_TEST_CHECK(app_ecg_get_pace_events() == events + 1);
+
+  return HOST_TEST_RESULT("test_ads129x_pace");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to add a pace pulse to a synthetic frame, on the status word of the pace device
+ */
+static void _test_pulse(uint8_t *frame) {
+  frame[TEST_PACE_OFFSET + 2] |= (1 << ADS129X_PACE_BIT);
+}
+
+
+/*
+ * @brief Function to run only the DRDY of a frame and its SPI read, as with the main loop busy
+ */
+static void _test_drdy(ecg_replay *replay, const uint8_t *frame) {
+
+  host_clock_advance_us(replay->period_us);
+  HOST_TEST_CHECK(ads129x_sim_drdy(&replay->board, frame));
+  host_spi_process();
+
+}
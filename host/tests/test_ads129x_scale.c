@@ -0,0 +1,152 @@
+/*
+* @file           test_ads129x_scale.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the Q31 conversion of the ADS129x codes against
+*                 the double-precision LSB of the datasheet at every gain,
+*                 and the channels of a frame in the lead fields of
+*                 MEASURES_SCHEMA.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+
+/* Drivers */
+#include "ads129x.h"
+
+/* Standard library */
+#include <math.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TEST_RANDOM_CODES             200000
+#define TEST_CHANNEL_VALUE(ch)        (-1000000 - 1000 * (int32_t)(ch))
+
+/* Private scale of the driver */
+int32_t _ads129x_get_scale(uint8_t gain);
+
+/* Gains of the PGA */
+static const uint8_t _gains[] = { 1, 2, 3, 4, 6, 8, 12 };
+
+/* Lead field of the schema and the device channel it must come from, ADS1298 CH1 to CH8 then ADS1296R CH1 to CH6 */
+static const struct {
+  uint16_t  offset;
+  uint8_t   channel;
+} _fields[] = {
+  { MEAS_ECG_OFFSET(ECG_I), 0 },
+  { MEAS_ECG_OFFSET(ECG_II), 1 },
+#if ECG_STORE_DERIVED_LEADS
+  { MEAS_ECG_OFFSET(ECG_III), 2 },
+  { MEAS_ECG_OFFSET(ECG_AVR), 3 },
+  { MEAS_ECG_OFFSET(ECG_AVL), 4 },
+  { MEAS_ECG_OFFSET(ECG_AVF), 5 },
+#endif
+  { MEAS_ECG_OFFSET(ECG_V2), 6 },
+  { MEAS_ECG_OFFSET(RESP), 8 },
+  { MEAS_ECG_OFFSET(ECG_V3), 9 },
+  { MEAS_ECG_OFFSET(ECG_V4), 10 },
+  { MEAS_ECG_OFFSET(ECG_V5), 11 },
+  { MEAS_ECG_OFFSET(ECG_V6), 12 },
+};
+
+/* Private functions list */
+static uint32_t _test_random(uint32_t *seed);
+static int32_t _test_reference(uint32_t raw, uint8_t gain);
+static int32_t _test_get(const uint8_t *array, uint16_t offset);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static const uint32_t codes[] = { 0x000000, 0x000001, 0xFFFFFF, 0x7FFFFF, 0x800000, 0x800001, 0x400000, 0xC00000 };
+  uint8_t array[ADS129X_DATA_SIZE];
+  ads129x_frame frame;
+  uint32_t seed = 0xAD51298;
+  uint32_t inexact = 0;
+  uint32_t tested = 0;
+
+  /* Sign extension of the 24-bit codes */
+  HOST_TEST_CHECK(ADS129X_SIGN_EXTEND(0x7FFFFF) == 8388607);
+  HOST_TEST_CHECK(ADS129X_SIGN_EXTEND(0x800000) == -8388608);
+  HOST_TEST_CHECK(ADS129X_SIGN_EXTEND(0xFFFFFF) == -1);
+  HOST_TEST_CHECK(_ads129x_get_scale(0) == 0);
+
+  /* Conversion, the reference rounded to the microvolt, off by one only on a tie */
+  for(uint8_t g = 0 ; g < sizeof(_gains) ; g++) {
+    int32_t scale = _ads129x_get_scale(_gains[g]);
+
+    HOST_TEST_CHECK(fabs(scale / 2147483648.0 - 2.0 * ADS129X_REF_UV / _gains[g] / ADS129X_FULL_SCALE_CODES) <= 0.5 / 2147483648.0);
+    for(uint32_t i = 0 ; i < sizeof(codes) / sizeof(codes[0]) + TEST_RANDOM_CODES ; i++) {
+      uint32_t raw = (i < sizeof(codes) / sizeof(codes[0])) ? codes[i] : (_test_random(&seed) & 0xFFFFFF);
+      int32_t diff = ADS129X_CONVERT_UV(raw, scale) - _test_reference(raw, _gains[g]);
+
+      HOST_TEST_CHECK(diff >= -1 && diff <= 1);
+      inexact += (diff != 0);
+      tested++;
+    }
+  }
+  printf("%u codes, %u off by one microvolt\n", tested, inexact);
+  HOST_TEST_CHECK(inexact <= tested / 1000);
+  HOST_TEST_CHECK(ADS129X_CONVERT_UV(0x7FFFFF, _ads129x_get_scale(1)) == 2400000);
+  HOST_TEST_CHECK(ADS129X_CONVERT_UV(0x800000, _ads129x_get_scale(1)) == -2400000);
+
+  /* Channel map, each lead field from its channel, ADS1298 CH8 and ADS1296R CH6 in no field */
+  memset(&frame, 0, sizeof(frame));
+  frame.sample = 0x01020304;
+  frame.pace = 1;
+  for(uint8_t ch = 0 ; ch < ADS129X_CHANNELS ; ch++) {
+    frame.channels[ch] = TEST_CHANNEL_VALUE(ch);
+  }
+  memset(array, 0, sizeof(array));
+  ads129x_frame_to_array(&frame, array);
+  HOST_TEST_CHECK(_test_get(array, MEAS_ECG_OFFSET(SAMPLE_INDEX)) == 0x01020304);
+  HOST_TEST_CHECK(array[MEAS_ECG_OFFSET(ECG_PACE)] == 1);
+  HOST_TEST_CHECK(sizeof(_fields) / sizeof(_fields[0]) == ADS129X_MAPPED_CHANNELS);
+  for(uint8_t i = 0 ; i < sizeof(_fields) / sizeof(_fields[0]) ; i++) {
+    HOST_TEST_CHECK(_test_get(array, _fields[i].offset) == TEST_CHANNEL_VALUE(_fields[i].channel));
+  }
+  for(uint16_t offset = 0 ; offset + sizeof(int32_t) <= sizeof(array) ; offset++) {
+    HOST_TEST_CHECK(_test_get(array, offset) != TEST_CHANNEL_VALUE(7) && _test_get(array, offset) != TEST_CHANNEL_VALUE(13));
+  }
+
+  return HOST_TEST_RESULT("test_ads129x_scale");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to get the next number of a random generator, xorshift32
+ */
+static uint32_t _test_random(uint32_t *seed) {
+
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+
+}
+
+
+/*
+ * @brief Function to convert a code with the LSB of the datasheet, 2 * VREF / gain / (2^24 - 1)
+ */
+static int32_t _test_reference(uint32_t raw, uint8_t gain) {
+
+  int32_t code = (raw & 0x800000) ? (int32_t)raw - 0x1000000 : (int32_t)raw;
+
+  return (int32_t)floor(code * (2.0 * ADS129X_REF_UV / gain / ADS129X_FULL_SCALE_CODES) + 0.5);
+
+}
+
+
+/*
+ * @brief Function to get a big-endian field of a serialized frame
+ */
+static int32_t _test_get(const uint8_t *array, uint16_t offset) {
+  return (int32_t)(((uint32_t)array[offset] << 24) | ((uint32_t)array[offset + 1] << 16) | ((uint32_t)array[offset + 2] << 8) | array[offset + 3]);
+}
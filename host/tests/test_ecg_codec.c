@@ -0,0 +1,189 @@
+/*
+* @file           test_ecg_codec.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the ECG codec against a golden block, so the
+*                 format of the recordings does not change unnoticed, and a
+*                 round trip of blocks of the 14 channels with gaps, status
+*                 changes, fields and full scale steps.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+
+/* DSP */
+#include "ecg_codec.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TEST_TYPE                     7         /* ECG_BLOCK_TYPE */
+#define TEST_BLOCK_SIZE               1024      /* APP_ECG_BLOCK_SIZE */
+#define TEST_FRAMES                   20000
+#define TEST_FULL_SCALE               8388607   /* 24-bit ADC */
+
+/* Golden block, 2 channels: continuous frames, pace, fields, a gap of 2 frames, full scale values */
+static const ecg_codec_frame _golden_frames[] = {
+  { 1000, 0x000, { 0, 0 }, { 0 } },
+  { 1001, 0x000, { 10, -10 }, { 0 } },
+  { 1002, 0x200, { 25, -30 }, { 0, 72, 0, 0 } },
+  { 1005, 0x200, { -TEST_FULL_SCALE - 1, TEST_FULL_SCALE }, { 0 } },
+  { 1006, 0x001, { -8388600, 8388600 }, { 0 } },
+  { 1007, 0x001, { 0, 0 }, { 0, 0, 0, 0xFFFF } },
+};
+
+static const uint8_t _golden_block[] = {
+  0x07, 0x02, 0x06, 0x00, 0x36, 0x00, 0x00, 0x03, 0xE8, 0x00, 0x00, 0x92,
+  0x36, 0x00, 0xA0, 0x09, 0x02, 0xA3, 0x80, 0x00, 0x01, 0xF6, 0x9F, 0xFF,
+  0xE0, 0x20, 0x00, 0x09, 0xFF, 0xFF, 0xE0, 0x20, 0x00, 0x0C, 0x48, 0x02,
+  0xFF, 0x00, 0x01, 0x0B, 0xFC, 0x00, 0x04, 0x72, 0x3F, 0xFF, 0xFF, 0xDF,
+  0xFF, 0xE0, 0xFE, 0xFF, 0xFF, 0x08
+};
+
+#define TEST_GOLDEN_FRAMES            (sizeof(_golden_frames) / sizeof(_golden_frames[0]))
+#define TEST_GOLDEN_CHANNELS          2
+
+/* Private functions list */
+static uint32_t _test_random(uint32_t *seed);
+static bool _test_same(const ecg_codec_frame *a, const ecg_codec_frame *b, uint8_t channels);
+static void _test_frame(ecg_codec_frame *frame, uint32_t i, uint32_t *seed);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static uint8_t block[TEST_BLOCK_SIZE];
+  static ecg_codec_frame frames[TEST_FRAMES];
+  ecg_codec_frame frame;
+  ecg_codec encoder;
+  ecg_codec decoder;
+  uint32_t seed = 0x11ECC0DE;
+  uint32_t decoded = 0;
+  uint32_t blocks = 0;
+  uint32_t first = 0;
+  uint64_t bytes = 0;
+  uint16_t size;
+
+  /* Encoder, the golden block byte for byte */
+  HOST_TEST_CHECK(ecg_codec_encoder_init(&encoder, TEST_TYPE, TEST_GOLDEN_CHANNELS, block, sizeof(block)));
+  for(uint8_t i = 0 ; i < TEST_GOLDEN_FRAMES ; i++) {
+    HOST_TEST_CHECK(!ecg_codec_encode(&encoder, &_golden_frames[i]));
+  }
+  size = ecg_codec_finish(&encoder);
+  HOST_TEST_CHECK(size == sizeof(_golden_block) && !memcmp(block, _golden_block, size));
+  HOST_TEST_CHECK(ecg_codec_finish(&encoder) == 0);
+
+  /* Decoder, the frames of the golden block */
+  HOST_TEST_CHECK(ecg_codec_decoder_init(&decoder, _golden_block, sizeof(_golden_block)));
+  HOST_TEST_CHECK(decoder.type == TEST_TYPE && decoder.channels_count == TEST_GOLDEN_CHANNELS);
+  for(uint8_t i = 0 ; i < TEST_GOLDEN_FRAMES ; i++) {
+    HOST_TEST_CHECK(ecg_codec_decode(&decoder, &frame) && _test_same(&frame, &_golden_frames[i], TEST_GOLDEN_CHANNELS));
+  }
+  HOST_TEST_CHECK(!ecg_codec_decode(&decoder, &frame));
+
+  /* Bad headers and a truncated block */
+  HOST_TEST_CHECK(!ecg_codec_decoder_init(&decoder, _golden_block, sizeof(_golden_block) - 1));
+  memcpy(block, _golden_block, sizeof(_golden_block));
+  block[1] = ECG_CODEC_MAX_CHANNELS + 1;
+  HOST_TEST_CHECK(!ecg_codec_decoder_init(&decoder, block, sizeof(_golden_block)));
+  memcpy(block, _golden_block, sizeof(_golden_block));
+  block[2] = 0;
+  HOST_TEST_CHECK(!ecg_codec_decoder_init(&decoder, block, sizeof(_golden_block)));
+  memcpy(block, _golden_block, sizeof(_golden_block));
+  block[4] = ECG_CODEC_HEADER_SIZE + 8;
+  HOST_TEST_CHECK(ecg_codec_decoder_init(&decoder, block, sizeof(_golden_block)));
+  while(ecg_codec_decode(&decoder, &frame)) {
+    decoded++;
+  }
+  HOST_TEST_CHECK(decoder.error && decoded < TEST_GOLDEN_FRAMES);
+
+  /* Round trip of the 14 channels, blocks closed on ECG_CODEC_BLOCK_FRAMES or on the block size */
+  for(uint32_t i = 0 ; i < TEST_FRAMES ; i++) {
+    _test_frame(&frames[i], i, &seed);
+  }
+  decoded = 0;
+  HOST_TEST_CHECK(ecg_codec_encoder_init(&encoder, TEST_TYPE, ECG_CODEC_MAX_CHANNELS, block, sizeof(block)));
+  for(uint32_t i = 0 ; i < TEST_FRAMES ; i++) {
+    if(!ecg_codec_encode(&encoder, &frames[i]) && i != TEST_FRAMES - 1) {
+      continue;
+    }
+    size = ecg_codec_finish(&encoder);
+    HOST_TEST_CHECK(size > ECG_CODEC_HEADER_SIZE && size <= sizeof(block));
+    HOST_TEST_CHECK(ecg_codec_decoder_init(&decoder, block, size));
+    HOST_TEST_CHECK(decoder.block_frames == i + 1 - first);
+    while(ecg_codec_decode(&decoder, &frame)) {
+      HOST_TEST_CHECK(_test_same(&frame, &frames[first + decoded], ECG_CODEC_MAX_CHANNELS));
+      decoded++;
+    }
+    HOST_TEST_CHECK(!decoder.error && decoded == i + 1 - first);
+    bytes += size;
+    blocks++;
+    first = i + 1;
+    decoded = 0;
+  }
+  HOST_TEST_CHECK(first == TEST_FRAMES);
+  printf("%u frames of %u channels in %u blocks, %.2f bytes per frame\n", TEST_FRAMES, ECG_CODEC_MAX_CHANNELS, blocks,
+         (double)bytes / TEST_FRAMES);
+
+  return HOST_TEST_RESULT("test_ecg_codec");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to get the next number of a random generator, xorshift32
+ */
+static uint32_t _test_random(uint32_t *seed) {
+
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+
+}
+
+
+static bool _test_same(const ecg_codec_frame *a, const ecg_codec_frame *b, uint8_t channels) {
+
+  return a->sample == b->sample && a->status == b->status &&
+         !memcmp(a->channels, b->channels, channels * sizeof(int32_t)) && !memcmp(a->fields, b->fields, sizeof(a->fields));
+
+}
+
+
+/*
+ * @brief Function to make a frame, slow waves with noise, and now and then a gap, a new status,
+ *        a field or a full scale step
+ */
+static void _test_frame(ecg_codec_frame *frame, uint32_t i, uint32_t *seed) {
+
+  static uint32_t sample = 0;
+  static uint16_t status = 0;
+  uint32_t event = _test_random(seed) % 1000;
+
+  memset(frame, 0, sizeof(ecg_codec_frame));
+  sample += (event < 2) ? 1 + _test_random(seed) % 100 : 1;
+  if(event >= 2 && event < 4) {
+    status = (uint16_t)(_test_random(seed) & ((1 << ECG_CODEC_STATUS_BITS) - 1));
+  }
+  frame->sample = sample;
+  frame->status = status;
+  if(event >= 4 && event < 8) {
+    frame->fields[event - 4] = (uint16_t)_test_random(seed);
+  }
+  for(uint8_t ch = 0 ; ch < ECG_CODEC_MAX_CHANNELS ; ch++) {
+    int32_t wave = (int32_t)((i * (ch + 3)) % 2000) - 1000;
+
+    frame->channels[ch] = wave * (ch + 1) + (int32_t)(_test_random(seed) % 64) - 32;
+    if(event == 8 + ch) {
+      frame->channels[ch] = (_test_random(seed) & 1) ? TEST_FULL_SCALE : -TEST_FULL_SCALE - 1;
+    }
+  }
+
+}
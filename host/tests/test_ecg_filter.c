@@ -0,0 +1,259 @@
+/*
+* @file           test_ecg_filter.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the fixed-point filter chain against the same
+*                 RBJ biquads designed and run in double precision, at both
+*                 rates and in the monitoring and diagnostic bandwidths.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+
+/* DSP */
+#include "ecg_filter.h"
+
+/* Standard library */
+#include <math.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TEST_SECONDS                  60
+#define TEST_CHANNELS                 2         /* Interleaved, as the frames of app_ecg */
+#define TEST_BLOCK                    10        /* Samples per call */
+#define TEST_COEFF_TOLERANCE          16        /* LSB of Q2.30, 1.5e-8 */
+#define TEST_MAX_ERROR_UV             2
+#define TEST_RMS_ERROR_UV             0.75
+#define TEST_NOTCH_DB                 30.0      /* Attenuation of the mains at f0 */
+
+/* Biquad in double, a0 = 1 */
+typedef struct {
+  double    b[3];
+  double    a[3];
+  double    x1, x2, y1, y2;
+} test_biquad;
+
+/* Configuration of the chain */
+typedef struct {
+  ecg_filter_hp     hp;
+  ecg_filter_notch  notch;
+  ecg_filter_lp     lp;
+  const char        *name;
+} test_config;
+
+static const test_config _configs[] = {
+  { ECG_FILTER_HP_0_5HZ, ECG_FILTER_NOTCH_50HZ, ECG_FILTER_LP_40HZ, "monitoring" },
+  { ECG_FILTER_HP_0_05HZ, ECG_FILTER_NOTCH_60HZ, ECG_FILTER_LP_100HZ, "diagnostic" },
+  { ECG_FILTER_HP_0_05HZ, ECG_FILTER_NOTCH_OFF, ECG_FILTER_LP_OFF, "high-pass" },
+  { ECG_FILTER_HP_OFF, ECG_FILTER_NOTCH_60HZ, ECG_FILTER_LP_OFF, "notch" },
+  { ECG_FILTER_HP_OFF, ECG_FILTER_NOTCH_OFF, ECG_FILTER_LP_40HZ, "low-pass" },
+};
+
+static const double _rates[ECG_FILTER_RATES_NUMBER] = { 250.0, 500.0 };
+static const double _hp_hz[] = { 0.0, 0.05, 0.5 };
+static const double _notch_hz[] = { 0.0, 50.0, 60.0 };
+static const double _lp_hz[] = { 0.0, 40.0, 100.0 };
+static const double _lp_poles[] = { 1.0 / 8, 3.0 / 8 };   /* 4th order Butterworth, Q = 1 / (2 cos(pi * pole)), 0.5412 and 1.3066 */
+
+/* Private functions list */
+static uint8_t _test_design(test_biquad *stages, const test_config *config, double fs);
+static void _test_rbj(test_biquad *biquad, double f0, double fs, double q, char type);
+static double _test_run(test_biquad *biquad, double x);
+static double _test_signal(uint32_t n, double fs, uint8_t channel, const test_config *config);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static int32_t samples[TEST_BLOCK * TEST_CHANNELS];
+  ecg_filter filter;
+  test_biquad stages[TEST_CHANNELS][ECG_FILTER_MAX_STAGES];
+
+  HOST_TEST_CHECK(!ecg_filter_init(&filter, ECG_FILTER_MAX_CHANNELS + 1, ECG_FILTER_500SPS, ECG_FILTER_HP_OFF,
+                                   ECG_FILTER_NOTCH_OFF, ECG_FILTER_LP_OFF));
+  HOST_TEST_CHECK(!ecg_filter_init(&filter, 1, ECG_FILTER_RATES_NUMBER, ECG_FILTER_HP_OFF, ECG_FILTER_NOTCH_OFF,
+                                   ECG_FILTER_LP_OFF));
+
+  for(uint8_t r = 0 ; r < ECG_FILTER_RATES_NUMBER ; r++) {
+    for(uint8_t c = 0 ; c < sizeof(_configs) / sizeof(_configs[0]) ; c++) {
+      const test_config *config = &_configs[c];
+      uint32_t total = (uint32_t)(TEST_SECONDS * _rates[r]);
+      double square = 0;
+      double worst = 0;
+      double mains_in = 0;                              /* Energy of the mains in and out, after the notch settled */
+      double mains_out = 0;
+      uint32_t mains_count = 0;
+      uint8_t count;
+
+      HOST_TEST_CHECK(ecg_filter_init(&filter, TEST_CHANNELS, r, config->hp, config->notch, config->lp));
+      for(uint8_t ch = 0 ; ch < TEST_CHANNELS ; ch++) {
+        count = _test_design(stages[ch], config, _rates[r]);
+      }
+
+      /* Coefficients of the tables against the design, then the reference runs with the table ones so only
+       * the arithmetic differs, the high-pass poles are too close to 1 for the quantization to be left out */
+      HOST_TEST_CHECK(filter.stages_number == count);
+      for(uint8_t s = 0 ; s < count ; s++) {
+        const ecg_filter_biquad *q = filter.stages[s];
+        double const expected[] = { stages[0][s].b[0], stages[0][s].b[1], stages[0][s].b[2], stages[0][s].a[1], stages[0][s].a[2] };
+        int32_t const actual[] = { q->b0, q->b1, q->b2, q->a1, q->a2 };
+
+        for(uint8_t i = 0 ; i < 5 ; i++) {
+          HOST_TEST_CHECK(fabs(actual[i] - expected[i] * (1 << ECG_FILTER_COEFF_SHIFT)) <= TEST_COEFF_TOLERANCE);
+        }
+        for(uint8_t ch = 0 ; ch < TEST_CHANNELS ; ch++) {
+          stages[ch][s].b[0] = ldexp(q->b0, -ECG_FILTER_COEFF_SHIFT);
+          stages[ch][s].b[1] = ldexp(q->b1, -ECG_FILTER_COEFF_SHIFT);
+          stages[ch][s].b[2] = ldexp(q->b2, -ECG_FILTER_COEFF_SHIFT);
+          stages[ch][s].a[1] = ldexp(q->a1, -ECG_FILTER_COEFF_SHIFT);
+          stages[ch][s].a[2] = ldexp(q->a2, -ECG_FILTER_COEFF_SHIFT);
+        }
+      }
+
+      /* Signal, in blocks of interleaved channels */
+      for(uint32_t n = 0 ; n < total ; n += TEST_BLOCK) {
+        for(uint8_t i = 0 ; i < TEST_BLOCK ; i++) {
+          for(uint8_t ch = 0 ; ch < TEST_CHANNELS ; ch++) {
+            samples[i * TEST_CHANNELS + ch] = (int32_t)lround(_test_signal(n + i, _rates[r], ch, config));
+          }
+        }
+        for(uint8_t ch = 0 ; ch < TEST_CHANNELS ; ch++) {
+          ecg_filter_process(&filter, ch, &samples[ch], TEST_BLOCK, TEST_CHANNELS);
+        }
+        for(uint8_t i = 0 ; i < TEST_BLOCK ; i++) {
+          for(uint8_t ch = 0 ; ch < TEST_CHANNELS ; ch++) {
+            double y = lround(_test_signal(n + i, _rates[r], ch, config));
+            double error;
+
+            for(uint8_t s = 0 ; s < count ; s++) {
+              y = _test_run(&stages[ch][s], y);
+            }
+            error = fabs(samples[i * TEST_CHANNELS + ch] - y);
+            worst = (error > worst) ? error : worst;
+            square += error * error;
+            if(ch == 1 && n + i >= total / 2) {
+              mains_in += pow(_test_signal(n + i, _rates[r], ch, config), 2);
+              mains_out += pow(samples[i * TEST_CHANNELS + ch], 2);
+              mains_count++;
+            }
+          }
+        }
+      }
+
+      printf("%3.0f SPS %-10s max error %.0f uV, RMS %.3f uV", _rates[r], config->name, worst,
+             sqrt(square / (total * TEST_CHANNELS)));
+      HOST_TEST_CHECK(worst <= TEST_MAX_ERROR_UV);
+      HOST_TEST_CHECK(sqrt(square / (total * TEST_CHANNELS)) <= TEST_RMS_ERROR_UV);
+      if(config->notch != ECG_FILTER_NOTCH_OFF) {
+        printf(", mains %.0f uV RMS in, %.2f uV RMS out", sqrt(mains_in / mains_count), sqrt(mains_out / mains_count));
+        HOST_TEST_CHECK(mains_out * pow(10, TEST_NOTCH_DB / 10) <= mains_in);
+      }
+      printf("\n");
+    }
+  }
+
+  return HOST_TEST_RESULT("test_ecg_filter");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to design the stages of a configuration, in the order of ecg_filter_init
+ *
+ * @retval                  Number of stages
+ */
+static uint8_t _test_design(test_biquad *stages, const test_config *config, double fs) {
+
+  uint8_t count = 0;
+
+  if(config->hp != ECG_FILTER_HP_OFF) {
+    _test_rbj(&stages[count++], _hp_hz[config->hp], fs, 1 / sqrt(2), 'h');
+  }
+  if(config->notch != ECG_FILTER_NOTCH_OFF) {
+    _test_rbj(&stages[count++], _notch_hz[config->notch], fs, 20, 'n');
+  }
+  if(config->lp != ECG_FILTER_LP_OFF) {
+    _test_rbj(&stages[count++], _lp_hz[config->lp], fs, 1 / (2 * cos(M_PI * _lp_poles[0])), 'l');
+    _test_rbj(&stages[count++], _lp_hz[config->lp], fs, 1 / (2 * cos(M_PI * _lp_poles[1])), 'l');
+  }
+  return count;
+
+}
+
+
+/*
+ * @brief Function to design a biquad of the RBJ Audio EQ Cookbook, h for high-pass, n for notch, l for low-pass
+ */
+static void _test_rbj(test_biquad *biquad, double f0, double fs, double q, char type) {
+
+  double w0 = 2 * M_PI * f0 / fs;
+  double alpha = sin(w0) / (2 * q);
+  double a0 = 1 + alpha;
+
+  memset(biquad, 0, sizeof(test_biquad));
+  switch(type) {
+    case 'h':
+      biquad->b[0] = (1 + cos(w0)) / 2;
+      biquad->b[1] = -(1 + cos(w0));
+      biquad->b[2] = (1 + cos(w0)) / 2;
+      break;
+    case 'n':
+      biquad->b[0] = 1;
+      biquad->b[1] = -2 * cos(w0);
+      biquad->b[2] = 1;
+      break;
+    default:
+      biquad->b[0] = (1 - cos(w0)) / 2;
+      biquad->b[1] = 1 - cos(w0);
+      biquad->b[2] = (1 - cos(w0)) / 2;
+      break;
+  }
+  biquad->a[1] = -2 * cos(w0);
+  biquad->a[2] = 1 - alpha;
+  for(uint8_t i = 0 ; i < 3 ; i++) {
+    biquad->b[i] /= a0;
+    biquad->a[i] /= a0;
+  }
+  biquad->a[0] = 1;
+
+}
+
+
+/*
+ * @brief Function to run one sample through a biquad in double, direct form I
+ */
+static double _test_run(test_biquad *biquad, double x) {
+
+  double y = biquad->b[0] * x + biquad->b[1] * biquad->x1 + biquad->b[2] * biquad->x2 - biquad->a[1] * biquad->y1 -
+             biquad->a[2] * biquad->y2;
+
+  biquad->x2 = biquad->x1;
+  biquad->x1 = x;
+  biquad->y2 = biquad->y1;
+  biquad->y1 = y;
+  return y;
+
+}
+
+
+/*
+ * @brief Function to get a sample in microvolts, ECG-like content with an electrode offset and baseline wander,
+ *        or only the mains on channel 1 of a configuration with a notch
+ */
+static double _test_signal(uint32_t n, double fs, uint8_t channel, const test_config *config) {
+
+  double t = n / fs;
+  double mains = 1000 * sin(2 * M_PI * _notch_hz[config->notch] * t);
+
+  if(channel == 1 && config->notch != ECG_FILTER_NOTCH_OFF) {
+    return mains;
+  }
+  return 300000 * (channel ? -1 : 1) + 2000 * sin(2 * M_PI * 0.3 * t) + 1500 * pow(sin(M_PI * 1.2 * t), 64) +
+         200 * sin(2 * M_PI * 17 * t + channel) + 50 * sin(2 * M_PI * 90 * t) + (config->notch ? mains : 0);
+
+}
@@ -0,0 +1,69 @@
+/*
+* @file           test_ecg_replay.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, a minute of synthetic ECG at the high resolution
+*                 rate through the simulated ADS129x, app_ecg and meas_mngr.
+*                 Every frame must come out of the RAM, in order, with the
+*                 beats of the recording.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "ecg_replay.h"
+#include "ecg_synth.h"
+#include "host_test.h"
+
+/* Apps */
+#include "app_ecg.h"
+
+/* Standard library */
+#include <stdlib.h>
+
+/********************************** Private ************************************/
+#define TEST_SECONDS                  60
+#define TEST_HR_BPM                   72
+#define TEST_RESP_BPM                 15
+#define TEST_HR_TOLERANCE             5         /* bpm, against the mean of the recording with its RR jitter */
+#define TEST_LEARNING_BEATS           4         /* Beats the QRS detector may take to lock */
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static ecg_replay replay;
+  uint8_t frame[ADS129X_REPLAY_FRAME_SIZE];
+  ecg_synth synth;
+
+  HOST_TEST_CHECK(ecg_replay_init(&replay, true, ECG_REPLAY_MAX_SPEED));
+  HOST_TEST_CHECK(ads129x_sim_get_rate(&replay.board.ads1298) == APP_ECG_HP_RATE);
+
+  ecg_synth_init(&synth, APP_ECG_HP_RATE, TEST_HR_BPM, TEST_RESP_BPM);
+  for(uint32_t i = 0 ; i < TEST_SECONDS * APP_ECG_HP_RATE ; i++) {
+    ecg_synth_next(&synth, frame);
+    HOST_TEST_CHECK(ecg_replay_feed(&replay, frame));
+  }
+  HOST_TEST_CHECK(ecg_replay_finish(&replay));
+  ecg_replay_print(&replay, stdout);
+
+  /* Frames */
+  HOST_TEST_CHECK(replay.fed == TEST_SECONDS * APP_ECG_HP_RATE);
+  HOST_TEST_CHECK(ecg_replay_get_dropped_frames(&replay) == 0);
+  HOST_TEST_CHECK(replay.delivered == replay.fed);
+  HOST_TEST_CHECK(replay.gaps == 0);
+
+  /* Records */
+  HOST_TEST_CHECK(replay.parser.crc_errors == 0);
+  HOST_TEST_CHECK(replay.parser.lost == 0);
+  HOST_TEST_CHECK(replay.decode_errors == 0);
+
+  /* Vital signs */
+  HOST_TEST_CHECK(replay.beats + TEST_LEARNING_BEATS >= synth.beats && replay.beats <= synth.beats);
+  HOST_TEST_CHECK(abs((int)replay.hr_bpm - TEST_HR_BPM) <= TEST_HR_TOLERANCE);
+
+  return HOST_TEST_RESULT("test_ecg_replay");
+
+}
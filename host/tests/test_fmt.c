@@ -0,0 +1,234 @@
+/*
+* @file           test_fmt.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the formatting of fmt against snprintf of the
+*                 host C library, on the limits of every type, NaN and the
+*                 infinities, ties at the last decimal and random values.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+
+/* System utilities */
+#include "fmt.h"
+
+/* Standard library */
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TEST_RANDOM_VALUES            200000
+#define TEST_SEED                     0x0F3A7u
+#define TEST_FIXED_RANGE              9.2e18    /* Random floats scaled below it, they fit in fmt_fixed */
+
+/* Floats with a tie or a near tie at the last decimal */
+typedef struct {
+  float     value;
+  uint8_t   decimals;
+} test_float;
+
+static const test_float _floats[] = {
+  { 0.125f, 2 }, { 0.375f, 2 }, { -0.125f, 2 }, { 2.5f, 0 }, { 3.5f, 0 }, { -2.5f, 0 }, { 0.5f, 0 },
+  { 2.675f, 2 }, { 1.005f, 2 }, { 0.0005f, 3 }, { 1.0e-3f, 3 }, { 9.9995f, 3 }, { 999999.94f, 1 },
+  { 3.3f, 3 }, { 4.2f, 3 }, { 16777215.0f, 0 }, { 16777217.0f, 0 }, { 1.0e-45f, 9 }, { 1.17549e-38f, 9 },
+  { -0.001f, 2 }, { -0.0f, 3 }, { 0.0f, 0 }, { 9.2e9f, 9 }, { 9.2e18f, 0 }, { 8.5e18f, 0 },
+};
+
+/* Private functions list */
+static uint32_t _test_random(uint32_t *seed);
+static bool _test_compare(const char *text, uint8_t length, const char *expected);
+static bool _test_i32(int32_t value);
+static bool _test_u64(uint64_t value);
+static bool _test_fixed(int64_t value, uint8_t decimals);
+static bool _test_float(float value, uint8_t decimals);
+static bool _test_hex(uint32_t value, uint8_t digits);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  uint32_t seed = TEST_SEED;
+  uint32_t mismatches = 0;
+  char text[FMT_FIXED_SIZE];
+
+  /* Limits */
+  HOST_TEST_CHECK(_test_i32(INT32_MIN));
+  HOST_TEST_CHECK(_test_i32(INT32_MAX));
+  HOST_TEST_CHECK(_test_i32(-1));
+  HOST_TEST_CHECK(_test_i32(0));
+  HOST_TEST_CHECK(_test_u64(UINT64_MAX));
+  HOST_TEST_CHECK(_test_u64((uint64_t)UINT32_MAX + 1));
+  HOST_TEST_CHECK(_test_u64(0));
+  for(uint8_t decimals = 0 ; decimals <= FMT_MAX_DECIMALS ; decimals++) {
+    HOST_TEST_CHECK(_test_fixed(INT64_MIN, decimals));
+    HOST_TEST_CHECK(_test_fixed(INT64_MAX, decimals));
+    HOST_TEST_CHECK(_test_fixed(-1, decimals));
+  }
+  HOST_TEST_CHECK(_test_hex(UINT32_MAX, 0));
+  HOST_TEST_CHECK(_test_hex(0, 0));
+  HOST_TEST_CHECK(_test_hex(0xA5, 4));
+  HOST_TEST_CHECK(fmt_hex(text, 0x12345678, 9) == 8 && !strcmp(text, "12345678"));
+
+  /* NaN and the infinities, and the floats scaled past the fixed point range */
+  HOST_TEST_CHECK(_test_float(NAN, 3));
+  HOST_TEST_CHECK(_test_float(INFINITY, 3));
+  HOST_TEST_CHECK(_test_float(-INFINITY, 3));
+  HOST_TEST_CHECK(fmt_float(text, 1.0e10f, 9) == 3 && !strcmp(text, "inf"));
+  HOST_TEST_CHECK(fmt_float(text, -1.0e19f, 0) == 4 && !strcmp(text, "-inf"));
+  HOST_TEST_CHECK(fmt_float(text, 3.0e38f, 0) == 3 && !strcmp(text, "inf"));
+
+  /* Ties and near ties at the last decimal */
+  for(uint8_t i = 0 ; i < sizeof(_floats) / sizeof(_floats[0]) ; i++) {
+    HOST_TEST_CHECK(_test_float(_floats[i].value, _floats[i].decimals));
+  }
+  HOST_TEST_CHECK(fmt_float(text, 1.5f, FMT_MAX_DECIMALS + 1) == 11 && !strcmp(text, "1.500000000"));
+
+  /* Random values, the floats from random bits in the fixed point range */
+  for(uint32_t i = 0 ; i < TEST_RANDOM_VALUES ; i++) {
+    uint32_t bits = _test_random(&seed);
+    uint64_t wide = ((uint64_t)_test_random(&seed) << 32) | _test_random(&seed);
+    uint8_t decimals = (uint8_t)(_test_random(&seed) % (FMT_MAX_DECIMALS + 1));
+    float value;
+
+    memcpy(&value, &bits, sizeof(value));
+    mismatches += !_test_i32((int32_t)bits);
+    mismatches += !_test_u64(wide >> (bits & 0x3F));
+    mismatches += !_test_fixed((int64_t)wide >> (bits & 0x3F), decimals);
+    mismatches += !_test_hex(bits >> (bits & 0x1F), (uint8_t)(bits % 9));
+    if(fabs((double)value) * pow(10, decimals) < TEST_FIXED_RANGE) {
+      mismatches += !_test_float(value, decimals);
+    }
+    mismatches += !_test_float((float)(int32_t)bits / (float)(1 << (bits & 0x0F)), decimals % 3);
+  }
+  printf("%u random values of each type, %u mismatches against snprintf\n", TEST_RANDOM_VALUES, mismatches);
+  HOST_TEST_CHECK(mismatches == 0);
+
+  return HOST_TEST_RESULT("test_fmt");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to get a random number, xorshift32
+ */
+static uint32_t _test_random(uint32_t *seed) {
+
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+
+}
+
+
+/*
+ * @brief Function to compare a text and its length with the one of snprintf, printing the first mismatches
+ */
+static bool _test_compare(const char *text, uint8_t length, const char *expected) {
+
+  static uint8_t printed;
+
+  if(length == strlen(text) && !strcmp(text, expected)) {
+    return true;
+  }
+  if(printed < 10) {
+    fprintf(stderr, "fmt \"%s\" (%u), snprintf \"%s\"\n", text, length, expected);
+    printed++;
+  }
+  return false;
+
+}
+
+
+/*
+ * @brief Function to check fmt_i32, and fmt_u32 with the same bits
+ */
+static bool _test_i32(int32_t value) {
+
+  char text[FMT_I32_SIZE];
+  char expected[FMT_I32_SIZE];
+  uint8_t length;
+  bool match;
+
+  length = fmt_i32(text, value);
+  snprintf(expected, sizeof(expected), "%" PRId32, value);
+  match = _test_compare(text, length, expected);
+
+  length = fmt_u32(text, (uint32_t)value);
+  snprintf(expected, sizeof(expected), "%" PRIu32, (uint32_t)value);
+  return _test_compare(text, length, expected) && match;
+
+}
+
+
+/*
+ * @brief Function to check fmt_u64
+ */
+static bool _test_u64(uint64_t value) {
+
+  char text[FMT_U64_SIZE];
+  char expected[FMT_U64_SIZE];
+
+  snprintf(expected, sizeof(expected), "%" PRIu64, value);
+  return _test_compare(text, fmt_u64(text, value), expected);
+
+}
+
+
+/*
+ * @brief Function to check fmt_fixed, the text of snprintf from the integer and fraction of the value
+ */
+static bool _test_fixed(int64_t value, uint8_t decimals) {
+
+  static const uint64_t powers[FMT_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+  };
+  char text[FMT_FIXED_SIZE];
+  char expected[2 * FMT_FIXED_SIZE];
+  uint64_t magnitude = (value < 0) ? 0U - (uint64_t)value : (uint64_t)value;
+
+  if(decimals) {
+    snprintf(expected, sizeof(expected), "%s%" PRIu64 ".%0*" PRIu64, (value < 0) ? "-" : "", magnitude / powers[decimals],
+             (int)decimals, magnitude % powers[decimals]);
+  } else {
+    snprintf(expected, sizeof(expected), "%" PRId64, value);
+  }
+  return _test_compare(text, fmt_fixed(text, value, decimals), expected);
+
+}
+
+
+/*
+ * @brief Function to check fmt_float
+ */
+static bool _test_float(float value, uint8_t decimals) {
+
+  char text[FMT_FIXED_SIZE];
+  char expected[64];
+
+  snprintf(expected, sizeof(expected), "%.*f", (int)decimals, (double)value);
+  return _test_compare(text, fmt_float(text, value, decimals), expected);
+
+}
+
+
+/*
+ * @brief Function to check fmt_hex, that keeps the low digits of a value with more digits than asked
+ */
+static bool _test_hex(uint32_t value, uint8_t digits) {
+
+  char text[FMT_HEX_SIZE];
+  char expected[FMT_HEX_SIZE];
+  uint32_t shown = (digits && digits < 8) ? value & ((1UL << (4 * digits)) - 1) : value;
+
+  snprintf(expected, sizeof(expected), "%0*" PRIx32, (int)(digits ? digits : 1), shown);
+  return _test_compare(text, fmt_hex(text, value, digits), expected);
+
+}
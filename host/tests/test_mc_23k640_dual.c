@@ -0,0 +1,60 @@
+/*
+* @file           test_mc_23k640_dual.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, MCU1 and MCU2 on two threads over the simulated
+*                 23K640, interleaved at random. Every record must come back
+*                 as written, and with torn writes and bit flips in the data
+*                 region the records hit must be dropped by their CRC.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+#include "mc_23k640_dual.h"
+
+/********************************** Private ************************************/
+#define TEST_RECORDS                  20000     /* About 5 MB, the ring wraps more than 600 times */
+#define TEST_YIELD_RATE               16
+#define TEST_FAULT_RATE               100
+#define TEST_SEED                     0x23640
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static mc_23k640_dual dual;
+  uint32_t produced;
+  uint32_t verified;
+
+  HOST_TEST_CHECK(mc_23k640_dual_init(&dual, TEST_SEED));
+  dual.ram.yield_rate = TEST_YIELD_RATE;
+
+  /* Clean bus */
+  HOST_TEST_CHECK(mc_23k640_dual_run(&dual, TEST_RECORDS));
+  mc_23k640_dual_print(&dual, stdout);
+  HOST_TEST_CHECK(dual.produced == TEST_RECORDS);
+  HOST_TEST_CHECK(dual.verified == dual.produced);
+  HOST_TEST_CHECK(dual.bytes_consumed == dual.bytes_produced);
+  HOST_TEST_CHECK(dual.corrupted == 0);
+  HOST_TEST_CHECK(dual.parser.lost == 0 && dual.parser.crc_errors == 0 && dual.parser.skipped == 0);
+
+  /* Faults in the data region, the indexes stay sound */
+  produced = dual.produced;
+  verified = dual.verified;
+  mc_23k640_sim_set_faults(&dual.ram, DATA_MEMORY_ADDR, CONFIG_MEMORY_ADDR, TEST_FAULT_RATE, TEST_FAULT_RATE);
+  HOST_TEST_CHECK(mc_23k640_dual_run(&dual, TEST_RECORDS));
+  mc_23k640_dual_print(&dual, stdout);
+  HOST_TEST_CHECK(dual.produced == produced + TEST_RECORDS);
+  HOST_TEST_CHECK(dual.ram.torn_writes > 0 && dual.ram.bit_flips > 0);
+  HOST_TEST_CHECK(dual.corrupted == 0);
+  HOST_TEST_CHECK(dual.parser.crc_errors > 0);
+  HOST_TEST_CHECK(dual.verified + dual.parser.lost >= dual.produced - dual.parser.stale);
+  HOST_TEST_CHECK(dual.verified - verified >= TEST_RECORDS * 9 / 10);
+
+  return HOST_TEST_RESULT("test_mc_23k640_dual");
+
+}
@@ -0,0 +1,248 @@
+/*
+* @file           test_mc_23k640_reboot.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, a reboot of one MCU while the other one keeps
+*                 running on the ring of the simulated 23K640. The MCU that
+*                 reboots takes the indexes back from the RAM: no record is
+*                 read twice or over stale bytes, and after a reboot of MCU1
+*                 only the bytes it had not published are missing.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+#include "mc_23k640_dual.h"
+
+/* System utilities */
+#include "spi_mngr.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TEST_RECORDS                  100       /* Records of each batch, about half of the ring */
+#define TEST_LAPS                     6         /* Batches before the reboots, the ring wraps */
+#define TEST_PAYLOAD_MAX              60
+#define TEST_PARTIAL_READ             1000      /* Bytes read before the reboot of MCU2, the tail in a record */
+#define TEST_SEED                     0x0B007u
+
+/* Builds of mc_23k640 after a reboot of each MCU */
+bool mcu1b_mc_23k640_init(void);
+uint16_t mcu1b_mc_23k640_write_data(uint8_t *data, uint16_t bytes);
+void mcu1b_spi_mngr_init(uint8_t spi_config);
+uint16_t mcu1_mc_23k640_append_data(uint8_t *data, uint16_t bytes);
+
+bool mcu2b_mc_23k640_init(void);
+uint16_t mcu2b_mc_23k640_read_data(uint8_t *data, uint16_t max_bytes, mc_23k640_status *status);
+void mcu2b_spi_mngr_init(uint8_t spi_config);
+
+typedef uint16_t (*test_write_fn)(uint8_t *data, uint16_t bytes);
+typedef uint16_t (*test_read_fn)(uint8_t *data, uint16_t max_bytes, mc_23k640_status *status);
+
+/* Run */
+typedef struct {
+  mc_23k640_sim       ram;
+  host_mcu            mcu1;
+  host_mcu            mcu2;
+  ram_record_parser   parser;
+  uint8_t             parser_buffer[MC_23K640_DUAL_PARSER_SIZE];
+  uint16_t            sequence;                 /* Next record written */
+  uint16_t            last;                     /* Last record read back */
+  bool                has_last;
+  uint32_t            produced;
+  uint32_t            verified;
+  uint32_t            corrupted;                /* Valid CRC with a wrong payload, or out of order */
+} test_run;
+
+/* Private functions list */
+static uint32_t _test_hash(uint32_t x);
+static uint16_t _test_record(uint16_t sequence, uint8_t *record);
+static bool _test_write(test_run *run, test_write_fn write, uint32_t records);
+static uint32_t _test_read(test_run *run, test_read_fn read, uint32_t max_bytes);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static test_run run;
+  uint8_t record[TEST_PAYLOAD_MAX + RAM_RECORD_OVERHEAD];
+  uint16_t size;
+  uint32_t produced;
+  uint32_t verified;
+  uint32_t lost;
+
+  memset(&run, 0, sizeof(run));
+  ram_record_parser_init(&run.parser, run.parser_buffer, sizeof(run.parser_buffer));
+  mc_23k640_sim_init(&run.ram);
+  host_mcu_init(&run.mcu1);
+  host_mcu_init(&run.mcu2);
+
+  /* Power-up, the RAM is random and MCU2 starts the ring */
+  host_mcu_bind(&run.mcu2);
+  mc_23k640_sim_attach(&run.ram, MC_23k640_CS1);
+  mcu2_spi_mngr_init(SPI_MNGR_CONFIG3);
+  HOST_TEST_CHECK(mcu2_mc_23k640_init());
+  host_mcu_bind(&run.mcu1);
+  mc_23k640_sim_attach(&run.ram, MC_23k640_CS1);
+  mcu1_spi_mngr_init(SPI_MNGR_CONFIG3);
+  HOST_TEST_CHECK(mcu1_mc_23k640_init());
+
+  for(uint8_t lap = 0 ; lap < TEST_LAPS ; lap++) {
+    HOST_TEST_CHECK(_test_write(&run, mcu1_mc_23k640_write_data, TEST_RECORDS));
+    _test_read(&run, mcu2_mc_23k640_read_data, UINT32_MAX);
+  }
+  HOST_TEST_CHECK(run.verified == run.produced && run.corrupted == 0);
+  HOST_TEST_CHECK(run.parser.lost == 0 && run.parser.crc_errors == 0 && run.parser.stale == 0);
+
+  /* Reboot of MCU2 with records not read yet, the tail in a record. Only the record cut by the reboot is lost */
+  HOST_TEST_CHECK(_test_write(&run, mcu1_mc_23k640_write_data, TEST_RECORDS));
+  HOST_TEST_CHECK(_test_read(&run, mcu2_mc_23k640_read_data, TEST_PARTIAL_READ) == TEST_PARTIAL_READ);
+  host_mcu_init(&run.mcu2);
+  host_mcu_bind(&run.mcu2);
+  mc_23k640_sim_attach(&run.ram, MC_23k640_CS1);
+  mcu2b_spi_mngr_init(SPI_MNGR_CONFIG3);
+  HOST_TEST_CHECK(mcu2b_mc_23k640_init());
+  ram_record_parser_reset(&run.parser);
+  HOST_TEST_CHECK(_test_write(&run, mcu1_mc_23k640_write_data, TEST_RECORDS));
+  _test_read(&run, mcu2b_mc_23k640_read_data, UINT32_MAX);
+  printf("MCU2 reboot: %u written, %u verified, %u corrupted, stale %u, bytes skipped %u\n",
+         run.produced, run.verified, run.corrupted, run.parser.stale, run.parser.skipped);
+  HOST_TEST_CHECK(run.corrupted == 0 && run.parser.stale == 0);
+  HOST_TEST_CHECK(run.verified + 1 >= run.produced);
+
+  /* Reboot of MCU1 with a record appended and not published, it is the only one lost */
+  produced = run.produced;
+  verified = run.verified;
+  lost = run.parser.lost;
+  host_mcu_bind(&run.mcu1);
+  size = _test_record(run.sequence++, record);
+  HOST_TEST_CHECK(mcu1_mc_23k640_append_data(record, size) == size);
+  host_mcu_init(&run.mcu1);
+  host_mcu_bind(&run.mcu1);
+  mc_23k640_sim_attach(&run.ram, MC_23k640_CS1);
+  mcu1b_spi_mngr_init(SPI_MNGR_CONFIG3);
+  HOST_TEST_CHECK(mcu1b_mc_23k640_init());
+  for(uint8_t lap = 0 ; lap < TEST_LAPS ; lap++) {
+    HOST_TEST_CHECK(_test_write(&run, mcu1b_mc_23k640_write_data, TEST_RECORDS));
+    _test_read(&run, mcu2b_mc_23k640_read_data, UINT32_MAX);
+  }
+  printf("MCU1 reboot: %u written, %u verified, %u corrupted, lost %u, CRC errors %u, stale %u\n",
+         run.produced - produced, run.verified - verified, run.corrupted, run.parser.lost - lost, run.parser.crc_errors,
+         run.parser.stale);
+  HOST_TEST_CHECK(run.corrupted == 0 && run.parser.stale == 0);
+  HOST_TEST_CHECK(run.verified - verified == run.produced - produced);
+  HOST_TEST_CHECK(run.parser.lost - lost == 1);
+
+  return HOST_TEST_RESULT("test_mc_23k640_reboot");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to mix the bits of a number, for the contents of the records
+ */
+static uint32_t _test_hash(uint32_t x) {
+
+  x ^= x >> 16;
+  x *= 0x7FEB352D;
+  x ^= x >> 15;
+  x *= 0x846CA68B;
+  x ^= x >> 16;
+  return x;
+
+}
+
+
+/*
+ * @brief Function to get a record from its sequence number
+ *
+ * @retval                  Record size
+ */
+static uint16_t _test_record(uint16_t sequence, uint8_t *record) {
+
+  uint32_t x = _test_hash(TEST_SEED ^ sequence);
+  uint16_t length = 1 + (uint16_t)(x % TEST_PAYLOAD_MAX);
+
+  for(uint16_t i = 0 ; i < length ; i++) {
+    record[RAM_RECORD_HEADER_SIZE + i] = (uint8_t)_test_hash(x + i);
+  }
+  ram_record_get_header(record, RAM_RECORD_ALERT, sequence, length);
+  ram_record_get_crc(&record[RAM_RECORD_HEADER_SIZE + length], record, &record[RAM_RECORD_HEADER_SIZE], length);
+  return length + RAM_RECORD_OVERHEAD;
+
+}
+
+
+/*
+ * @brief Function to write records from MCU1, each published
+ *
+ * @retval                  Returns true if all fitted in the ring
+ */
+static bool _test_write(test_run *run, test_write_fn write, uint32_t records) {
+
+  uint8_t record[TEST_PAYLOAD_MAX + RAM_RECORD_OVERHEAD];
+
+  host_mcu_bind(&run->mcu1);
+  for(uint32_t i = 0 ; i < records ; i++) {
+    uint16_t size = _test_record(run->sequence, record);
+
+    if(write(record, size) != size) {
+      return false;
+    }
+    run->sequence++;
+    run->produced++;
+  }
+  return true;
+
+}
+
+
+/*
+ * @brief Function to read from MCU2 until the ring is empty or max_bytes were read, and check the records
+ *
+ * @retval                  Bytes read
+ */
+static uint32_t _test_read(test_run *run, test_read_fn read, uint32_t max_bytes) {
+
+  uint8_t expected[TEST_PAYLOAD_MAX + RAM_RECORD_OVERHEAD];
+  mc_23k640_status status;
+  ram_record record;
+  uint32_t total = 0;
+  uint16_t space;
+  uint16_t nbytes;
+
+  host_mcu_bind(&run->mcu2);
+  do {
+    uint8_t *ptr = ram_record_parser_get_space(&run->parser, &space);
+
+    if(space > MC_23K640_DUAL_READ_CHUNK) {
+      space = MC_23K640_DUAL_READ_CHUNK;
+    }
+    if(space > max_bytes - total) {
+      space = (uint16_t)(max_bytes - total);
+    }
+    nbytes = read(ptr, space, &status);
+    ram_record_parser_commit(&run->parser, nbytes);
+    total += nbytes;
+    while(ram_record_parser_next(&run->parser, &record)) {
+      uint16_t size = _test_record(record.sequence, expected);
+      bool in_order = !run->has_last || (int16_t)(record.sequence - run->last) > 0;
+
+      if(in_order && record.type == RAM_RECORD_ALERT && record.length + RAM_RECORD_OVERHEAD == size &&
+         !memcmp(record.payload, &expected[RAM_RECORD_HEADER_SIZE], record.length)) {
+        run->verified++;
+      } else {
+        run->corrupted++;
+      }
+      run->last = record.sequence;
+      run->has_last = true;
+    }
+  } while(status == MC_23K640_DONE && total < max_bytes);
+  return total;
+
+}
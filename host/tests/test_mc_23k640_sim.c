@@ -0,0 +1,177 @@
+/*
+* @file           test_mc_23k640_sim.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the commands of the simulated 23K640 through the
+*                 SPI manager stub, in byte, page and sequential modes, and
+*                 its torn writes and bit flips.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+#include "mc_23k640_sim.h"
+
+/* Drivers */
+#include "mc_23k640.h"
+
+/* SDK */
+#include "nrf_gpio.h"
+#include "nrf_spi_mngr.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TEST_CS_PIN                   MC_23k640_CS1
+#define TEST_MAX_DATA                 200       /* Data bytes of a command, one transfer of the SPI manager */
+#define TEST_COMMAND_SIZE             3         /* Instruction and address */
+
+NRF_SPI_MNGR_DEF(_test_spi, 1, 2);
+
+static const nrf_drv_spi_config_t _test_spi_config = { .orc = 0xFF };
+
+/* Private functions list */
+static void _test_select(const uint8_t *tx, uint8_t tx_length, uint8_t *rx, uint8_t rx_length);
+static void _test_write_status(uint8_t status);
+static uint8_t _test_read_status(void);
+static void _test_write(uint16_t address, const uint8_t *data, uint8_t length);
+static void _test_read(uint16_t address, uint8_t *data, uint8_t length);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static mc_23k640_sim sim;
+  uint8_t data[TEST_MAX_DATA];
+  uint8_t back[TEST_MAX_DATA];
+  uint8_t before[MC_23K640_SIM_SIZE];
+  uint16_t diff;
+
+  for(uint16_t i = 0 ; i < TEST_MAX_DATA ; i++) {
+    data[i] = (uint8_t)(i * 7 + 1);
+  }
+  mc_23k640_sim_init(&sim);
+  mc_23k640_sim_attach(&sim, TEST_CS_PIN);
+  HOST_TEST_CHECK(nrf_spi_mngr_init(&_test_spi, &_test_spi_config) == NRF_SUCCESS);
+
+  /* RDSR and WRSR, byte mode after power up */
+  HOST_TEST_CHECK(_test_read_status() == MC_23K640_SIM_STATUS_RESET);
+  HOST_TEST_CHECK(mc_23k640_sim_get_mode(&sim) == MC_23K640_SIM_BYTE_MODE);
+
+  /* Byte mode, one byte per command */
+  memcpy(before, sim.memory, MC_23K640_SIM_SIZE);
+  _test_write(0x0100, data, 4);
+  HOST_TEST_CHECK(sim.memory[0x0100] == data[0]);
+  HOST_TEST_CHECK(!memcmp(&sim.memory[0x0101], &before[0x0101], 3));
+  _test_read(0x0100, back, 2);
+  HOST_TEST_CHECK(back[0] == data[0] && back[1] == 0xFF);
+
+  /* Page mode, wraps to the start of the 32 byte page */
+  _test_write_status(MC_23K640_SIM_PAGE_MODE << MC_23K640_SIM_MODE_SHIFT);
+  HOST_TEST_CHECK(_test_read_status() == MC_23K640_SIM_PAGE_MODE << MC_23K640_SIM_MODE_SHIFT);
+  _test_write(0x021C, data, 8);
+  HOST_TEST_CHECK(!memcmp(&sim.memory[0x021C], data, 4));
+  HOST_TEST_CHECK(!memcmp(&sim.memory[0x0200], &data[4], 4));
+  _test_read(0x021C, back, 8);
+  HOST_TEST_CHECK(!memcmp(back, data, 8));
+
+  /* Sequential mode, the whole array and back to 0, the 3 upper address bits are ignored */
+  _test_write_status(MC_23K640_SIM_SEQUENTIAL_MODE << MC_23K640_SIM_MODE_SHIFT);
+  _test_write(MC_23K640_SIM_SIZE - 2, data, 6);
+  HOST_TEST_CHECK(sim.memory[MC_23K640_SIM_SIZE - 2] == data[0] && sim.memory[MC_23K640_SIM_SIZE - 1] == data[1]);
+  HOST_TEST_CHECK(!memcmp(sim.memory, &data[2], 4));
+  _test_read(0xE000 | (MC_23K640_SIM_SIZE - 2), back, 6);
+  HOST_TEST_CHECK(!memcmp(back, data, 6));
+  _test_write(0x1000, data, TEST_MAX_DATA);
+  _test_read(0x1000, back, TEST_MAX_DATA);
+  HOST_TEST_CHECK(!memcmp(back, data, TEST_MAX_DATA));
+
+  /* Torn write, only the bytes before the fault are stored, a fault past the data bytes is no fault */
+  mc_23k640_sim_set_faults(&sim, 0x1000, 0x1001, 1, 0);
+  do {
+    memset(&sim.memory[0x1000], 0, TEST_MAX_DATA);
+    _test_write(0x1000, data, TEST_MAX_DATA);
+  } while(!sim.torn_writes);
+  HOST_TEST_CHECK(sim.torn_writes == 1 && sim.fault_at < TEST_MAX_DATA);
+  HOST_TEST_CHECK(!memcmp(&sim.memory[0x1000], data, sim.fault_at));
+  HOST_TEST_CHECK(sim.memory[0x1000 + sim.fault_at] == 0);
+  _test_write(0x1001, data, TEST_MAX_DATA);
+  HOST_TEST_CHECK(sim.torn_writes == 1);
+
+  /* Bit flip, one bit of one byte read, the memory keeps its value */
+  _test_write(0x1000, data, TEST_MAX_DATA);
+  mc_23k640_sim_set_faults(&sim, 0x1000, 0x1001, 0, 1);
+  do {
+    _test_read(0x1000, back, TEST_MAX_DATA);
+  } while(!sim.bit_flips);
+  HOST_TEST_CHECK(sim.bit_flips == 1);
+  diff = 0;
+  for(uint16_t i = 0 ; i < TEST_MAX_DATA ; i++) {
+    diff += __builtin_popcount(back[i] ^ data[i]);
+  }
+  HOST_TEST_CHECK(diff == 1);
+  HOST_TEST_CHECK(!memcmp(&sim.memory[0x1000], data, TEST_MAX_DATA));
+
+  return HOST_TEST_RESULT("test_mc_23k640_sim");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to run one command, with the chip select low for one transfer
+ */
+static void _test_select(const uint8_t *tx, uint8_t tx_length, uint8_t *rx, uint8_t rx_length) {
+
+  nrf_spi_mngr_transfer_t const transfers[] = { NRF_SPI_MNGR_TRANSFER(tx, tx_length, rx, rx_length) };
+
+  nrf_gpio_pin_clear(TEST_CS_PIN);
+  HOST_TEST_CHECK(nrf_spi_mngr_perform(&_test_spi, NULL, transfers, 1, NULL) == NRF_SUCCESS);
+  nrf_gpio_pin_set(TEST_CS_PIN);
+
+}
+
+
+static void _test_write_status(uint8_t status) {
+
+  uint8_t tx[] = { MC_23K640_WRITE_STAT_CMD, status };
+
+  _test_select(tx, sizeof(tx), NULL, 0);
+
+}
+
+
+static uint8_t _test_read_status(void) {
+
+  uint8_t tx[] = { MC_23K640_READ_STAT_CMD };
+  uint8_t rx[2];
+
+  _test_select(tx, sizeof(tx), rx, sizeof(rx));
+  return rx[1];
+
+}
+
+
+static void _test_write(uint16_t address, const uint8_t *data, uint8_t length) {
+
+  uint8_t tx[TEST_COMMAND_SIZE + TEST_MAX_DATA] = { MC_23K640_WRITE_CMD, address >> 8, address & 0xFF };
+
+  memcpy(&tx[TEST_COMMAND_SIZE], data, length);
+  _test_select(tx, TEST_COMMAND_SIZE + length, NULL, 0);
+
+}
+
+
+static void _test_read(uint16_t address, uint8_t *data, uint8_t length) {
+
+  uint8_t tx[] = { MC_23K640_READ_CMD, address >> 8, address & 0xFF };
+  uint8_t rx[TEST_COMMAND_SIZE + TEST_MAX_DATA];
+
+  _test_select(tx, sizeof(tx), rx, TEST_COMMAND_SIZE + length);
+  memcpy(data, &rx[TEST_COMMAND_SIZE], length);
+
+}
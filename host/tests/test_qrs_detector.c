@@ -0,0 +1,144 @@
+/*
+* @file           test_qrs_detector.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, sensitivity and positive predictivity of the QRS
+*                 detector of app_ecg at the monitoring rate. The beats read
+*                 back from the RAM are matched against the R peaks of the
+*                 synthetic ECG, over heart rate steps and two noise levels.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "ecg_replay.h"
+#include "ecg_synth.h"
+#include "host_test.h"
+
+/* Apps */
+#include "app_ecg.h"
+
+/* DSP */
+#include "qrs_detector.h"
+
+/* Standard library */
+#include <stdlib.h>
+
+/********************************** Private ************************************/
+#define TEST_RATE                     APP_ECG_LP_RATE
+#define TEST_SEGMENT_SECONDS          60
+#define TEST_RESP_BPM                 15
+#define TEST_NOISY_UV                 50        /* Noise of the odd segments, 10 uV on the others */
+#define TEST_SKIP_MS                  (2 * QRS_DETECTOR_LEARNING_MS)    /* Beats before this time are not scored */
+#define TEST_MATCH_MS                 75        /* Half of the 150 ms match window of EC57 */
+#define TEST_MIN_PERCENT              99.5      /* Sensitivity and positive predictivity */
+#define TEST_MAX_BEATS                2048
+
+/* Heart rate of each segment */
+static const uint16_t _hr_bpm[] = { 72, 45, 120, 180, 60, 150 };
+
+/* R peaks, of the recording and of the frames read back */
+typedef struct {
+  int32_t   samples[TEST_MAX_BEATS];
+  uint32_t  count;
+} test_beats;
+
+/* Private functions list */
+static void _test_add(test_beats *beats, int32_t sample);
+static void _test_frame(const ecg_codec_frame *frame, void *context);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static ecg_replay replay;
+  static test_beats truth;
+  static test_beats detected;
+  uint8_t frame[ADS129X_REPLAY_FRAME_SIZE];
+  ecg_synth synth;
+  int32_t skip = TEST_RATE * TEST_SKIP_MS / 1000;
+  int32_t window = TEST_RATE * TEST_MATCH_MS / 1000;
+  uint32_t tp = 0;
+  uint32_t fn = 0;
+  uint32_t fp = 0;
+  int64_t offset = 0;
+  double se;
+  double ppv;
+
+  HOST_TEST_CHECK(ecg_replay_init(&replay, false, ECG_REPLAY_MAX_SPEED));
+  HOST_TEST_CHECK(ads129x_sim_get_rate(&replay.board.ads1298) == TEST_RATE);
+  ecg_replay_set_frame_callback(&replay, _test_frame, &detected);
+
+  ecg_synth_init(&synth, TEST_RATE, _hr_bpm[0], TEST_RESP_BPM);
+  for(uint8_t s = 0 ; s < sizeof(_hr_bpm) / sizeof(_hr_bpm[0]) ; s++) {
+    synth.hr_bpm = _hr_bpm[s];
+    synth.noise_uv = (s & 1) ? TEST_NOISY_UV : 10;
+    for(uint32_t i = 0 ; i < TEST_SEGMENT_SECONDS * TEST_RATE ; i++) {
+      int32_t sample = (int32_t)synth.sample;
+
+      if(ecg_synth_next(&synth, frame)) {
+        _test_add(&truth, sample);
+      }
+      HOST_TEST_CHECK(ecg_replay_feed(&replay, frame));
+    }
+  }
+  HOST_TEST_CHECK(ecg_replay_finish(&replay));
+  HOST_TEST_CHECK(ecg_replay_get_dropped_frames(&replay) == 0);
+  HOST_TEST_CHECK(replay.delivered == replay.fed);
+
+  /* Beats matched in order, each R peak of the recording with at most one detection */
+  for(uint32_t t = 0, d = 0 ; t < truth.count || d < detected.count ; ) {
+    if(t < truth.count && d < detected.count && abs(detected.samples[d] - truth.samples[t]) <= window) {
+      if(truth.samples[t] >= skip) {
+        tp++;
+        offset += detected.samples[d] - truth.samples[t];
+      }
+      t++;
+      d++;
+    } else if(d >= detected.count || (t < truth.count && truth.samples[t] < detected.samples[d])) {
+      fn += (truth.samples[t] >= skip);
+      t++;
+    } else {
+      fp += (detected.samples[d] >= skip);
+      d++;
+    }
+  }
+  se = tp ? 100.0 * tp / (tp + fn) : 0;
+  ppv = tp ? 100.0 * tp / (tp + fp) : 0;
+  printf("Beats: %u in the recording, %u detected; TP %u FN %u FP %u, Se %.2f%% PPV %.2f%%, R offset mean %.1f ms\n",
+         truth.count, detected.count, tp, fn, fp, se, ppv, tp ? (double)offset * 1000 / TEST_RATE / tp : 0.0);
+
+  HOST_TEST_CHECK(truth.count < TEST_MAX_BEATS && detected.count < TEST_MAX_BEATS);
+  HOST_TEST_CHECK(se >= TEST_MIN_PERCENT);
+  HOST_TEST_CHECK(ppv >= TEST_MIN_PERCENT);
+
+  return HOST_TEST_RESULT("test_qrs_detector");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to add an R peak, the ones past TEST_MAX_BEATS are dropped and fail the test
+ */
+static void _test_add(test_beats *beats, int32_t sample) {
+
+  if(beats->count < TEST_MAX_BEATS) {
+    beats->samples[beats->count++] = sample;
+  }
+
+}
+
+
+/*
+ * @brief Callback of the frames read back, a beat is reported with the time from its R peak
+ */
+static void _test_frame(const ecg_codec_frame *frame, void *context) {
+
+  if(frame->fields[ECG_CODEC_FIELD_HR] || frame->fields[ECG_CODEC_FIELD_RR]) {
+    _test_add(context, (int32_t)frame->sample - (int32_t)frame->fields[ECG_CODEC_FIELD_R_OFFSET] * TEST_RATE / 1000);
+  }
+
+}
@@ -0,0 +1,139 @@
+/*
+* @file           test_resp_rate.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the respiration rate of resp_rate on synthetic
+*                 breathing at known rates, at 250 and 500 SPS. A sine on
+*                 an electrode offset with noise, then a pause past the
+*                 apnea time and a signal too small to be breathing.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+
+/* DSP */
+#include "resp_rate.h"
+
+/* Standard library */
+#include <math.h>
+#include <stdlib.h>
+
+/********************************** Private ************************************/
+#define TEST_SECONDS                  90        /* Breathing of each rate */
+#define TEST_SETTLE_SECONDS           30        /* Rates reported before this time are not scored */
+#define TEST_AMPLITUDE_UV             2000      /* Peak of the breathing, as ecg_synth */
+#define TEST_OFFSET_UV                -150000   /* Electrode offset on RESP */
+#define TEST_NOISE_UV                 100       /* Peak of the uniform noise */
+#define TEST_SMALL_UV                 5         /* Breathing below RESP_RATE_MIN_AMPLITUDE */
+#define TEST_MAX_ERROR_BPM            1
+#define TEST_SEED                     0x0BEA7u
+
+/* Sampling rates of the RESP channel and breathing rates */
+static const uint16_t _rates[] = { 250, 500 };
+static const uint16_t _bpm[] = { 6, 8, 12, 15, 20, 30, 40, 50 };    /* 60 is the edge, breaths RESP_RATE_MIN_BREATH_MS apart */
+
+/* Reports of one run */
+typedef struct {
+  uint32_t  reports;                            /* Rates reported after the settling time */
+  uint32_t  errors;                             /* Rates off by more than TEST_MAX_ERROR_BPM */
+  uint16_t  last_bpm;                           /* Last rate reported, 0 on apnea */
+} test_run;
+
+/* Private functions list */
+static uint32_t _test_random(uint32_t *seed);
+static void _test_breathe(resp_rate *resp, uint16_t rate, double bpm, double amplitude, uint32_t seconds,
+                          uint32_t *seed, test_run *run);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static resp_rate resp;
+  uint32_t seed = TEST_SEED;
+  uint32_t reports = 0;
+  uint32_t errors = 0;
+  test_run run;
+
+  HOST_TEST_CHECK(!resp_rate_init(&resp, 1000));
+
+  for(uint8_t r = 0 ; r < sizeof(_rates) / sizeof(_rates[0]) ; r++) {
+
+    /* Breathing at each rate, from a reset */
+    for(uint8_t b = 0 ; b < sizeof(_bpm) / sizeof(_bpm[0]) ; b++) {
+      HOST_TEST_CHECK(resp_rate_init(&resp, _rates[r]));
+      _test_breathe(&resp, _rates[r], _bpm[b], TEST_AMPLITUDE_UV, TEST_SECONDS, &seed, &run);
+      printf("%u SPS, %2u bpm: %2u bpm reported, %u reports, %u off by more than %u bpm\n", _rates[r], _bpm[b],
+             run.last_bpm, run.reports, run.errors, TEST_MAX_ERROR_BPM);
+      HOST_TEST_CHECK(run.reports > 0 && run.errors == 0);
+      HOST_TEST_CHECK(abs((int)resp_rate_get_bpm(&resp) - (int)_bpm[b]) <= TEST_MAX_ERROR_BPM);
+      reports += run.reports;
+      errors += run.errors;
+    }
+
+    /* A rate change without a reset, then a pause past the apnea time */
+    _test_breathe(&resp, _rates[r], 12, TEST_AMPLITUDE_UV, TEST_SECONDS, &seed, &run);
+    HOST_TEST_CHECK(run.errors == 0 && abs((int)run.last_bpm - 12) <= TEST_MAX_ERROR_BPM);
+    _test_breathe(&resp, _rates[r], 12, 0, RESP_RATE_APNEA_MS / 1000 + 2, &seed, &run);
+    HOST_TEST_CHECK(run.last_bpm == 0 && resp_rate_get_bpm(&resp) == 0);
+
+    /* Breathing too small is not counted */
+    HOST_TEST_CHECK(resp_rate_init(&resp, _rates[r]));
+    _test_breathe(&resp, _rates[r], 15, TEST_SMALL_UV, TEST_SECONDS, &seed, &run);
+    HOST_TEST_CHECK(resp_rate_get_bpm(&resp) == 0);
+  }
+  printf("%u rates reported, %u off by more than %u bpm\n", reports, errors, TEST_MAX_ERROR_BPM);
+
+  return HOST_TEST_RESULT("test_resp_rate");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to get a random number, xorshift32
+ */
+static uint32_t _test_random(uint32_t *seed) {
+
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+
+}
+
+
+/*
+ * @brief Function to run breathing through resp_rate and score the rates it reports
+ *
+ * @note                    The noise is TEST_NOISE_UV scaled down with the amplitude, so 0 is a flat signal
+ */
+static void _test_breathe(resp_rate *resp, uint16_t rate, double bpm, double amplitude, uint32_t seconds,
+                          uint32_t *seed, test_run *run) {
+
+  int32_t noise = (int32_t)(TEST_NOISE_UV * amplitude / TEST_AMPLITUDE_UV);
+
+  run->reports = 0;
+  run->errors = 0;
+  run->last_bpm = resp_rate_get_bpm(resp);
+  for(uint32_t i = 0 ; i < seconds * rate ; i++) {
+    double t = (double)i / rate;
+    int32_t sample = TEST_OFFSET_UV + (int32_t)lround(amplitude * sin(2 * M_PI * bpm / 60 * t));
+
+    if(noise) {
+      sample += (int32_t)(_test_random(seed) % (2 * noise + 1)) - noise;
+    }
+    if(!resp_rate_process(resp, sample)) {
+      continue;
+    }
+    run->last_bpm = resp_rate_get_bpm(resp);
+    if(i >= TEST_SETTLE_SECONDS * rate && run->last_bpm) {
+      run->reports++;
+      run->errors += (abs((int)run->last_bpm - (int)bpm) > TEST_MAX_ERROR_BPM);
+    }
+  }
+
+}
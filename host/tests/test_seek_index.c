@@ -0,0 +1,142 @@
+/*
+* @file           test_seek_index.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, an index written as app_usd writes it, with gaps
+*                 and a last sector not full, read back with seek_index_find
+*                 against a linear search of every entry.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+
+/* System utilities */
+#include "seek_index.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TEST_ENTRIES                  1000      /* 31 full sectors and 8 entries in the last one */
+#define TEST_SECTORS                  ((TEST_ENTRIES + SEEK_INDEX_ENTRIES - 1) / SEEK_INDEX_ENTRIES)
+#define TEST_START_MS                 1633046400000ULL
+#define TEST_ENTRY_MS                 25000     /* APP_USD_INDEX_RECORDS data records of one second */
+#define TEST_GAP_EVERY                97        /* Entries between gaps of the recording */
+#define TEST_GAP_MS                   3600000
+#define TEST_RECORD_SIZE              1234
+
+/* File of the index, the last sector is written up to its last entry */
+typedef struct {
+  uint8_t   bytes[TEST_SECTORS * SEEK_INDEX_SECTOR_SIZE];
+  uint32_t  size;
+  uint32_t  reads;
+  bool      fail;
+} test_file;
+
+/* Private functions list */
+static bool _test_read(void *context, uint32_t sector, uint8_t *buffer);
+static uint32_t _test_linear(const seek_index_entry *entries, uint64_t timestamp);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static test_file file;
+  static seek_index_entry entries[TEST_ENTRIES];
+  static seek_index_writer writer;
+  uint8_t buffer[SEEK_INDEX_SECTOR_SIZE];
+  seek_index_entry entry;
+  uint64_t timestamp = TEST_START_MS;
+  uint32_t max_reads = 0;
+
+  /* Writer, a sector written when it is full and the last one as it is at the end of the recording */
+  seek_index_writer_init(&writer);
+  for(uint32_t i = 0 ; i < TEST_ENTRIES ; i++) {
+    entries[i].timestamp = timestamp;
+    entries[i].record = i * (TEST_ENTRY_MS / 1000);
+    entries[i].offset = 256 * 4 + entries[i].record * TEST_RECORD_SIZE;
+    timestamp += TEST_ENTRY_MS + ((i % TEST_GAP_EVERY == TEST_GAP_EVERY - 1) ? TEST_GAP_MS : 0);
+    HOST_TEST_CHECK(seek_index_add(&writer, &entries[i]));
+    if(seek_index_is_full(&writer)) {
+      memcpy(&file.bytes[writer.sectors * SEEK_INDEX_SECTOR_SIZE], writer.sector, SEEK_INDEX_SECTOR_SIZE);
+      seek_index_next_sector(&writer);
+    }
+  }
+  HOST_TEST_CHECK(!seek_index_add(&writer, &entries[0]));
+  memcpy(&file.bytes[writer.sectors * SEEK_INDEX_SECTOR_SIZE], writer.sector, writer.count * SEEK_INDEX_ENTRY_SIZE);
+  file.size = writer.sectors * SEEK_INDEX_SECTOR_SIZE + writer.count * SEEK_INDEX_ENTRY_SIZE;
+  HOST_TEST_CHECK(seek_index_get_sectors(&writer) == TEST_SECTORS);
+
+  /* Format, little-endian entries of 16 bytes */
+  HOST_TEST_CHECK(file.bytes[0] == (uint8_t)TEST_START_MS && file.bytes[5] == (uint8_t)(TEST_START_MS >> 40));
+  HOST_TEST_CHECK(file.bytes[SEEK_INDEX_ENTRY_SIZE + 12] == (uint8_t)entries[1].record);
+
+  /* Each entry, just before it, within it and past the end */
+  for(uint32_t i = 0 ; i < TEST_ENTRIES ; i++) {
+    uint64_t times[] = { entries[i].timestamp - 1, entries[i].timestamp, entries[i].timestamp + TEST_ENTRY_MS / 2,
+                         entries[i].timestamp + TEST_GAP_MS };
+
+    for(uint8_t j = 0 ; j < sizeof(times) / sizeof(times[0]) ; j++) {
+      seek_index_entry const *expected = &entries[_test_linear(entries, times[j])];
+
+      file.reads = 0;
+      HOST_TEST_CHECK(seek_index_find(_test_read, &file, TEST_SECTORS, times[j], buffer, &entry));
+      HOST_TEST_CHECK(!memcmp(&entry, expected, sizeof(seek_index_entry)));
+      max_reads = (file.reads > max_reads) ? file.reads : max_reads;
+    }
+  }
+  HOST_TEST_CHECK(max_reads <= 6);                    /* log2(32) + 1 */
+
+  /* Before the recording, the first entry */
+  HOST_TEST_CHECK(seek_index_find(_test_read, &file, TEST_SECTORS, 0, buffer, &entry));
+  HOST_TEST_CHECK(entry.record == 0);
+
+  /* Empty index, and a failed read */
+  HOST_TEST_CHECK(!seek_index_find(_test_read, &file, 0, TEST_START_MS, buffer, &entry));
+  file.fail = true;
+  HOST_TEST_CHECK(!seek_index_find(_test_read, &file, TEST_SECTORS, TEST_START_MS, buffer, &entry));
+
+  return HOST_TEST_RESULT("test_seek_index");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to read a sector of the file, as _app_usd_index_read
+ */
+static bool _test_read(void *context, uint32_t sector, uint8_t *buffer) {
+
+  test_file *file = context;
+  uint32_t offset = sector * SEEK_INDEX_SECTOR_SIZE;
+  uint32_t bytes = (file->size > offset) ? file->size - offset : 0;
+
+  if(file->fail) {
+    return false;
+  }
+  bytes = (bytes > SEEK_INDEX_SECTOR_SIZE) ? SEEK_INDEX_SECTOR_SIZE : bytes;
+  memcpy(buffer, &file->bytes[offset], bytes);
+  memset(&buffer[bytes], SEEK_INDEX_EMPTY, SEEK_INDEX_SECTOR_SIZE - bytes);
+  file->reads++;
+  return true;
+
+}
+
+
+/*
+ * @brief Function to find the last entry not after a time, or the first one, one entry after the other
+ */
+static uint32_t _test_linear(const seek_index_entry *entries, uint64_t timestamp) {
+
+  uint32_t found = 0;
+
+  for(uint32_t i = 0 ; i < TEST_ENTRIES && entries[i].timestamp <= timestamp ; i++) {
+    found = i;
+  }
+  return found;
+
+}
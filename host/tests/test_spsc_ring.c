@@ -0,0 +1,228 @@
+/*
+* @file           test_spsc_ring.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host test, the SPSC ring between a producer and a consumer
+*                 thread interleaved at random, as the DRDY interrupt and the
+*                 main loop. Every element must arrive whole and in order,
+*                 and every element refused on a full ring must be counted.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_test.h"
+
+/* System utilities */
+#include "spsc_ring.h"
+
+/* Standard library */
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TEST_RING_SIZE                16        /* ADS129X_RAW_RING_SIZE */
+#define TEST_WORDS                    14        /* Element of the size of the frames of both devices */
+#define TEST_ELEMENTS                 2000000
+#define TEST_BATCH                    5
+#define TEST_START_INDEX              (UINT32_MAX - 1000)   /* The free running indexes wrap during the run */
+
+/* Element, every word follows from the sequence number so a torn element is seen */
+typedef struct {
+  uint32_t  sequence;
+  uint32_t  words[TEST_WORDS];
+} test_element;
+
+/* Run */
+typedef struct {
+  spsc_ring     ring;
+  test_element  buffer[TEST_RING_SIZE];
+  bool          drop;                                   /* Producer drops an element on a full ring, or tries again */
+  uint32_t      producer_yield;                         /* Producer yields once in N elements, 0 for never */
+  uint32_t      consumer_yield;                         /* Consumer yields once in N calls */
+  uint32_t      produced;
+  uint32_t      consumed;
+  uint32_t      skipped;                                /* Sequence numbers missing at the consumer */
+  uint32_t      torn;
+  uint32_t      unordered;
+  volatile bool done;
+} test_run;
+
+/* Private functions list */
+static uint32_t _test_random(uint32_t *seed);
+static void _test_fill(test_element *element, uint32_t sequence);
+static void _test_check(test_run *run, const test_element *element, uint32_t *next);
+static void *_test_producer(void *context);
+static void *_test_consumer(void *context);
+static void _test_run(test_run *run, bool drop, uint32_t producer_yield, uint32_t consumer_yield);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  static test_run run;
+
+  /* Producer tries again on a full ring, nothing is lost */
+  _test_run(&run, false, 0, 8);
+  HOST_TEST_CHECK(run.consumed == TEST_ELEMENTS && run.skipped == 0);
+  HOST_TEST_CHECK(run.torn == 0 && run.unordered == 0);
+
+  /* Producer drops on a full ring as the DRDY interrupt, the gaps are the overruns */
+  _test_run(&run, true, 4, 2);
+  HOST_TEST_CHECK(spsc_ring_get_overruns(&run.ring) > 0);
+  HOST_TEST_CHECK(run.consumed + spsc_ring_get_overruns(&run.ring) == TEST_ELEMENTS);
+  HOST_TEST_CHECK(run.skipped == spsc_ring_get_overruns(&run.ring));
+  HOST_TEST_CHECK(run.torn == 0 && run.unordered == 0);
+  HOST_TEST_CHECK(spsc_ring_count(&run.ring) == 0 && spsc_ring_free(&run.ring) == TEST_RING_SIZE);
+
+  return HOST_TEST_RESULT("test_spsc_ring");
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to get the next number of a random generator, xorshift32
+ */
+static uint32_t _test_random(uint32_t *seed) {
+
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+
+}
+
+
+static void _test_fill(test_element *element, uint32_t sequence) {
+
+  element->sequence = sequence;
+  for(uint8_t i = 0 ; i < TEST_WORDS ; i++) {
+    element->words[i] = sequence * 2654435761u + i;
+  }
+
+}
+
+
+/*
+ * @brief Function to check an element, its words and its order after the previous one
+ */
+static void _test_check(test_run *run, const test_element *element, uint32_t *next) {
+
+  test_element expected;
+
+  _test_fill(&expected, element->sequence);
+  run->torn += (memcmp(element, &expected, sizeof(test_element)) != 0);
+  if(element->sequence < *next) {
+    run->unordered++;
+  } else {
+    run->skipped += element->sequence - *next;
+    *next = element->sequence + 1;
+  }
+  run->consumed++;
+
+}
+
+
+/*
+ * @brief Thread of the producer, with both ways of writing
+ */
+static void *_test_producer(void *context) {
+
+  test_run *run = context;
+  uint32_t seed = 0x5C5C0001;
+
+  for(uint32_t sequence = 0 ; sequence < TEST_ELEMENTS ; sequence++) {
+    test_element element;
+    bool written;
+
+    do {
+      if(_test_random(&seed) & 1) {
+        _test_fill(&element, sequence);
+        written = spsc_ring_push(&run->ring, &element);
+      } else {
+        test_element *slot = spsc_ring_write_slot(&run->ring);
+
+        written = (slot != NULL);
+        if(written) {
+          _test_fill(slot, sequence);
+          spsc_ring_commit(&run->ring);
+        }
+      }
+      if(!written && !run->drop) {
+        sched_yield();
+      }
+    } while(!written && !run->drop);
+    run->produced++;
+    if(run->producer_yield && !(_test_random(&seed) % run->producer_yield)) {
+      sched_yield();
+    }
+  }
+  __atomic_store_n(&run->done, true, __ATOMIC_SEQ_CST);
+  return NULL;
+
+}
+
+
+/*
+ * @brief Thread of the consumer, one element in place or a batch, until the ring is empty after the producer ended
+ */
+static void *_test_consumer(void *context) {
+
+  test_run *run = context;
+  test_element batch[TEST_BATCH];
+  uint32_t seed = 0xC0C0C002;
+  uint32_t next = 0;
+  uint16_t count;
+  bool done;
+
+  do {
+    done = __atomic_load_n(&run->done, __ATOMIC_SEQ_CST);
+    if(_test_random(&seed) & 1) {
+      test_element *slot = spsc_ring_read_slot(&run->ring);
+
+      count = (slot != NULL);
+      if(slot) {
+        _test_check(run, slot, &next);
+        spsc_ring_release(&run->ring);
+      }
+    } else {
+      count = spsc_ring_pop_batch(&run->ring, batch, 1 + _test_random(&seed) % TEST_BATCH);
+      for(uint16_t i = 0 ; i < count ; i++) {
+        _test_check(run, &batch[i], &next);
+      }
+    }
+    if(!(_test_random(&seed) % run->consumer_yield)) {
+      sched_yield();
+    }
+  } while(!done || count);
+  run->skipped += TEST_ELEMENTS - next;
+  return NULL;
+
+}
+
+
+static void _test_run(test_run *run, bool drop, uint32_t producer_yield, uint32_t consumer_yield) {
+
+  pthread_t producer;
+  pthread_t consumer;
+
+  memset(run, 0, sizeof(test_run));
+  HOST_TEST_CHECK(spsc_ring_init(&run->ring, run->buffer, sizeof(test_element), TEST_RING_SIZE));
+  run->ring.head = TEST_START_INDEX;
+  run->ring.tail = TEST_START_INDEX;
+  run->drop = drop;
+  run->producer_yield = producer_yield;
+  run->consumer_yield = consumer_yield;
+
+  HOST_TEST_CHECK(!pthread_create(&consumer, NULL, _test_consumer, run));
+  HOST_TEST_CHECK(!pthread_create(&producer, NULL, _test_producer, run));
+  pthread_join(producer, NULL);
+  pthread_join(consumer, NULL);
+  printf("%u elements, %u consumed, %u overruns, %u skipped, %u torn, %u out of order\n", run->produced, run->consumed,
+         spsc_ring_get_overruns(&run->ring), run->skipped, run->torn, run->unordered);
+
+}
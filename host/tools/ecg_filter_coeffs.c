@@ -0,0 +1,185 @@
+/*
+* @file           ecg_filter_coeffs.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, design of the biquads of ecg_filter, from the
+*                 RBJ Audio EQ Cookbook formulas (bilinear transform) with
+*                 a0 = 1 and the coefficients rounded to Q2.30.
+*
+*                   ecg_filter_coeffs
+*
+*                 Prints the tables in the layout of ecg_filter.c, to paste
+*                 there when a design parameter changes. Exits with 1 if a
+*                 table of the build differs from the design.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* DSP */
+#include "ecg_filter.h"
+
+/* Standard library */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define ECG_FILTER_COEFFS_HP_Q        M_SQRT1_2 /* 2nd order Butterworth, 1 / sqrt(2) */
+#define ECG_FILTER_COEFFS_NOTCH_Q     20.0      /* Stop band of f0 / 20, 2.5 Hz at 50 Hz and 3 Hz at 60 Hz */
+#define ECG_FILTER_COEFFS_LP_SECTIONS 2
+
+/* Design of the tables */
+static const double _rates[ECG_FILTER_RATES_NUMBER] = { 250.0, 500.0 };
+static const double _hp_hz[] = { 0.05, 0.5 };
+static const double _notch_hz[] = { 50.0, 60.0 };
+static const double _lp_hz[] = { 40.0, 100.0 };
+static const double _lp_q[ECG_FILTER_COEFFS_LP_SECTIONS] = {   /* 4th order Butterworth, 1 / (2 cos(pi/8)) and 1 / (2 cos(3 pi/8)) */
+  0.54119610014619699, 1.3065629648763766
+};
+
+/* Kinds of biquad */
+typedef enum {
+  ECG_FILTER_COEFFS_HP,
+  ECG_FILTER_COEFFS_NOTCH,
+  ECG_FILTER_COEFFS_LP,
+} ecg_filter_coeffs_kind;
+
+/* Private functions list */
+static ecg_filter_biquad _ecg_filter_coeffs_design(ecg_filter_coeffs_kind kind, double f0, double fs, double q);
+static int32_t _ecg_filter_coeffs_q30(double value);
+static void _ecg_filter_coeffs_print(const ecg_filter_biquad *biquad, const char *indent);
+static uint32_t _ecg_filter_coeffs_check(const ecg_filter_biquad *biquad, ecg_filter_rate rate, ecg_filter_hp hp,
+                                         ecg_filter_notch notch, ecg_filter_lp lp, uint8_t stage);
+
+/********************************** Public ************************************/
+int main(void) {
+
+  ecg_filter_biquad biquad;
+  uint32_t mismatches = 0;
+
+  printf("static const ecg_filter_biquad _hp_coeffs[ECG_FILTER_RATES_NUMBER][2] = {\n");
+  for(uint8_t r = 0 ; r < ECG_FILTER_RATES_NUMBER ; r++) {
+    printf("  { /* %.0f SPS */\n", _rates[r]);
+    for(uint8_t f = 0 ; f < 2 ; f++) {
+      biquad = _ecg_filter_coeffs_design(ECG_FILTER_COEFFS_HP, _hp_hz[f], _rates[r], ECG_FILTER_COEFFS_HP_Q);
+      _ecg_filter_coeffs_print(&biquad, "    ");
+      mismatches += _ecg_filter_coeffs_check(&biquad, r, ECG_FILTER_HP_0_05HZ + f, ECG_FILTER_NOTCH_OFF, ECG_FILTER_LP_OFF, 0);
+    }
+    printf("  },\n");
+  }
+  printf("};\n\n");
+
+  printf("static const ecg_filter_biquad _notch_coeffs[ECG_FILTER_RATES_NUMBER][2] = {\n");
+  for(uint8_t r = 0 ; r < ECG_FILTER_RATES_NUMBER ; r++) {
+    printf("  { /* %.0f SPS */\n", _rates[r]);
+    for(uint8_t f = 0 ; f < 2 ; f++) {
+      biquad = _ecg_filter_coeffs_design(ECG_FILTER_COEFFS_NOTCH, _notch_hz[f], _rates[r], ECG_FILTER_COEFFS_NOTCH_Q);
+      _ecg_filter_coeffs_print(&biquad, "    ");
+      mismatches += _ecg_filter_coeffs_check(&biquad, r, ECG_FILTER_HP_OFF, ECG_FILTER_NOTCH_50HZ + f, ECG_FILTER_LP_OFF, 0);
+    }
+    printf("  },\n");
+  }
+  printf("};\n\n");
+
+  printf("static const ecg_filter_biquad _lp_coeffs[ECG_FILTER_RATES_NUMBER][2][2] = {\n");
+  for(uint8_t r = 0 ; r < ECG_FILTER_RATES_NUMBER ; r++) {
+    printf("  { /* %.0f SPS */\n", _rates[r]);
+    for(uint8_t f = 0 ; f < 2 ; f++) {
+      printf("    {\n");
+      for(uint8_t s = 0 ; s < ECG_FILTER_COEFFS_LP_SECTIONS ; s++) {
+        biquad = _ecg_filter_coeffs_design(ECG_FILTER_COEFFS_LP, _lp_hz[f], _rates[r], _lp_q[s]);
+        _ecg_filter_coeffs_print(&biquad, "      ");
+        mismatches += _ecg_filter_coeffs_check(&biquad, r, ECG_FILTER_HP_OFF, ECG_FILTER_NOTCH_OFF, ECG_FILTER_LP_40HZ + f, s);
+      }
+      printf("    },\n");
+    }
+    printf("  },\n");
+  }
+  printf("};\n");
+
+  if(mismatches) {
+    fprintf(stderr, "ecg_filter_coeffs: %u biquads of ecg_filter.c differ from the design\n", mismatches);
+    return 1;
+  }
+  return 0;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to design a biquad, normalized to a0 = 1
+ */
+static ecg_filter_biquad _ecg_filter_coeffs_design(ecg_filter_coeffs_kind kind, double f0, double fs, double q) {
+
+  double w0 = 2 * M_PI * f0 / fs;
+  double cos_w0 = cos(w0);
+  double alpha = sin(w0) / (2 * q);
+  double a0 = 1 + alpha;
+  double b0;
+  double b1;
+  ecg_filter_biquad biquad;
+
+  switch(kind) {
+    case ECG_FILTER_COEFFS_HP:
+      b0 = (1 + cos_w0) / 2;
+      b1 = -(1 + cos_w0);
+      break;
+    case ECG_FILTER_COEFFS_NOTCH:
+      b0 = 1;
+      b1 = -2 * cos_w0;
+      break;
+    default:
+      b0 = (1 - cos_w0) / 2;
+      b1 = 1 - cos_w0;
+      break;
+  }
+  biquad.b0 = _ecg_filter_coeffs_q30(b0 / a0);
+  biquad.b1 = _ecg_filter_coeffs_q30(b1 / a0);
+  biquad.b2 = biquad.b0;
+  biquad.a1 = _ecg_filter_coeffs_q30(-2 * cos_w0 / a0);
+  biquad.a2 = _ecg_filter_coeffs_q30((1 - alpha) / a0);
+  return biquad;
+
+}
+
+
+/*
+ * @brief Function to round a coefficient to Q2.30
+ */
+static int32_t _ecg_filter_coeffs_q30(double value) {
+  return (int32_t)lround(value * (1L << ECG_FILTER_COEFF_SHIFT));
+}
+
+
+/*
+ * @brief Function to print a biquad as a row of the tables, b0, b1, b2, a1, a2
+ */
+static void _ecg_filter_coeffs_print(const ecg_filter_biquad *biquad, const char *indent) {
+
+  printf("%s{%d, %d, %d, %d, %d},\n", indent, (int)biquad->b0, (int)biquad->b1, (int)biquad->b2, (int)biquad->a1,
+         (int)biquad->a2);
+
+}
+
+
+/*
+ * @brief Function to compare a biquad with the stage of the chain ecg_filter_init builds from the tables
+ *
+ * @retval                  Returns 1 if they differ, otherwise 0
+ */
+static uint32_t _ecg_filter_coeffs_check(const ecg_filter_biquad *biquad, ecg_filter_rate rate, ecg_filter_hp hp,
+                                         ecg_filter_notch notch, ecg_filter_lp lp, uint8_t stage) {
+
+  static ecg_filter filter;
+
+  if(!ecg_filter_init(&filter, 1, rate, hp, notch, lp) || stage >= filter.stages_number ||
+     memcmp(filter.stages[stage], biquad, sizeof(ecg_filter_biquad))) {
+    return 1;
+  }
+  return 0;
+
+}
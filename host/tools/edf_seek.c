@@ -0,0 +1,219 @@
+/*
+* @file           edf_seek.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, seek of a recording of the uSD card with its
+*                 index, as app_usd_seek, and extract of its data records
+*                 from that time into a new EDF+ file.
+*
+*                   edf_seek FILE.EDF TIME_MS [-r] [-o OUT.EDF] [-n RECORDS]
+*
+*                 The index is the file of the same name with the .IDX
+*                 extension, see seek_index.h. TIME_MS is in the time of the
+*                 TIMESTAMP field, or from the first entry with -r. OUT.EDF
+*                 gets the header with the number of data records copied,
+*                 up to RECORDS of them, otherwise up to the end, as EDF+D
+*                 when it does not start at the first one.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* System utilities */
+#include "edf.h"
+#include "seek_index.h"
+
+/* Standard library */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define EDF_SEEK_INDEX_EXTENSION      ".IDX"    /* APP_USD_INDEX_EXTENSION */
+#define EDF_SEEK_SIGNALS_OFFSET       252
+#define EDF_SEEK_SIGNALS_LENGTH       4
+#define EDF_SEEK_SAMPLES_OFFSET       (16 + 80 + 8 + 8 + 8 + 8 + 8 + 80)   /* Signal fields before the samples, per signal */
+#define EDF_SEEK_SAMPLES_LENGTH       8
+
+/* Private functions list */
+static int _edf_seek_usage(void);
+static bool _edf_seek_read(void *context, uint32_t sector, uint8_t *buffer);
+static uint32_t _edf_seek_field(const uint8_t *header, uint32_t offset, uint8_t length);
+static int _edf_seek_extract(FILE *edf, const seek_index_entry *entry, const char *path, uint32_t max_records);
+
+/********************************** Public ************************************/
+int main(int argc, char **argv) {
+
+  static uint8_t sector[SEEK_INDEX_SECTOR_SIZE];
+  char index_path[FILENAME_MAX];
+  const char *out = NULL;
+  const char *dot;
+  uint32_t max_records = UINT32_MAX;
+  uint64_t timestamp;
+  bool relative = false;
+  seek_index_entry entry;
+  uint32_t sectors;
+  FILE *index;
+  FILE *edf;
+  int ret;
+
+  if(argc < 3) {
+    return _edf_seek_usage();
+  }
+  timestamp = strtoull(argv[2], NULL, 0);
+  for(int i = 3 ; i < argc ; i++) {
+    if(!strcmp(argv[i], "-r")) {
+      relative = true;
+    } else if(!strcmp(argv[i], "-o") && i + 1 < argc) {
+      out = argv[++i];
+    } else if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+      max_records = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else {
+      return _edf_seek_usage();
+    }
+  }
+
+  dot = strrchr(argv[1], '.');
+  snprintf(index_path, sizeof(index_path), "%.*s%s", (int)(dot ? dot - argv[1] : (long)strlen(argv[1])), argv[1],
+           EDF_SEEK_INDEX_EXTENSION);
+  index = fopen(index_path, "rb");
+  if(index == NULL) {
+    fprintf(stderr, "edf_seek: no index %s\n", index_path);
+    return 1;
+  }
+  fseek(index, 0, SEEK_END);
+  sectors = (uint32_t)((ftell(index) + SEEK_INDEX_SECTOR_SIZE - 1) / SEEK_INDEX_SECTOR_SIZE);
+
+  /* The first entry is the start of the recording */
+  if(relative) {
+    if(!_edf_seek_read(index, 0, sector)) {
+      fclose(index);
+      fprintf(stderr, "edf_seek: %s is empty\n", index_path);
+      return 1;
+    }
+    seek_index_get_entry(sector, 0, &entry);
+    timestamp += entry.timestamp;
+  }
+  if(!seek_index_find(_edf_seek_read, index, sectors, timestamp, sector, &entry)) {
+    fclose(index);
+    fprintf(stderr, "edf_seek: %s is empty\n", index_path);
+    return 1;
+  }
+  fclose(index);
+  printf("%llu ms: data record %u at offset %u, time %llu ms\n", (unsigned long long)timestamp, entry.record,
+         entry.offset, (unsigned long long)entry.timestamp);
+  if(out == NULL) {
+    return 0;
+  }
+
+  edf = fopen(argv[1], "rb");
+  if(edf == NULL) {
+    fprintf(stderr, "edf_seek: cannot open %s\n", argv[1]);
+    return 1;
+  }
+  ret = _edf_seek_extract(edf, &entry, out, max_records);
+  fclose(edf);
+  return ret;
+
+}
+
+
+/********************************** Private ************************************/
+static int _edf_seek_usage(void) {
+
+  fprintf(stderr, "usage: edf_seek FILE.EDF TIME_MS [-r] [-o OUT.EDF] [-n RECORDS]\n");
+  return 2;
+
+}
+
+
+/*
+ * @brief Function to read a sector of the index, the rest of a short last sector is SEEK_INDEX_EMPTY
+ */
+static bool _edf_seek_read(void *context, uint32_t sector, uint8_t *buffer) {
+
+  FILE *file = context;
+  size_t bytes;
+
+  if(fseek(file, (long)sector * SEEK_INDEX_SECTOR_SIZE, SEEK_SET)) {
+    return false;
+  }
+  bytes = fread(buffer, 1, SEEK_INDEX_SECTOR_SIZE, file);
+  memset(&buffer[bytes], SEEK_INDEX_EMPTY, SEEK_INDEX_SECTOR_SIZE - bytes);
+  return bytes > 0;
+
+}
+
+
+/*
+ * @brief Function to get a number field of the header, ASCII padded with spaces
+ */
+static uint32_t _edf_seek_field(const uint8_t *header, uint32_t offset, uint8_t length) {
+
+  char text[EDF_SEEK_SAMPLES_LENGTH + 1];
+
+  memcpy(text, &header[offset], length);
+  text[length] = '\0';
+  return (uint32_t)strtoul(text, NULL, 10);
+
+}
+
+
+/*
+ * @brief Function to copy the header and the data records from the entry on, with the number of records copied
+ */
+static int _edf_seek_extract(FILE *edf, const seek_index_entry *entry, const char *path, uint32_t max_records) {
+
+  static uint8_t header[EDF_HEADER_BYTES(EDF_MAX_SIGNALS)];
+  uint8_t *record;
+  uint32_t signals;
+  uint32_t record_size = 0;
+  uint32_t records = 0;
+  FILE *out;
+
+  if(fread(header, 1, EDF_HEADER_SIZE, edf) != EDF_HEADER_SIZE) {
+    fprintf(stderr, "edf_seek: no EDF header\n");
+    return 1;
+  }
+  signals = _edf_seek_field(header, EDF_SEEK_SIGNALS_OFFSET, EDF_SEEK_SIGNALS_LENGTH);
+  if(signals == 0 || signals > EDF_MAX_SIGNALS ||
+     fread(&header[EDF_HEADER_SIZE], 1, EDF_HEADER_SIZE * signals, edf) != EDF_HEADER_SIZE * signals ||
+     entry->offset < EDF_HEADER_BYTES(signals)) {
+    fprintf(stderr, "edf_seek: bad EDF header\n");
+    return 1;
+  }
+  for(uint32_t i = 0 ; i < signals ; i++) {
+    record_size += EDF_SAMPLE_SIZE *
+                   _edf_seek_field(header, EDF_HEADER_SIZE + signals * EDF_SEEK_SAMPLES_OFFSET + i * EDF_SEEK_SAMPLES_LENGTH,
+                                   EDF_SEEK_SAMPLES_LENGTH);
+  }
+
+  record = malloc(record_size);
+  out = fopen(path, "wb");
+  if(record == NULL || out == NULL || fseek(edf, entry->offset, SEEK_SET) ||
+     fseek(out, EDF_HEADER_BYTES(signals), SEEK_SET)) {
+    fprintf(stderr, "edf_seek: cannot write %s\n", path);
+    free(record);
+    if(out) {
+      fclose(out);
+    }
+    return 1;
+  }
+  while(records < max_records && fread(record, 1, record_size, edf) == record_size) {
+    fwrite(record, 1, record_size, out);
+    records++;
+  }
+  edf_get_records(&header[EDF_RECORDS_OFFSET], (int32_t)records);
+  if(entry->record) {
+    edf_get_reserved(&header[EDF_RESERVED_OFFSET], false);   /* The onsets of the TALs keep the time from the start */
+  }
+  rewind(out);
+  fwrite(header, 1, EDF_HEADER_BYTES(signals), out);
+  fclose(out);
+  free(record);
+  printf("%u data records of %u bytes in %s\n", records, record_size, path);
+  return 0;
+
+}
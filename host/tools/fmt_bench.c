@@ -0,0 +1,249 @@
+/*
+* @file           fmt_bench.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, time per call of fmt_u32, fmt_i32 and
+*                 fmt_float against snprintf of the host C library, and of
+*                 utils_ftoa of the sense library for the floats, on the
+*                 same random values.
+*
+*                   fmt_bench [-n VALUES] [-d DECIMALS] [-s SEED]
+*
+*                 Each function formats the VALUES values in turn, the best
+*                 of 5 runs is kept. utils_ftoa is only timed up to 3
+*                 decimals, past the digits of a float it does not end.
+*                 Exits with 1 if a text of fmt differs from snprintf.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "host_clock.h"
+
+/* System utilities */
+#include "fmt.h"
+
+/* Sensefinity */
+#include "sense_library/utils/utils.h"
+
+/* Standard library */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define FMT_BENCH_VALUES              100000
+#define FMT_BENCH_DECIMALS            3
+#define FMT_BENCH_SAMPLES             5
+#define FMT_BENCH_SEED                0x0F3A7u
+#define FMT_BENCH_FLOAT_RANGE         100000.0f /* Floats in +-, as the measurements printed */
+#define FMT_BENCH_FTOA_DECIMALS       3
+
+/* Function timed, formats value i of the set and returns the length */
+typedef uint8_t (*fmt_bench_fn)(char *text, uint32_t i);
+
+/* Random values */
+static uint32_t *_u32;
+static float *_float;
+static uint8_t _decimals = FMT_BENCH_DECIMALS;
+
+/* Lengths of all the calls, so none is left out by the compiler */
+static volatile uint32_t _sink;
+
+/* Private functions list */
+static int _fmt_bench_usage(void);
+static uint32_t _fmt_bench_random(uint32_t *seed);
+static double _fmt_bench_time(fmt_bench_fn fn, uint32_t values);
+static uint32_t _fmt_bench_mismatches(fmt_bench_fn fn, fmt_bench_fn reference, uint32_t values);
+static uint8_t _fmt_bench_u32(char *text, uint32_t i);
+static uint8_t _fmt_bench_u32_snprintf(char *text, uint32_t i);
+static uint8_t _fmt_bench_i32(char *text, uint32_t i);
+static uint8_t _fmt_bench_i32_snprintf(char *text, uint32_t i);
+static uint8_t _fmt_bench_float(char *text, uint32_t i);
+static uint8_t _fmt_bench_float_snprintf(char *text, uint32_t i);
+static uint8_t _fmt_bench_float_ftoa(char *text, uint32_t i);
+
+/********************************** Public ************************************/
+int main(int argc, char **argv) {
+
+  uint32_t values = FMT_BENCH_VALUES;
+  uint32_t decimals = FMT_BENCH_DECIMALS;
+  uint32_t seed = FMT_BENCH_SEED;
+  uint32_t mismatches = 0;
+  double ns[2];
+
+  for(int i = 1 ; i < argc ; i++) {
+    uint32_t *option = NULL;
+
+    if(!strcmp(argv[i], "-n")) {
+      option = &values;
+    } else if(!strcmp(argv[i], "-d")) {
+      option = &decimals;
+    } else if(!strcmp(argv[i], "-s")) {
+      option = &seed;
+    }
+    if(option == NULL || i + 1 >= argc) {
+      return _fmt_bench_usage();
+    }
+    *option = (uint32_t)strtoul(argv[++i], NULL, 0);
+  }
+  if(!values || decimals > FMT_MAX_DECIMALS) {
+    return _fmt_bench_usage();
+  }
+  _decimals = (uint8_t)decimals;
+
+  _u32 = malloc(values * sizeof(uint32_t));
+  _float = malloc(values * sizeof(float));
+  if(_u32 == NULL || _float == NULL) {
+    fprintf(stderr, "fmt_bench: out of memory\n");
+    return 1;
+  }
+  for(uint32_t i = 0 ; i < values ; i++) {
+    _u32[i] = _fmt_bench_random(&seed) >> (_fmt_bench_random(&seed) & 0x1F);    /* All the numbers of digits */
+    _float[i] = ((float)_fmt_bench_random(&seed) / UINT32_MAX * 2 - 1) * FMT_BENCH_FLOAT_RANGE;
+  }
+
+  mismatches += _fmt_bench_mismatches(_fmt_bench_u32, _fmt_bench_u32_snprintf, values);
+  mismatches += _fmt_bench_mismatches(_fmt_bench_i32, _fmt_bench_i32_snprintf, values);
+  mismatches += _fmt_bench_mismatches(_fmt_bench_float, _fmt_bench_float_snprintf, values);
+
+  printf("%u values, ns per call, best of %u runs\n", values, FMT_BENCH_SAMPLES);
+  ns[0] = _fmt_bench_time(_fmt_bench_u32_snprintf, values);
+  ns[1] = _fmt_bench_time(_fmt_bench_u32, values);
+  printf("u32:   snprintf %6.1f, fmt_u32   %6.1f, %4.1fx\n", ns[0], ns[1], ns[0] / ns[1]);
+  ns[0] = _fmt_bench_time(_fmt_bench_i32_snprintf, values);
+  ns[1] = _fmt_bench_time(_fmt_bench_i32, values);
+  printf("i32:   snprintf %6.1f, fmt_i32   %6.1f, %4.1fx\n", ns[0], ns[1], ns[0] / ns[1]);
+  ns[0] = _fmt_bench_time(_fmt_bench_float_snprintf, values);
+  ns[1] = _fmt_bench_time(_fmt_bench_float, values);
+  printf("float: snprintf %6.1f, fmt_float %6.1f, %4.1fx, %u decimals\n", ns[0], ns[1], ns[0] / ns[1], _decimals);
+  if(_decimals <= FMT_BENCH_FTOA_DECIMALS) {
+    printf("float: utils_ftoa %6.1f\n", _fmt_bench_time(_fmt_bench_float_ftoa, values));
+  }
+
+  free(_u32);
+  free(_float);
+  if(mismatches) {
+    fprintf(stderr, "fmt_bench: %u texts differ from snprintf\n", mismatches);
+    return 1;
+  }
+  return 0;
+
+}
+
+
+/********************************** Private ************************************/
+static int _fmt_bench_usage(void) {
+
+  fprintf(stderr, "usage: fmt_bench [-n VALUES] [-d DECIMALS] [-s SEED]\n");
+  return 2;
+
+}
+
+
+/*
+ * @brief Function to get a random number, xorshift32
+ */
+static uint32_t _fmt_bench_random(uint32_t *seed) {
+
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+
+}
+
+
+/*
+ * @brief Function to time a function over the values, the best of FMT_BENCH_SAMPLES runs
+ *
+ * @retval                  Nanoseconds per call
+ */
+static double _fmt_bench_time(fmt_bench_fn fn, uint32_t values) {
+
+  char text[FMT_FIXED_SIZE + 16];
+  uint64_t best = UINT64_MAX;
+
+  for(uint8_t s = 0 ; s < FMT_BENCH_SAMPLES ; s++) {
+    uint64_t start = host_clock_get_host_ns();
+    uint32_t length = 0;
+
+    for(uint32_t i = 0 ; i < values ; i++) {
+      length += fn(text, i);
+    }
+    start = host_clock_get_host_ns() - start;
+    if(start < best) {
+      best = start;
+    }
+    _sink += length;
+  }
+  return (double)best / values;
+
+}
+
+
+/*
+ * @brief Function to count the values a function formats unlike the reference
+ */
+static uint32_t _fmt_bench_mismatches(fmt_bench_fn fn, fmt_bench_fn reference, uint32_t values) {
+
+  char text[FMT_FIXED_SIZE + 16];
+  char expected[FMT_FIXED_SIZE + 16];
+  uint32_t mismatches = 0;
+
+  for(uint32_t i = 0 ; i < values ; i++) {
+    uint8_t length = fn(text, i);
+
+    if(length != reference(expected, i) || strcmp(text, expected)) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+
+}
+
+
+static uint8_t _fmt_bench_u32(char *text, uint32_t i) {
+  return fmt_u32(text, _u32[i]);
+}
+
+
+static uint8_t _fmt_bench_u32_snprintf(char *text, uint32_t i) {
+  return (uint8_t)snprintf(text, FMT_U32_SIZE, "%" PRIu32, _u32[i]);
+}
+
+
+static uint8_t _fmt_bench_i32(char *text, uint32_t i) {
+  return fmt_i32(text, (int32_t)_u32[i]);
+}
+
+
+static uint8_t _fmt_bench_i32_snprintf(char *text, uint32_t i) {
+  return (uint8_t)snprintf(text, FMT_I32_SIZE, "%" PRId32, (int32_t)_u32[i]);
+}
+
+
+static uint8_t _fmt_bench_float(char *text, uint32_t i) {
+  return fmt_float(text, _float[i], _decimals);
+}
+
+
+static uint8_t _fmt_bench_float_snprintf(char *text, uint32_t i) {
+  return (uint8_t)snprintf(text, FMT_FIXED_SIZE, "%.*f", (int)_decimals, (double)_float[i]);
+}
+
+
+/*
+ * @brief Function to format a float with utils_ftoa, to the precision of the decimals
+ */
+static uint8_t _fmt_bench_float_ftoa(char *text, uint32_t i) {
+
+  static const float precisions[FMT_BENCH_FTOA_DECIMALS + 1] = { 1.0f, 1e-1f, 1e-2f, 1e-3f };
+
+  return (uint8_t)strlen(utils_ftoa(text, _float[i], precisions[_decimals]));
+
+}
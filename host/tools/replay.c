@@ -0,0 +1,141 @@
+/*
+* @file           replay.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, replay of recorded ADS129x frames through the
+*                 firmware of MCU1, or a synthetic recording to replay.
+*
+*                   replay gen FILE SECONDS [-l] [-h HR_BPM]
+*                   replay run FILE [-l] [-x SPEED]
+*
+*                 FILE has ADS129X_REPLAY_FRAME_SIZE bytes per frame, back to
+*                 back, as app_replay takes them. -l is the low power rate,
+*                 otherwise high resolution. SPEED is 1 for real time, N for
+*                 N times faster and 0, the default, as fast as possible.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "ecg_replay.h"
+#include "ecg_synth.h"
+
+/* Apps */
+#include "app_ecg.h"
+
+/* Standard library */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define REPLAY_HR_BPM                 72
+#define REPLAY_RESP_BPM               15
+
+/* Private functions list */
+static int _replay_usage(void);
+static int _replay_gen(const char *path, uint32_t seconds, bool accuracy, uint16_t hr_bpm);
+static int _replay_run(const char *path, bool accuracy, uint32_t speed);
+
+/********************************** Public ************************************/
+int main(int argc, char **argv) {
+
+  bool accuracy = true;
+  uint32_t speed = ECG_REPLAY_MAX_SPEED;
+  uint16_t hr_bpm = REPLAY_HR_BPM;
+  int first = (argc > 1 && !strcmp(argv[1], "gen")) ? 4 : 3;
+
+  if(argc < first) {
+    return _replay_usage();
+  }
+  for(int i = first ; i < argc ; i++) {
+    if(!strcmp(argv[i], "-l")) {
+      accuracy = false;
+    } else if(!strcmp(argv[i], "-x") && i + 1 < argc) {
+      speed = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else if(!strcmp(argv[i], "-h") && i + 1 < argc) {
+      hr_bpm = (uint16_t)strtoul(argv[++i], NULL, 0);
+    } else {
+      return _replay_usage();
+    }
+  }
+
+  if(!strcmp(argv[1], "gen")) {
+    return _replay_gen(argv[2], (uint32_t)strtoul(argv[3], NULL, 0), accuracy, hr_bpm);
+  }
+  if(!strcmp(argv[1], "run")) {
+    return _replay_run(argv[2], accuracy, speed);
+  }
+  return _replay_usage();
+
+}
+
+
+/********************************** Private ************************************/
+static int _replay_usage(void) {
+
+  fprintf(stderr, "usage: replay gen FILE SECONDS [-l] [-h HR_BPM]\n"
+                  "       replay run FILE [-l] [-x SPEED]\n");
+  return 2;
+
+}
+
+
+/*
+ * @brief Function to write a synthetic recording
+ */
+static int _replay_gen(const char *path, uint32_t seconds, bool accuracy, uint16_t hr_bpm) {
+
+  uint32_t rate = accuracy ? APP_ECG_HP_RATE : APP_ECG_LP_RATE;
+  uint8_t frame[ADS129X_REPLAY_FRAME_SIZE];
+  ecg_synth synth;
+  FILE *file = fopen(path, "wb");
+
+  if(!file || !hr_bpm) {
+    fprintf(stderr, "replay: cannot write %s\n", path);
+    return 1;
+  }
+  ecg_synth_init(&synth, rate, hr_bpm, REPLAY_RESP_BPM);
+  for(uint32_t i = 0 ; i < seconds * rate ; i++) {
+    ecg_synth_next(&synth, frame);
+    fwrite(frame, 1, sizeof(frame), file);
+  }
+  fclose(file);
+  printf("%u frames at %u SPS, %u beats\n", seconds * rate, rate, synth.beats);
+  return 0;
+
+}
+
+
+/*
+ * @brief Function to replay a recording and print the report
+ */
+static int _replay_run(const char *path, bool accuracy, uint32_t speed) {
+
+  static ecg_replay replay;
+  uint8_t frame[ADS129X_REPLAY_FRAME_SIZE];
+  FILE *file = fopen(path, "rb");
+  bool stopped;
+
+  if(!file) {
+    fprintf(stderr, "replay: cannot read %s\n", path);
+    return 1;
+  }
+  if(!ecg_replay_init(&replay, accuracy, speed)) {
+    fprintf(stderr, "replay: the ADS129x did not start\n");
+    fclose(file);
+    return 1;
+  }
+  while(fread(frame, 1, sizeof(frame), file) == sizeof(frame)) {
+    ecg_replay_feed(&replay, frame);
+  }
+  fclose(file);
+  stopped = ecg_replay_finish(&replay);
+
+  ecg_replay_print(&replay, stdout);
+  return (stopped && !ecg_replay_get_dropped_frames(&replay)) ? 0 : 1;
+
+}
@@ -0,0 +1,89 @@
+/*
+* @file           sram_bench.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          Host build, throughput of the 23K640 shared by MCU1 and MCU2,
+*                 with the threads interleaved at random and faults injected
+*                 in the data region of the ring.
+*
+*                   sram_bench [-n RECORDS] [-y YIELD] [-t TORN] [-f FLIP] [-s SEED]
+*
+*                 YIELD is one yield in N bytes clocked, TORN and FLIP are one
+*                 torn write and one bit flip in N commands, 0 for none.
+*                 Exits with 1 if a record read back is not the one written.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Host */
+#include "mc_23k640_dual.h"
+
+/* Standard library */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************** Private ************************************/
+#define SRAM_BENCH_RECORDS            100000
+#define SRAM_BENCH_YIELD_RATE         64
+#define SRAM_BENCH_SEED               0x23640
+
+/* Private functions list */
+static int _sram_bench_usage(void);
+
+/********************************** Public ************************************/
+int main(int argc, char **argv) {
+
+  static mc_23k640_dual dual;
+  uint32_t records = SRAM_BENCH_RECORDS;
+  uint32_t yield_rate = SRAM_BENCH_YIELD_RATE;
+  uint32_t torn_rate = 0;
+  uint32_t flip_rate = 0;
+  uint32_t seed = SRAM_BENCH_SEED;
+
+  for(int i = 1 ; i < argc ; i++) {
+    uint32_t *option = NULL;
+
+    if(!strcmp(argv[i], "-n")) {
+      option = &records;
+    } else if(!strcmp(argv[i], "-y")) {
+      option = &yield_rate;
+    } else if(!strcmp(argv[i], "-t")) {
+      option = &torn_rate;
+    } else if(!strcmp(argv[i], "-f")) {
+      option = &flip_rate;
+    } else if(!strcmp(argv[i], "-s")) {
+      option = &seed;
+    }
+    if(option == NULL || i + 1 >= argc) {
+      return _sram_bench_usage();
+    }
+    *option = (uint32_t)strtoul(argv[++i], NULL, 0);
+  }
+
+  if(!mc_23k640_dual_init(&dual, seed)) {
+    fprintf(stderr, "sram_bench: init of the RAM failed\n");
+    return 1;
+  }
+  dual.ram.yield_rate = yield_rate;
+  mc_23k640_sim_set_faults(&dual.ram, DATA_MEMORY_ADDR, CONFIG_MEMORY_ADDR, torn_rate, flip_rate);
+  if(!mc_23k640_dual_run(&dual, records)) {
+    fprintf(stderr, "sram_bench: threads failed\n");
+    return 1;
+  }
+  mc_23k640_dual_print(&dual, stdout);
+  return (dual.corrupted == 0) ? 0 : 1;
+
+}
+
+
+/********************************** Private ************************************/
+static int _sram_bench_usage(void) {
+
+  fprintf(stderr, "usage: sram_bench [-n RECORDS] [-y YIELD] [-t TORN] [-f FLIP] [-s SEED]\n");
+  return 2;
+
+}
@@ -20,6 +20,7 @@
 #include "sense_library/periph/rtc.h"
 #include "utils.h"
 #include "twi_mngr.h"
+#include "fmt.h"
 
 /* Debug - libs */
 #include "sense_library/utils/debug.h"
@@ -188,20 +189,18 @@ void app_body_temperature_loop(void) {
         temp_res = temp_res/APP_BODYTEMP_TEMPERATURE_FACTOR;
 
         /* Add temperature timestamp to send */
-        utils_save_uint64_t_to_array_keep_endianness(&_data_buffer[4], ads1114_get_data()->timestamp);
+        utils_save_uint64_t_to_array_keep_endianness(&_data_buffer[APP_BODYTEMP_RECORD_IDX + MEAS_DEVICE_OFFSET(TIMESTAMP)], ads1114_get_data()->timestamp);
 
         debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());//////////////////////////////////////////////////////////////////////////
         debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[app_body_temperature_loop] Timestamp:%dms\n", ads1114_get_data()->timestamp);
 
         /* Store the low resolution temperature */
-        _data_buffer[12] = CONVERT_UINT16_TO_UINT8((i + APP_BODYTEMP_LOOKUP_TABLE_MIN_TEMPERATURE), 1);
-        _data_buffer[13] = CONVERT_UINT16_TO_UINT8((i + APP_BODYTEMP_LOOKUP_TABLE_MIN_TEMPERATURE), 0);               
+        utils_save_uint32_t_to_array(&_data_buffer[APP_BODYTEMP_RECORD_IDX + MEAS_DEVICE_OFFSET(TEMP)], i + APP_BODYTEMP_LOOKUP_TABLE_MIN_TEMPERATURE);
 
         /* Converts charge voltage to string */
-        char temp_string[10];
-        _lr_temperature = _data_buffer[12] << 8 | _data_buffer[13];
-        memset(temp_string, '\0', 10);
-        utils_ftoa(temp_string, (float)_lr_temperature/APP_BODYTEMP_TEMPERATURE_FACTOR, 0.01);
+        char temp_string[FMT_FIXED_SIZE];
+        _lr_temperature = i + APP_BODYTEMP_LOOKUP_TABLE_MIN_TEMPERATURE;
+        fmt_fixed(temp_string, (int64_t)_lr_temperature, APP_BODYTEMP_TEMPERATURE_DECIMALS);
 
         debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
         debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[app_body_temperature_loop] Calculated Resistance:%d, Low Resolution temperature:%sC\n", temp_res, temp_string);
@@ -216,7 +215,7 @@ void app_body_temperature_loop(void) {
       /* To Do - Adicionar alertas para a RAM */         
 
       /* Adicionar measurement da temperatura da NTC  RAM */
-      if(meas_mngr_store_temp(&_data_buffer[4])) {
+      if(meas_mngr_store_temp(&_data_buffer[APP_BODYTEMP_RECORD_IDX])) {
         _current_state = BODYTEMP_IDLE;
       }  
 
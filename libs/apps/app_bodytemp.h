@@ -37,7 +37,8 @@ typedef enum {
 
 #define APP_BODYTEMP_PWR_EN                                 (NRF_GPIO_PIN_MAP(0, 25))      ///< Telco UART Rx pin number.
 
-#define APP_BODYTEMP_DATA_PACKET_MEASUREMENT_SIZE           14             /* Size in bytes of each measurement */
+#define APP_BODYTEMP_RECORD_IDX                             4              /* Temperature record in the meas_device_layout, after the resistance */
+#define APP_BODYTEMP_DATA_PACKET_MEASUREMENT_SIZE           (APP_BODYTEMP_RECORD_IDX + MEAS_DEVICE_FRAME_SIZE) /* Size in bytes of each measurement */
 
 /* Analog frontend constants */
 #define APP_BODYTEMP_VREF                                   3             /* Voltage reference on the wheatstone bridge */
@@ -48,6 +49,7 @@ typedef enum {
 #define APP_BODYTEMP_LOOKUP_TABLE_MIN_TEMPERATURE           340           /* Minimum temperature */
 #define APP_BODYTEMP_LOOKUP_TABLE_MAX_TEMPERATURE           430           /* Maximum temperature */
 #define APP_BODYTEMP_TEMPERATURE_FACTOR                     10            /* Multiplying factor for temperature value */
+#define APP_BODYTEMP_TEMPERATURE_DECIMALS                   1             /* Decimals of the factor */
 
 /* Utility macros*/
 #define RESISTANCE_CONVERTER(voltage) (APP_BODYTEMP_R_BOTTOM_WHEATSTONE * (((float)APP_BODYTEMP_VREF / (float)((float)voltage + APP_BODYTEMP_VA)) - 1))  /* Converter tenso para resistencia */
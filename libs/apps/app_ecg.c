@@ -26,12 +26,17 @@
 #include "sense_library/utils/debug.h"
 #include "sense_library/utils/utils.h"
 
-/* C standard library */
-//#include <stdint.h>
-//#include <stdbool.h>
-//#include <stdlib.h>
-//#include "arm_math.h"
-//uint16_t _idxxx = 0;
+/* DSP */
+#include "dsp/ecg_filter.h"
+#include "dsp/ecg_leads.h"
+#include "dsp/qrs_detector.h"
+#include "dsp/resp_rate.h"
+#include "dsp/pace_capture.h"
+#include "dsp/timebase.h"
+#include "dsp/ecg_codec.h"
+
+/* Utilities */
+#include "cycle_counter.h"
 
 /********************************** Private ************************************/
 /*
@@ -40,9 +45,77 @@
 static app_ecg_states _current_state;
 
 /*
-* Varivel da ultimo timestamp de medida adquirido
+* Frames convertidos pelo ADS129x e respetivo nmero
 */
-static uint64_t _data_timestamp;
+static ads129x_frame _ecg_frames[APP_ECG_FRAMES_BATCH];
+static uint16_t _ecg_frames_count;
+
+/*
+* Sinais vitais detetados em cada frame
+*/
+static app_ecg_vitals _ecg_vitals[APP_ECG_FRAMES_BATCH];
+
+#if !APP_ECG_COMPRESS_FRAMES
+/*
+* Varivel com o frame serializado para envio
+*/
+static uint8_t _ecg_data[APP_ECG_DATA_SIZE];
+#endif
+
+/*
+* Filtros dos canais de ECG
+*/
+static ecg_filter _ecg_filter;
+
+/*
+* Execution time statistics of the filter chain, per batch of frames
+*/
+static cycle_counter_stats _filter_stats;
+
+/*
+* Number of samples filtered, used to get the cycles per sample
+*/
+static uint64_t _filtered_samples;
+
+/*
+* Detetor de QRS do lead APP_ECG_QRS_LEAD
+*/
+static qrs_detector _qrs_detector;
+
+/*
+* Execution time statistics of the QRS detector, per batch of frames
+*/
+static cycle_counter_stats _qrs_stats;
+
+/*
+* Number of samples through the QRS detector, used to get the cycles per sample
+*/
+static uint64_t _qrs_samples;
+
+/*
+* Frequncia respiratria do canal RESP
+*/
+static resp_rate _resp_rate;
+
+/*
+* Captura de eventos de pace e registo serializado
+*/
+static pace_capture _pace_capture;
+static uint8_t _pace_record[PACE_CAPTURE_RECORD_MAX];
+
+/*
+* Base de tempo das amostras e registo serializado da ncora
+*/
+static timebase _timebase;
+static uint8_t _anchor_record[TIMEBASE_RECORD_SIZE];
+
+/*
+* Compresso dos frames, bloco em curso e bytes antes e depois da compresso
+*/
+static ecg_codec _ecg_codec;
+static uint8_t _ecg_block[APP_ECG_CODEC_BLOCK_SIZE];
+static uint64_t _raw_bytes;
+static uint64_t _compressed_bytes;
 
 /*
 * Varivel de estado da configurao inicial
@@ -54,53 +127,43 @@ static bool _init_config_status;
 */
 static bool _save_mode;
 
+/*
+* Settings of the last app_ecg_config(), to restart at a lower rate
+*/
+static bool _accuracy;
+static bool _lead_off;
+static uint8_t _ecg_gain;
+static uint8_t _resp_gain;
+static uint8_t _test_mode;
+
+/*
+* Backpressure from meas_mngr, frames thinned out while the RAM is full
+*/
+static bool _pressure;
+static bool _low_rate_pending;
+static uint8_t _low_rate_retries;
+static uint8_t _decimation_count;
+static uint32_t _decimated_frames;
+
 /*
  * Callback function to check if save mode is active
  */
 static power_save_callback_def _power_save_callback;
 
 /* Private functions list */
-
-
-//arm_fir_instance_f32 ssss;
-//float32_t samples_to_filter[5000];
-//float32_t samples_filtered[5000];
-
-//static uint8_t _count = 0;
-
-//#define BLOCK_SIZE            10
-//#if defined(ARM_MATH_MVEF) && !defined(ARM_MATH_AUTOVECTORIZE)
-///* Must be a multiple of 16 */
-//#define NUM_TAPS_ARRAY_SIZE              32
-//#else
-//#define NUM_TAPS_ARRAY_SIZE              29
-//#endif
-//#define NUM_TAPS              29
-
-///* -------------------------------------------------------------------
-// * Declare State buffer of size (numTaps + blockSize - 1)
-// * ------------------------------------------------------------------- */
-//#if defined(ARM_MATH_MVEF) && !defined(ARM_MATH_AUTOVECTORIZE)
-//static float32_t firStateF32[2 * BLOCK_SIZE + NUM_TAPS - 1];
-//#else
-//static float32_t firStateF32[BLOCK_SIZE + NUM_TAPS - 1];
-//#endif 
-///* ----------------------------------------------------------------------
-//** FIR Coefficients buffer generated using fir1() MATLAB function.
-//** fir1(28, 6/24)
-//** ------------------------------------------------------------------- */
-//#if defined(ARM_MATH_MVEF) && !defined(ARM_MATH_AUTOVECTORIZE)
-//const float32_t firCoeffs32[NUM_TAPS_ARRAY_SIZE] = {
-//  -0.0018225230f, -0.0015879294f, +0.0000000000f, +0.0036977508f, +0.0080754303f, +0.0085302217f, -0.0000000000f, -0.0173976984f,
-//  -0.0341458607f, -0.0333591565f, +0.0000000000f, +0.0676308395f, +0.1522061835f, +0.2229246956f, +0.2504960933f, +0.2229246956f,
-//  +0.1522061835f, +0.0676308395f, +0.0000000000f, -0.0333591565f, -0.0341458607f, -0.0173976984f, -0.0000000000f, +0.0085302217f,
-//  +0.0080754303f, +0.0036977508f, +0.0000000000f, -0.0015879294f, -0.0018225230f, 0.0f,0.0f,0.0f
-//};
-//#else
-//const float32_t firCoeffs32[NUM_TAPS_ARRAY_SIZE] = {
-//  -0.0011,-0.0002,-0.0003, -0.0031, -0.0095, -0.0150, -0.0098,  0.0149,  0.0551,  0.0897,  0.0901,  0.0405, -0.0453, -0.1268,  0.8415, -0.1268, -0.0453,  0.0405,  0.0901,  0.0897,  0.0551,  0.0149, -0.0098, -0.0150, -0.0095, -0.0031, -0.0003, -0.0002, -0.001
-//};
-//#endif
+static void _app_ecg_detect_beat(int32_t sample, app_ecg_vitals *vitals);
+static void _app_ecg_detect_breath(int32_t sample, app_ecg_vitals *vitals);
+static void _app_ecg_capture_pace(const ads129x_frame *frame);
+static void _app_ecg_add_anchor(const ads129x_frame *frame);
+static void _app_ecg_compress(const ads129x_frame *frame, const app_ecg_vitals *vitals);
+static void _app_ecg_store_block(void);
+static void _app_ecg_set_rate(bool accuracy);
+static void _app_ecg_set_config(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain, uint8_t test_mode);
+static void _app_ecg_reset_processing(void);
+static meas_mngr_policy _app_ecg_policy(uint8_t type, uint16_t size, uint16_t free);
+static bool _app_ecg_keep_frame(const app_ecg_vitals *vitals);
+static void _app_ecg_go_low_rate(void);
+static void _app_ecg_low_rate_failed(void);
 
 /********************************** Public ************************************/
 /*
@@ -112,11 +175,26 @@ void app_ecg_init(power_save_callback_def power_save_callback) {
   
   _power_save_callback = power_save_callback;
   _current_state = APP_ECG_POWERED_OFF;
-  char *sequence[] = ADS129X_DATA_ORDER;
-  meas_mngr_ecg_set_sequence(sequence, ARRAY_LEN(sequence));
      
-  /* Call FIR init function to initialize the instance structure. */
-  //arm_fir_init_f32(&ssss, NUM_TAPS, (float32_t *)&firCoeffs32[0], &firStateF32[0], BLOCK_SIZE);  
+  /* Filtros para a amostragem por defeito (250 SPS) */
+  ecg_filter_init(&_ecg_filter, ADS129X_CHANNELS, ECG_FILTER_250SPS, APP_ECG_FILTER_HP, APP_ECG_FILTER_NOTCH, APP_ECG_FILTER_LP);
+  cycle_counter_init();
+  cycle_counter_stats_init(&_filter_stats, 0);
+  _filtered_samples = 0;
+  qrs_detector_init(&_qrs_detector, APP_ECG_LP_RATE);
+  cycle_counter_stats_init(&_qrs_stats, 0);
+  _qrs_samples = 0;
+  resp_rate_init(&_resp_rate, APP_ECG_LP_RATE);
+  pace_capture_init(&_pace_capture, APP_ECG_LP_RATE, APP_ECG_PACE_PRE, APP_ECG_PACE_POST);
+  timebase_init(&_timebase, APP_ECG_LP_RATE);
+  ecg_codec_encoder_init(&_ecg_codec, ECG_BLOCK_TYPE, APP_ECG_CODEC_CHANNELS, _ecg_block, sizeof(_ecg_block));
+  _raw_bytes = 0;
+  _compressed_bytes = 0;
+  _pressure = false;
+  _low_rate_pending = false;
+  _low_rate_retries = 0;
+  _decimated_frames = 0;
+  meas_mngr_set_policy(_app_ecg_policy);
 
 }
 
@@ -126,6 +204,8 @@ void app_ecg_init(power_save_callback_def power_save_callback) {
  */
 void app_ecg_loop(void) {
     
+  uint32_t start;
+
   if(_power_save_callback()) {                          /* Check if save mode is active */
     _current_state = APP_ECG_SAVE_MODE;
     _save_mode = true;
@@ -161,54 +241,131 @@ void app_ecg_loop(void) {
     case APP_ECG_SAMPLING:       
 
       /* Verificar se existe novo data para envio */      
-      if(utils_get_serial_from_array(&ads129x_get_data()[0]) > _data_timestamp) {
-
-        uint64_t timestamp = utils_get_serial_from_array(&ads129x_get_data()[0]);
-        debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-        debug_printf_string(DEBUG_LEVEL_0, "[app_ecg_loop] Send data timestamp: %d\n", timestamp);
-
+      _ecg_frames_count = ads129x_read_frames(_ecg_frames, APP_ECG_FRAMES_BATCH);
+      if(_ecg_frames_count) {
 
         _current_state = APP_ECG_UPLOAD_DATA;
-        _data_timestamp = rtc_get_milliseconds();
         debug_print_time(DEBUG_LEVEL_3, rtc_get_milliseconds());
-        debug_print_string(DEBUG_LEVEL_3, "[app_ecg_loop] Going to send data\n");
+        debug_printf_string(DEBUG_LEVEL_3, (uint8_t*)"[app_ecg_loop] Going to send data, sample: %lu, timestamp: %lu ms, frames: %d\n",
+                            (unsigned long)_ecg_frames[0].sample, (unsigned long)(timebase_get_us(&_timebase, _ecg_frames[0].sample) / 1000),
+                            _ecg_frames_count);
       }
 
       break;
     case APP_ECG_UPLOAD_DATA:
-      
-      //if(_count < 5000) {
-      //  samples_to_filter[_count] = (utils_get_uint32_from_array(&ads129x_get_data()[8]))/ADS129x_INTEGER_CONVERT;
-      //  _count++;
-      
-      //  if(_count >= 10){
-      //    arm_fir_f32(&ssss, &samples_to_filter[_idxxx], samples_filtered, 10);
-      //    _idxxx++;
-      //  }
-      //} else{
-      //  debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-      //  debug_print_string(DEBUG_LEVEL_0, "[app_ecg_loop] Filtering Ended, Going to print\n");
-
-      //  /* Converts charge voltage to string */
-      //  char voltage_string[10];
-      //  memset(voltage_string, '\0', 10);
-        
-      //  for(int i=0; i < 5000; i++) {
-      //    memset(voltage_string, '\0', 10);
-      //    utils_ftoa(voltage_string, (float)samples_to_filter[i] * 1000, 0.00000001);
 
-      //    debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-      //    debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"%s\n", voltage_string);
-          
-      //  }
+      /* Timebase anchors, stored before the events and frames they time */
+      for(uint16_t i = 0 ; i < _ecg_frames_count ; i++) {
+        if(_ecg_frames[i].anchor) {
+          _app_ecg_add_anchor(&_ecg_frames[i]);
+        }
+      }
 
+      /* Pace events, before filtering to keep the pulses */
+      for(uint16_t i = 0 ; i < _ecg_frames_count ; i++) {
+        _app_ecg_capture_pace(&_ecg_frames[i]);
+      }
+      
+      /* Filter each ECG lead over the whole batch, RESP has its own processing */
+      start = cycle_counter_get();
+      for(uint8_t ch = 0 ; ch < ADS129X_CHANNELS ; ch++) {
+        if(ch != ADS129X_RESP_CHANNEL) {
+          ecg_filter_process(&_ecg_filter, ch, &_ecg_frames[0].channels[ch], _ecg_frames_count, APP_ECG_FRAME_STRIDE);
+        }
+      }
+      cycle_counter_stats_add(&_filter_stats, start);
+      _filtered_samples += _ecg_frames_count * (ADS129X_CHANNELS - 1);
+
+      #if ECG_STORE_DERIVED_LEADS
+      /* Derived limb leads from the filtered leads I and II */
+      for(uint16_t i = 0 ; i < _ecg_frames_count ; i++) {
+        ecg_leads_derive_all(_ecg_frames[i].channels[ADS129X_LEAD_I_CHANNEL], _ecg_frames[i].channels[ADS129X_LEAD_II_CHANNEL],
+                             &_ecg_frames[i].channels[ADS129X_LEAD_III_CHANNEL]);
+      }
+      #endif
+
+      /* QRS detection, the beat goes in the frame where it was detected */
+      start = cycle_counter_get();
+      for(uint16_t i = 0 ; i < _ecg_frames_count ; i++) {
+        _app_ecg_detect_beat(_ecg_frames[i].channels[APP_ECG_QRS_LEAD], &_ecg_vitals[i]);
+      }
+      cycle_counter_stats_add(&_qrs_stats, start);
+      _qrs_samples += _ecg_frames_count;
 
-      //}
+      /* Respiration rate from the raw RESP channel */
+      for(uint16_t i = 0 ; i < _ecg_frames_count ; i++) {
+        _app_ecg_detect_breath(_ecg_frames[i].channels[ADS129X_RESP_CHANNEL], &_ecg_vitals[i]);
+      }
       
+      /* Backpressure ends once MCU2 freed APP_ECG_PRESSURE_RELEASE bytes of RAM */
+      if(_pressure && meas_mngr_get_free_space() >= APP_ECG_PRESSURE_RELEASE) {
+        _pressure = false;
+        debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+        debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[app_ecg_loop] RAM pressure ended, frames decimated: %lu\n", (unsigned long)_decimated_frames);
+      }
+
       /* Upload to RAM */
-      //meas_mngr_store_ecg(ads129x_get_data());      
+      for(uint16_t i = 0 ; i < _ecg_frames_count ; i++) {
+        if(!_app_ecg_keep_frame(&_ecg_vitals[i])) {
+          continue;
+        }
+        #if APP_ECG_COMPRESS_FRAMES
+        _app_ecg_compress(&_ecg_frames[i], &_ecg_vitals[i]);
+        #else
+        ads129x_frame_to_array(&_ecg_frames[i], _ecg_data);
+        app_ecg_vitals_to_array(&_ecg_vitals[i], _ecg_data);
+        meas_mngr_store_ecg(_ecg_data);
+        #endif
+      }
       _current_state = APP_ECG_SAMPLING;
 
+      if(_low_rate_pending) {
+        _app_ecg_go_low_rate();
+      }
+
+      break;
+    case APP_ECG_LOW_RATE_STOP:
+
+      /* Last frames at the previous rate, in a shorter block */
+      if(!app_ecg_stop_sample()) {
+        _app_ecg_low_rate_failed();
+        break;
+      }
+      _current_state = APP_ECG_LOW_RATE_CONFIG;
+
+      break;
+    case APP_ECG_LOW_RATE_CONFIG:
+
+      if(!app_ecg_config(false, _lead_off, _ecg_gain, _resp_gain, _test_mode)) {
+        _app_ecg_low_rate_failed();
+        break;
+      }
+      _current_state = APP_ECG_LOW_RATE_START;
+
+      break;
+    case APP_ECG_LOW_RATE_START:
+
+      /* The wakeup of the ADS129x takes ADS129X_TWAKEUP, the next loops check it again */
+      switch(ads129x_start_sample()) {
+        case ADS129X_TRUE:
+          _app_ecg_reset_processing();
+          if(ads129x_start_datac()) {
+            _current_state = APP_ECG_SAMPLING;
+            debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+            debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[app_ecg_go_low_rate] Sampling at %u SPS\n", (unsigned int)APP_ECG_LP_RATE);
+          } else if(++_low_rate_retries >= APP_ECG_RETRIES_CMD) {
+            _app_ecg_low_rate_failed();
+          }
+          break;
+        case ADS129X_FAULT:
+          if(++_low_rate_retries >= APP_ECG_RETRIES_CMD) {
+            _app_ecg_low_rate_failed();
+          }
+          break;
+        default:
+          break;
+      }
+
       break;
     case APP_ECG_SAVE_MODE:
       app_ecg_stop_sample();
@@ -236,14 +393,19 @@ void app_ecg_loop(void) {
  */
 bool app_ecg_config(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain, uint8_t test_mode) {
   
-  uint8_t status;
   uint8_t retries = 0;
   
+  /* Precaution, nothing changes while sampling */
+  if(_current_state == APP_ECG_SAMPLING || _current_state == APP_ECG_UPLOAD_DATA ||
+     _current_state == APP_ECG_LOW_RATE_STOP || _current_state == APP_ECG_LOW_RATE_START) {
+    return false;
+  }
+
   /* Configuraes iniciais */
   if(!_init_config_status) {     
     while(true) {
       if(ads129x_configs(accuracy, lead_off, ecg_gain, resp_gain, test_mode)) {    
-        _current_state = APP_ECG_NOP;
+        _app_ecg_set_config(accuracy, lead_off, ecg_gain, resp_gain, test_mode);
         return true;
       }
       retries++;
@@ -255,15 +417,10 @@ bool app_ecg_config(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp
     }
   }
     
-  /* Precaution */
-  if(_current_state == APP_ECG_SAMPLING) {
-    return false;
-  }
-
   /* User Configs */
   while(true) {
     if(ads129x_user_configs(accuracy, lead_off, ecg_gain, resp_gain, test_mode)) {    
-      _current_state = APP_ECG_NOP;
+      _app_ecg_set_config(accuracy, lead_off, ecg_gain, resp_gain, test_mode);
       return true;
     }
     retries++;
@@ -285,7 +442,7 @@ bool app_ecg_config(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp
  */
 bool app_ecg_start_sample(void) {
 
-  uint8_t retries;
+  uint8_t retries = 0;
 
   /* Precaution */
   if(_current_state == APP_ECG_SAMPLING) {
@@ -309,6 +466,8 @@ bool app_ecg_start_sample(void) {
     }
   }    
   
+  _app_ecg_reset_processing();
+  
   retries = 0;
   for(; retries < APP_ECG_RETRIES_CMD; retries++) {
     if(ads129x_start_datac()) {
@@ -316,8 +475,48 @@ bool app_ecg_start_sample(void) {
       return true;
     }
   }
+  return false;
+
+}
+
+
+#if ADS129X_REPLAY
+/*
+ * @brief Function to start sampling recorded frames, fed with ads129x_replay_feed() instead of the ECG devices
+ *
+ * @param[in] accuracy      True if the recording is high resolution (APP_ECG_HP_RATE), otherwise low power
+ * @param[in] lead_off      True if the recording has the lead-off status
+ * @param[in] ecg_gain      ECG gain of the recording, must be 1,2,3,4,6,8 or 12
+ * @param[in] resp_gain     RESP gain of the recording, must be 1,2,3,4,6,8 or 12
+ */
+void app_ecg_start_replay(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain) {
+
+  _app_ecg_set_rate(accuracy);
+  _app_ecg_reset_processing();
+  ads129x_replay_start(lead_off, ecg_gain, resp_gain);
+  _current_state = APP_ECG_SAMPLING;
+
+}
+
+
+/*
+ * @brief Function to stop sampling recorded frames, the last frames are stored in a shorter block
+ *
+ * @retval                  Returns true if stopped, or false if the last frames read are still being processed
+ */
+bool app_ecg_stop_replay(void) {
+
+  if(_current_state == APP_ECG_UPLOAD_DATA) {
+    return false;
+  }
+  if(_current_state == APP_ECG_SAMPLING) {
+    _app_ecg_store_block();
+    _current_state = APP_ECG_NOP;
+  }
+  return true;
 
 }
+#endif
 
 
 /*
@@ -334,6 +533,7 @@ bool app_ecg_stop_sample(void) {
   
   for(int retries = 0 ; retries < APP_ECG_RETRIES_CMD; retries++) {
     if(ads129x_stop_datac()) {
+      _app_ecg_store_block();                           /* Last frames, in a shorter block */
       _current_state = APP_ECG_NOP;
       return true;
     }
@@ -367,4 +567,392 @@ bool app_ecg_is_busy(void) {
     return true;
   }
 
-}
\ No newline at end of file
+}
+
+
+/*
+ * @brief Function to get the mean cost of the filter chain
+ *
+ * @return                  Returns the mean CPU cycles per filtered sample
+ */
+uint32_t app_ecg_get_filter_cycles_per_sample(void) {
+
+  if(!_filtered_samples) {
+    return 0;
+  }
+  return (uint32_t)(_filter_stats.total / _filtered_samples);
+
+}
+
+
+/*
+ * @brief Function to get the mean cost of the QRS detector
+ *
+ * @return                  Returns the mean CPU cycles per sample of the detected lead
+ */
+uint32_t app_ecg_get_qrs_cycles_per_sample(void) {
+
+  if(!_qrs_samples) {
+    return 0;
+  }
+  return (uint32_t)(_qrs_stats.total / _qrs_samples);
+
+}
+
+
+/*
+ * @brief Function to get the heart rate of the last beat
+ *
+ * @return                  Returns the heart rate in beats per minute, or 0 if unknown
+ */
+uint16_t app_ecg_get_heart_rate(void) {
+  return qrs_detector_get_beat(&_qrs_detector)->hr_bpm;
+}
+
+
+/*
+ * @brief Function to get the respiration rate
+ *
+ * @return                  Returns the breaths per minute, or 0 if unknown or on apnea
+ */
+uint16_t app_ecg_get_resp_rate(void) {
+  return resp_rate_get_bpm(&_resp_rate);
+}
+
+
+/*
+ * @brief Function to get the number of pace events captured
+ *
+ * @return                  Returns the events since the sampling started
+ */
+uint32_t app_ecg_get_pace_events(void) {
+  return pace_capture_get_events(&_pace_capture);
+}
+
+
+/*
+ * @brief Function to get the drift of the ADS129x clock against the RTC
+ *
+ * @return                  Returns the drift in ppm, positive if the sampling is slower than nominal
+ */
+int32_t app_ecg_get_clock_drift(void) {
+  return timebase_get_drift_ppm(&_timebase);
+}
+
+
+/*
+ * @brief Function to get the compression ratio of the stored frames
+ *
+ * @return                  Returns the frames size in the meas_ecg_layout over the compressed size,
+ *                          in hundredths, or 0 if no block was stored
+ */
+uint32_t app_ecg_get_compression_ratio(void) {
+
+  if(!_compressed_bytes) {
+    return 0;
+  }
+  return (uint32_t)(_raw_bytes * 100 / _compressed_bytes);
+
+}
+
+
+/*
+ * @brief Function to get the time of a sample
+ *
+ * @param[in] sample        Sample index of the frame
+ * @return                  Returns the RTC time of the sample in microseconds
+ */
+uint64_t app_ecg_get_sample_time(uint32_t sample) {
+  return timebase_get_us(&_timebase, sample);
+}
+
+
+/*
+ * @brief Function to serialize the vital signs fields of a frame, after the ADS129x data
+ *
+ * @param[in] vitals        Vital signs of the frame
+ * @param[out] array        Frame with APP_ECG_DATA_SIZE bytes, the ADS129x data is kept
+ */
+void app_ecg_vitals_to_array(const app_ecg_vitals *vitals, uint8_t *array) {
+
+  utils_save_uint16_t_to_array(&array[MEAS_ECG_OFFSET(ECG_HR)], vitals->hr_bpm);
+  utils_save_uint16_t_to_array(&array[MEAS_ECG_OFFSET(ECG_RR)], vitals->rr_ms);
+  utils_save_uint16_t_to_array(&array[MEAS_ECG_OFFSET(ECG_R_OFFSET)], vitals->r_offset_ms);
+  utils_save_uint16_t_to_array(&array[MEAS_ECG_OFFSET(RESP_RATE)], vitals->resp_bpm);
+
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to run one sample of the detected lead through the QRS detector
+ *
+ * @param[in] sample        Filtered sample in microvolts
+ * @param[out] vitals       Vital signs of the frame, beat fields all 0 if there was no beat
+ */
+static void _app_ecg_detect_beat(int32_t sample, app_ecg_vitals *vitals) {
+
+  if(qrs_detector_process(&_qrs_detector, sample)) {
+    const qrs_detector_beat *detected = qrs_detector_get_beat(&_qrs_detector);
+
+    vitals->hr_bpm = detected->hr_bpm;
+    vitals->rr_ms = detected->rr_ms;
+    vitals->r_offset_ms = detected->delay_ms;
+    debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[app_ecg_loop] Beat, HR: %d bpm, RR: %d ms\n", detected->hr_bpm, detected->rr_ms);
+  } else {
+    vitals->hr_bpm = 0;
+    vitals->rr_ms = 0;
+    vitals->r_offset_ms = 0;
+  }
+
+}
+
+
+/*
+ * @brief Function to run one sample of the RESP channel through the respiration rate
+ *
+ * @param[in] sample        RESP sample in microvolts
+ * @param[out] vitals       Vital signs of the frame, respiration field 0 if there was no new rate
+ */
+static void _app_ecg_detect_breath(int32_t sample, app_ecg_vitals *vitals) {
+
+  if(resp_rate_process(&_resp_rate, sample)) {
+    vitals->resp_bpm = MEAS_RESP_RATE_REPORTED | resp_rate_get_bpm(&_resp_rate);
+    debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[app_ecg_loop] Respiration rate: %d bpm\n", resp_rate_get_bpm(&_resp_rate));
+  } else {
+    vitals->resp_bpm = 0;
+  }
+
+}
+
+
+/*
+ * @brief Function to run one frame through the pace capture and store the complete events
+ *
+ * @param[in] frame         Converted frame, not filtered
+ */
+static void _app_ecg_capture_pace(const ads129x_frame *frame) {
+
+  static const uint8_t channels[PACE_CAPTURE_CHANNELS] = APP_ECG_PACE_CHANNELS;
+  int32_t samples[PACE_CAPTURE_CHANNELS];
+  uint8_t result;
+  uint16_t size;
+
+  for(uint8_t ch = 0 ; ch < PACE_CAPTURE_CHANNELS ; ch++) {
+    samples[ch] = frame->channels[channels[ch]];
+  }
+  result = pace_capture_process(&_pace_capture, frame->sample, frame->pace, samples);
+
+  /* Event window complete */
+  if(result & PACE_CAPTURE_READY) {
+    size = pace_capture_get_record(&_pace_capture, PACE_PULSE_ALERT, _pace_record);
+    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*)"[app_ecg_loop] Pace event captured, %d bytes\n", size);
+    meas_mngr_store_event(_pace_record, size);
+  }
+
+}
+
+
+/*
+ * @brief Function to update the timebase with the RTC ticks of an anchor frame and store the new anchor
+ *
+ * @param[in] frame         Converted frame with the anchor flag set
+ */
+static void _app_ecg_add_anchor(const ads129x_frame *frame) {
+
+  uint16_t size;
+
+  timebase_add_anchor(&_timebase, frame->sample, frame->anchor_ticks);
+  size = timebase_get_record(&_timebase, TIMEBASE_ANCHOR_TYPE, _anchor_record);
+  debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[app_ecg_loop] Anchor at sample %lu, drift: %ld ppm\n", frame->sample, timebase_get_drift_ppm(&_timebase));
+  meas_mngr_store_event(_anchor_record, size);
+
+}
+
+
+/*
+ * @brief Function to add a frame to the compressed block and store the block when complete
+ *
+ * @param[in] frame         Converted and filtered frame
+ * @param[in] vitals        Vital signs of the frame
+ */
+static void _app_ecg_compress(const ads129x_frame *frame, const app_ecg_vitals *vitals) {
+
+  static const uint8_t channels[ADS129X_MAPPED_CHANNELS] = ADS129X_MAP_CHANNELS;
+  static ecg_codec_frame coded;
+
+  coded.sample = frame->sample;
+  coded.status = (uint16_t)frame->pace << (ADS129X_ELECT_NUMB - 1);
+  for(uint8_t i = 0 ; i < ADS129X_ELECT_NUMB - 1 ; i++) {
+    coded.status |= (uint16_t)(frame->lead_off[i] != 0) << i;
+  }
+
+  /* Lead fields of MEASURES_SCHEMA in the order of ADS129X_CHANNEL_MAP, as ads129x_frame_to_array() */
+  for(uint8_t i = 0 ; i < ADS129X_MAPPED_CHANNELS ; i++) {
+    coded.channels[i] = frame->channels[channels[i]];
+  }
+
+  coded.fields[ECG_CODEC_FIELD_HR] = vitals->hr_bpm;
+  coded.fields[ECG_CODEC_FIELD_RR] = vitals->rr_ms;
+  coded.fields[ECG_CODEC_FIELD_R_OFFSET] = vitals->r_offset_ms;
+  coded.fields[ECG_CODEC_FIELD_RESP] = vitals->resp_bpm;
+
+  _raw_bytes += APP_ECG_DATA_SIZE;
+  if(ecg_codec_encode(&_ecg_codec, &coded)) {
+    _app_ecg_store_block();
+  }
+
+}
+
+
+/*
+ * @brief Function to close the compressed block and store it
+ *
+ */
+static void _app_ecg_store_block(void) {
+
+  uint16_t size = ecg_codec_finish(&_ecg_codec);
+
+  if(!size) {
+    return;
+  }
+
+  _compressed_bytes += size;
+  debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[app_ecg_loop] Block of %d bytes, ratio: %d%%\n", size, app_ecg_get_compression_ratio());
+  meas_mngr_store_event(_ecg_block, size);
+
+}
+
+
+/*
+ * @brief Function to set the filters, QRS detector, respiration, pace capture and timebase for a sampling rate
+ *
+ * @param[in] accuracy      True if high resolution (APP_ECG_HP_RATE), otherwise low power resolution
+ */
+static void _app_ecg_set_rate(bool accuracy) {
+
+  ecg_filter_init(&_ecg_filter, ADS129X_CHANNELS, (accuracy ? ECG_FILTER_500SPS : ECG_FILTER_250SPS), 
+                  APP_ECG_FILTER_HP, APP_ECG_FILTER_NOTCH, APP_ECG_FILTER_LP);
+  qrs_detector_init(&_qrs_detector, (accuracy ? APP_ECG_HP_RATE : APP_ECG_LP_RATE));
+  resp_rate_init(&_resp_rate, (accuracy ? APP_ECG_HP_RATE : APP_ECG_LP_RATE));
+  pace_capture_init(&_pace_capture, (accuracy ? APP_ECG_HP_RATE : APP_ECG_LP_RATE), APP_ECG_PACE_PRE, APP_ECG_PACE_POST);
+  timebase_init(&_timebase, (accuracy ? APP_ECG_HP_RATE : APP_ECG_LP_RATE));
+
+}
+
+
+/*
+ * @brief Function to keep the settings of a config the ECG devices took, and set the processing for its rate
+ *
+ * @param[in] accuracy      True if high resolution (APP_ECG_HP_RATE), otherwise low power resolution
+ * @param[in] lead_off      True if lead-off on, otherwise off
+ * @param[in] ecg_gain      ECG gain
+ * @param[in] resp_gain     RESP gain
+ * @param[in] test_mode     Test mode of app_ecg_config()
+ */
+static void _app_ecg_set_config(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain, uint8_t test_mode) {
+
+  _app_ecg_set_rate(accuracy);
+  _accuracy = accuracy;
+  _lead_off = lead_off;
+  _ecg_gain = ecg_gain;
+  _resp_gain = resp_gain;
+  _test_mode = test_mode;
+  _current_state = APP_ECG_NOP;
+
+}
+
+
+/*
+ * @brief Function to drop the processing state of previous samplings
+ *
+ */
+static void _app_ecg_reset_processing(void) {
+
+  ecg_filter_reset(&_ecg_filter);
+  qrs_detector_reset(&_qrs_detector);
+  resp_rate_reset(&_resp_rate);
+  pace_capture_reset(&_pace_capture);
+  timebase_reset(&_timebase);                           /* The sample index restarts with the sampling */
+  ecg_codec_encoder_init(&_ecg_codec, ECG_BLOCK_TYPE, APP_ECG_CODEC_CHANNELS, _ecg_block, sizeof(_ecg_block));
+
+}
+
+
+/*
+ * @brief Function called by meas_mngr when a record does not fit in RAM
+ *
+ * @param[in] type          Record type
+ * @param[in] size          Record size in bytes
+ * @param[in] free          Free bytes of RAM
+ * @return                  Returns APP_ECG_POLICY, the frames are thinned out or the rate lowered from the next batch
+ */
+static meas_mngr_policy _app_ecg_policy(uint8_t type, uint16_t size, uint16_t free) {
+
+  if(!_pressure) {
+    debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[app_ecg_policy] RAM full, record type %u of %u bytes, %u bytes free\n",
+                        (unsigned int)type, (unsigned int)size, (unsigned int)free);
+  }
+  _pressure = true;
+  if(APP_ECG_POLICY == MEAS_MNGR_LOW_RATE && _accuracy) {
+    _low_rate_pending = true;
+  }
+  return APP_ECG_POLICY;
+
+}
+
+
+/*
+ * @brief Function to decimate the frames under backpressure
+ *
+ * @param[in] vitals        Vital signs of the frame
+ * @retval                  Returns true if the frame is stored, or false if it is decimated
+ * @note                    Frames with a beat or a new respiration rate are always kept
+ */
+static bool _app_ecg_keep_frame(const app_ecg_vitals *vitals) {
+
+  if(!_pressure || APP_ECG_POLICY != MEAS_MNGR_DECIMATE || vitals->rr_ms || vitals->resp_bpm) {
+    return true;
+  }
+  if(++_decimation_count >= APP_ECG_DECIMATION) {
+    _decimation_count = 0;
+    return true;
+  }
+  _decimated_frames++;
+  return false;
+
+}
+
+
+/*
+ * @brief Function to start the restart of the sampling at APP_ECG_LP_RATE with the settings of the last app_ecg_config()
+ *
+ * @note                    Goes on in the APP_ECG_LOW_RATE_* states, a step per loop, the loop is never held
+ */
+static void _app_ecg_go_low_rate(void) {
+
+  _low_rate_pending = false;
+  _low_rate_retries = 0;
+  _current_state = APP_ECG_LOW_RATE_STOP;
+
+}
+
+
+/*
+ * @brief Function to give up the restart at APP_ECG_LP_RATE, the sampling stays stopped
+ *
+ */
+static void _app_ecg_low_rate_failed(void) {
+
+  app_ecg_stop_sample();
+  _current_state = APP_ECG_NOP;
+  debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+  debug_print_string(DEBUG_LEVEL_0, (uint8_t*)"[app_ecg_go_low_rate] Restart failed\n");
+
+}
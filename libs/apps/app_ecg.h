@@ -21,6 +21,35 @@
 
 /********************************** Definies ***********************************/
 #define APP_ECG_RETRIES_CMD     3
+#define APP_ECG_FRAMES_BATCH    8         /* Maximum frames read from the ADS129x per loop */
+#define APP_ECG_FRAME_STRIDE    (sizeof(ads129x_frame) / sizeof(int32_t))
+#define APP_ECG_LP_RATE         250       /* Sampling rate in SPS with ADS129X_CONFIG1_LP_VALUE */
+#define APP_ECG_HP_RATE         500       /* Sampling rate in SPS with ADS129X_CONFIG1_HP_VALUE */
+
+/* Sinais vitais */
+#define APP_ECG_QRS_LEAD        ADS129X_LEAD_II_CHANNEL                   /* Lead used by the QRS detector */
+#define APP_ECG_VITALS_SIZE     (MEAS_ECG_FRAME_SIZE - ADS129X_DATA_SIZE) /* HR, RR, R-peak offset and respiration rate, 2 bytes each */
+#define APP_ECG_DATA_SIZE       MEAS_ECG_FRAME_SIZE                       /* Serialized frame, see MEASURES_SCHEMA */
+
+/* Filtros dos canais de ECG */
+#define APP_ECG_FILTER_HP       ECG_FILTER_HP_0_5HZ
+#define APP_ECG_FILTER_NOTCH    ECG_FILTER_NOTCH_50HZ
+#define APP_ECG_FILTER_LP       ECG_FILTER_LP_40HZ
+
+/* Compresso dos frames */
+#define APP_ECG_COMPRESS_FRAMES   1         /* Frames stored in ecg_codec blocks, otherwise in the meas_ecg_layout */
+#define APP_ECG_CODEC_BLOCK_SIZE  1024      /* Buffer of one block, closed earlier if the next frame may not fit */
+#define APP_ECG_CODEC_CHANNELS    ADS129X_MAPPED_CHANNELS  /* Lead fields of MEASURES_SCHEMA, in the order of ADS129X_CHANNEL_MAP */
+
+/* Backpressure, see meas_mngr_policy */
+#define APP_ECG_POLICY            MEAS_MNGR_DECIMATE
+#define APP_ECG_DECIMATION        2         /* Frames stored 1 in N with MEAS_MNGR_DECIMATE */
+#define APP_ECG_PRESSURE_RELEASE  2048      /* Free bytes of RAM that end the backpressure */
+
+/* Eventos de pace */
+#define APP_ECG_PACE_CHANNELS   {0, 1, 2}   /* ADS1298 channels 1 to 3 before filtering, PACE_CAPTURE_CHANNELS */
+#define APP_ECG_PACE_PRE        32          /* Samples kept before each pace pulse */
+#define APP_ECG_PACE_POST       96          /* Samples kept from each pace pulse on */
 
 /* Estados da aplicao loop ECG */
 typedef enum {
@@ -29,10 +58,21 @@ typedef enum {
   APP_ECG_START_SAMPLE,
   APP_ECG_SAMPLING,
   APP_ECG_UPLOAD_DATA,
+  APP_ECG_LOW_RATE_STOP,        /* Restart at APP_ECG_LP_RATE under backpressure, a step per loop */
+  APP_ECG_LOW_RATE_CONFIG,
+  APP_ECG_LOW_RATE_START,
   APP_ECG_SAVE_MODE,
   APP_ECG_NOP
 } app_ecg_states;
 
+/* Vital signs reported in a frame, all 0 if nothing was detected in it */
+typedef struct {
+  uint16_t  hr_bpm;         /* Heart rate from the RR average in beats per minute */
+  uint16_t  rr_ms;          /* RR interval in milliseconds, 0 if no beat */
+  uint16_t  r_offset_ms;    /* Time from the R peak to the frame in milliseconds */
+  uint16_t  resp_bpm;       /* Breaths per minute with MEAS_RESP_RATE_REPORTED, 0 if no new rate */
+} app_ecg_vitals;
+
 /* Callback functions needed */
 typedef bool (*power_save_callback_def)(void);   /* Powersave function callback definition. */
 
@@ -41,9 +81,22 @@ void app_ecg_init(power_save_callback_def power_save_callback);
 void app_ecg_loop(void);
 bool app_ecg_config(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain, uint8_t test_mode);
 bool app_ecg_start_sample(void);
+#if ADS129X_REPLAY
+void app_ecg_start_replay(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain);
+bool app_ecg_stop_replay(void);
+#endif
 bool app_ecg_stop_sample(void);
 void app_ecg_power_off(void);
 bool app_ecg_is_busy(void);
+uint32_t app_ecg_get_filter_cycles_per_sample(void);
+uint32_t app_ecg_get_qrs_cycles_per_sample(void);
+uint16_t app_ecg_get_heart_rate(void);
+uint16_t app_ecg_get_resp_rate(void);
+void app_ecg_vitals_to_array(const app_ecg_vitals *vitals, uint8_t *array);
+uint32_t app_ecg_get_pace_events(void);
+int32_t app_ecg_get_clock_drift(void);
+uint32_t app_ecg_get_compression_ratio(void);
+uint64_t app_ecg_get_sample_time(uint32_t sample);
 
 
 #endif /* APP_ECG_H_ */
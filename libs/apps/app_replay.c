@@ -0,0 +1,245 @@
+/*
+* @file           app_replay.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the replay of recorded ADS129x frames through
+*                 app_ecg and meas_mngr, paced at the recording rate or
+*                 accelerated, with throughput and timing reports.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/********************************** Includes ***********************************/
+/* Interface */
+#include "app_replay.h"
+
+#if ADS129X_REPLAY
+/* Apps */
+#include "app_ecg.h"
+
+/* RTC */
+#include "sense_library/periph/rtc.h"
+
+/* Debug - libs */
+#include "sense_library/utils/debug.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* Replay states */
+typedef enum {
+  APP_REPLAY_IDLE,
+  APP_REPLAY_FEEDING,
+  APP_REPLAY_DRAINING
+} app_replay_states;
+
+static app_replay_states _current_state = APP_REPLAY_IDLE;
+static app_replay_source_def _source;
+
+/* Frames in memory, default source */
+static const uint8_t *_buffer;
+static uint32_t _buffer_count;
+static uint32_t _buffer_idx;
+
+/* Frame read from the source and not yet taken by the ads129x */
+static uint8_t _frame[ADS129X_REPLAY_FRAME_SIZE];
+static bool _frame_pending;
+
+/* Pacing and statistics */
+static uint16_t _rate;
+static uint8_t _speed;
+static uint64_t _start_ticks;
+static uint64_t _start_ms;
+static uint64_t _last_report;
+static uint32_t _fed;
+static uint32_t _stalls;                                /* Loops with the raw frames ring full */
+
+/* Private functions list */
+static bool _app_replay_buffer_source(uint8_t *frame);
+static uint32_t _app_replay_get_due(void);
+static void _app_replay_report(void);
+
+/********************************** Public *************************************/
+/*
+ * @brief Function to set the source of the recorded frames
+ *
+ * @param[in] source        Source callback, or NULL for the frames set with app_replay_set_buffer()
+ */
+void app_replay_init(app_replay_source_def source) {
+
+  _source = (source != NULL) ? source : _app_replay_buffer_source;
+  _current_state = APP_REPLAY_IDLE;
+
+  debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+  debug_print_string(DEBUG_LEVEL_1, "[app_replay_init] Init ended\n");
+
+}
+
+
+/*
+ * @brief Function to set the recorded frames of the default source, usually a const array in flash
+ *
+ * @param[in] frames        Frames of ADS129X_REPLAY_FRAME_SIZE bytes, back to back
+ * @param[in] count         Number of frames
+ */
+void app_replay_set_buffer(const uint8_t *frames, uint32_t count) {
+
+  _buffer = frames;
+  _buffer_count = count;
+  _buffer_idx = 0;
+
+}
+
+
+/*
+ * @brief Function to start the replay, app_ecg goes to sampling with the recording settings
+ *
+ * @param[in] accuracy      True if the recording is high resolution (APP_ECG_HP_RATE), otherwise low power
+ * @param[in] speed         APP_REPLAY_REAL_TIME, N times the recording rate or APP_REPLAY_MAX_SPEED
+ */
+void app_replay_start(bool accuracy, uint8_t speed) {
+
+  _rate = accuracy ? APP_ECG_HP_RATE : APP_ECG_LP_RATE;
+  _speed = speed;
+  _fed = 0;
+  _stalls = 0;
+  _frame_pending = false;
+  _buffer_idx = 0;
+
+  app_ecg_start_replay(accuracy, APP_REPLAY_LEAD_OFF, APP_REPLAY_ECG_GAIN, APP_REPLAY_RESP_GAIN);
+  _start_ticks = rtc_get_ticks();
+  _start_ms = rtc_get_milliseconds();
+  _last_report = _start_ms;
+  _current_state = APP_REPLAY_FEEDING;
+
+  debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_0, "[app_replay_start] Replay at %d SPS, speed: %d\n", _rate, _speed);
+
+}
+
+
+/*
+ * @brief Function to feed the frames due since the start, up to APP_REPLAY_BURST per loop
+ *
+ */
+void app_replay_loop(void) {
+
+  uint32_t due;
+
+  switch(_current_state) {
+    case APP_REPLAY_IDLE:
+      break;
+    case APP_REPLAY_FEEDING:
+      due = _app_replay_get_due();
+      for(uint32_t i = 0 ; i < due ; i++) {
+        if(!_frame_pending) {
+          if(!_source(_frame)) {
+            _current_state = APP_REPLAY_DRAINING;
+            break;
+          }
+          _frame_pending = true;
+        }
+        if(!ads129x_replay_feed(_frame)) {
+          _stalls++;                                    /* app_ecg is late, retried on the next loop */
+          break;
+        }
+        _frame_pending = false;
+        _fed++;
+      }
+
+      if((rtc_get_milliseconds() - _last_report) >= APP_REPLAY_REPORT_MS) {
+        _app_replay_report();
+        _last_report = rtc_get_milliseconds();
+      }
+      break;
+    case APP_REPLAY_DRAINING:
+
+      /* End of the recording, wait for app_ecg to read and process the last frames */
+      if(!ads129x_get_frames_count() && app_ecg_stop_replay()) {
+        _app_replay_report();
+        debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+        debug_print_string(DEBUG_LEVEL_0, "[app_replay_loop] Replay ended\n");
+        _current_state = APP_REPLAY_IDLE;
+      }
+      break;
+  }
+
+}
+
+
+/*
+ * @brief Function to check if the replay is running
+ *
+ * @retval                  Returns true if there are frames to feed or to process
+ */
+bool app_replay_is_busy(void) {
+  return _current_state != APP_REPLAY_IDLE;
+}
+
+
+/********************************** Private ************************************/
+/*
+ * @brief Function to read the next frame of the buffer set with app_replay_set_buffer()
+ *
+ * @param[out] frame        ADS129X_REPLAY_FRAME_SIZE bytes
+ * @retval                  Returns true if successful, or false at the end of the buffer
+ */
+static bool _app_replay_buffer_source(uint8_t *frame) {
+
+  if(_buffer == NULL || _buffer_idx >= _buffer_count) {
+    return false;
+  }
+
+  memcpy(frame, &_buffer[_buffer_idx * ADS129X_REPLAY_FRAME_SIZE], ADS129X_REPLAY_FRAME_SIZE);
+  _buffer_idx++;
+  return true;
+
+}
+
+
+/*
+ * @brief Function to get the number of frames to feed in this loop
+ *
+ * @return                  Returns the frames due at the replay speed, up to APP_REPLAY_BURST
+ */
+static uint32_t _app_replay_get_due(void) {
+
+  uint64_t expected;
+
+  if(_speed == APP_REPLAY_MAX_SPEED) {
+    return APP_REPLAY_BURST;
+  }
+
+  expected = (rtc_get_ticks() - _start_ticks) * _rate * _speed / RTC_TICKS_PER_SECOND;
+  if(expected <= _fed) {
+    return 0;
+  }
+  return (expected - _fed > APP_REPLAY_BURST) ? APP_REPLAY_BURST : (uint32_t)(expected - _fed);
+
+}
+
+
+/*
+ * @brief Function to print the throughput of the replay and the timings of the processing
+ *
+ */
+static void _app_replay_report(void) {
+
+  uint64_t elapsed_ms = rtc_get_milliseconds() - _start_ms;
+  cycle_counter_stats *isr = ads129x_get_isr_stats();
+
+  debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_0, "[app_replay_report] Frames: %lu, %lu frames/s, stalls: %lu, dropped: %lu\n",
+                      _fed, (uint32_t)(elapsed_ms ? (uint64_t)_fed * 1000 / elapsed_ms : 0), _stalls,
+                      ads129x_get_dropped_frames());
+  debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_0, "[app_replay_report] Feed cycles mean: %lu, max: %lu, filter: %lu/sample, QRS: %lu/sample, ratio: %lu%%\n",
+                      cycle_counter_stats_mean(isr), isr->max, app_ecg_get_filter_cycles_per_sample(),
+                      app_ecg_get_qrs_cycles_per_sample(), app_ecg_get_compression_ratio());
+
+}
+
+#endif /* ADS129X_REPLAY */
@@ -0,0 +1,53 @@
+/*
+* @file           app_replay.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This is the header for the replay of recorded ADS129x frames
+*                 through app_ecg and meas_mngr, with throughput and timing
+*                 reports.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef APP_REPLAY_H_
+#define APP_REPLAY_H_
+
+/********************************** Includes ***********************************/
+/* Drivers */
+#include "ads129x.h"
+
+/* Config */
+#include "config.h"
+
+#if ADS129X_REPLAY
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+#define APP_REPLAY_BURST              16        /* Maximum frames fed per loop, app_ecg reads APP_ECG_FRAMES_BATCH */
+#define APP_REPLAY_REPORT_MS          10000     /* Period of the statistics report */
+#define APP_REPLAY_REAL_TIME          1         /* Speed of the recording sampling rate */
+#define APP_REPLAY_MAX_SPEED          0         /* Frames fed as fast as the raw frames ring takes them */
+
+/* Recording, the frames must have been sampled with the same settings */
+#define APP_REPLAY_ACCURACY           false
+#define APP_REPLAY_LEAD_OFF           false
+#define APP_REPLAY_ECG_GAIN           1
+#define APP_REPLAY_RESP_GAIN          1
+
+/* Source of the frames, ADS129X_REPLAY_FRAME_SIZE bytes each, returns false at the end of the recording */
+typedef bool (*app_replay_source_def)(uint8_t *frame);
+
+/********************************** Functions ***********************************/
+void app_replay_init(app_replay_source_def source);
+void app_replay_set_buffer(const uint8_t *frames, uint32_t count);
+void app_replay_start(bool accuracy, uint8_t speed);
+void app_replay_loop(void);
+bool app_replay_is_busy(void);
+
+#endif /* ADS129X_REPLAY */
+
+#endif /* APP_REPLAY_H_ */
@@ -35,6 +35,13 @@
 
 /* Utils */
 #include "sense_library/utils/utils.h"
+#include "flow_stats.h"
+#include "cycle_counter.h"
+#include "edf.h"
+#include "spsc_ring.h"
+
+/* Standard library */
+#include <ctype.h>
 /********************************** Private ************************************/
 /* SDC block device definition */
 NRF_BLOCK_DEV_SDC_DEFINE(
@@ -104,14 +111,55 @@ static uint8_t _patient_name[APP_USD_DATAF_NAME_STR_SIZE];
 static uint8_t _patient_gender[APP_USD_DATAF_NAME_STR_SIZE];
 
 /*
-* Buffer que armazena as medidas a serem escritas para o uSD.
+* Slots of measurements, the one being filled by the producer and its row reserved, the others
+* handed to the writer through the ring
+*/
+static app_usd_meas_slot _meas_slots[APP_USD_MEAS_SLOTS];
+static spsc_ring _meas_ring;
+static app_usd_meas_slot *_meas_filling;
+static bool _meas_reserved;
+
+/*
+* Flow statistics of the measurements slots
+*/
+static flow_stats _flow;
+
+/*
+* EDF+ recording of the data file, its signals and the row offsets of the leads
+*/
+static edf_file _edf;
+static edf_signal _edf_signals[EDF_MAX_SIGNALS];
+static uint16_t _edf_lead_offsets[APP_USD_EDF_MAX_LEADS];
+static uint8_t _edf_leads;
+static char _edf_patient[EDF_PATIENT_LENGTH + 1];
+
+/*
+* Data record being filled, from its first sample in the segment
+*/
+static uint8_t _edf_record[APP_USD_EDF_RECORD_SIZE];
+static uint16_t _edf_rate;                        /* Rate of the signals in the header */
+static uint16_t _edf_samples;
+static uint16_t _edf_position;                    /* Next sample of the data record */
+static uint32_t _edf_record_sample;               /* Samples at _edf_rate from the start of the segment */
+static uint32_t _edf_next_ms;                     /* Onset of the data record after the last one written */
+static bool _edf_started;
+static uint16_t _edf_status;                      /* Lead-off flags and pace of the previous row */
+static int32_t _edf_vitals[APP_USD_EDF_VITALS];    /* Vital signs of the data record, app_usd_edf_vital */
+
+/*
+* Segment of the recording, rows of one sampling with a sample index going forward. The index restarts
+* with each sampling, so a new segment is a new data record with its own onset and the recording EDF+D
 */
-static uint8_t _meas_buffer[APP_USD_MEAS_BATCH_NUMBER][APP_USD_MEAS_BATCH_SIZE];
+static uint32_t _edf_segment_index;               /* Sample index of the first row */
+static uint32_t _edf_segment_ms;                  /* Onset of the first row */
+static uint16_t _edf_segment_rate;                /* Rate of the rows */
+static uint32_t _edf_last_index;                  /* Sample index of the previous row */
 
 /*
-* Varivel que armazena o nmero de medidas armazenadas.
+* Annotations waiting for the next data record
 */
-static uint8_t _meas_buffer_index;
+static uint8_t _edf_pending[APP_USD_EDF_PENDING_SIZE];
+static uint8_t _edf_pending_count;
 
 /*
 * Varivel que armazena o threshold para o nmero de uploads para o uSD.
@@ -119,9 +167,49 @@ static uint8_t _meas_buffer_index;
 static uint8_t _upload_meas_th;
 
 /*
-* Varivel que armazena o nmero de uploads para o uSD.
+* Streaming writer, blocks queued for the card, the one being filled and the offset in the file
+* of the next one written
+*/
+static bool _recording;
+static uint8_t _blocks[APP_USD_BLOCKS][APP_USD_BLOCK_SIZE];
+static spsc_ring _block_ring;
+static uint8_t *_block;
+static uint16_t _block_count;
+static uint32_t _block_offset;
+static uint32_t _allocated;                       /* File size preallocated */
+static uint8_t _first_sector[SDC_SECTOR_SIZE];    /* Copy of the sector with the EDF+ header, rewritten on sync */
+static uint8_t _write_errors;
+
+/*
+* Seek index of the recording, its file and the start of the next data record without a gap,
+* and the file and sector of the searches
 */
-static uint8_t _uploud_count;
+static seek_index_writer _index;
+static FIL _index_file;
+static bool _index_open;
+static bool _index_dirty;                         /* Entries of the sector being filled not on the card */
+static uint32_t _index_next_ms;
+static FIL _seek_file;
+static uint8_t _seek_sector[SEEK_INDEX_SECTOR_SIZE];
+
+/*
+* Sync policy and write statistics
+*/
+static uint64_t _sync_timestamp;
+static uint32_t _sync_bytes;
+static uint64_t _stream_timestamp;
+static uint32_t _stream_bytes;
+static cycle_counter_stats _write_stats;
+static cycle_counter_stats _sync_stats;
+
+#if APP_USD_BENCHMARK
+/*
+* Benchmark file and its blocks
+*/
+static FIL _bench_file;
+static uint8_t _bench_block[APP_USD_BLOCK_SIZE];
+static bool _bench_done;
+#endif
 
 /*
 * Varivel que armazena o nmero de meas definidas no config.h para o uSD.
@@ -153,15 +241,49 @@ static uint8_t _file_status;
 */
 static bool _save_mode_exec;
 
+/* Contiguous preallocation with f_expand, otherwise the clusters are allocated by a seek past the end */
+#if (defined(FF_USE_EXPAND) && FF_USE_EXPAND) || (defined(_USE_EXPAND) && _USE_EXPAND)
+#define APP_USD_EXPAND                1
+#else
+#define APP_USD_EXPAND                0
+#endif
+
 /* Private functions list */
 void _app_usd_power_on(void);
 void _app_usd_power_off(void);
 uint8_t _app_usd_read_pacient_info(void);
-void _app_usd_upload_meas(void);
+uint8_t _app_usd_upload_meas(void);
+void _app_usd_meas_handoff(void);
+void _app_usd_writer_loop(void);
+void _app_usd_edf_init(void);
+void _app_usd_edf_set_rate(uint16_t rate);
+void _app_usd_edf_write_header(void);
+bool _app_usd_edf_add_row(uint8_t *row);
+void _app_usd_edf_new_segment(uint32_t index, uint16_t rate, uint32_t onset_ms);
+bool _app_usd_edf_write_record(void);
+bool _app_usd_edf_annotate(uint32_t onset_ms, const char *text);
+bool _app_usd_preallocate(FIL *fp, uint32_t size);
+void _app_usd_stream_open(void);
+bool _app_usd_stream_reopen(void);
+uint32_t _app_usd_stream_room(void);
+bool _app_usd_stream_write(const uint8_t *data, uint32_t size);
+uint8_t _app_usd_stream_write_slice(uint8_t blocks);
+bool _app_usd_stream_write_block(const uint8_t *block);
+bool _app_usd_stream_sync(bool force);
+void _app_usd_stream_close(void);
+void _app_usd_index_open(bool create);
+void _app_usd_index_add(uint32_t onset_ms);
+bool _app_usd_index_write(bool force);
+bool _app_usd_index_read(void *context, uint32_t sector, uint8_t *buffer);
+#if APP_USD_BENCHMARK
+void _app_usd_benchmark(bool streaming);
+#endif
 bool _app_usd_mount(void);
 bool _app_usd_unmount(void);
 bool _app_usd_unmount_and_mount(void);
 void _app_usd_init_global_variables(void);
+void _app_usd_get_file_name(char *file_name, uint8_t number, const char *extension);
+uint16_t _app_usd_put_config(char *line, const char *id, uint16_t value);
 
 
 /********************************** Public ************************************/
@@ -184,12 +306,11 @@ void app_usd_init(uint8_t upload_meas_th) {
   
   _save_mode_exec = false;
   /* Atualizao interna das measures atuais */  
-  uint8_t meas[] = MEASURES_CONTENT_SIZE;
-  _meas_number = ARRAY_SIZE(meas);
-
-  for(int i = 0 ; i < _meas_number ; i++) {
-    _meas_size += meas[i];
-  }
+  _meas_number = DEVICE_MEASURES_NUMBER;
+  _meas_size = MEAS_FRAME_SIZE;
+  flow_stats_init(&_flow, APP_USD_MEAS_SLOTS * APP_USD_MEAS_BATCH_NUMBER);
+  (void)spsc_ring_init(&_block_ring, _blocks, APP_USD_BLOCK_SIZE, APP_USD_BLOCKS);
+  cycle_counter_init();
   
   debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
   debug_print_string(DEBUG_LEVEL_1, "[app_usd_init] Init started \n");  
@@ -209,7 +330,7 @@ void app_usd_loop(bool save_mode) {
   FRESULT ff_result;
   
   /* Colocar em save mode quando requerido e measurements todas enviadas */
-  if(save_mode && _meas_buffer_index == 0) {
+  if(save_mode && !spsc_ring_count(&_meas_ring) && (_meas_filling == NULL || !_meas_filling->count)) {
     _current_state = APP_USD_SAVE_MODE;
   }
 
@@ -434,7 +555,7 @@ void app_usd_loop(bool save_mode) {
             debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[app_usd_loop] %9lu  %s\r\n", fno.fsize, (uint32_t)fno.fname);  
             
             memcpy(file_name, fno.fname, APP_USD_DATAF_NAME_DATA_SIZE - 1);
-            if(!strcmp(file_name, APP_USD_DATAF_NAME)) {
+            if(!strcmp(file_name, APP_USD_DATAF_NAME) && strstr((char *)fno.fname, APP_USD_EDF_EXTENSION) != NULL) {
               _data_file_count++;
             }
           }
@@ -450,9 +571,8 @@ void app_usd_loop(bool save_mode) {
       }
 
       /* Existe ficheiros para validar */
-      sprintf(file_name, APP_USD_CSV_FILE, _data_file_count - 1);
+      _app_usd_get_file_name((char *)file_name, _data_file_count - 1, APP_USD_EDF_EXTENSION);
 
-      /* O ficheiro APP_USD_CONFIG_FILE no  vlido ou no existe */
       ff_result = f_open(&file, file_name, FA_READ | FA_WRITE | FA_OPEN_ALWAYS);
       if (ff_result != FR_OK) {
         debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
@@ -460,44 +580,37 @@ void app_usd_loop(bool save_mode) {
         break;
       }
       
-      char patient_buffer[APP_USD_DATAF_PATIENT_INFO_SIZE] = "\0";
+      char patient_buffer[EDF_PATIENT_LENGTH + 1] = "\0";
       int patient_fields_found = 0;
-      char patient_string[APP_USD_PATIENT_ELEMENTS*2][30] = {"\0"};  
-      uint8_t addr = 0;
+      char patient_string[APP_USD_PATIENT_ELEMENTS + 1][30] = {"\0"};  
 
-      /* Offset no ponteiro do ficheiro para o ID do paciente */
-      f_lseek(&file, APP_USD_DATAF_ID_OFFSET); 
+      /* Patient subfields of the EDF+ header, "ID sex X name age" */
+      f_lseek(&file, EDF_PATIENT_OFFSET); 
       
-      ff_result = f_read(&file, patient_buffer, APP_USD_DATAF_PATIENT_INFO_SIZE, &bytes_readed); 
+      ff_result = f_read(&file, patient_buffer, EDF_PATIENT_LENGTH, &bytes_readed); 
+      patient_buffer[EDF_PATIENT_LENGTH] = '\0';
       utils_strtok_n_elems(patient_buffer, APP_USD_PATIENT_DELIMITER1, &patient_fields_found, patient_string);
       
       /* Verificar nmero de fields do paciente */
-      if((patient_fields_found - 1) != (APP_USD_PATIENT_ELEMENTS*2)){
+      if(ff_result != FR_OK || patient_fields_found != APP_USD_PATIENT_ELEMENTS) {
+        (void)f_close(&file); 
         _valid_csv_file = false;
         _current_state = APP_USD_CONFIG_IDDLE;
         break;
       }
 
-      /* Percorrer os campos do paciente existentes */
-      for(int i = 0 ; i < APP_USD_PATIENT_ELEMENTS ; i++) {
-        
-        if(!strcmp(patient_string[addr], (uint8_t*)APP_USD_DATAF_ID_STR)) {          
-          _patient_info.id = utils_get_uint32_from_string(patient_string[addr + 1]); /* It is uint32_t but the function is equivalent */
-        } else if(!strcmp(&patient_string[addr][1], (uint8_t*)APP_USD_DATAF_NAME_STR)) {           
-          memcpy(_patient_name, patient_string[addr + 1], APP_USD_DATAF_NAME_STR_SIZE); 
-          _patient_info.name = _patient_name;
-        } else if(!strcmp(&patient_string[addr][1], (uint8_t*)APP_USD_DATAF_AGE_STR)) {
-          _patient_info.age = atoi(patient_string[addr + 1]);
-        } else if(!strcmp(patient_string[addr], (uint8_t*)APP_USD_DATAF_GENDER_STR)) {
-          memcpy(_patient_gender, patient_string[addr + 1], APP_USD_DATAF_NAME_STR_SIZE); 
-          _patient_info.gender = _patient_gender;
-        } else {
-          _valid_cfg_file = false;
-          _current_state = APP_USD_GET_CSV_FILE;
-          break;
+      /* Names are stored with '_' for the spaces */
+      for(int i = 0 ; patient_string[3][i] ; i++) {
+        if(patient_string[3][i] == '_') {
+          patient_string[3][i] = ' ';
         }
-        addr += 2;
       }
+      _patient_info.id = utils_get_uint32_from_string(patient_string[0]);
+      memcpy(_patient_gender, patient_string[1], APP_USD_DATAF_NAME_STR_SIZE); 
+      _patient_info.gender = _patient_gender;
+      memcpy(_patient_name, patient_string[3], APP_USD_DATAF_NAME_STR_SIZE); 
+      _patient_info.name = _patient_name;
+      _patient_info.age = atoi(patient_string[4]);
       
       (void)f_close(&file); 
       _valid_csv_file = true;
@@ -507,7 +620,11 @@ void app_usd_loop(bool save_mode) {
     case APP_USD_CONFIG_IDDLE:
 
       if(_patient_checked && _valid_cfg_file) {                               /* Paciente verificado e CFG validado */
-        /* Preveno */
+        /* Preveno, the recording is reopened on the first upload */
+        if(_file_status == APP_USD_CSV_OPEN) {
+          (void)f_close(&file);
+          _file_status = APP_USD_CSV_CLOSED;
+        }
         if(!_app_usd_unmount_and_mount()) {
           break;
         }        
@@ -517,37 +634,23 @@ void app_usd_loop(bool save_mode) {
       break;    
     case APP_USD_IDLE:
        
-      /* Mounting precaution */
-      if((_uploud_count == APP_USD_MEAS_UPLOAD_MOUNT_TH)) {        
-
-        /* Preveno */                                                
-        (void)f_close(&file);  
-        if(!_app_usd_unmount_and_mount()) {
-          break;
-        }      
-        
-        ff_result = f_open(&file, _actual_csv_file, FA_READ | FA_WRITE | FA_OPEN_APPEND);
-        if (ff_result != FR_OK) {
-          debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
-          debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[app_usd_loop] Unable to open or create file: %s\r\n", _actual_csv_file);
-          break;
-        }
-        _uploud_count = 0;       
+#if APP_USD_BENCHMARK
+      if(!_bench_done) {
+        _app_usd_benchmark(true);
+        _app_usd_benchmark(false);
+        _bench_done = true;
       }
+#endif
 
-      /* Verificar se  altura de enviar um pacote de measurements */
-      if((_meas_buffer_index >= 1) && (_meas_buffer_index < (APP_USD_MEAS_BATCH_NUMBER + 1))) {        
-        _app_usd_upload_meas();        
-        _meas_buffer_index = 0;
-        _uploud_count++;
-        f_sync(&file);
-      }     
+      /* Measurements to the data records and blocks to the card, a bounded step per loop */
+      _app_usd_writer_loop();
 
       break; 
     case APP_USD_SAVE_MODE:
       /* In case of no operation or power save mode */
       if(!_save_mode_exec) {
-        (void)f_close(&file);
+
+        _app_usd_stream_close();
         _app_usd_unmount();
         _app_usd_init_global_variables();
         _app_usd_power_off();
@@ -608,20 +711,20 @@ void app_usd_add_device_config(device_config *config) {
   } 
   _file_status = APP_USD_CFG_OPEN;
 
-  offset += sprintf(cfg_str, APP_USD_CFG_STR, APP_USD_ID1, _device_config.mode);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID2, (uint8_t)_device_config.ecg);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID3, (uint8_t)_device_config.ecg_lead_off);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID4, _device_config.ecg_gain);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID5, (uint8_t)_device_config.ecg_accuracy);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID6, (uint8_t)_device_config.pace);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID7, _device_config.resp_gain);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID8, (uint8_t)_device_config.temp);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID9, _device_config.temp_low);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID10, _device_config.temp_high);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID11, _device_config.heart_rate_low);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID12, _device_config.heart_rate_high);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID13, _device_config.resp_rate_low);
-  offset += sprintf(&cfg_str[offset], APP_USD_CFG_STR, APP_USD_ID14, _device_config.resp_rate_high);
+  offset += _app_usd_put_config(cfg_str, APP_USD_ID1, _device_config.mode);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID2, _device_config.ecg);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID3, _device_config.ecg_lead_off);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID4, _device_config.ecg_gain);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID5, _device_config.ecg_accuracy);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID6, _device_config.pace);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID7, _device_config.resp_gain);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID8, _device_config.temp);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID9, _device_config.temp_low);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID10, _device_config.temp_high);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID11, _device_config.heart_rate_low);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID12, _device_config.heart_rate_high);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID13, _device_config.resp_rate_low);
+  offset += _app_usd_put_config(&cfg_str[offset], APP_USD_ID14, _device_config.resp_rate_high);
 
   uint8_t *device_cfg_send[] = {APP_USD_CFG_TITLE, cfg_str};
   uint8_t device_cfg_send_size[] = {APP_USD_CFG_TITLE_SIZE, strlen(cfg_str) + 1};
@@ -658,7 +761,7 @@ device_config *app_usd_get_device_config(void) {
 
 
 /*
- * @brief Function to add patient info to uSD APP_USD_CSV_FILE
+ * @brief Function to add patient info to the uSD data file
  *
  * @param[in] patient         Struct with patient info
  * @param[in] overwrite       True if is to overwrite data measures in case of
@@ -688,18 +791,23 @@ void app_usd_add_patient_info(patient_info *patient, bool overwrite) {
   
   if((_patient_status == APP_USD_PATIENT_OVERWRITE) || (_patient_status == APP_USD_PATIENT_ADD)) {  
 
+    /* Precaution */
+    _app_usd_stream_close();
+
     if(_valid_csv_file) {                             /* Caso exista ficheiros para apagar */
       
-      /* Apagar APP_USD_CSV_FILE existentes */
+      /* Apagar ficheiros de dados existentes */
       for(int i = _data_file_count ; i >= 0 ; i--) {
-        sprintf(file_name, APP_USD_CSV_FILE, i);
+        _app_usd_get_file_name(file_name, i, APP_USD_EDF_EXTENSION);
+        f_unlink(file_name);
+        _app_usd_get_file_name(file_name, i, APP_USD_INDEX_EXTENSION);
         f_unlink(file_name);
         _data_file_count = 0;
       }
     }
     
     /* Init file */
-    sprintf(file_name, APP_USD_CSV_FILE, APP_USD_DATAF_NAME_INIT_NUMBER);
+    _app_usd_get_file_name(file_name, APP_USD_DATAF_NAME_INIT_NUMBER, APP_USD_EDF_EXTENSION);
     _data_file_count++;
     
     /* Abrir ou criar ficheiro, caso exista ser sobreposto */
@@ -715,12 +823,10 @@ void app_usd_add_patient_info(patient_info *patient, bool overwrite) {
   } else {
     
     /* Precaution */
-    if(_file_status == APP_USD_CSV_OPEN || _file_status == APP_USD_CFG_OPEN) {
-      (void)f_close(&file);
-    }   
+    _app_usd_stream_close();
 
     /* Add file */
-    sprintf(file_name, APP_USD_CSV_FILE, _data_file_count);
+    _app_usd_get_file_name(file_name, _data_file_count, APP_USD_EDF_EXTENSION);
     _data_file_count++;
 
     /* Abrir ou criar ficheiro, caso exista ser sobreposto */
@@ -733,49 +839,10 @@ void app_usd_add_patient_info(patient_info *patient, bool overwrite) {
     _file_status = APP_USD_CSV_OPEN;
   }  
    
-  /* Formatar cabealho do ficheiro excel */
-  uint8_t patient_info_str[APP_USD_DATAF_PATIENT_INFO_SIZE] = "\0";
-  sprintf(patient_info_str, APP_USD_DATAF_PATIENT2, _patient_info.id, _patient_info.name, _patient_info.age, _patient_info.gender);
- 
-  static uint8_t *meas_title[] = MEASURES_CONTENT;
-  uint8_t meas_title_send[APP_USD_MEAS_TITLE_SIZE] = "\0";
-  uint8_t i_send = 0;
-  uint8_t size = 0;
-  
-  /* Formatar cabealho de measurements existentes a enviar */
-  for(int i = 0 ; i < DEVICE_CONFIGS_NUMBER; i++) {
-    
-    size = strlen(meas_title[i]);
-    memcpy(&meas_title_send[i_send], meas_title[i], size);
-    i_send += size;
-
-    if(!strcmp(meas_title[i + 1], MEAS_TIMESTAMP)) {
-      memcpy(&meas_title_send[i_send], ";;", 2*APP_USD_COL1_SIZE);     
-      i_send += 2*APP_USD_COL1_SIZE;
-    } else {
-      memcpy(&meas_title_send[i_send], ";", 1*APP_USD_COL1_SIZE);
-      i_send += APP_USD_COL1_SIZE;
-    }
-
-  }
-  memcpy(&meas_title_send[i_send], "\n", 1*APP_USD_COL1_SIZE);  
-
-  uint8_t *data_csv_send[] = {APP_USD_DATAF_TITLE, APP_USD_DATAF_DESCRIPTION1, APP_USD_DATAF_PATIENT1, patient_info_str, meas_title_send};      
-  uint8_t data_csv_send_size[] = {APP_USD_DATAF_TITLE_SIZE, APP_USD_DATAF_DESCRIPTION1_SIZE, APP_USD_DATAF_PATIENT1_SIZE, APP_USD_DATAF_PATIENT_INFO_SIZE, ARRAY_SIZE(meas_title_send)};
-                            
-  for(int i = 0 ; i < ARRAY_SIZE(data_csv_send) ; i++) {  
-            
-    ff_result = f_write(&file, data_csv_send[i], data_csv_send_size[i] - 1, (UINT *) &bytes_written);
-    if (ff_result != FR_OK) {
-      debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
-      debug_print_string(DEBUG_LEVEL_1, (uint8_t*) "[app_usd_add_patient_info] Write failed.\r\n");
-      break;
-    } 
-
-  }
+  /* EDF+ header, the start and the data records are updated on each sync */
   memcpy(_actual_csv_file, file_name, APP_USD_DATAF_NAME_SIZE);
-  (void)f_close(&file);
-  _file_status = APP_USD_CSV_CLOSED;
+  _app_usd_stream_open();
+  _app_usd_edf_init();
   _patient_checked = true; 
 
 }
@@ -802,27 +869,160 @@ patient_info *app_usd_get_patient_info(void) {
  * @param[in] meas_buffer     Buffer with samples from RESP, ECG and Temperature.
  * @param[in] size            Buffer size in bytes.
  * @return    True if it was successful, false otherwise.
+ * @note      Check app_usd_get_free_measurements() first, a measurement refused here is counted as dropped.
  */
 bool app_usd_add_measurement(uint8_t *meas_buffer, uint8_t size) {
 
-  if(_meas_buffer_index == APP_USD_MEAS_BATCH_NUMBER) {
-    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
-    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[app_usd_add_measurement] Failed - internal buffer is full\r\n");
-
-    return false;
-  }
+  uint8_t *row;
 
   if(size != _meas_size) {
     debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
     debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[app_usd_add_measurement] Failed - Samples size is different\r\n");
 
+    flow_stats_produced(&_flow, 1, app_usd_get_free_measurements());
+    flow_stats_dropped(&_flow, 1);
     return false;
   }
 
-  /* Add measurment to the buffer */
-  memcpy(_meas_buffer[_meas_buffer_index], meas_buffer, _meas_size); 
+  row = app_usd_reserve_measurement();
+  if(row == NULL) {
+    return false;
+  }
+  memcpy(row, meas_buffer, _meas_size); 
+  app_usd_commit_measurement();
+  return true;
+}
+
+
+/*
+ * @brief Function to get the row of the next measurement, to fill in place in the slot being filled.
+ *
+ * @return    Row of MEAS_FRAME_SIZE bytes, or NULL if all the slots are with the writer.
+ * @note      The row is added by app_usd_commit_measurement(), a row refused here is counted as dropped.
+ *            Reserved again before its commit, the same row is returned.
+ */
+uint8_t *app_usd_reserve_measurement(void) {
+
+  if(_meas_reserved) {
+    return _meas_filling->rows[_meas_filling->count];
+  }
+
+  flow_stats_produced(&_flow, 1, app_usd_get_free_measurements());
+  if(_meas_filling == NULL) {
+    _meas_filling = spsc_ring_write_slot(&_meas_ring);
+    if(_meas_filling == NULL) {
+      debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+      debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[app_usd_reserve_measurement] Failed - internal buffer is full\r\n");
+
+      flow_stats_dropped(&_flow, 1);
+      return NULL;
+    }
+    _meas_filling->count = 0;
+    _meas_filling->taken = 0;
+  }
+  _meas_reserved = true;
+  return _meas_filling->rows[_meas_filling->count];
+}
+
+
+/*
+ * @brief Function to add the measurement filled in the row from app_usd_reserve_measurement().
+ *
+ * @note      A filled slot is handed to the writer as it is, the rows are never copied again.
+ */
+void app_usd_commit_measurement(void) {
+
+  if(!_meas_reserved) {
+    return;
+  }
+  _meas_reserved = false;
+
+  if(!_meas_filling->count) {
+    _meas_filling->timestamp = rtc_get_milliseconds();
+  }
+  if(++_meas_filling->count == APP_USD_MEAS_BATCH_NUMBER) {
+    _app_usd_meas_handoff();
+  }
+}
+
+
+/*
+ * @brief Function to add an annotation to the recording, such as an alert.
+ *
+ * @param[in] timestamp       Time of the event in milliseconds, in the time of the TIMESTAMP field.
+ * @param[in] text            Annotation, up to APP_USD_EDF_TEXT_SIZE characters.
+ * @return    True if it was successful, false if there is no room until the next data record.
+ * @note      Lead-off and pace are annotated from the measurements, this is for the other events.
+ */
+bool app_usd_add_annotation(uint64_t timestamp, const char *text) {
+
+  uint32_t onset_ms = 0;
+
+  if(_edf_started && timestamp > _edf.start_ms) {
+    onset_ms = (uint32_t)(timestamp - _edf.start_ms);
+  }
+  return _app_usd_edf_annotate(onset_ms, text);
+}
+
+
+/*
+ * @brief Function to get the room left in the slots not handed to the writer.
+ *
+ * @return    Number of measurements that can still be added.
+ */
+uint8_t app_usd_get_free_measurements(void) {
+
+  uint16_t slots = spsc_ring_free(&_meas_ring);
+  uint8_t rows = 0;
+
+  if(_meas_filling != NULL) {
+    slots--;
+    rows = APP_USD_MEAS_BATCH_NUMBER - _meas_filling->count;
+  }
+  return rows + slots * APP_USD_MEAS_BATCH_NUMBER;
+}
+
+
+/*
+ * @brief Function to get the flow statistics of the internal buffer.
+ *
+ * @return    Statistics, measurements as items and the time from the first row of a slot to its conversion as latency.
+ */
+flow_stats *app_usd_get_flow_stats(void) {
+  return &_flow;
+}
+
+
+/*
+ * @brief Function to find where to start reading a recording from a time, with its seek index.
+ *
+ * @param[in]  number          Number of the data file.
+ * @param[in]  timestamp       Time in milliseconds, in the time of the TIMESTAMP field.
+ * @param[out] entry           Data record not after the time, or the first one if the time is before them all.
+ * @return    True if it was found, false if there is no index or it is empty.
+ * @note      A binary search, a few sector reads for a recording of a day. The data records from the
+ *            entry on can be read up to the number of data records in the header.
+ */
+bool app_usd_seek(uint8_t number, uint64_t timestamp, seek_index_entry *entry) {
+
+  char file_name[APP_USD_DATAF_NAME_SIZE];
+  uint32_t sectors;
+  bool ret;
+
+  /* The recording, with the entries not on the card yet */
+  _app_usd_get_file_name(file_name, number, APP_USD_EDF_EXTENSION);
+  if(_index_open && !strcmp(file_name, _actual_csv_file)) {
+    return seek_index_find(_app_usd_index_read, &_index_file, seek_index_get_sectors(&_index), timestamp, _seek_sector, entry);
+  }
 
-  _meas_buffer_index++;
+  _app_usd_get_file_name(file_name, number, APP_USD_INDEX_EXTENSION);
+  if(f_open(&_seek_file, file_name, FA_READ | FA_OPEN_EXISTING) != FR_OK) {
+    return false;
+  }
+  sectors = (f_size(&_seek_file) + SEEK_INDEX_SECTOR_SIZE - 1) / SEEK_INDEX_SECTOR_SIZE;
+  ret = seek_index_find(_app_usd_index_read, &_seek_file, sectors, timestamp, _seek_sector, entry);
+  (void)f_close(&_seek_file);
+  return ret;
 }
 
 
@@ -908,99 +1108,1063 @@ void _app_usd_init_global_variables() {
  
   //_upload_meas_th = upload_meas_th;
   _retries = 3;
-  _meas_buffer_index = 0;
+  (void)spsc_ring_init(&_meas_ring, _meas_slots, sizeof(app_usd_meas_slot), APP_USD_MEAS_SLOTS);
+  _meas_filling = NULL;
+  _meas_reserved = false;
   _valid_cfg_file = false;
   _valid_csv_file = false;
   _patient_checked = false;
-  _uploud_count = 0;
   _data_file_count = 0;
+  _recording = false;
 }
 
+
 /* 
- * @brief Function to upload internal buffer measurements.
+ * @brief Function to get the name of a data file, APP_USD_DATAF_NAME with its number and extension.
+ *
+ * @param[out] file_name       Buffer with APP_USD_DATAF_NAME_SIZE bytes.
+ * @param[in]  number          Number of the file.
+ * @param[in]  extension       APP_USD_EDF_EXTENSION for the recording, APP_USD_INDEX_EXTENSION for its index.
  */
-void _app_usd_upload_meas(void) {
+void _app_usd_get_file_name(char *file_name, uint8_t number, const char *extension) {
 
-  uint32_t bytes_written = 0;
-  int ff_result;
-  
-  static uint8_t *meas_title[] = MEASURES_CONTENT;
-  static uint8_t meas[] = MEASURES_CONTENT_SIZE;  
-  uint8_t var_8;
-  uint16_t var_16;
-  uint32_t var_32;
-  uint64_t var_64;  
-  
-  /* Precaution */
-  if(_file_status == APP_USD_CFG_OPEN) {
-    (void)f_close(&file);
-  } else if(_file_status == APP_USD_CSV_CLOSED) {
-    ff_result = f_open(&file, _actual_csv_file, FA_READ | FA_WRITE | FA_OPEN_ALWAYS);
-    if (ff_result != FR_OK) {
-      debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
-      debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_upload_meas] Unable to open or create file: %s\r\n", _actual_csv_file);
-      return;
+  uint8_t length = sizeof(APP_USD_DATAF_NAME) - 1;
+
+  memcpy(file_name, APP_USD_DATAF_NAME, length);
+  length += fmt_u32(&file_name[length], number);
+  strcpy(&file_name[length], extension);
+}
+
+
+/* 
+ * @brief Function to format a line "id{value}" of the APP_USD_CONFIG_FILE.
+ *
+ * @param[out] line            Buffer for the line, terminated.
+ * @param[in]  id              Identifier of the configuration.
+ * @param[in]  value           Value of the configuration.
+ * @return    Line length in bytes, without the terminator.
+ */
+uint16_t _app_usd_put_config(char *line, const char *id, uint16_t value) {
+
+  uint16_t length = strlen(id);
+
+  memcpy(line, id, length);
+  line[length++] = APP_USD_CFG_DELIMITER1[0];
+  length += fmt_u32(&line[length], value);
+  line[length++] = APP_USD_CFG_DELIMITER2[0];
+  line[length++] = '\n';
+  line[length] = '\0';
+  return length;
+}
+
+/* 
+ * @brief Function to convert the measurements of the oldest slot handed to the writer, in place.
+ *
+ * @return    Number of measurements taken from the slot, written or dropped.
+ * @note      A row is converted only with room for the data record it may complete, otherwise the
+ *            rest of the slot waits for the blocks to be written. The slot is released when done.
+ */
+uint8_t _app_usd_upload_meas(void) {
+
+  app_usd_meas_slot *slot = spsc_ring_read_slot(&_meas_ring);
+  uint8_t written = 0;
+  uint8_t taken;
+
+  if(slot == NULL) {
+    return 0;
+  }
+  taken = slot->taken;
+
+  /* Precaution, the recording is closed by the device configuration and the remounts */
+  if(_file_status != APP_USD_CSV_OPEN && !_app_usd_stream_reopen()) {
+    if(_recording) {
+      return 0;
     }
-    f_lseek(&file, f_size(&file));
-  }  
+    slot->taken = slot->count;                            /* No recording, nowhere to write them */
+  }
+
+  /* Samples of the measurements to the data records, queued as they are filled, the first after the header */
+  while(slot->taken < slot->count &&
+        _app_usd_stream_room() >= edf_get_record_size(&_edf) + (_edf_started ? 0 : EDF_HEADER_BYTES(_edf.signals_count))) {
+    if(_app_usd_edf_add_row(slot->rows[slot->taken])) {
+      written++;
+    }
+    slot->taken++;
+  }
+  taken = slot->taken - taken;
+
+  flow_stats_forwarded(&_flow, written, (uint32_t)(rtc_get_milliseconds() - slot->timestamp));
+  flow_stats_dropped(&_flow, taken - written);
+  if(slot->taken == slot->count) {
+    spsc_ring_release(&_meas_ring);
+  }
+  return taken;
+}
+
+
+/* 
+ * @brief Function to hand the slot being filled to the writer.
+ */
+void _app_usd_meas_handoff(void) {
+
+  if(_meas_filling == NULL || _meas_reserved || !_meas_filling->count) {
+    return;
+  }
+  spsc_ring_commit(&_meas_ring);
+  _meas_filling = NULL;
+}
+
+
+/* 
+ * @brief Function of the writer, one bounded step of the recording per loop.
+ *
+ * @note      The measurements are converted while there is room in the blocks, and APP_USD_WRITE_SLICE
+ *            blocks are written, so a slow card write fills the blocks and then the slots instead of
+ *            dropping measurements. The sync is left for a loop with no blocks queued.
+ */
+void _app_usd_writer_loop(void) {
+
+  /* Slot not filled by a slow producer */
+  if(_meas_filling != NULL && _meas_filling->count &&
+     (rtc_get_milliseconds() - _meas_filling->timestamp) >= APP_USD_MEAS_HANDOFF_MS) {
+    _app_usd_meas_handoff();
+  }
+
+  (void)_app_usd_upload_meas();
+
+  if(!_recording || _app_usd_stream_write_slice(APP_USD_WRITE_SLICE) || _app_usd_index_write(false)) {
+    return;
+  }
+
+  /* Sync on the time or size policy, the file is preallocated so only its entry is updated */
+  if(_file_status == APP_USD_CSV_OPEN && !spsc_ring_count(&_block_ring)) {
+    (void)_app_usd_stream_sync(false);
+  }
+}
+
+
+/* 
+ * @brief Function to set the EDF+ signals and to start a new recording.
+ *
+ * @note      The rate of the device configuration is only a guess, the header is written with the
+ *            rate of the first measurement by _app_usd_edf_add_row().
+ */
+void _app_usd_edf_init(void) {
+
+  static const uint8_t meas[] = MEASURES_CONTENT_SIZE;
+  static const uint16_t meas_offset[] = MEASURES_CONTENT_OFFSET;
+  static const char *meas_name[] = MEASURES_CONTENT;
+  uint16_t length;
+  int32_t range;
   
-  /* Formatar cabealho de measurements existentes a enviar */
-  for(int idx_meas = 0 ; idx_meas < APP_USD_MEAS_BATCH_NUMBER; idx_meas++) {
-    
-    uint8_t measures_send[APP_USD_MEAS_BATCH_SIZE] = "\0";
-    uint8_t idx_send = 0;
-    uint8_t idx_read = 0;
+  _edf_rate = _device_config.ecg_accuracy ? APP_ECG_HP_RATE : APP_ECG_LP_RATE;
+  _edf_samples = _edf_rate * APP_USD_EDF_RECORD_MS / 1000;
+
+  /* Leads, the 32-bit ECG fields in microvolts */
+  _edf_leads = 0;
+  for(int i = 0 ; i < DEVICE_MEASURES_NUMBER && _edf_leads < APP_USD_EDF_MAX_LEADS ; i++) {
+    if(meas[i] != MEAS_4BYTE || i == MEAS_ID_TEMP || i == MEAS_ID_SAMPLE_INDEX) {
+      continue;
+    }
+    range = (i == MEAS_ID_RESP) ? APP_USD_EDF_RESP_RANGE : APP_USD_EDF_LEAD_RANGE;
+    _edf_signals[_edf_leads] = (edf_signal){
+      .label = meas_name[i], .dimension = "uV",
+      .physical_min = -range, .physical_max = range - range / (EDF_DIGITAL_MAX + 1),
+      .digital_min = EDF_DIGITAL_MIN, .digital_max = EDF_DIGITAL_MAX,
+      .samples = _edf_samples
+    };
+    _edf_lead_offsets[_edf_leads++] = meas_offset[i];
+  }
 
-    for(int i = 0 ; i < DEVICE_MEASURES_NUMBER; i++) {
-    
-      switch(meas[i]) {
+  /* Temperature and vital signs, one sample per data record, and the annotations */
+  _edf_signals[_edf_leads] = (edf_signal){
+    .label = MEAS_TEMP, .dimension = "degC",
+    .physical_min = 0, .physical_max = APP_USD_EDF_TEMP_MAX, .decimals = 1,
+    .digital_min = 0, .digital_max = APP_USD_EDF_TEMP_MAX,
+    .samples = 1
+  };
+  _edf_signals[_edf_leads + 1 + APP_USD_EDF_HR] = (edf_signal){
+    .label = MEAS_ECG_HR, .dimension = "bpm",
+    .physical_min = 0, .physical_max = APP_USD_EDF_VITAL_MAX,
+    .digital_min = 0, .digital_max = APP_USD_EDF_VITAL_MAX,
+    .samples = 1
+  };
+  _edf_signals[_edf_leads + 1 + APP_USD_EDF_RR] = (edf_signal){
+    .label = MEAS_ECG_RR, .dimension = "ms",
+    .physical_min = 0, .physical_max = APP_USD_EDF_VITAL_MAX,
+    .digital_min = 0, .digital_max = APP_USD_EDF_VITAL_MAX,
+    .samples = 1
+  };
+  _edf_signals[_edf_leads + 1 + APP_USD_EDF_R_PEAK] = (edf_signal){
+    .label = MEAS_ECG_R_OFFSET, .dimension = "ms",
+    .physical_min = EDF_DIGITAL_MIN, .physical_max = EDF_DIGITAL_MAX,
+    .digital_min = EDF_DIGITAL_MIN, .digital_max = EDF_DIGITAL_MAX,
+    .samples = 1
+  };
+  _edf_signals[_edf_leads + 1 + APP_USD_EDF_RESP_RATE] = (edf_signal){
+    .label = MEAS_RESP_RATE, .dimension = "/min",
+    .physical_min = 0, .physical_max = APP_USD_EDF_VITAL_MAX,
+    .digital_min = 0, .digital_max = APP_USD_EDF_VITAL_MAX,
+    .samples = 1
+  };
+  _edf_signals[_edf_leads + 1 + APP_USD_EDF_VITALS] = (edf_signal){
+    .label = EDF_ANNOTATIONS_LABEL,
+    .physical_min = EDF_DIGITAL_MIN, .physical_max = EDF_DIGITAL_MAX,
+    .digital_min = EDF_DIGITAL_MIN, .digital_max = EDF_DIGITAL_MAX,
+    .samples = APP_USD_EDF_ANNOTATION_SAMPLES
+  };
+
+  /* Patient, names with '_' for the spaces */
+  length = fmt_u32(_edf_patient, _patient_info.id);
+  _edf_patient[length++] = ' ';
+  _edf_patient[length++] = (_patient_info.gender != NULL && _patient_info.gender[0]) ? toupper(_patient_info.gender[0]) : 'X';
+  _edf_patient[length++] = ' ';
+  length += strlen(strcpy(&_edf_patient[length], APP_USD_PATIENT_BIRTHDATE));
+  _edf_patient[length++] = ' ';
+  for(int i = 0 ; _patient_info.name != NULL && _patient_info.name[i] && length < EDF_PATIENT_LENGTH - 4 ; i++) {
+    _edf_patient[length++] = (_patient_info.name[i] == ' ') ? '_' : _patient_info.name[i];
+  }
+  if(_patient_info.name == NULL || !_patient_info.name[0]) {
+    _edf_patient[length++] = 'X';
+  }
+  _edf_patient[length++] = ' ';
+  (void)fmt_u32(&_edf_patient[length], _patient_info.age);
+
+  _edf.patient = _edf_patient;
+  _edf.equipment = APP_USD_EDF_EQUIPMENT;
+  _edf.start_ms = 0;
+  _edf.records = 0;
+  _edf.record_ms = APP_USD_EDF_RECORD_MS;
+  _edf.continuous = true;
+  _edf.signals_count = _edf_leads + 2 + APP_USD_EDF_VITALS;
+  _edf.signals = _edf_signals;
+
+  _edf_started = false;
+  _edf_position = 0;
+  _edf_record_sample = 0;
+  _edf_next_ms = 0;
+  _edf_status = 0;
+  memset(_edf_vitals, 0, sizeof(_edf_vitals));
+  _edf_pending_count = 0;
+}
 
-        case MEAS_1BYTE:
-          sprintf(&measures_send[idx_send], "%d", &_meas_buffer[idx_meas][idx_read]);
-          idx_send += MEAS_1BYTE;
-          idx_read += MEAS_1BYTE;
 
-          break;
-        case MEAS_2BYTE:
-          var_16 = utils_get_uint16_from_array(&_meas_buffer[idx_meas][idx_read]);
-          sprintf(&measures_send[idx_send], "%d", var_16);
-          idx_send += MEAS_2BYTE;
-          idx_read += MEAS_2BYTE;
+/* 
+ * @brief Function to set the rate of the signals in the header, before it is written.
+ *
+ * @param[in] rate            Sampling rate of the leads, up to APP_ECG_HP_RATE for the size of the data records.
+ */
+void _app_usd_edf_set_rate(uint16_t rate) {
 
-          break;
-        case MEAS_4BYTE:
-          var_32 = utils_get_uint32_from_array(&_meas_buffer[idx_meas][idx_read]);
-          sprintf(&measures_send[idx_send], "%d", var_32);
-          idx_send += MEAS_4BYTE;
-          idx_read += MEAS_4BYTE;
+  _edf_rate = (rate > APP_ECG_HP_RATE) ? APP_ECG_HP_RATE : rate;
+  _edf_samples = _edf_rate * APP_USD_EDF_RECORD_MS / 1000;
+  for(int i = 0 ; i < _edf_leads ; i++) {
+    _edf_signals[i].samples = _edf_samples;
+  }
+}
 
-          break;
-        case MEAS_8BYTE:
-          var_64 = utils_get_serial_from_array(&_meas_buffer[idx_meas][idx_read]);
-          sprintf(&measures_send[idx_send], "%d", var_64);
-          idx_send += MEAS_8BYTE;
-          idx_read += MEAS_8BYTE;
 
-          break;
-        default:
-          break;
-      }
+/* 
+ * @brief Function to stream the EDF+ header and signal headers at the start of a new recording.
+ */
+void _app_usd_edf_write_header(void) {
 
-      if(!strcmp(meas_title[i + 1], MEAS_TIMESTAMP)) {
-        memcpy(&measures_send[idx_send], ";;", 2*APP_USD_COL1_SIZE);     
-        idx_send += 2*APP_USD_COL1_SIZE;
-      } else {
-        memcpy(&measures_send[idx_send], ";", APP_USD_COL1_SIZE);
-        idx_send += APP_USD_COL1_SIZE;
-      }
+  uint8_t header[EDF_HEADER_SIZE];
+  uint8_t length;
 
+  edf_get_header(header, &_edf);
+  (void)_app_usd_stream_write(header, EDF_HEADER_SIZE);
+
+  /* Signal headers, field by field for all the signals */
+  for(int id = 0 ; id < EDF_SIGNAL_FIELDS ; id++) {
+    for(int i = 0 ; i < _edf.signals_count ; i++) {
+      length = edf_get_signal_field(header, &_edf, (edf_signal_field)id, i);
+      (void)_app_usd_stream_write(header, length);
     }
-    memcpy(&measures_send[idx_send], "\n", APP_USD_COL1_SIZE);
+  }
+}
+
+
+/* 
+ * @brief Function to add the samples of a measurement to the data record, and write it when filled.
+ *
+ * @param[in] row             Measurement in the meas_frame_layout.
+ * @return    True if it was successful, false if it is older than the data record or the write failed.
+ * @note      Frames dropped or decimated keep the previous samples, a gap of more than one data
+ *            record starts a new one and the recording becomes EDF+D. The rate is the SAMPLE_RATE of
+ *            the row, the header takes the one of the first row. A sample index going back or a new
+ *            rate start a new segment, so a restart of the sampling at another rate keeps its time.
+ *            Rows at a rate other than the one of the header are held or decimated to it.
+ */
+bool _app_usd_edf_add_row(uint8_t *row) {
+
+  static const char *meas_name[] = MEASURES_CONTENT;
+  uint32_t index = utils_get_uint32_from_array(&row[MEAS_OFFSET(SAMPLE_INDEX)]);
+  uint64_t timestamp = utils_get_serial_from_array(&row[MEAS_OFFSET(TIMESTAMP)]);
+  uint16_t rate = utils_get_uint16_from_array(&row[MEAS_OFFSET(SAMPLE_RATE)]);
+  uint32_t sample;
+  int32_t offset;
+  uint16_t status = 0;
+  uint16_t changed;
+  uint16_t value;
+  uint32_t onset_ms;
+  char text[APP_USD_EDF_TEXT_SIZE + 1];
+  uint8_t length;
+  uint8_t *samples;
+  int16_t digital;
+  int16_t held;
+  bool new_rate;
+  bool ret = true;
+
+  /* Rows read before any timebase anchor, at the rate of the rows before them */
+  if(!rate) {
+    rate = _edf_started ? _edf_segment_rate : _edf_rate;
+  }
+
+  if(!_edf_started) {
+    _edf.start_ms = timestamp ? timestamp : rtc_get_milliseconds();
+    _app_usd_edf_set_rate(rate);
+    _app_usd_edf_write_header();
+    _app_usd_edf_new_segment(index, rate, 0);
+    _edf_started = true;
+  } else if(index < _edf_last_index || rate != _edf_segment_rate) {
+
+    /* New sampling, the data record so far is written and the next one starts at the time of the row */
+    if(_edf_position) {
+      ret = _app_usd_edf_write_record();
+    }
+    new_rate = (rate != _edf_segment_rate);
+    _app_usd_edf_new_segment(index, rate, (timestamp > _edf.start_ms) ? (uint32_t)(timestamp - _edf.start_ms) : 0);
+    _edf.continuous = false;
+    if(new_rate) {
+      length = strlen(strcpy(text, APP_USD_EDF_RATE_TEXT));
+      length += fmt_u32(&text[length], rate);
+      strcpy(&text[length], APP_USD_EDF_RATE_UNIT);
+      (void)_app_usd_edf_annotate(_edf_segment_ms, text);
+    }
+  }
+  _edf_last_index = index;
+
+  /* Sample of the segment at the rate of the header */
+  sample = (uint32_t)((uint64_t)(index - _edf_segment_index) * _edf_rate / _edf_segment_rate);
+  offset = (int32_t)(sample - _edf_record_sample);
+  if(offset < _edf_position) {
+    return _edf_segment_rate > _edf_rate;                 /* Decimated to the rate of the header */
+  }
+  if(offset >= _edf_samples) {
+    if(_edf_position) {
+      ret = _app_usd_edf_write_record();
+      offset = (int32_t)(sample - _edf_record_sample);
+    }
+    if(offset >= _edf_samples) {
+      _edf_record_sample = sample;
+      _edf.continuous = false;
+      offset = 0;
+    }
+  }
+
+  /* Leads, the samples missing since the previous row keep its value */
+  for(int i = 0 ; i < _edf_leads ; i++) {
+    samples = &_edf_record[i * _edf_samples * EDF_SAMPLE_SIZE];
+    digital = edf_get_digital(&_edf_signals[i], (int32_t)utils_get_uint32_from_array(&row[_edf_lead_offsets[i]]));
+    held = _edf_position ? edf_get_sample(samples, _edf_position - 1) : digital;
+    for(int j = _edf_position ; j < offset ; j++) {
+      edf_set_sample(samples, j, held);
+    }
+    edf_set_sample(samples, offset, digital);
+  }
+  digital = edf_get_digital(&_edf_signals[_edf_leads], (int32_t)utils_get_uint32_from_array(&row[MEAS_OFFSET(TEMP)]));
+  edf_set_sample(&_edf_record[_edf_leads * _edf_samples * EDF_SAMPLE_SIZE], 0, digital);
+
+  /* Vital signs, a beat is reported in the frame after its R peak with the time since the peak */
+  if((value = utils_get_uint16_from_array(&row[MEAS_OFFSET(ECG_RR)]))) {
+    _edf_vitals[APP_USD_EDF_RR] = value;
+    _edf_vitals[APP_USD_EDF_R_PEAK] = (int32_t)((uint32_t)offset * 1000 / _edf_rate) -
+                                      utils_get_uint16_from_array(&row[MEAS_OFFSET(ECG_R_OFFSET)]);
+  }
+  if((value = utils_get_uint16_from_array(&row[MEAS_OFFSET(ECG_HR)]))) {
+    _edf_vitals[APP_USD_EDF_HR] = value;
+  }
+  if((value = utils_get_uint16_from_array(&row[MEAS_OFFSET(RESP_RATE)])) & MEAS_RESP_RATE_REPORTED) {
+    _edf_vitals[APP_USD_EDF_RESP_RATE] = value & ~MEAS_RESP_RATE_REPORTED;
+  }
+
+  /* Lead-off and pace, annotated on their changes */
+  for(int i = MEAS_ID_ECG_LOFF_LA ; i <= MEAS_ID_ECG_PACE ; i++) {
+    if(row[MEAS_OFFSET(ECG_LOFF_LA) + i - MEAS_ID_ECG_LOFF_LA]) {
+      status |= 1 << (i - MEAS_ID_ECG_LOFF_LA);
+    }
+  }
+  changed = status ^ _edf_status;
+  onset_ms = _edf_segment_ms + (uint32_t)((uint64_t)sample * 1000 / _edf_rate);
+  for(int i = MEAS_ID_ECG_LOFF_LA ; changed && i <= MEAS_ID_ECG_PACE ; i++) {
+    uint16_t flag = 1 << (i - MEAS_ID_ECG_LOFF_LA);
+
+    if(!(changed & flag)) {
+      continue;
+    }
+    if(i == MEAS_ID_ECG_PACE) {
+      if(status & flag) {
+        (void)_app_usd_edf_annotate(onset_ms, APP_USD_EDF_PACE_TEXT);
+      }
+      continue;
+    }
+    strcpy(text, meas_name[i]);
+    if(!(status & flag)) {
+      strcat(text, APP_USD_EDF_END_TEXT);
+    }
+    (void)_app_usd_edf_annotate(onset_ms, text);
+  }
+  _edf_status = status;
+
+  _edf_position = offset + 1;
+  if(_edf_position == _edf_samples) {
+    ret = _app_usd_edf_write_record() && ret;
+  }
+  return ret;
+}
+
+
+/* 
+ * @brief Function to start a segment of the recording, from a row of a new sampling.
+ *
+ * @param[in] index           Sample index of the row.
+ * @param[in] rate            Sampling rate of the rows.
+ * @param[in] onset_ms        Time of the row from the start of the recording, 0 if not known.
+ * @note      The onset is never before the end of the last data record written, so the data
+ *            records stay in order and do not overlap.
+ */
+void _app_usd_edf_new_segment(uint32_t index, uint16_t rate, uint32_t onset_ms) {
+
+  _edf_segment_index = index;
+  _edf_segment_rate = rate;
+  _edf_segment_ms = (onset_ms > _edf_next_ms) ? onset_ms : _edf_next_ms;
+  _edf_last_index = index;
+  _edf_record_sample = 0;
+  _edf_position = 0;
+}
+
+
+/* 
+ * @brief Function to complete the data record with the last samples, add the annotations that
+ *        fit and write it.
+ *
+ * @return    True if it was successful, false otherwise.
+ */
+bool _app_usd_edf_write_record(void) {
+
+  uint8_t *samples;
+  int16_t held;
+  uint8_t *vitals = &_edf_record[(_edf_leads * _edf_samples + 1) * EDF_SAMPLE_SIZE];
+  uint8_t *annotations = &_edf_record[(_edf_leads * _edf_samples + 1 + APP_USD_EDF_VITALS) * EDF_SAMPLE_SIZE];
+  uint16_t size = APP_USD_EDF_ANNOTATION_SAMPLES * EDF_SAMPLE_SIZE;
+  uint16_t used;
+  uint16_t taken = 0;
+  uint16_t length;
+  uint32_t onset_ms = _edf_segment_ms + (uint32_t)((uint64_t)_edf_record_sample * 1000 / _edf_rate);
+
+  /* Samples after the last row */
+  for(int i = 0 ; i < _edf_leads ; i++) {
+    samples = &_edf_record[i * _edf_samples * EDF_SAMPLE_SIZE];
+    held = edf_get_sample(samples, _edf_position - 1);
+    for(int j = _edf_position ; j < _edf_samples ; j++) {
+      edf_set_sample(samples, j, held);
+    }
+  }
+
+  /* Vital signs, the beat ones only for the data record they are in */
+  for(int i = 0 ; i < APP_USD_EDF_VITALS ; i++) {
+    edf_set_sample(vitals, i, edf_get_digital(&_edf_signals[_edf_leads + 1 + i], _edf_vitals[i]));
+  }
+  _edf_vitals[APP_USD_EDF_RR] = 0;
+  _edf_vitals[APP_USD_EDF_R_PEAK] = 0;
+
+  /* Time-keeping TAL with the start of the data record, then whole TALs while they fit */
+  used = edf_get_tal(annotations, size, onset_ms, NULL);
+  while(taken < _edf_pending_count) {
+    for(length = 0 ; _edf_pending[taken + length] ; length++);
+    length++;
+    if(used + length > size) {
+      break;
+    }
+    memcpy(&annotations[used], &_edf_pending[taken], length);
+    used += length;
+    taken += length;
+  }
+  memset(&annotations[used], 0, size - used);
+  _edf_pending_count -= taken;
+  memmove(_edf_pending, &_edf_pending[taken], _edf_pending_count);
+
+  _edf_record_sample += _edf_samples;
+  _edf_position = 0;
+  _edf_next_ms = onset_ms + APP_USD_EDF_RECORD_MS;
+
+  if(!_app_usd_stream_write(_edf_record, edf_get_record_size(&_edf))) {
+    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+    debug_print_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_edf_write_record] Write failed.\r\n");
+    return false;
+  }
+  _app_usd_index_add(onset_ms);
+  _edf.records++;
+  return true;
+}
+
+
+/* 
+ * @brief Function to add an annotation to the ones waiting for the next data record.
+ *
+ * @param[in] onset_ms        Time from the start of the recording.
+ * @param[in] text            Annotation.
+ * @return    True if it was successful, false if there is no room.
+ */
+bool _app_usd_edf_annotate(uint32_t onset_ms, const char *text) {
+
+  uint8_t length = 0;
+
+  if(strlen(text) <= APP_USD_EDF_TEXT_SIZE) {
+    length = edf_get_tal(&_edf_pending[_edf_pending_count], APP_USD_EDF_PENDING_SIZE - _edf_pending_count, onset_ms, text);
+  }
+  if(!length) {
+    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_edf_annotate] Failed - no room for: %s\r\n", text);
+    return false;
+  }
+  _edf_pending_count += length;
+  return true;
+}
+
+
+/* 
+ * @brief Function to allocate the clusters of a file up front, so that its writes do not update the FAT.
+ *
+ * @param[in] fp              Open file, empty for a contiguous allocation.
+ * @param[in] size            File size to allocate in bytes.
+ * @return    True if it was successful, false otherwise.
+ * @note      The file position is left at the start of the file.
+ */
+bool _app_usd_preallocate(FIL *fp, uint32_t size) {
+
+  FRESULT ff_result = FR_DENIED;
+
+#if APP_USD_EXPAND
+  if(!f_size(fp)) {
+    ff_result = f_expand(fp, size, 1);
+  }
+#endif
+  if(ff_result != FR_OK) {
+    ff_result = f_lseek(fp, size);
+    if(ff_result == FR_OK && f_tell(fp) != size) {
+      ff_result = FR_DENIED;                                  /* Disk full */
+    }
+  }
+  (void)f_lseek(fp, 0);
+  return ff_result == FR_OK;
+}
+
+
+/* 
+ * @brief Function to start the streaming writer on the recording just created.
+ */
+void _app_usd_stream_open(void) {
+
+  uint32_t start = cycle_counter_get();
+
+  spsc_ring_reset(&_block_ring);
+  _block = NULL;
+  _block_count = 0;
+  _block_offset = 0;
+  _write_errors = 0;
+  _allocated = 0;
+  if(_app_usd_preallocate(&file, APP_USD_PREALLOCATE_SIZE)) {
+    _allocated = APP_USD_PREALLOCATE_SIZE;
+  } else {
+    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+    debug_print_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_stream_open] Preallocation failed\r\n");
+  }
+
+  debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_2, (uint8_t*) "[_app_usd_stream_open] %s: %lu KB preallocated in %lu us\r\n", _actual_csv_file,
+                      _allocated / 1024, CYCLE_COUNTER_CYCLES_TO_US(cycle_counter_get() - start));
+
+  _app_usd_index_open(true);
+
+  cycle_counter_stats_init(&_write_stats, 0);
+  cycle_counter_stats_init(&_sync_stats, 0);
+  _stream_bytes = 0;
+  _stream_timestamp = rtc_get_milliseconds();
+  _sync_bytes = 0;
+  _sync_timestamp = _stream_timestamp;
+  _recording = true;
+}
+
+
+/* 
+ * @brief Function to open the recording again, after it was closed by a remount or the device configuration.
+ *
+ * @return    True if it was successful, false otherwise.
+ */
+bool _app_usd_stream_reopen(void) {
+
+  FRESULT ff_result;
+
+  if(!_recording) {
+    return false;
+  }
+  if(_file_status == APP_USD_CFG_OPEN) {
+    (void)f_close(&file);
+  }
+
+  ff_result = f_open(&file, _actual_csv_file, FA_READ | FA_WRITE | FA_OPEN_EXISTING);
+  if(ff_result == FR_OK) {
+    ff_result = f_lseek(&file, _block_offset);
+  }
+  if (ff_result != FR_OK) {
+    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_stream_reopen] Unable to open file: %s\r\n", _actual_csv_file);
+    return false;
+  }
+  _file_status = APP_USD_CSV_OPEN;
+
+  /* Closed too by the remounts */
+  if(!_index_open) {
+    _app_usd_index_open(false);
+  }
+  return true;
+}
+
+
+/* 
+ * @brief Function to get the room left in the blocks not queued for the card.
+ *
+ * @return    Number of bytes that can still be added to the recording.
+ */
+uint32_t _app_usd_stream_room(void) {
+  return (uint32_t)spsc_ring_free(&_block_ring) * APP_USD_BLOCK_SIZE - _block_count;
+}
+
+
+/* 
+ * @brief Function to add bytes to the recording, queued for the card in whole blocks.
+ *
+ * @param[in] data            Bytes to write.
+ * @param[in] size            Number of bytes, up to APP_USD_EDF_RECORD_SIZE.
+ * @return    True if it was successful, false if there is no room while the card does not take the blocks.
+ * @note      The bytes are taken all or none, so a failed write never leaves a part of a data record.
+ *            No card access here, the blocks are written by _app_usd_stream_write_slice().
+ */
+bool _app_usd_stream_write(const uint8_t *data, uint32_t size) {
+
+  uint32_t length;
+
+  if(size > _app_usd_stream_room()) {
+    return false;
+  }
+
+  while(size) {
+    if(_block == NULL) {
+      _block = spsc_ring_write_slot(&_block_ring);
+    }
+    length = APP_USD_BLOCK_SIZE - _block_count;
+    if(length > size) {
+      length = size;
+    }
+    memcpy(&_block[_block_count], data, length);
+    _block_count += length;
+    data += length;
+    size -= length;
+
+    /* Filled, queued for the card */
+    if(_block_count == APP_USD_BLOCK_SIZE) {
+      spsc_ring_commit(&_block_ring);
+      _block = NULL;
+      _block_count = 0;
+    }
+  }
+  return true;
+}
+
+
+/* 
+ * @brief Function to write the blocks queued for the card, from the oldest.
+ *
+ * @param[in] blocks          Maximum number of blocks to write.
+ * @return    Number of blocks written.
+ */
+uint8_t _app_usd_stream_write_slice(uint8_t blocks) {
+
+  uint8_t *block;
+  uint8_t written = 0;
+
+  while(written < blocks && (block = spsc_ring_read_slot(&_block_ring)) != NULL) {
+    if(!_app_usd_stream_write_block(block)) {
+      break;
+    }
+    spsc_ring_release(&_block_ring);
+    written++;
+  }
+  return written;
+}
+
+
+/* 
+ * @brief Function to write a block at the next sector-aligned offset.
+ *
+ * @param[in] block           APP_USD_BLOCK_SIZE bytes to write.
+ * @return    True if it was successful, false otherwise.
+ * @note      After APP_USD_WRITE_RETRIES failed writes the card is remounted and the recording reopened.
+ */
+bool _app_usd_stream_write_block(const uint8_t *block) {
+
+  uint32_t bytes_written = 0;
+  uint32_t start;
+  FRESULT ff_result;
+
+  if(_file_status != APP_USD_CSV_OPEN && !_app_usd_stream_reopen()) {
+    return false;
+  }
+
+  /* Preallocation filled, the next one is not contiguous but keeps the FAT updates out of the writes */
+  if(_block_offset + APP_USD_BLOCK_SIZE > _allocated) {
+    if(f_lseek(&file, _allocated + APP_USD_PREALLOCATE_SIZE) == FR_OK && f_tell(&file) == _allocated + APP_USD_PREALLOCATE_SIZE) {
+      _allocated += APP_USD_PREALLOCATE_SIZE;
+    }
+    (void)f_lseek(&file, _block_offset);
+  }
+
+  start = cycle_counter_get();
+  ff_result = f_write(&file, block, APP_USD_BLOCK_SIZE, (UINT *) &bytes_written);
+  cycle_counter_stats_add(&_write_stats, start);
+
+  if(ff_result != FR_OK || bytes_written != APP_USD_BLOCK_SIZE) {
+    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_stream_write_block] Write failed: %d\r\n", ff_result);
+
+    (void)f_lseek(&file, _block_offset);
+    if(++_write_errors >= APP_USD_WRITE_RETRIES) {
+      (void)f_close(&file);
+      (void)f_close(&_index_file);
+      _file_status = APP_USD_CSV_CLOSED;
+      _index_open = false;
+      (void)_app_usd_unmount_and_mount();
+      _write_errors = 0;
+    }
+    return false;
+  }
+  _write_errors = 0;
+
+  /* Copy of the first sector, to rewrite the EDF+ header without reading it */
+  if(!_block_offset) {
+    memcpy(_first_sector, block, SDC_SECTOR_SIZE);
+  }
+
+  _block_offset += APP_USD_BLOCK_SIZE;
+  _stream_bytes += APP_USD_BLOCK_SIZE;
+  _sync_bytes += APP_USD_BLOCK_SIZE;
+  return true;
+}
+
+
+/* 
+ * @brief Function to update the EDF+ header and sync the file, on the time or size policy.
+ *
+ * @param[in] force           True to sync now.
+ * @return    True if it was synced, false otherwise.
+ * @note      The header counts only the data records already on the card, the blocks queued and
+ *            the one being filled are lost on a power failure.
+ */
+bool _app_usd_stream_sync(bool force) {
+
+  uint32_t bytes_written = 0;
+  uint32_t header_size = EDF_HEADER_BYTES(_edf.signals_count);
+  uint32_t start;
+  uint64_t elapsed;
+  uint8_t *first;
+  edf_file header = _edf;
+  FRESULT ff_result = FR_OK;
+
+  if(!force && (rtc_get_milliseconds() - _sync_timestamp) < APP_USD_SYNC_PERIOD_MS && _sync_bytes < APP_USD_SYNC_BYTES) {
+    return false;
+  }
+  start = cycle_counter_get();
+
+  /* Header in the first sector, a whole sector write. Only the data records on the card are counted, also
+   * on the close, where blocks can still be queued after the card failed */
+  header.records = (_block_offset > header_size) ? (_block_offset - header_size) / edf_get_record_size(&_edf) : 0;
+  if(!_block_offset) {
+    first = spsc_ring_read_slot(&_block_ring);            /* Nothing on the card yet, the oldest block */
+    if(first == NULL) {
+      first = _block;
+    }
+    if(first != NULL) {
+      edf_get_header(first, &header);
+    }
+  } else {
+    edf_get_header(_first_sector, &header);
+    ff_result = f_lseek(&file, 0);
+    if(ff_result == FR_OK) {
+      ff_result = f_write(&file, _first_sector, SDC_SECTOR_SIZE, (UINT *) &bytes_written);
+    }
+    (void)f_lseek(&file, _block_offset);
+  }
+  if(ff_result == FR_OK) {
+    ff_result = f_sync(&file);
+  }
+  (void)_app_usd_index_write(true);                      /* Entries so far, with the sector being filled */
+  cycle_counter_stats_add(&_sync_stats, start);
+
+  elapsed = rtc_get_milliseconds() - _stream_timestamp;
+  debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_2, (uint8_t*) "[_app_usd_stream_sync] Written: %lu KB, %lu B/s, write mean: %lu us, max: %lu us, sync max: %lu us\r\n",
+                      _stream_bytes / 1024, (uint32_t)(elapsed ? (uint64_t)_stream_bytes * 1000 / elapsed : 0),
+                      CYCLE_COUNTER_CYCLES_TO_US(cycle_counter_stats_mean(&_write_stats)), CYCLE_COUNTER_CYCLES_TO_US(_write_stats.max),
+                      CYCLE_COUNTER_CYCLES_TO_US(_sync_stats.max));
+
+  _sync_bytes = 0;
+  _sync_timestamp = rtc_get_milliseconds();
+  return ff_result == FR_OK;
+}
+
+
+/* 
+ * @brief Function to end the recording, with the last data record, and trim the preallocation.
+ */
+void _app_usd_stream_close(void) {
+
+  uint32_t bytes_written = 0;
+
+  if(!_recording) {
+    if(_file_status == APP_USD_CSV_OPEN || _file_status == APP_USD_CFG_OPEN) {
+      (void)f_close(&file);
+      _file_status = (_file_status == APP_USD_CSV_OPEN) ? APP_USD_CSV_CLOSED : APP_USD_CFG_CLOSED;
+    }
+    return;
+  }
+  _recording = false;
+  if(_file_status != APP_USD_CSV_OPEN) {
+    _recording = true;
+    if(!_app_usd_stream_reopen()) {
+      _recording = false;
+      return;
+    }
+    _recording = false;
+  }
+
+  /* Measurements still in the slots, converted while the blocks are written to make room */
+  _meas_reserved = false;
+  _app_usd_meas_handoff();
+  while(spsc_ring_count(&_meas_ring)) {
+    (void)_app_usd_index_write(false);
+    if(!_app_usd_upload_meas() && !_app_usd_stream_write_slice(APP_USD_BLOCKS)) {
+      break;
+    }
+  }
+
+  /* Last data record, completed with the last samples, and the block not filled. A recording without
+   * measurements gets its header with the rate of the device configuration */
+  (void)_app_usd_stream_write_slice(APP_USD_BLOCKS);
+  if(!_edf_started) {
+    _app_usd_edf_write_header();
+  }
+  if(_edf_position) {
+    (void)_app_usd_edf_write_record();
+  }
+  (void)_app_usd_stream_write_slice(APP_USD_BLOCKS);
+  if(!spsc_ring_count(&_block_ring) && _block != NULL) {
+    if(!_block_offset) {
+      memcpy(_first_sector, _block, SDC_SECTOR_SIZE);
+    }
+    if(f_write(&file, _block, _block_count, (UINT *) &bytes_written) == FR_OK) {
+      _block_offset += bytes_written;
+    }
+  }
+  _block = NULL;
+  _block_count = 0;
+  (void)f_truncate(&file);
+  (void)_app_usd_index_write(false);
+  (void)_app_usd_stream_sync(true);
+
+  (void)f_close(&file);
+  (void)f_close(&_index_file);
+  _file_status = APP_USD_CSV_CLOSED;
+  _index_open = false;
+}
+
+
+/* 
+ * @brief Function to open the seek index of the recording.
+ *
+ * @param[in] create          True for a new recording, false to open it again where it was.
+ */
+void _app_usd_index_open(bool create) {
+
+  char index_name[APP_USD_DATAF_NAME_SIZE];
+  FRESULT ff_result;
+
+  strcpy(index_name, _actual_csv_file);
+  strcpy(strrchr(index_name, '.'), APP_USD_INDEX_EXTENSION);
+
+  if(create) {
+    seek_index_writer_init(&_index);
+    _index_dirty = false;
+    _index_next_ms = 0;
+  }
+  ff_result = f_open(&_index_file, index_name, FA_READ | FA_WRITE | (create ? FA_CREATE_ALWAYS : FA_OPEN_EXISTING));
+  _index_open = (ff_result == FR_OK);
+  if(!_index_open) {
+    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_index_open] Unable to open file: %s\r\n", index_name);
+  }
+}
+
+
+/* 
+ * @brief Function to add the data record being written to the seek index, every
+ *        APP_USD_INDEX_RECORDS data records and after each gap.
+ *
+ * @param[in] onset_ms        Start of the data record from the start of the recording.
+ * @note      No card access here, the sectors are written by _app_usd_index_write(). An entry
+ *            that finds the sector full and not written yet is left out of the index.
+ */
+void _app_usd_index_add(uint32_t onset_ms) {
+
+  seek_index_entry entry;
+  bool gap = (onset_ms != _index_next_ms);
+
+  _index_next_ms = onset_ms + _edf.record_ms;
+  if((_edf.records % APP_USD_INDEX_RECORDS) && !gap) {
+    return;
+  }
+
+  entry.timestamp = _edf.start_ms + onset_ms;
+  entry.offset = EDF_HEADER_BYTES(_edf.signals_count) + _edf.records * edf_get_record_size(&_edf);
+  entry.record = (uint32_t)_edf.records;
+  if(seek_index_add(&_index, &entry)) {
+    _index_dirty = true;
+  }
+}
+
+
+/* 
+ * @brief Function to write the sector of the seek index being filled, a whole sector at its offset.
+ *
+ * @param[in] force           True to write it and sync the index even if it is not full.
+ * @return    True if a sector was written, false otherwise.
+ */
+bool _app_usd_index_write(bool force) {
+
+  uint32_t bytes_written = 0;
+  FRESULT ff_result;
+
+  if(!_index_open || !(seek_index_is_full(&_index) || (force && _index_dirty))) {
+    return false;
+  }
+
+  ff_result = f_lseek(&_index_file, _index.sectors * SEEK_INDEX_SECTOR_SIZE);
+  if(ff_result == FR_OK) {
+    ff_result = f_write(&_index_file, _index.sector, SEEK_INDEX_SECTOR_SIZE, (UINT *) &bytes_written);
+  }
+  if(ff_result != FR_OK || bytes_written != SEEK_INDEX_SECTOR_SIZE) {
+    debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_index_write] Write failed: %d\r\n", ff_result);
+    return false;
+  }
+
+  _index_dirty = false;
+  if(seek_index_is_full(&_index)) {
+    seek_index_next_sector(&_index);
+  }
+  if(force) {
+    (void)f_sync(&_index_file);
+  }
+  return true;
+}
+
+
+/* 
+ * @brief Function to read a sector of a seek index, for seek_index_find().
+ *
+ * @param[in]  context         File of the index.
+ * @param[in]  sector          Sector to read.
+ * @param[out] buffer          Buffer with SEEK_INDEX_SECTOR_SIZE bytes.
+ * @return    True if it was successful, false otherwise.
+ * @note      The sector of the recording being filled is taken from memory.
+ */
+bool _app_usd_index_read(void *context, uint32_t sector, uint8_t *buffer) {
+
+  FIL *fp = (FIL *)context;
+  uint32_t bytes_read = 0;
+
+  if(fp == &_index_file && sector == _index.sectors) {
+    memcpy(buffer, _index.sector, SEEK_INDEX_SECTOR_SIZE);
+    return true;
+  }
+
+  if(f_lseek(fp, sector * SEEK_INDEX_SECTOR_SIZE) != FR_OK ||
+     f_read(fp, buffer, SEEK_INDEX_SECTOR_SIZE, (UINT *) &bytes_read) != FR_OK) {
+    return false;
+  }
+  memset(&buffer[bytes_read], SEEK_INDEX_EMPTY, SEEK_INDEX_SECTOR_SIZE - bytes_read);
+  return true;
+}
+
+
+#if APP_USD_BENCHMARK
+/* 
+ * @brief Function to measure the sustained write throughput and the worst write latency of the card.
+ *
+ * @param[in] streaming       True for the streaming writer, whole blocks of a preallocated file synced on
+ *                            APP_USD_SYNC_BYTES, otherwise unaligned batches synced one by one.
+ */
+void _app_usd_benchmark(bool streaming) {
+
+  uint32_t bytes_written = 0;
+  uint32_t size = streaming ? APP_USD_BLOCK_SIZE : APP_USD_BENCHMARK_BATCH_SIZE;
+  uint32_t written = 0;
+  uint32_t unsynced = 0;
+  uint32_t start;
+  uint64_t timestamp;
+  uint64_t elapsed;
+  cycle_counter_stats stats;
+  FRESULT ff_result;
+
+  ff_result = f_open(&_bench_file, APP_USD_BENCHMARK_FILE, FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+  if (ff_result != FR_OK) {
+    debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_0, (uint8_t*) "[_app_usd_benchmark] Unable to open or create file: %s\r\n", APP_USD_BENCHMARK_FILE);
+    return;
+  }
+  for(uint32_t i = 0 ; i < sizeof(_bench_block) ; i++) {
+    _bench_block[i] = (uint8_t)i;
+  }
+
+  cycle_counter_stats_init(&stats, 0);
+  timestamp = rtc_get_milliseconds();
+  if(streaming) {
+    (void)_app_usd_preallocate(&_bench_file, APP_USD_BENCHMARK_BYTES);
+  }
+
+  /* Latency of each write, with its sync */
+  while(ff_result == FR_OK && written < APP_USD_BENCHMARK_BYTES) {
+    start = cycle_counter_get();
+    ff_result = f_write(&_bench_file, _bench_block, size, (UINT *) &bytes_written);
+    unsynced += size;
+    if(ff_result == FR_OK && (!streaming || unsynced >= APP_USD_SYNC_BYTES)) {
+      ff_result = f_sync(&_bench_file);
+      unsynced = 0;
+    }
+    cycle_counter_stats_add(&stats, start);
+    written += bytes_written;
+  }
+  elapsed = rtc_get_milliseconds() - timestamp;
+
+  (void)f_close(&_bench_file);
+  (void)f_unlink(APP_USD_BENCHMARK_FILE);
+
+  debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_0, (uint8_t*) "[_app_usd_benchmark] %s: %lu KB in %lu ms, %lu KB/s, write mean: %lu us, max: %lu us, error: %d\r\n",
+                      streaming ? "Streaming" : "Batches", written / 1024, (uint32_t)elapsed,
+                      (uint32_t)(elapsed ? (uint64_t)written * 1000 / 1024 / elapsed : 0),
+                      CYCLE_COUNTER_CYCLES_TO_US(cycle_counter_stats_mean(&stats)), CYCLE_COUNTER_CYCLES_TO_US(stats.max), ff_result);
+}
+#endif
 
-    ff_result = f_write(&file, measures_send, ARRAY_SIZE(measures_send) - 1, (UINT *) &bytes_written);
-    if (ff_result != FR_OK) {
-      debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
-      debug_print_string(DEBUG_LEVEL_1, (uint8_t*) "[_app_usd_upload_meas] Write failed.\r\n");    
-    } 
-  }  
-}
\ No newline at end of file
@@ -19,6 +19,15 @@
 /* Config */
 #include "config.h"
 
+/* Apps */
+#include "app_ecg.h"
+
+/* Utilities */
+#include "flow_stats.h"
+#include "edf.h"
+#include "fmt.h"
+#include "seek_index.h"
+
 /* standard library */
 #include <stdint.h>
 #include <stdbool.h>
@@ -26,7 +35,8 @@
 /********************************** Definies ***********************************/
 /* Files */
 #define APP_USD_README_FILE                                 "README.TXT"
-#define APP_USD_CSV_FILE                                    "DATA%d.CSV"
+#define APP_USD_EDF_EXTENSION                               ".EDF"
+#define APP_USD_INDEX_EXTENSION                             ".IDX"
 #define APP_USD_CONFIG_FILE                                 "CONFIG.TXT"
 
 /* APP_USD_README_FILE */
@@ -37,37 +47,44 @@
 #define APP_USD_README_STRING1_SIZE                         ARRAY_SIZE(APP_USD_README_STRING1)
 #define APP_USD_README_STRING2_SIZE                         ARRAY_SIZE(APP_USD_README_STRING2)    
 
-#define APP_USD_COL1_SIZE                                   1
-
-/* APP_USD_DATA_FILE */
+/* APP_USD_DATA_FILE, EDF+ recording with the patient subfields "ID sex X name age" */
 #define APP_USD_DATAF_NAME                                  "DATA"
-#define APP_USD_DATAF_NAME_SIZE                             11
+#define APP_USD_DATAF_NAME_SIZE                             12      /* Name, up to 3 digits, the extension and the terminator */
 #define APP_USD_DATAF_NAME_INIT_NUMBER                      0
 #define APP_USD_DATAF_NAME_DATA_SIZE                        ARRAY_SIZE(APP_USD_DATAF_NAME)
-#define APP_USD_DATAF_TITLE                                 "Document with ECG and temperature signals acquired by the SAMB V1.0 equipment\n\nThis output file is proprietary of Cave Tech company\n"
-#define APP_USD_DATAF_DESCRIPTION1                          "Disclaimer: Cave Tech company is not responsible for the incorrect use of the private information of the patient\n\n\n"
-#define APP_USD_DATAF_PATIENT1                              "Monitored patient information:\n"
-#define APP_USD_DATAF_PATIENT2                              "ID;%d;\nName;%s;\nAge;%d;Gender;%s;\n\n\n"
-#define APP_USD_DATAF_TITLE_SIZE                            ARRAY_SIZE(APP_USD_DATAF_TITLE)
-#define APP_USD_DATAF_DESCRIPTION1_SIZE                     ARRAY_SIZE(APP_USD_DATAF_DESCRIPTION1)
-#define APP_USD_DATAF_PATIENT1_SIZE                         ARRAY_SIZE(APP_USD_DATAF_PATIENT1)
-#define APP_USD_DATAF_ID_OFFSET                             APP_USD_DATAF_TITLE_SIZE + APP_USD_DATAF_DESCRIPTION1_SIZE + APP_USD_DATAF_PATIENT1_SIZE - 3
-#define APP_USD_DATAF_ID_STR                                "ID"
-#define APP_USD_DATAF_NAME_STR                              "Name"
-#define APP_USD_DATAF_AGE_STR                               "Age"
-#define APP_USD_DATAF_GENDER_STR                            "Gender"
-#define APP_USD_DATAF_ID_STR_SIZE                           ARRAY_SIZE(APP_USD_DATAF_ID_STR) + 5
-#define APP_USD_DATAF_NAME_STR_SIZE                         ARRAY_SIZE(APP_USD_DATAF_NAME_STR) + 30
-#define APP_USD_DATAF_AGE_STR_SIZE                          ARRAY_SIZE(APP_USD_DATAF_AGE_STR) + 2
-#define APP_USD_DATAF_GENDER_STR_SIZE                       ARRAY_SIZE(APP_USD_DATAF_GENDER_STR) + 10
-#define APP_USD_DATAF_PATIENT_INFO_SIZE                     APP_USD_DATAF_ID_STR_SIZE + APP_USD_DATAF_NAME_STR_SIZE + APP_USD_DATAF_AGE_STR_SIZE + APP_USD_DATAF_GENDER_STR_SIZE
-#define APP_USD_PATIENT_ELEMENTS                            4
-#define APP_USD_PATIENT_DELIMITER1                          ";"
+#define APP_USD_DATAF_NAME_STR_SIZE                         30
+#define APP_USD_PATIENT_ELEMENTS                            5
+#define APP_USD_PATIENT_DELIMITER1                          " "
+#define APP_USD_PATIENT_BIRTHDATE                           "X"     /* Not known */
+
+/* EDF+ signals and data records. Every field of MEASURES_SCHEMA is in the recording, but not all as signals:
+ *   leads and RESP       a signal each, at the rate of the header
+ *   TEMP and the vitals  a signal each, one sample per data record
+ *   TIMESTAMP            the onsets of the data records, from the first row and the restarts of the sampling
+ *   SAMPLE_INDEX         the position of the samples in the data records, not stored
+ *   SAMPLE_RATE          the rate of the header from the first row, a new one starts a segment, not stored
+ *   ECG_LOFF_* and PACE  annotations, on their changes */
+#define APP_USD_EDF_EQUIPMENT                               "SAMB_V2.0"
+#define APP_USD_EDF_RECORD_MS                               200     /* Data record duration */
+#define APP_USD_EDF_VITALS                                  4       /* HR, RR, R peak and RESP_RATE, app_usd_edf_vital */
+#define APP_USD_EDF_MAX_LEADS                               (EDF_MAX_SIGNALS - 2 - APP_USD_EDF_VITALS)      /* Besides temperature, vitals and annotations */
+#define APP_USD_EDF_MAX_SAMPLES                             (APP_ECG_HP_RATE * APP_USD_EDF_RECORD_MS / 1000)  /* Samples of a lead per data record */
+#define APP_USD_EDF_LEAD_RANGE                              32768   /* uV, 1 uV per bit */
+#define APP_USD_EDF_RESP_RANGE                              327680  /* uV, 10 uV per bit */
+#define APP_USD_EDF_TEMP_MAX                                1000    /* 0.1 degC, the TEMP field as it is */
+#define APP_USD_EDF_VITAL_MAX                               32767   /* Vitals as they are, ms, bpm and breaths per minute */
+#define APP_USD_EDF_ANNOTATION_SAMPLES                      40      /* 80 characters of TALs per data record */
+#define APP_USD_EDF_PENDING_SIZE                            160     /* TALs waiting for room in a data record */
+#define APP_USD_EDF_RECORD_SIZE                             ((APP_USD_EDF_MAX_LEADS * APP_USD_EDF_MAX_SAMPLES + 1 + APP_USD_EDF_VITALS + APP_USD_EDF_ANNOTATION_SAMPLES) * EDF_SAMPLE_SIZE)
+#define APP_USD_EDF_TEXT_SIZE                               32
+#define APP_USD_EDF_PACE_TEXT                               "Pace"
+#define APP_USD_EDF_END_TEXT                                " end"
+#define APP_USD_EDF_RATE_TEXT                               "Rate "  /* Annotation of a segment at a new rate */
+#define APP_USD_EDF_RATE_UNIT                               " SPS"
 
 /* APP_USD_CONFIG_FILE */
 #define APP_USD_CFG_TITLE                                   "Configuration file, only people allowed can modify\n"
 //#define APP_USD_CFG_SIZE                                    200
-#define APP_USD_CFG_STR                                     "%s{%d}\n"
 #define APP_USD_CFG_DELIMITER1                              "{"
 #define APP_USD_CFG_DELIMITER2                              "}"
 #define APP_USD_CFG_SIZE                                    322
@@ -91,13 +108,30 @@
 #define APP_USD_ID14  "Resp rate high"
 
 /* Measurments macros */
-#define APP_USD_MEAS_TITLE_SIZE                             150
-#define APP_USD_MEAS_BATCH_NUMBER                           20
-#define APP_USD_MEAS_BATCH_SIZE                             100
-#define APP_USD_MEAS_UPLOAD_MOUNT_TH                        2
+#define APP_USD_MEAS_BATCH_NUMBER                           20      /* Rows of a slot, in the meas_frame_layout */
+#define APP_USD_MEAS_SLOTS                                  4       /* Slots of rows, a power of 2 */
+#define APP_USD_MEAS_HANDOFF_MS                             200     /* A slot not filled is handed to the writer after this */
 #define APP_USD_SAMPLES_ADDR_OFFSET                         11
 #define APP_USD_BYTES_IN_64BITS                             8
 
+/* Streaming writer of the recording, whole sectors at sector-aligned offsets of a preallocated file */
+#define APP_USD_BLOCK_SIZE                                  (4 * SDC_SECTOR_SIZE)
+#define APP_USD_PREALLOCATE_SIZE                            (64UL * 1024 * 1024)  /* Allocated up front and again when filled */
+#define APP_USD_SYNC_PERIOD_MS                              5000                  /* Sync and header update, on time or on size */
+#define APP_USD_SYNC_BYTES                                  (256UL * 1024)
+#define APP_USD_WRITE_RETRIES                               3                     /* Failed writes before a remount */
+#define APP_USD_BLOCKS                                      4                     /* Blocks queued for the card, a power of 2 */
+#define APP_USD_WRITE_SLICE                                 1                     /* Blocks written per loop */
+
+/* Seek index of the recording, a file of the same name with APP_USD_INDEX_EXTENSION */
+#define APP_USD_INDEX_RECORDS                               25                    /* Data records between entries, and an entry after each gap */
+
+/* Benchmark of the writer, once on the first APP_USD_IDLE, against the writes and syncs per batch it replaced */
+#define APP_USD_BENCHMARK                                   0
+#define APP_USD_BENCHMARK_FILE                              "BENCH.BIN"
+#define APP_USD_BENCHMARK_BYTES                             (1024UL * 1024)
+#define APP_USD_BENCHMARK_BATCH_SIZE                        1986                  /* Unaligned batch, 20 rows of text */
+
 /* uSD data sampling internal states */
 typedef enum {
   APP_USD_INIT,
@@ -110,6 +144,23 @@ typedef enum {
   APP_USD_NOP
 } app_usd_sampling_states;
 
+/* Slot of measurements, filled in place by the producer and handed whole to the writer */
+typedef struct {
+  uint8_t   rows[APP_USD_MEAS_BATCH_NUMBER][MEAS_FRAME_SIZE];
+  uint8_t   count;
+  uint8_t   taken;                                  /* Rows already converted by the writer */
+  uint64_t  timestamp;                              /* Time of the first row */
+} app_usd_meas_slot;
+
+/* Vital signs of a data record, in the order of their signals. The rates are the last reported, the
+ * RR interval and the R peak are of the last beat of the data record, 0 if it has no beat */
+typedef enum {
+  APP_USD_EDF_HR,
+  APP_USD_EDF_RR,
+  APP_USD_EDF_R_PEAK,                               /* ms from the onset of the data record, before it if negative */
+  APP_USD_EDF_RESP_RATE
+} app_usd_edf_vital;
+
 /* Patient status */
 typedef enum {
   APP_USD_PATIENT_ADD,
@@ -135,6 +186,12 @@ device_config *app_usd_get_device_config(void);
 void app_usd_add_patient_info(patient_info *patient, bool overwrite);
 patient_info *app_usd_get_patient_info(void);
 bool app_usd_add_measurement(uint8_t *meas_buffer, uint8_t size);
+uint8_t *app_usd_reserve_measurement(void);
+void app_usd_commit_measurement(void);
+bool app_usd_add_annotation(uint64_t timestamp, const char *text);
+uint8_t app_usd_get_free_measurements(void);
+flow_stats *app_usd_get_flow_stats(void);
+bool app_usd_seek(uint8_t number, uint64_t timestamp, seek_index_entry *entry);
 
 #endif /* APP_USD_H_ */
 
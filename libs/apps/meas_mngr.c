@@ -15,9 +15,17 @@
 
 /* Driver */
 #include "drivers/mc_23k640.h"
+#include "drivers/ads129x.h"
 
-/* Utilities */
+/* DSP */
+#include "dsp/ecg_leads.h"
+#include "dsp/ecg_codec.h"
+#include "dsp/timebase.h"
 
+/* Utilities */
+#include "ram_record.h"
+#include "flow_stats.h"
+#include "fmt.h"
 #include "utils.h"
 
 /* Sense */
@@ -35,7 +43,8 @@
 #include <stdbool.h>
 #include <string.h>
 
-#include "nrf_delay.h"
+/* Cycle counter */
+#include "cycle_counter.h"
 
 /********************************** Private ************************************/
 const uint8_t EXTERNAL_PROBE_SENSOR_SEQUENCE           = (16);  ///< External probe sensor sequence.
@@ -47,62 +56,83 @@ static uint8_t _queue_add_attempts = 0;
 /*
  * 
  */
-static char **_ecg_sequence;
-
-/*
- * 
- */
-static uint16_t ecg_size = 0;
-
-/*
- * 
- */
-static uint16_t ram_idx = 0;
-
-/*
- * 
- */
-static uint8_t ecg_hash[ECG_SEQUENCE_SIZE];
+static meas_mngr_states current_state;
 
 /*
  * 
  */
-static char *_ram_sequence[] = MEASURES_CONTENT;
+ static uint8_t ram_counter = 0;
 
 /*
- * 
+ * Write combining, records staged on MCU1 until MEAS_MNGR_STAGE_RECORDS, a full buffer or the deadline
  */
-static uint8_t _ram_sequence_sizes[] = MEASURES_CONTENT_SIZE;
+static uint8_t _stage[MEAS_MNGR_STAGE_SIZE];
+static uint16_t _stage_bytes = 0;
+static uint8_t _stage_records = 0;
+static uint64_t _stage_timestamp = 0;   /* Time of the oldest staged record */
 
 /*
- * 
+ * Records framing, sequence number of the next record on MCU1 and parser of the records on MCU2
  */
-static uint8_t ram_buffer[RAM_BUFFER_SIZE] = "0";
+static uint16_t _record_sequence = 0;
+#if MICROCONTROLER_2
+static uint8_t _ram_parser_buffer[RAM_PARSER_BUFFER_SIZE];
+static ram_record_parser _ram_parser;
 
 /*
- * 
+ * Anchor of the ECG sample indexes, from the last TIMEBASE_ANCHOR_TYPE record
  */
-static meas_mngr_states current_state;
+static timebase_anchor _ecg_anchor;
+static bool _ecg_anchor_valid = false;
 
 /*
- * 
+ * ECG block decoder
  */
- static uint8_t ram_counter = 0;
+static ecg_codec _ecg_decoder;
 
 /*
- * 
+ * Upload lead of the last ECG sample read
  */
- static uint16_t total_sequence_size = 0;
+static uint8_t _upload_lead[MEAS_4BYTE];
+static bool _upload_pending = false;
+#endif
 
 /*
- * 
+ * Drain of the RAM on MCU2, posted by the doorbell interrupt and done by meas_mngr_loop
  */
-static uint16_t upload_ecg_meas_idx;
+static volatile bool _drain_pending = false;
+#if MICROCONTROLER_2
+static bool _draining = false;
+static uint64_t _drain_timestamp = 0;   /* Start of the drain in progress */
+#endif
+static cycle_counter_stats _isr_stats;
+static cycle_counter_stats _drain_stats;
+static meas_mngr_record_callback_def _record_callback = NULL;
 
 /*
- * 
+ * Backpressure and flow statistics of each stage, published every MEAS_MNGR_DIAG_PERIOD_MS
  */
-static uint16_t upload_ecg_meas_bytes = 0;
+static meas_mngr_policy_def _policy = NULL;
+static flow_stats _flow[MEAS_MNGR_FLOW_STAGES];
+static uint64_t _queue_timestamp = 0;   /* First attempt of the measurement being added */
+static uint64_t _diag_timestamp = 0;
+static uint8_t _diag_record[1 + FLOW_STATS_SIZE];
+
+/* Private functions list */
+static bool _meas_mngr_stage(uint8_t type, uint8_t *data, uint16_t size);
+static bool _meas_mngr_make_room(uint8_t type, uint16_t size);
+static bool _meas_mngr_queue(gama_measure_format_v2_fields_t *fields);
+static void _meas_mngr_publish_diag(void);
+static bool _meas_mngr_append_ram(uint8_t *data, uint16_t size);
+static bool _meas_mngr_publish_ram(void);
+#if MICROCONTROLER_2
+static void _meas_mngr_drain(void);
+static void _meas_mngr_add_flow_stats(uint8_t stage, const flow_stats *stats);
+static void _meas_mngr_process_record(const ram_record *record);
+static void _meas_mngr_process_frame(const uint8_t *frame);
+static void _meas_mngr_process_block(const uint8_t *block, uint16_t size);
+static void _meas_mngr_add_vitals(uint16_t hr_bpm, uint16_t rr_ms, uint16_t resp);
+#endif
 /*
  * @brief  
  * 
@@ -111,7 +141,7 @@ static uint16_t upload_ecg_meas_bytes = 0;
  */
 bool meas_mngr_add_measurement(uint8_t *value, uint8_t bytes) {
 
-  float data = (float)utils_get_uint32_from_array(value) / 100000000;
+  float data = (float)(int32_t)utils_get_uint32_from_array(value) / 1000000;               /* ECG samples in microvolts */
   
   gama_measure_format_v2_fields_t measurement_fields;
   measurement_fields.measure_type = GAMA_MEASURE_ECG;
@@ -119,19 +149,26 @@ bool meas_mngr_add_measurement(uint8_t *value, uint8_t bytes) {
   measurement_fields.config_byte = MEASURE_VALUE_FLOAT_TYPE;
   measurement_fields.val = &data;
 
-  /* Converts pressure to string */
-  char str[10];
-  memset(str, '\0', 10);
-  utils_ftoa(str, data, 0.000001);
+  /* Converts the sample to string, from the microvolts as they are */
+  char str[FMT_FIXED_SIZE];
+  fmt_fixed(str, (int32_t)utils_get_uint32_from_array(value), 6);
+
+  if(!_queue_add_attempts) {
+    _queue_timestamp = rtc_get_milliseconds();
+    flow_stats_produced(&_flow[MEAS_MNGR_FLOW_GAMA], 1, 0);
+  }
 
   if(measurements_v2_manager_add_measurement(&measurement_fields)) {
     debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
     debug_printf_string(DEBUG_LEVEL_1,(uint8_t*)"[add_ecg_measurement] measurement added; details: Voltage = %sV\n", str);
     
+    flow_stats_forwarded(&_flow[MEAS_MNGR_FLOW_GAMA], 1, (uint32_t)(rtc_get_milliseconds() - _queue_timestamp));
     _queue_add_attempts = 0;
     return true;
   } else {
     if(_queue_add_attempts >= GAMA_QUEUE_ADD_MAX_ATTEMPTS) {
+      /* Given up, the measurement is dropped */
+      flow_stats_dropped(&_flow[MEAS_MNGR_FLOW_GAMA], 1);
       _queue_add_attempts = 0;
       return true;
     }
@@ -144,43 +181,86 @@ bool meas_mngr_add_measurement(uint8_t *value, uint8_t bytes) {
 
 
 /*
- * @brief  
+ * @brief Function to publish the heart rate and RR interval of a beat detected by app_ecg
  * 
- * @param[in] 
- * @retval 
+ * @param[in] hr_bpm        Heart rate in beats per minute, 0 until the second beat
+ * @param[in] rr_ms         RR interval in milliseconds
+ * @retval                  Returns true if the measurements were added to the queue, or false otherwise
+ */
+bool meas_mngr_add_beat(uint16_t hr_bpm, uint16_t rr_ms) {
+
+  uint32_t hr = hr_bpm;
+  uint32_t rr = rr_ms;
+  
+  gama_measure_format_v2_fields_t measurement_fields;
+  measurement_fields.measure_type = GAMA_MEASURE_ECG;
+  measurement_fields.config_byte = MEASURE_VALUE_UINT32_TYPE;
+
+  /* RR interval */
+  measurement_fields.sensor = ECG_RR_TYPE;
+  measurement_fields.val = &rr;
+  if(!_meas_mngr_queue(&measurement_fields)) {
+    return false;
+  }
+
+  /* Heart rate */
+  measurement_fields.sensor = ECG_HR_TYPE;
+  measurement_fields.val = &hr;
+  if(!_meas_mngr_queue(&measurement_fields)) {
+    return false;
+  }
+
+  debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_1,(uint8_t*)"[meas_mngr_add_beat] measurement added; details: HR = %d bpm, RR = %d ms\n", hr_bpm, rr_ms);
+  return true;
+}
+
+
+/*
+ * @brief Function to publish the respiration rate extracted by app_ecg
+ * 
+ * @param[in] bpm           Breaths per minute, 0 on apnea
+ * @retval                  Returns true if the measurement was added to the queue, or false otherwise
+ */
+bool meas_mngr_add_resp_rate(uint16_t bpm) {
+
+  uint32_t rate = bpm;
+  
+  gama_measure_format_v2_fields_t measurement_fields;
+  measurement_fields.measure_type = GAMA_MEASURE_ECG;
+  measurement_fields.sensor = RESP_RATE_TYPE;
+  measurement_fields.config_byte = MEASURE_VALUE_UINT32_TYPE;
+  measurement_fields.val = &rate;
+
+  if(!_meas_mngr_queue(&measurement_fields)) {
+    return false;
+  }
+
+  debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_1,(uint8_t*)"[meas_mngr_add_resp_rate] measurement added; details: Respiration = %d bpm\n", bpm);
+  return true;
+}
+
+
+/*
+ * @brief Function to count the RAM transactions of MCU1, the drain is left to meas_mngr_loop
+ * 
+ * @param[in] pin           Pin of the doorbell, MC_23k640_CS2
+ * @param[in] action        Edge of the pin
  */
 void meas_mngr_interrupt_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+  uint32_t start = cycle_counter_get();
+
   ram_counter++;
   if(pin != MC_23k640_CS2 || action != NRF_GPIOTE_POLARITY_LOTOHI) {
     return;
   }
 
   if(ram_counter >= READ_RAM_THRESHOLD) {
-    nrf_delay_ms(1);
     ram_counter = 0;
-    uint8_t read_str[RAM_BUFFER_SIZE] = "\0";
-    uint8_t rbytes = 1;
-    uint64_t timestamp;
-    while(rbytes) {
-      rbytes = mc_23k640_read_data(read_str);
-      debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-      debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"Bytes read: %d", rbytes);
-      
-      //debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[main] Bytes remaining: %d , Str read: %s\n\n", rbytes, read_str); 
-      
-      timestamp = utils_get_serial_from_array(read_str);
-      //debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-      debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"Timestamp: %ld \n", timestamp);
-      for(uint16_t i=0; i < total_sequence_size ; i++) {
-        debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"%x", read_str[i]);
-      }
-      
-      debug_print_string(DEBUG_LEVEL_0, (uint8_t*)"\n\n");
-      /* Clear */
-      memset(read_str, '\0', RAM_BUFFER_SIZE);
-    }
-    meas_mngr_add_measurement(&read_str[upload_ecg_meas_bytes], _ram_sequence_sizes[upload_ecg_meas_idx]);
+    _drain_pending = true;
   }
+  cycle_counter_stats_add(&_isr_stats, start);
 }
 
 /*
@@ -192,9 +272,10 @@ void meas_mngr_interrupt_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t
 void meas_mngr_init(void) {
  
   mc_23k640_init();
-   for(uint16_t i = 0 ; i < ARRAY_SIZE(_ram_sequence_sizes) ; i++) {
-    total_sequence_size += _ram_sequence_sizes[i];
-  }
+  flow_stats_init(&_flow[MEAS_MNGR_FLOW_RAM], DATA_MEMORY_SIZE - 1);
+  flow_stats_init(&_flow[MEAS_MNGR_FLOW_RECORDS], RAM_PARSER_BUFFER_SIZE);
+  flow_stats_init(&_flow[MEAS_MNGR_FLOW_GAMA], 0);               /* Capacity of the Gama queue not known here */
+  _diag_timestamp = rtc_get_milliseconds();
 #if MICROCONTROLER_2
  
   /* GPIO Configuration */
@@ -207,14 +288,10 @@ void meas_mngr_init(void) {
     .skip_gpio_setup = false 
   };
   
-  /* Calculate idx of upload ecg measurement on config.h buffer */
-  for(uint8_t i = 0; i < DEVICE_MEASURES_NUMBER ; i++) {
-    if(!strcmp(_ram_sequence[i], UPLOAD_ECG_MEAS)) {
-      break;
-    } else {
-      upload_ecg_meas_bytes += i * _ram_sequence_sizes[i];
-    }
-  }
+  ram_record_parser_init(&_ram_parser, _ram_parser_buffer, sizeof(_ram_parser_buffer));
+  cycle_counter_init();
+  cycle_counter_stats_init(&_isr_stats, CYCLE_COUNTER_US_TO_CYCLES(MEAS_MNGR_ISR_BUDGET_US));
+  cycle_counter_stats_init(&_drain_stats, CYCLE_COUNTER_US_TO_CYCLES(MEAS_MNGR_DRAIN_BUDGET_US));
 
   /* Inicializar GPIO DRY */
   if(!nrf_drv_gpiote_in_init(MC_23k640_CS2, &in_config, meas_mngr_interrupt_handler)) {
@@ -226,110 +303,589 @@ void meas_mngr_init(void) {
 
 #endif 
  
-#if MICROCONTROLLER_1
+#if MICROCONTROLER_1
   current_state = MEAS_MNGR_IDLE;
 #endif
 }
 
+/* 
+ * @brief Function to store a temperature measurement
+ *
+ * @param[in] data          Measurement in the meas_device_layout, MEAS_DEVICE_FRAME_SIZE bytes
+ * @retval                  Returns true if the record was staged or written, or false otherwise
+ */
+bool meas_mngr_store_temp(uint8_t *data) {
+  return _meas_mngr_stage(RAM_RECORD_TEMPERATURE, data, MEAS_DEVICE_FRAME_SIZE);
+}
+/* 
+ * @brief Function to store a variable size event record, as the pace events of app_ecg
+ *
+ * @param[in] record        Record, starting with its alert type
+ * @param[in] size          Record size in bytes
+ * @retval                  Returns true if the whole record was staged or written, or false otherwise
+ * @note                    Records larger than MEAS_MNGR_STAGE_SIZE are written right after the staged ones
+ */
+bool meas_mngr_store_event(uint8_t *record, uint16_t size) {
+  return _meas_mngr_stage(RAM_RECORD_ALERT, record, size);
+}
+
+
+/* 
+ * @brief Function to store an ECG frame
+ *
+ * @param[in] data          Frame in the meas_ecg_layout, MEAS_ECG_FRAME_SIZE bytes
+ * @retval                  Returns true if the record was staged or written, or false otherwise
+ */
+bool meas_mngr_store_ecg(uint8_t *data) {
+
+  /* Write data to RAM with the next frames */
+  return _meas_mngr_stage(RAM_RECORD_ECG, data, MEAS_ECG_FRAME_SIZE);
+}
+
+void meas_mngr_loop(void) {
+
+  switch(current_state) {
+    case MEAS_MNGR_INITIALIZING:
+      meas_mngr_init();
+      break;
+    case MEAS_MNGR_IDLE:
+#if MICROCONTROLER_1
+      /* Staged records waited enough for more to join the burst */
+      if(_stage_bytes && (rtc_get_milliseconds() - _stage_timestamp) >= MEAS_MNGR_STAGE_DEADLINE_MS) {
+        meas_mngr_flush();
+      }
+#endif
+#if MICROCONTROLER_2
+      /* Records from MCU1, a bounded chunk per loop */
+      if(_drain_pending || _draining) {
+        _meas_mngr_drain();
+      }
+#endif
+      if((rtc_get_milliseconds() - _diag_timestamp) >= MEAS_MNGR_DIAG_PERIOD_MS) {
+        _diag_timestamp = rtc_get_milliseconds();
+        _meas_mngr_publish_diag();
+      }
+      break;
+  }
+}
+
+
 /*
- * @brief  
+ * @brief Function to set a callback for every record read from RAM, as the uSD writer
  * 
- * @param[in] 
- * @retval 
+ * @param[in] callback      Callback, or NULL to remove it
  */
-void meas_mngr_ecg_set_sequence(char *ecg_sequence[], uint16_t sequence_size) {
-  _ecg_sequence = ecg_sequence;
-  uint16_t _sequence_size = sequence_size;
+void meas_mngr_set_record_callback(meas_mngr_record_callback_def callback) {
+  _record_callback = callback;
+}
 
-  /* Calculate ecg sequence hash */
-  for(int16_t seq_idx = 0 ; seq_idx < sequence_size ; seq_idx++) {
-    uint16_t ecg_i = 0;
 
-    /* Search the ecg sequence for a specific sequence, aka _ram_sequence[seq_idx] */
-    while(strcmp(_ram_sequence[seq_idx], _ecg_sequence[ecg_i])) {
-      ecg_i++;
+/*
+ * @brief Function to get the execution time of the doorbell interrupt
+ * 
+ * @return                  Returns the statistics, with MEAS_MNGR_ISR_BUDGET_US as budget
+ */
+cycle_counter_stats *meas_mngr_get_isr_stats(void) {
+  return &_isr_stats;
+}
 
-      /* When we reach the end of the ecg sequence */
-      if(ecg_i > sequence_size) {
-        ecg_i = SEQUENCE_ERROR;
-        break;
-      }
-    }
-    if(ecg_i != SEQUENCE_ERROR) {
-      ecg_hash[seq_idx] = ecg_i;
 
-      /* Calculate ECG sequence size */
-      ecg_size += _ram_sequence_sizes[seq_idx];
-    }
-  }
+/*
+ * @brief Function to get the execution time of the drain in each loop
+ * 
+ * @return                  Returns the statistics, with MEAS_MNGR_DRAIN_BUDGET_US as budget
+ */
+cycle_counter_stats *meas_mngr_get_drain_stats(void) {
+  return &_drain_stats;
 }
 
-/* 
- * @brief
- *
- * @param[in] 
- * @retval 
+
+/*
+ * @brief Function to set the backpressure policy, asked for each record that does not fit in RAM
+ * 
+ * @param[in] policy        Callback, or NULL for MEAS_MNGR_DROP_NEWEST
  */
-bool meas_mngr_store_temp(uint8_t *data) {
-  uint8_t copied_bytes = 0;
-  uint8_t temp_size = _ram_sequence_sizes[0] + _ram_sequence_sizes[1];
-  int8_t write_retries = MAX_RAM_RETRIES;
+void meas_mngr_set_policy(meas_mngr_policy_def policy) {
+  _policy = policy;
+}
+
+
+/*
+ * @brief Function to get the room left for the records of MCU1
+ * 
+ * @return                  Returns the free bytes of RAM minus the staged records, a lower bound
+ * @note                    Each record takes RAM_RECORD_OVERHEAD bytes more than its payload
+ */
+uint16_t meas_mngr_get_free_space(void) {
+
+  uint16_t free = mc_23k640_get_free_space();
+
+  return (free > _stage_bytes) ? free - _stage_bytes : 0;
+}
+
 
-  for(uint8_t i = 0 ; copied_bytes < temp_size ; i++) {
-    ram_buffer[i] = data[i];
-    copied_bytes++;
+/*
+ * @brief Function to get the flow statistics of a stage
+ * 
+ * @param[in] stage         MEAS_MNGR_FLOW_RAM on MCU1, MEAS_MNGR_FLOW_RECORDS or MEAS_MNGR_FLOW_GAMA on MCU2
+ * @return                  Returns the statistics, records or measurements as items
+ */
+flow_stats *meas_mngr_get_flow_stats(meas_mngr_flow_stage stage) {
+  return &_flow[stage];
+}
+
+
+/*
+ * @brief Function to get the sampling rate of the ECG frames read back, the SAMPLE_RATE of the uSD rows
+ * 
+ * @return                  Returns the rate in SPS of the last timebase anchor, or 0 before the first one and on MCU1
+ * @note                    A sampling stores its anchor at its first frame, so the rate follows its restarts
+ */
+uint16_t meas_mngr_get_ecg_rate(void) {
+#if MICROCONTROLER_2
+  return _ecg_anchor_valid ? timebase_anchor_get_rate(&_ecg_anchor) : 0;
+#else
+  return 0;
+#endif
+}
+
+
+/*
+ * @brief Function to write the staged records to RAM in one burst
+ * 
+ * @retval                  Returns true if the records were written, or false if they are still staged
+ */
+bool meas_mngr_flush(void) {
+
+  if(!_stage_bytes) {
+    return true;
   }
-  /* Write data to RAM !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! APAGAR!!!!!!!!!!!!!!!!!!!!*/
-  while(!mc_23k640_write_data(data, total_sequence_size) && (write_retries >= 0)) {
-    write_retries--;
+
+  /* A burst fits in one write, it is written whole or kept for the next flush */
+  if(!_meas_mngr_append_ram(_stage, _stage_bytes) || !_meas_mngr_publish_ram()) {
+    return false;
   }
-  memset(ram_buffer, 0, total_sequence_size);
-  debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[meas_mngr_ram_write] Write with: %d retries\n", MAX_RAM_RETRIES - write_retries);
-  if(write_retries <= 0) {
+  flow_stats_forwarded(&_flow[MEAS_MNGR_FLOW_RAM], _stage_records, (uint32_t)(rtc_get_milliseconds() - _stage_timestamp));
+  debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[meas_mngr_flush] %d records, %d bytes\n", _stage_records, _stage_bytes);
+  _stage_bytes = 0;
+  _stage_records = 0;
+  return true;
+}
+
+
+/*
+ * @brief Function to frame a record and add it to the staging buffer, flushed when MEAS_MNGR_STAGE_RECORDS are staged
+ * 
+ * @param[in] type          Record type, RAM_RECORD_TEMPERATURE to RAM_RECORD_CONFIG
+ * @param[in] data          Payload
+ * @param[in] size          Payload size in bytes
+ * @retval                  Returns true if the record was staged or written, or false if it was dropped
+ * @note                    A staged record is only lost if the backpressure policy drops it
+ */
+static bool _meas_mngr_stage(uint8_t type, uint8_t *data, uint16_t size) {
+
+  uint8_t header[RAM_RECORD_HEADER_SIZE];
+  uint8_t crc[RAM_RECORD_CRC_SIZE];
+
+  flow_stats_produced(&_flow[MEAS_MNGR_FLOW_RAM], 1, meas_mngr_get_free_space());
+
+  /* The sequence number goes on for dropped records, MCU2 counts them as lost */
+  ram_record_get_header(header, type, _record_sequence++, size);
+  ram_record_get_crc(crc, header, data, size);
+
+  if(!_meas_mngr_make_room(type, size + RAM_RECORD_OVERHEAD)) {
     return false;
   }
+
+  /* Larger than a burst, written on its own after the staged records to keep the order. Its room was checked
+   * whole and the head is only published after the CRC, so MCU2 never sees part of it */
+  if(size + RAM_RECORD_OVERHEAD > MEAS_MNGR_STAGE_SIZE) {
+    if(!_meas_mngr_append_ram(header, RAM_RECORD_HEADER_SIZE) || !_meas_mngr_append_ram(data, size) ||
+       !_meas_mngr_append_ram(crc, RAM_RECORD_CRC_SIZE) || !_meas_mngr_publish_ram()) {
+      flow_stats_dropped(&_flow[MEAS_MNGR_FLOW_RAM], 1);
+      return false;
+    }
+    flow_stats_forwarded(&_flow[MEAS_MNGR_FLOW_RAM], 1, 0);
+    return true;
+  }
+
+  if(!_stage_bytes) {
+    _stage_timestamp = rtc_get_milliseconds();
+  }
+  memcpy(&_stage[_stage_bytes], header, RAM_RECORD_HEADER_SIZE);
+  memcpy(&_stage[_stage_bytes + RAM_RECORD_HEADER_SIZE], data, size);
+  memcpy(&_stage[_stage_bytes + RAM_RECORD_HEADER_SIZE + size], crc, RAM_RECORD_CRC_SIZE);
+  _stage_bytes += size + RAM_RECORD_OVERHEAD;
+  _stage_records++;
+
+  if(_stage_records >= MEAS_MNGR_STAGE_RECORDS) {
+    meas_mngr_flush();
+  }
   return true;
 }
-/* 
- * @brief
- *
- * @param[in] 
- * @retval 
+
+
+/*
+ * @brief Function to make room for a record after the staged ones, the backpressure policy decides when RAM is full
+ * 
+ * @param[in] type          Record type, RAM_RECORD_TEMPERATURE to RAM_RECORD_CONFIG
+ * @param[in] size          Record size in bytes, with RAM_RECORD_OVERHEAD
+ * @retval                  Returns true if the record fits in the staging buffer, or in RAM if larger than a
+ *                          burst, or false if it was dropped
  */
-bool meas_mngr_store_ecg(uint8_t *data) {
+static bool _meas_mngr_make_room(uint8_t type, uint16_t size) {
+
+  bool large = size > MEAS_MNGR_STAGE_SIZE;
+  meas_mngr_policy action;
 
-  uint16_t copied_bytes = 0;
+  if(large ? (meas_mngr_flush() && mc_23k640_get_free_space() >= size) :
+             (_stage_bytes + size <= MEAS_MNGR_STAGE_SIZE || meas_mngr_flush())) {
+    return true;
+  }
+
+  /* RAM full, MCU2 is late */
+  action = (_policy != NULL) ? _policy(type, size, meas_mngr_get_free_space()) : MEAS_MNGR_DROP_NEWEST;
+  if(action == MEAS_MNGR_DROP_OLDEST && _stage_bytes) {
+    flow_stats_dropped(&_flow[MEAS_MNGR_FLOW_RAM], _stage_records);
+    _stage_bytes = 0;
+    _stage_records = 0;
+    if(!large || mc_23k640_get_free_space() >= size) {
+      return true;
+    }
+  }
+
+  debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[meas_mngr_make_room] Record type %d of %d bytes dropped, policy %d\n", type, size, action);
+  flow_stats_dropped(&_flow[MEAS_MNGR_FLOW_RAM], 1);
+  return false;
+}
+
+
+/*
+ * @brief Function to append data to RAM in bursts of up to MC_23K640_MAX_TRANSFER_SIZE bytes, not seen by MCU2 yet
+ * 
+ * @param[in] data          Data, in RAM for the EasyDMA
+ * @param[in] size          Size in bytes
+ * @retval                  Returns true if all the data was written, or false after dropping all the data appended
+ * @note                    MCU2 sees the data after _meas_mngr_publish_ram()
+ */
+static bool _meas_mngr_append_ram(uint8_t *data, uint16_t size) {
+
+  uint16_t written = 0;
   int8_t write_retries = MAX_RAM_RETRIES;
 
-  /* Apply the hash key */
-  for(uint8_t i = 0 ; copied_bytes < total_sequence_size ; i++) {
-    if(ecg_hash[i] != SEQUENCE_ERROR) {
-      ram_buffer[i] = data[ecg_hash[i]];
+  while(written < size) {
+    uint16_t nbytes = mc_23k640_append_data(&data[written], size - written);
+
+    if(!nbytes) {
+      if(--write_retries < 0) {
+        debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[meas_mngr_ram_write] Write failed after %d of %d bytes\n", written, size);
+        mc_23k640_discard_data();
+        return false;
+      }
+      continue;
     }
-    copied_bytes++;
+    written += nbytes;
   }
-    
-  /* Write data to RAM */
-  while(!mc_23k640_write_data(data, total_sequence_size) && (write_retries >= 0)) {
-    write_retries--;
+  return true;
+}
+
+
+/*
+ * @brief Function to publish the data appended to RAM to MCU2
+ * 
+ * @retval                  Returns true if it was published, or false after dropping all the data appended
+ */
+static bool _meas_mngr_publish_ram(void) {
+
+  for(int8_t write_retries = MAX_RAM_RETRIES ; write_retries >= 0 ; write_retries--) {
+    if(mc_23k640_publish_data()) {
+      return true;
+    }
   }
-  memset(ram_buffer, 0, total_sequence_size);
+  debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[meas_mngr_ram_write] Head not written\n");
+  mc_23k640_discard_data();
+  return false;
+}
 
-  debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[meas_mngr_ram_write] Write with: %d retries\n", MAX_RAM_RETRIES - write_retries); 
 
-   
+#if MICROCONTROLER_2
+/*
+ * @brief Function to read and parse up to MEAS_MNGR_DRAIN_READS chunks of the records written by MCU1
+ * 
+ * @note                    Goes on in the next loops until the RAM is empty, a bus not granted or a failed
+ *                          read is tried again in the next loop
+ */
+static void _meas_mngr_drain(void) {
+
+  uint32_t start = cycle_counter_get();
+  uint32_t lost = _ram_parser.lost;
+  uint32_t counted = lost;
+  mc_23k640_arb_stats *arb = mc_23k640_get_arb_stats();
+  uint16_t rbytes = 0;
+  uint16_t space;
+  mc_23k640_status status;
+  ram_record record;
+
+  _drain_pending = false;                               /* Cleared first, an edge from now on posts again */
+  if(!_draining) {
+    _drain_timestamp = rtc_get_milliseconds();
+  }
+  _draining = true;
+  for(uint8_t i = 0 ; i < MEAS_MNGR_DRAIN_READS ; i++) {
+    uint8_t *ptr = ram_record_parser_get_space(&_ram_parser, &space);
+
+    rbytes = mc_23k640_read_data(ptr, (space > MEAS_MNGR_DRAIN_CHUNK) ? MEAS_MNGR_DRAIN_CHUNK : space, &status);
+    ram_record_parser_commit(&_ram_parser, rbytes);
+    while(ram_record_parser_next(&_ram_parser, &record)) {
+
+      /* Records missing before this one were dropped by MCU1 or lost in RAM */
+      flow_stats_produced(&_flow[MEAS_MNGR_FLOW_RECORDS], 1 + _ram_parser.lost - counted, space);
+      flow_stats_dropped(&_flow[MEAS_MNGR_FLOW_RECORDS], _ram_parser.lost - counted);
+      counted = _ram_parser.lost;
+
+      _meas_mngr_process_record(&record);
+      flow_stats_forwarded(&_flow[MEAS_MNGR_FLOW_RECORDS], 1, (uint32_t)(rtc_get_milliseconds() - _drain_timestamp));
+    }
+    if(status == MC_23K640_EMPTY) {
+      _draining = false;
+      break;
+    }
+    if(status != MC_23K640_DONE) {
+      break;
+    }
+  }
+  cycle_counter_stats_add(&_drain_stats, start);
+
+  if(_ram_parser.lost != lost) {
+    debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[meas_mngr_drain] Records lost: %lu, CRC errors: %lu, stale: %lu, bytes skipped: %lu\n",
+                        _ram_parser.lost, _ram_parser.crc_errors, _ram_parser.stale, _ram_parser.skipped);
+  }
+
+  /* RAM empty, last ECG sample read */
+  if(!_draining) {
+    if(_upload_pending) {
+      meas_mngr_add_measurement(_upload_lead, MEAS_4BYTE);
+      _upload_pending = false;
+    }
+    debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[meas_mngr_drain] Interrupt max: %lu us, drain max: %lu us, over budget: %lu\n",
+                        CYCLE_COUNTER_CYCLES_TO_US(_isr_stats.max), CYCLE_COUNTER_CYCLES_TO_US(_drain_stats.max), _drain_stats.over_budget);
+    debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[meas_mngr_drain] RAM bus wait mean: %lu us, max: %lu us, timeouts: %lu, throughput: %lu B/s\n",
+                        CYCLE_COUNTER_CYCLES_TO_US(cycle_counter_stats_mean(&arb->wait)), CYCLE_COUNTER_CYCLES_TO_US(arb->wait.max), arb->timeouts,
+                        mc_23k640_get_throughput());
+#if MC_23K640_FAULT_INJECTION
+    debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
+    debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[meas_mngr_drain] Bit flips injected: %lu, CRC errors: %lu, records: %lu, lost: %lu\n",
+                        mc_23k640_get_fault_stats()->bit_flips, _ram_parser.crc_errors, _ram_parser.records, _ram_parser.lost);
+#endif
+  }
 }
 
-void meas_mngr_loop(void) {
 
-  switch(current_state) {
-    case MEAS_MNGR_INITIALIZING:
-      meas_mngr_init();
+/*
+ * @brief Function to handle a record read from RAM
+ * 
+ * @param[in] record        Record found by the parser
+ */
+static void _meas_mngr_process_record(const ram_record *record) {
+
+  flow_stats stats;
+  uint8_t stage;
+
+  if(_record_callback != NULL) {
+    _record_callback(record->type, record->payload, record->length);
+  }
+
+  switch(record->type) {
+    case RAM_RECORD_ECG:
+      if(record->length >= MEAS_ECG_FRAME_SIZE) {
+        _meas_mngr_process_frame(record->payload);
+      }
       break;
-    case MEAS_MNGR_IDLE:
-      
+    case RAM_RECORD_ALERT:
+      switch(record->payload[0]) {
+        case TIMEBASE_ANCHOR_TYPE:
+          _ecg_anchor_valid = (record->length >= TIMEBASE_RECORD_SIZE) && timebase_parse_record(record->payload, &_ecg_anchor);
+          break;
+        case ECG_BLOCK_TYPE:
+          _meas_mngr_process_block(record->payload, record->length);
+          break;
+        case FLOW_STATS_TYPE:
+          if(flow_stats_from_array(&record->payload[1], record->length - 1, &stage, &stats)) {
+            _meas_mngr_add_flow_stats(stage, &stats);
+          }
+          break;
+        default:
+          debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+          debug_printf_string(DEBUG_LEVEL_1, (uint8_t*)"[meas_mngr_process_record] Alert %d, %d bytes\n", record->payload[0], record->length);
+          break;
+      }
       break;
+    default:
+      debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+      debug_printf_string(DEBUG_LEVEL_1, (uint8_t*)"[meas_mngr_process_record] Record type %d, %d bytes\n", record->type, record->length);
+      break;
+  }
+}
+
+
+/*
+ * @brief Function to handle an ECG frame in the meas_ecg_layout
+ * 
+ * @param[in] frame         Frame with MEAS_ECG_FRAME_SIZE bytes
+ */
+static void _meas_mngr_process_frame(const uint8_t *frame) {
+
+  uint32_t sample = utils_get_uint32_from_array((uint8_t *)&frame[MEAS_ECG_OFFSET(SAMPLE_INDEX)]);
+
+  debug_print_time(DEBUG_LEVEL_2, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_2, (uint8_t*)"[meas_mngr_process_frame] Sample: %lu\n", sample);
+
+  _meas_mngr_add_vitals(utils_get_uint16_from_array((uint8_t *)&frame[MEAS_ECG_OFFSET(ECG_HR)]), utils_get_uint16_from_array((uint8_t *)&frame[MEAS_ECG_OFFSET(ECG_RR)]),
+                        utils_get_uint16_from_array((uint8_t *)&frame[MEAS_ECG_OFFSET(RESP_RATE)]));
+
+#if ECG_STORE_DERIVED_LEADS
+  memcpy(_upload_lead, &frame[MEAS_ECG_OFFSET(UPLOAD_ECG_MEAS)], MEAS_4BYTE);
+#else
+  /* Derived leads are not stored, rebuild the upload lead from leads I and II */
+  utils_save_uint32_t_to_array(_upload_lead, (uint32_t)ecg_leads_derive(UPLOAD_ECG_DERIVED_LEAD,
+                                                                        (int32_t)utils_get_uint32_from_array((uint8_t *)&frame[MEAS_ECG_OFFSET(ECG_I)]),
+                                                                        (int32_t)utils_get_uint32_from_array((uint8_t *)&frame[MEAS_ECG_OFFSET(ECG_II)])));
+#endif
+  _upload_pending = true;
+}
+
+
+/*
+ * @brief Function to handle a block of ECG frames compressed with ecg_codec
+ * 
+ * @param[in] block         Block, starting with ECG_BLOCK_TYPE
+ * @param[in] size          Block size in bytes
+ * @note                    The codec channels are the lead fields in the order of ADS129X_CHANNEL_MAP, and the
+ *                          fields the vital signs of app_ecg_vitals, at the ECG_CODEC_FIELD_ indexes
+ */
+static void _meas_mngr_process_block(const uint8_t *block, uint16_t size) {
+
+  static ecg_codec_frame frame;
+  uint16_t frames = 0;
+
+  if(!ecg_codec_decoder_init(&_ecg_decoder, block, size)) {
+    return;
+  }
+
+  while(ecg_codec_decode(&_ecg_decoder, &frame)) {
+    _meas_mngr_add_vitals(frame.fields[ECG_CODEC_FIELD_HR], frame.fields[ECG_CODEC_FIELD_RR], frame.fields[ECG_CODEC_FIELD_RESP]);
+    frames++;
+  }
+  if(!frames) {
+    return;
+  }
+
+  utils_save_uint32_t_to_array(_upload_lead, (uint32_t)ecg_leads_derive(UPLOAD_ECG_DERIVED_LEAD, frame.channels[ADS129X_MAP_ECG_I],
+                                                                       frame.channels[ADS129X_MAP_ECG_II]));
+  _upload_pending = true;
+
+  debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+  if(_ecg_anchor_valid) {
+    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*)"[meas_mngr_process_block] %d frames up to sample %lu at %lu ms\n", frames, frame.sample,
+                        (uint32_t)(timebase_ticks_to_us(timebase_anchor_get_ticks(&_ecg_anchor, frame.sample)) / 1000));
+  } else {
+    debug_printf_string(DEBUG_LEVEL_1, (uint8_t*)"[meas_mngr_process_block] %d frames up to sample %lu\n", frames, frame.sample);
   }
 }
 
 
+/*
+ * @brief Function to publish the vital signs of an ECG frame
+ * 
+ * @param[in] hr_bpm        Heart rate in beats per minute
+ * @param[in] rr_ms         RR interval in milliseconds, 0 if no beat in the frame
+ * @param[in] resp          Respiration rate with MEAS_RESP_RATE_REPORTED if new in the frame
+ */
+static void _meas_mngr_add_vitals(uint16_t hr_bpm, uint16_t rr_ms, uint16_t resp) {
+
+  /* Beat detected in this frame */
+  if(rr_ms) {
+    meas_mngr_add_beat(hr_bpm, rr_ms);
+  }
+
+  /* New respiration rate in this frame */
+  if(resp & MEAS_RESP_RATE_REPORTED) {
+    meas_mngr_add_resp_rate(resp & ~MEAS_RESP_RATE_REPORTED);
+  }
+}
+#endif
+
+
+/*
+ * @brief Function to add a measurement to the Gama queue, counted in the MEAS_MNGR_FLOW_GAMA stage
+ * 
+ * @param[in] fields        Measurement
+ * @retval                  Returns true if the measurement was added, or false if it was dropped
+ */
+static bool _meas_mngr_queue(gama_measure_format_v2_fields_t *fields) {
+
+  flow_stats_produced(&_flow[MEAS_MNGR_FLOW_GAMA], 1, 0);
+  if(!measurements_v2_manager_add_measurement(fields)) {
+    flow_stats_dropped(&_flow[MEAS_MNGR_FLOW_GAMA], 1);
+    return false;
+  }
+  flow_stats_forwarded(&_flow[MEAS_MNGR_FLOW_GAMA], 1, 0);
+  return true;
+}
+
+
+#if MICROCONTROLER_2
+/*
+ * @brief Function to publish the flow statistics of a stage as diagnostic measurements
+ * 
+ * @param[in] stage         Stage, MEAS_MNGR_FLOW_RAM to MEAS_MNGR_FLOW_GAMA
+ * @param[in] stats         Statistics
+ * @note                    One measurement per value, with FLOW_STATS_SENSOR() as sensor
+ */
+static void _meas_mngr_add_flow_stats(uint8_t stage, const flow_stats *stats) {
+
+  uint32_t value;
+
+  gama_measure_format_v2_fields_t measurement_fields;
+  measurement_fields.measure_type = GAMA_MEASURE_ECG;
+  measurement_fields.config_byte = MEASURE_VALUE_UINT32_TYPE;
+  measurement_fields.val = &value;
+
+  for(uint8_t i = 0 ; i < FLOW_STATS_VALUES ; i++) {
+    value = flow_stats_get_value(stats, (flow_stats_value)i);
+    measurement_fields.sensor = FLOW_STATS_SENSOR(stage, i);
+    if(!measurements_v2_manager_add_measurement(&measurement_fields)) {
+      return;
+    }
+  }
+
+  debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
+  debug_printf_string(DEBUG_LEVEL_1, (uint8_t*)"[meas_mngr_add_flow_stats] Stage %d, produced: %lu, forwarded: %lu, dropped: %lu, latency mean: %lu ms, max: %lu ms, free min: %lu\n",
+                      stage, stats->produced, stats->forwarded, stats->dropped, flow_stats_get_value(stats, FLOW_STATS_LATENCY_MEAN),
+                      stats->latency_max, stats->free_min);
+}
+#endif
+
+
+/*
+ * @brief Function to publish the flow statistics of the stages of this MCU
+ * 
+ * @note                    MCU1 has no Gama queue, its RAM stage goes to MCU2 in a FLOW_STATS_TYPE record
+ */
+static void _meas_mngr_publish_diag(void) {
+
+#if MICROCONTROLER_1
+  _diag_record[0] = FLOW_STATS_TYPE;
+  flow_stats_to_array(&_flow[MEAS_MNGR_FLOW_RAM], MEAS_MNGR_FLOW_RAM, &_diag_record[1]);
+  meas_mngr_store_event(_diag_record, sizeof(_diag_record));
+#endif
+#if MICROCONTROLER_2
+  _meas_mngr_add_flow_stats(MEAS_MNGR_FLOW_RECORDS, &_flow[MEAS_MNGR_FLOW_RECORDS]);
+  _meas_mngr_add_flow_stats(MEAS_MNGR_FLOW_GAMA, &_flow[MEAS_MNGR_FLOW_GAMA]);
+#endif
+}
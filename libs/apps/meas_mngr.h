@@ -16,6 +16,10 @@
 /* Config */
 #include "config.h"
 
+/* Utilities */
+#include "cycle_counter.h"
+#include "flow_stats.h"
+
 /* Standard library */
 #include <stdint.h>
 #include <stdbool.h>
@@ -43,26 +47,61 @@ typedef struct {
 
 //}queue_struct;
 
+/* Callback for every record read from RAM, with its RAM_RECORD_xxx type */
+typedef void (*meas_mngr_record_callback_def)(uint8_t type, const uint8_t *payload, uint16_t length);
+
 /* App states */
 typedef enum {
   MEAS_MNGR_INITIALIZING,
   MEAS_MNGR_IDLE
 } meas_mngr_states;
 
+/* Stages of the measurements pipeline with flow statistics */
+typedef enum {
+  MEAS_MNGR_FLOW_RAM,           /* MCU1: records staged and written to RAM */
+  MEAS_MNGR_FLOW_RECORDS,       /* MCU2: records read from RAM, the missing sequence numbers as dropped */
+  MEAS_MNGR_FLOW_GAMA,          /* MCU2: measurements added to the Gama queue */
+  MEAS_MNGR_FLOW_STAGES
+} meas_mngr_flow_stage;
+
+/* Backpressure policy, for a record that does not fit in RAM */
+typedef enum {
+  MEAS_MNGR_DROP_NEWEST,        /* The record is dropped, the staged ones wait for room */
+  MEAS_MNGR_DROP_OLDEST,        /* The staged records are dropped to make room for the record */
+  MEAS_MNGR_DECIMATE,           /* The record is dropped, the producer keeps 1 in N of the next ones */
+  MEAS_MNGR_LOW_RATE            /* The record is dropped, the producer goes to a lower rate */
+} meas_mngr_policy;
+
+/* Callback asked for the policy, with the record type and size and the free bytes of RAM */
+typedef meas_mngr_policy (*meas_mngr_policy_def)(uint8_t type, uint16_t size, uint16_t free);
+
 #define MC_23k640_CS2           NRF_GPIO_PIN_MAP(0, 31)        /*  */
 
 /* Sequence */
 #define READ_RAM_THRESHOLD      8       /* Number of packets sent from MCU 1 */
 
-/* Sequence */
-#define ECG_SEQUENCE_SIZE       100     /* Maximum sequence buffer sizes */
-#define RAM_BUFFER_SIZE         500     /* Maximum sequence buffer sizes */
-#define SEQUENCE_ERROR          0xfafa  /* */
-
 #define RAM_THRESHOLD           320     /* */
 #define MAX_RAM_RETRIES         2       /* */
 
-#define UPLOAD_ECG_MEAS         MEAS_ECG_III    /* */
+/* Write combining, MCU1 stages the records and writes them to RAM in one burst */
+#define MEAS_MNGR_STAGE_SIZE        500     /* Staging buffer, up to MC_23K640_MAX_TRANSFER_SIZE */
+#define MEAS_MNGR_STAGE_RECORDS     8       /* Records staged before a flush */
+#define MEAS_MNGR_STAGE_DEADLINE_MS 20      /* Maximum time the oldest staged record waits for a flush */
+
+/* Records parser of MCU2, fits the largest record, a pace event, and a read from RAM */
+#define RAM_PARSER_BUFFER_SIZE      2048
+
+/* Drain of the RAM on MCU2, in meas_mngr_loop */
+#define MEAS_MNGR_DRAIN_CHUNK       500     /* Bytes per RAM read, up to MC_23K640_MAX_TRANSFER_SIZE */
+#define MEAS_MNGR_DRAIN_READS       2       /* RAM reads per loop, the rest waits for the next loops */
+#define MEAS_MNGR_ISR_BUDGET_US     10      /* Doorbell interrupt */
+#define MEAS_MNGR_DRAIN_BUDGET_US   2000    /* Drain of one loop */
+
+/* Flow statistics, published as diagnostic measurements */
+#define MEAS_MNGR_DIAG_PERIOD_MS    60000
+
+#define UPLOAD_ECG_MEAS         ECG_III         /* Field of MEASURES_SCHEMA */
+#define UPLOAD_ECG_DERIVED_LEAD ECG_LEADS_III   /* Same lead, rebuilt from leads I and II when ECG_STORE_DERIVED_LEADS is 0 */
 
 
 
@@ -91,9 +130,12 @@ extern const uint8_t GAMA_QUEUE_ADD_MAX_ATTEMPTS;               ///< Tells the m
 //#define ECG_QT_TYPE             21      /* Measure type that refers to QT segment duration data */
 //#define ECG_QRS_TYPE            22      /* Measure type that refers to QRS segment duration data */
 //#define ECG_AXIS_TYPE           23      /* Measure type that refers to axis data */
-//#define ECG_HR_TYPE             24      /* Measure type that refers to heart rate data */
-//#define ECG_RR_TYPE             25      /* Measure type that refers to respiratory  rate data */
+#define ECG_HR_TYPE             24      /* Measure type that refers to heart rate data */
+#define ECG_RR_TYPE             25      /* Measure type that refers to RR interval data */
 //#define ECG_LPWAN_RSSI_TYPE     26     /* Measure type that refers to RA lead data */
+#define RESP_RATE_TYPE          27      /* Measure type that refers to respiratory rate data */
+#define FLOW_STATS_TYPE_BASE    32      /* Measure types of the flow statistics, FLOW_STATS_VALUES per stage */
+#define FLOW_STATS_SENSOR(stage, value) (FLOW_STATS_TYPE_BASE + (stage) * FLOW_STATS_VALUES + (value))
 
 
 #define UPLOAD_DATA_ID          0       /* ID that tells the SD card driver where to store data */
@@ -105,6 +147,9 @@ extern const uint8_t GAMA_QUEUE_ADD_MAX_ATTEMPTS;               ///< Tells the m
 #define BATTERY_CHRG_ALERT      3       /* Battery charging detected */
 #define PACE_PULSE_ALERT        4       /* Pacemaker discharge detected */ 
 #define LEAD_OFF_ALERT          5       /* Lead off detected */
+#define TIMEBASE_ANCHOR_TYPE    6       /* Sample index to RTC ticks anchor of the ECG frames */
+#define ECG_BLOCK_TYPE          7       /* Block of ECG frames compressed with ecg_codec */
+#define FLOW_STATS_TYPE         8       /* Flow statistics of the RAM stage of MCU1, see flow_stats_to_array() */
 #define POWER_SAVING_TYPE       XX      /* Check Sensefinity value */
 #define HELLO_TYPE              XX      /* Check Sensefinity value */
 
@@ -115,9 +160,19 @@ extern const uint8_t GAMA_QUEUE_ADD_MAX_ATTEMPTS;               ///< Tells the m
 /********************************** Funções ***********************************/
 
 void meas_mngr_init(void);
-void meas_mngr_ecg_set_sequence(char *ecg_sequence[], uint16_t sequence_size);
 bool meas_mngr_store_ecg(uint8_t *data);
 bool meas_mngr_store_temp(uint8_t *data);
+bool meas_mngr_store_event(uint8_t *record, uint16_t size);
+bool meas_mngr_add_beat(uint16_t hr_bpm, uint16_t rr_ms);
+bool meas_mngr_add_resp_rate(uint16_t bpm);
+bool meas_mngr_flush(void);
+void meas_mngr_set_record_callback(meas_mngr_record_callback_def callback);
+cycle_counter_stats *meas_mngr_get_isr_stats(void);
+cycle_counter_stats *meas_mngr_get_drain_stats(void);
+void meas_mngr_set_policy(meas_mngr_policy_def policy);
+uint16_t meas_mngr_get_free_space(void);
+flow_stats *meas_mngr_get_flow_stats(meas_mngr_flow_stage stage);
+uint16_t meas_mngr_get_ecg_rate(void);
 void meas_mngr_loop(void);
 #endif /* MEASUREMENTS_MNGR_H_ */
 
@@ -29,6 +29,7 @@
 
 /* Utils */
 #include "sense_library/utils/utils.h"
+#include "fmt.h"
 
 /* C standard library */
 #include "math.h"
@@ -326,9 +327,8 @@ static void ads1114_readValue_cb(ret_code_t result, void *p_user_data) {
   _ads1114_data.voltage = ads1114_voltage_value (adc_result);                      /* Obter valor de tenso total */
 
   /* Converts charge voltage to string */
-  char voltage_string[10];
-  memset(voltage_string, '\0', 10);
-  utils_ftoa(voltage_string, _ads1114_data.voltage, 0.0001);
+  char voltage_string[FMT_FIXED_SIZE];
+  fmt_float(voltage_string, _ads1114_data.voltage, 4);
 
   //debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
   //debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[ads1114_readValue_cb] data collected; voltage = %sV \n", voltage_string);
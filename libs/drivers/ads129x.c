@@ -16,6 +16,8 @@
 
 /* Utilities */
 #include "spi_mngr.h"
+#include "cycle_counter.h"
+#include "spsc_ring.h"
 
 /* Pheriperals */
 #include "sense_library/periph/rtc.h"
@@ -25,9 +27,12 @@
 #include "sense_library/utils/utils.h"
 
 /* C standard library */
+#if ADS129X_CONVERSION_CHECK
 #include <math.h>
+#endif
 
 /* SDK */
+#include "app_util.h"
 #include "nrf_spi_mngr.h"
 #include "nrf_gpio.h"
 #include "nrf_drv_gpiote.h"
@@ -95,15 +100,96 @@ static bool _ads_state_standby;
 static bool _ads_state_start_sample;
 
 /*
- * Data structure to save raw data from ADS129x
+ * Storage of the raw frames ring
  */
-static ads129x_data _ads129x_data;
+static ads129x_data _ads129x_raw_buffer[ADS129X_RAW_RING_SIZE];
+
+#if ADS129X_DAISY_CHAIN
+/* The daisy-chain read fills the ADS1298 buffer and goes on into the ADS1296R buffer, and needs
+ * both devices in daisy-chain mode */
+STATIC_ASSERT(offsetof(ads129x_data, ads1296r_sw_buffer) == offsetof(ads129x_data, ads1298_sw_buffer) + ADS129X_SW_BUFFER_SIZE, "Buffers not contiguous");
+STATIC_ASSERT(ADS129X_DAISY_READ_SIZE <= 2 * ADS129X_SW_BUFFER_SIZE, "Daisy-chain read larger than the buffers");
+STATIC_ASSERT(!(ADS129X_CONFIG1_HP_VALUE & ADS129X_CONFIG1_MULTI_READBACK) && !(ADS129X_CONFIG1_LP_VALUE & ADS129X_CONFIG1_MULTI_READBACK), "CONFIG1 in multiple readback mode");
+#endif
+
+/*
+ * Ring of raw frames from ADS129x, filled by the SPI manager and emptied by ads129x_read_frames()
+ */
+static spsc_ring _raw_ring;
+
+/*
+ * Ring slot being read by the SPI manager
+ */
+static ads129x_data *_read_slot;
+
+/*
+ * Varivel que indica que existe uma leitura de frame em curso no SPI manager
+ */
+static volatile bool _read_pending;
+
+/*
+ * Number of frames lost because a read was still in transfer or the SPI read failed
+ */
+static volatile uint32_t _dropped_frames;
+
+/*
+ * Sequence number of the DRDY, incremented on every sample including the dropped ones
+ */
+static volatile uint32_t _sample_index;
+
+/*
+ * SPI transfers of each slot of the raw frames ring (ADS1298 and ADS1296R)
+ */
+static nrf_spi_mngr_transfer_t _read_transfers[ADS129X_RAW_RING_SIZE][ADS129X_READ_TRANSACTIONS];
+
+/*
+ * SPI transactions of each slot of the raw frames ring, the ADS1296R read is chained to the ADS1298 one
+ */
+static nrf_spi_mngr_transaction_t _read_transactions[ADS129X_RAW_RING_SIZE][ADS129X_READ_TRANSACTIONS];
+
+/*
+ * Frames left with the pace latch held in reset, counted down by the read of each frame
+ */
+static uint8_t _pace_rst_frames;
+
+/*
+ * Execution time statistics of the DRDY interrupt
+ */
+static cycle_counter_stats _isr_stats;
 
 /*
  * Data structure to return through the function ads129x_get_data()
  */
 static uint8_t _ads129x_data_upload[ADS129X_DATA_SIZE];
 
+/*
+ * Frame returned through the function ads129x_get_data()
+ */
+static ads129x_frame _ads129x_frame;
+
+/*
+ * Conversion scale of each channel in Q31 microvolts per LSB, updated only when the gains change
+ */
+static int32_t _ads129x_scale[ADS129X_CHANNELS];
+
+/*
+ * Source channel and offset in the meas_ecg_layout of each lead field, see ADS129X_CHANNEL_MAP
+ */
+static const uint8_t _map_channels[ADS129X_MAPPED_CHANNELS] = ADS129X_MAP_CHANNELS;
+static const uint16_t _map_offsets[ADS129X_MAPPED_CHANNELS] = ADS129X_MAP_OFFSETS;
+
+/* Every lead field of MEASURES_SCHEMA, the 4-byte fields from ECG_I to the vital signs, has exactly
+ * one source channel: as many fields as entries, each field once, and no channel used twice */
+#define ADS129X_X_FIELD_SIZE(field, channel)  + sizeof(((meas_ecg_layout *)0)->field)
+#define ADS129X_X_FIELD_BIT(field, channel)   + (1UL << ((MEAS_ECG_OFFSET(field) - MEAS_ECG_OFFSET(ECG_I)) / ADS129X_4BYTE))
+#define ADS129X_X_CHANNEL_SUM(field, channel) + (1UL << (channel))
+#define ADS129X_X_CHANNEL_OR(field, channel)  | (1UL << (channel))
+STATIC_ASSERT(ADS129X_MAPPED_CHANNELS * ADS129X_4BYTE == ADS129X_DATA_SIZE - MEAS_ECG_OFFSET(ECG_I), "Lead fields without a channel");
+STATIC_ASSERT((0 ADS129X_CHANNEL_MAP(ADS129X_X_FIELD_SIZE)) == ADS129X_MAPPED_CHANNELS * ADS129X_4BYTE, "Lead field not of 4 bytes");
+STATIC_ASSERT((0 ADS129X_CHANNEL_MAP(ADS129X_X_FIELD_BIT)) == (1UL << ADS129X_MAPPED_CHANNELS) - 1, "Lead field with two channels");
+STATIC_ASSERT((0 ADS129X_CHANNEL_MAP(ADS129X_X_CHANNEL_SUM)) == (0 ADS129X_CHANNEL_MAP(ADS129X_X_CHANNEL_OR)), "Channel in two lead fields");
+STATIC_ASSERT((0 ADS129X_CHANNEL_MAP(ADS129X_X_CHANNEL_OR)) < (1UL << ADS129X_CHANNELS), "Channel out of the frames");
+
 /*
 * Varivel do estado de lead_off 
 */
@@ -126,12 +212,28 @@ static bool _test_mode;
 
 /* SPI callback functions list */
 void ads129x_data_ready_cb(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+#if ADS129X_DAISY_CHAIN
+void _ads129x_read_daisy_begin_cb(void *p_user_data);
+void _ads129x_read_daisy_end_cb(ret_code_t result, void *p_user_data);
+#else
+void _ads129x_read_begin_cb(void *p_user_data);
+void _ads129x_read_8_end_cb(ret_code_t result, void *p_user_data);
+void _ads129x_read_6r_end_cb(ret_code_t result, void *p_user_data);
+#endif
 
 /* Private functions list */
-static bool _ads129x_cmd_getstatus(uint8_t next_status, uint8_t actual_status, uint8_t failed_status, uint64_t timeout);
 bool _ads129x_configs(bool accuracy, bool lead_off, uint8_t pga_gain, uint8_t resp_gain, uint8_t ads129x, uint8_t test_mode);
 bool _ads129x_read(void);
-void _ads129x_get_voltage(void);
+void _ads129x_stamp(ads129x_data *raw);
+void _ads129x_read_pipeline_init(void);
+void _ads129x_get_voltage(ads129x_data *raw, ads129x_frame *frame);
+uint8_t _ads129x_get_pace(const ads129x_data *raw);
+void _ads129x_pace_rearm(const ads129x_data *raw);
+void _ads129x_update_scale(void);
+int32_t _ads129x_get_scale(uint8_t gain);
+#if ADS129X_CONVERSION_CHECK
+void _ads129x_check_conversion(uint32_t value_raw, uint8_t gain, int32_t uvoltage);
+#endif
 uint32_t _ads129x_utils_get_uint32_from_array_of_16bit(uint8_t *array);
 bool _ads129x_standby(void);
 
@@ -173,8 +275,7 @@ bool ads129x_init(void) {
       uint32_t err_code = nrf_drv_gpiote_in_init(ADS129X_DRDY_PIN, &in_config, ads129x_data_ready_cb);
 
       /* Inicializao dos pinos de ambos ADS129x */
-      ads129x_pace_rst(true);                                                       /* Resetar Latch do Pace Detection */
-      ads129x_pace_rst(false);
+      ads129x_pace_rst(true);                                                       /* Latch do Pace Detection em reset at ao incio da amostragem */
       nrf_gpio_pin_clear(ADS129X_8_CS_PIN);                                         /* Manter os CS PINS a low no "Power-Up */
       nrf_gpio_pin_clear(ADS129X_6R_CS_PIN);
 
@@ -190,9 +291,12 @@ bool ads129x_init(void) {
       _ads_state_standby = false;
       _ads_state_start_sample = false;
       _lead_off = false;
-      _ecg_gain = ADS129X_CHNSET_GAIN1;
-      _resp_gain = ADS129X_CHNSET_GAIN1;
+      _ecg_gain = ADS129X_GAIN1;
+      _resp_gain = ADS129X_GAIN1;
       _test_mode = false;
+      _ads129x_update_scale();
+      cycle_counter_init();
+      cycle_counter_stats_init(&_isr_stats, CYCLE_COUNTER_US_TO_CYCLES(ADS129X_ISR_BUDGET_US));
             
       debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds()); 
       debug_print_string(DEBUG_LEVEL_0, (uint8_t*)"[ads129x_init] ADS129X_INIT_CONFIG_ST done \n");
@@ -403,14 +507,6 @@ bool ads129x_init(void) {
  */
 bool ads129x_configs(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain, uint8_t test_mode) {
   
-  /* Update internal variables */
-  if(!test_mode) {
-    _lead_off = lead_off;
-    _ecg_gain = ecg_gain;
-    _resp_gain = resp_gain;
-  }
-  _test_mode = test_mode;
-  
   if(_ads129x_state_init) {                                                         /* Preveno de execuo caso a ads129x_init_loop no esteja finalizada */
     
     /* Configurao do ADS1298 com base nos parametros de entrada */
@@ -425,6 +521,15 @@ bool ads129x_configs(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t res
   } else {
     return false;
   }
+
+  /* Update internal variables, only once the devices have the config */
+  if(!test_mode) {
+    _lead_off = lead_off;
+    _ecg_gain = ecg_gain;
+    _resp_gain = resp_gain;
+  }
+  _test_mode = test_mode;
+  _ads129x_update_scale();
   
   /* Colocar ADS129x em standby */
   if(!_ads129x_standby()) {
@@ -444,7 +549,7 @@ bool ads129x_configs(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t res
  */
 uint8_t ads129x_start_sample(void) {
   
-  uint64_t timestamp_wakeup;
+  static uint64_t timestamp_wakeup = 0;                                           /* Kept between the calls of the loop */
 
   /* Preveno de execuo caso a ads129x_configs no esteja finalizada */
   if(_ads_state_standby) {  
@@ -545,7 +650,8 @@ bool ads129x_start_datac(void) {
     return false;      
   }
   nrf_gpio_pin_set(ADS129X_6R_CS_PIN);
-    
+  
+  _ads129x_read_pipeline_init();                                                  /* Descartar frames de amostragens anteriores */
   nrf_drv_gpiote_in_event_enable(ADS129X_DRDY_PIN, true);                         /* Permitir interrupes para Data Ready pin */  
   return true;   
 
@@ -553,15 +659,75 @@ bool ads129x_start_datac(void) {
 
 
 /* 
- * @brief Function that returns the data structure 
+ * @brief Function that converts the oldest frame read from ADS129x and returns the data structure
  *
- * @return                Returns the data structure pointer
+ * @return                Returns the data structure pointer, or NULL if there is no new frame
+ * @note                  Must be called from the main loop, the conversion is not done in interrupt context
  */
 uint8_t *ads129x_get_data(void) {
+
+  if(!ads129x_read_frames(&_ads129x_frame, 1)) {
+    return NULL;
+  }
+
+  ads129x_frame_to_array(&_ads129x_frame, _ads129x_data_upload);
   return _ads129x_data_upload;
 }
 
 
+/* 
+ * @brief Function that converts up to max frames read from ADS129x, oldest first
+ *
+ * @param[out] frames     Array with room for max frames
+ * @param[in] max         Maximum number of frames to read
+ * @return                Returns the number of frames read
+ * @note                  Must be called from the main loop, the conversion is not done in interrupt context.
+ *                        Frames are timed by their sample index, every ADS129X_ANCHOR_PERIOD samples a frame
+ *                        carries the RTC ticks of its DRDY for the timebase
+ */
+uint16_t ads129x_read_frames(ads129x_frame *frames, uint16_t max) {
+
+  uint16_t count = 0;
+  ads129x_data *raw;
+
+  while(count < max && (raw = spsc_ring_read_slot(&_raw_ring)) != NULL) {
+    _ads129x_get_voltage(raw, &frames[count]);
+    spsc_ring_release(&_raw_ring);                                                /* Give back the slot to the SPI manager */
+    count++;
+  }
+
+  return count;
+}
+
+
+/* 
+ * @brief Function to get the number of frames waiting to be read
+ *
+ * @return                Returns the number of frames in the raw frames ring
+ */
+uint16_t ads129x_get_frames_count(void) {
+  return spsc_ring_count(&_raw_ring);
+}
+
+
+/* 
+ * @brief Function to serialize a frame in the meas_ecg_layout of MEASURES_SCHEMA
+ *
+ * @param[in] frame       Frame to serialize
+ * @param[out] array      Destination array with ADS129X_DATA_SIZE bytes
+ */
+void ads129x_frame_to_array(const ads129x_frame *frame, uint8_t *array) {
+
+  utils_save_uint32_t_to_array(&array[MEAS_ECG_OFFSET(SAMPLE_INDEX)], frame->sample);
+  memcpy(&array[MEAS_ECG_OFFSET(ECG_LOFF_LA)], frame->lead_off, ADS129X_ELECT_NUMB - 1);
+  array[MEAS_ECG_OFFSET(ECG_PACE)] = frame->pace;
+
+  for(uint8_t i = 0 ; i < ADS129X_MAPPED_CHANNELS ; i++) {
+    utils_save_uint32_t_to_array(&array[_map_offsets[i]], (uint32_t)frame->channels[_map_channels[i]]);
+  }
+}
+
+
 /*
  * @brief Function to stop data continous mode of ADS1296R and ADS1298 in data continous mode        
  *
@@ -628,14 +794,6 @@ bool ads129x_stop_datac(void) {
  */
 bool ads129x_user_configs(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain, uint8_t test_mode) {
 
-  /* Update internal variables */
-  if(!test_mode) {
-    _lead_off = lead_off;
-    _ecg_gain = ecg_gain;
-    _resp_gain = resp_gain;
-  }
-  _test_mode = test_mode;
-
   /* Preveno de execuo caso a ads129x_stop_datac no esteja finalizada */
   if(_ads_state_standby) { 
     
@@ -648,6 +806,15 @@ bool ads129x_user_configs(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_
     if(!_ads129x_configs(accuracy, lead_off, ecg_gain, resp_gain, ADS129X_6R, test_mode)) {
       return false;
     } 
+
+    /* Update internal variables, only once the devices have the config */
+    if(!test_mode) {
+      _lead_off = lead_off;
+      _ecg_gain = ecg_gain;
+      _resp_gain = resp_gain;
+    }
+    _test_mode = test_mode;
+    _ads129x_update_scale();
     return true;
   }
   return false;
@@ -673,6 +840,92 @@ void ads129x_pace_rst(bool state) {
 }
 
 
+/*
+ * @brief Function to get the number of frames lost since the last start of sampling
+ *
+ * @return                  Returns the number of frames not read or not converted in time
+ */
+uint32_t ads129x_get_dropped_frames(void) {
+  return _dropped_frames + spsc_ring_get_overruns(&_raw_ring);
+}
+
+
+/*
+ * @brief Function to get the number of frames lost because the consumer was late
+ *
+ * @return                  Returns the overruns of the raw frames ring
+ */
+uint32_t ads129x_get_overruns(void) {
+  return spsc_ring_get_overruns(&_raw_ring);
+}
+
+
+/*
+ * @brief Function to get the execution time statistics of the DRDY interrupt
+ *
+ * @return                  Returns the pointer to the statistics structure
+ * @note                    Only the interrupts that scheduled the reads of a frame, the dropped frames are counted apart
+ */
+cycle_counter_stats *ads129x_get_isr_stats(void) {
+  return &_isr_stats;
+}
+
+
+#if ADS129X_REPLAY
+/*
+ * @brief Function to start a replay of recorded frames, the ADS129x are not used
+ *
+ * @param[in] lead_off      True if the recording has the lead-off status
+ * @param[in] ecg_gain      ECG gain of the recording, must be 1,2,3,4,6,8 or 12
+ * @param[in] resp_gain     RESP gain of the recording, must be 1,2,3,4,6,8 or 12
+ * @note                    Empties the raw frames ring and restarts the sample index, as ads129x_start_datac()
+ */
+void ads129x_replay_start(bool lead_off, uint8_t ecg_gain, uint8_t resp_gain) {
+
+  _lead_off = lead_off;
+  _ecg_gain = ecg_gain;
+  _resp_gain = resp_gain;
+  _test_mode = false;
+  _ads129x_update_scale();
+
+  cycle_counter_stats_init(&_isr_stats, CYCLE_COUNTER_US_TO_CYCLES(ADS129X_ISR_BUDGET_US));
+  _ads129x_read_pipeline_init();
+
+}
+
+
+/*
+ * @brief Function to add one recorded frame as if it was read at a DRDY
+ *
+ * @param[in] frame         ADS129X_REPLAY_FRAME_SIZE bytes, ADS1298 data followed by ADS1296R data as read from the devices
+ * @retval                  Returns true if the frame was added, or false if the raw frames ring is full
+ * @note                    Same sample index, anchors and raw frames ring as the DRDY reads, so the frames go through
+ *                          the real conversion and ads129x_get_isr_stats(). Unlike a DRDY, a frame that does not fit
+ *                          is not consumed, it must be fed again so the recording is replayed without gaps
+ */
+bool ads129x_replay_feed(const uint8_t *frame) {
+
+  uint32_t start = cycle_counter_get();
+  ads129x_data *slot;
+
+  if(!spsc_ring_free(&_raw_ring)) {                     /* Not an overrun, the frame is fed again */
+    return false;
+  }
+  slot = spsc_ring_write_slot(&_raw_ring);
+
+  memcpy(slot->ads1298_sw_buffer, frame, ADS129X_SW_BUFFER_SIZE);
+  memcpy(slot->ads1296r_sw_buffer, &frame[ADS129X_SW_BUFFER_SIZE], ADS129X_SW_BUFFER_SIZE);
+  _ads129x_stamp(slot);
+  spsc_ring_commit(&_raw_ring);
+  _sample_index++;
+
+  cycle_counter_stats_add(&_isr_stats, start);
+  return true;
+
+}
+#endif
+
+
 /*
  * @brief Function to set or clear reset pin of pace latch
  *
@@ -695,19 +948,108 @@ void ads129x_uninit(void) {
  */
 void ads129x_data_ready_cb(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
 
+  uint32_t start = cycle_counter_get();
+
   if(pin != ADS129X_DRDY_PIN || action != NRF_GPIOTE_POLARITY_HITOLO) {
     return;
   }
 
-  uint8_t read_reg_status = _ads129x_read();                                         /* Read Output register from both ADS129x */
-  if(!read_reg_status) {
-    debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-    debug_print_string(DEBUG_LEVEL_0, (uint8_t*)"[ads129x_data_ready_cb] Erro no acesso de leitura do ADS129x \r\n");     
+  if(!_ads129x_read()) {                                                             /* Schedule read of Output register from both ADS129x */
+    _dropped_frames++;
+    _sample_index++;
+    return;                                                                          /* Not timed, only the reads scheduled are */
   }
+  _sample_index++;
+
+  cycle_counter_stats_add(&_isr_stats, start);
 
 }
 
 
+#if ADS129X_DAISY_CHAIN
+/*
+ * @brief Function called by the SPI manager before a daisy-chain frame read, asserts both chip selects
+ *
+ * @param[in] p_user_data   Not used
+ */
+void _ads129x_read_daisy_begin_cb(void *p_user_data) {
+  nrf_gpio_pin_clear(ADS129X_8_CS_PIN);
+  nrf_gpio_pin_clear(ADS129X_6R_CS_PIN);
+}
+
+
+/*
+ * @brief Function called by the SPI manager after a daisy-chain frame read, publishes the raw frame
+ *
+ * @param[in] result        Result of the transaction
+ * @param[in] p_user_data   Not used
+ */
+void _ads129x_read_daisy_end_cb(ret_code_t result, void *p_user_data) {
+
+  nrf_gpio_pin_set(ADS129X_8_CS_PIN);
+  nrf_gpio_pin_set(ADS129X_6R_CS_PIN);
+
+  if(result == NRF_SUCCESS) {
+    _ads129x_pace_rearm(_read_slot);
+    spsc_ring_commit(&_raw_ring);                                                    /* Publish the frame to the consumer */
+  } else {
+    _dropped_frames++;
+  }
+  _read_pending = false;
+
+}
+#else
+/*
+ * @brief Function called by the SPI manager before a frame read, asserts the device chip select
+ *
+ * @param[in] p_user_data   Chip select pin of the device to read
+ */
+void _ads129x_read_begin_cb(void *p_user_data) {
+  nrf_gpio_pin_clear((uint32_t)(uintptr_t)p_user_data);
+}
+
+
+/*
+ * @brief Function called by the SPI manager after the ADS1298 read, chains the ADS1296R read
+ *
+ * @param[in] result        Result of the ADS1298 transaction
+ * @param[in] p_user_data   Chip select pin of the ADS1298
+ */
+void _ads129x_read_8_end_cb(ret_code_t result, void *p_user_data) {
+
+  nrf_gpio_pin_set((uint32_t)(uintptr_t)p_user_data);
+
+  if(result != NRF_SUCCESS ||
+     nrf_spi_mngr_schedule(_p_nrf_spi_mngr, &_read_transactions[_read_slot - _ads129x_raw_buffer][1]) != NRF_SUCCESS) {
+    _dropped_frames++;
+    _read_pending = false;
+  }
+
+}
+
+
+/*
+ * @brief Function called by the SPI manager after the ADS1296R read, publishes the raw frame
+ *
+ * @param[in] result        Result of the ADS1296R transaction
+ * @param[in] p_user_data   Chip select pin of the ADS1296R
+ */
+void _ads129x_read_6r_end_cb(ret_code_t result, void *p_user_data) {
+
+  nrf_gpio_pin_set((uint32_t)(uintptr_t)p_user_data);
+
+  if(result == NRF_SUCCESS) {
+    _ads129x_pace_rearm(_read_slot);
+    spsc_ring_commit(&_raw_ring);                                                    /* Publish the frame to the consumer */
+  } else {
+    _dropped_frames++;
+  }
+  _read_pending = false;
+
+}
+#endif
+
+
 /********************************** Private ************************************/
 /*
  * @brief Function to set ADS129x registers values for specific config
@@ -842,158 +1184,288 @@ bool _ads129x_configs(bool accuracy, bool lead_off, uint8_t pga_gain, uint8_t re
  * @brief Function to schedule Status Word read data for ADS1298 and ADS1296R
  *
  * @retval                  Returns true if the read schedule is successfull, or false otherwise
+ * @note                    Called in the DRDY interrupt, only schedules the read. In daisy-chain mode both
+ *                          devices are read in one transfer, otherwise the ADS1296R read is chained in
+ *                          _ads129x_read_8_end_cb(). The conversion is done later by ads129x_read_frames()
  */
 bool _ads129x_read(void) {
 
-  static uint8_t buffer[ADS129X_SW_BUFFER_SIZE] = "\0";
- 
-  /* Formalizar transferncias para SPI manager */
-  static nrf_spi_mngr_transfer_t const transfers[] = 
-  {
-    ADS129X_TRANSFER(NULL, 0, _ads129x_data.ads1298_sw_buffer, ADS129X_SW_BUFFER_SIZE),   /* ADS1298 */
-    ADS129X_TRANSFER(NULL, 0, _ads129x_data.ads1296r_sw_buffer, ADS129X_SW_BUFFER_SIZE),  /* ADS1296R */
-  };  
-  
-  /* Get data from ADS1298 */
-  nrf_gpio_pin_clear(ADS129X_8_CS_PIN);
-  if(nrf_spi_mngr_perform(_p_nrf_spi_mngr, NULL, &transfers[0], 1, NULL) != NRF_SUCCESS) {       
-    debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-    debug_print_string(DEBUG_LEVEL_0, (uint8_t*)"[_ads129x_read] Get data from ADS1298 error\n");
-    return false;      
+  /* Previous frame still in transfer, the output registers were already overwritten */
+  if(_read_pending) {
+    return false;
   }
-  nrf_gpio_pin_set(ADS129X_8_CS_PIN);
 
-  /* Get data from ADS1296R */
-  nrf_gpio_pin_clear(ADS129X_6R_CS_PIN);
-  if(nrf_spi_mngr_perform(_p_nrf_spi_mngr, NULL, &transfers[1], 1, NULL) != NRF_SUCCESS) {     
-    debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-    debug_print_string(DEBUG_LEVEL_0, (uint8_t*)"[_ads129x_read] Get data from ADS1296R error\n");
-    return false;      
+  /* Ring full, the consumer is late (counted as overrun by the ring) */
+  _read_slot = spsc_ring_write_slot(&_raw_ring);
+  if(_read_slot == NULL) {
+    return true;
   }
-  nrf_gpio_pin_set(ADS129X_6R_CS_PIN);
-  
-  _ads129x_data.timestamp = rtc_get_milliseconds();
 
-  _ads129x_get_voltage();
+  _ads129x_stamp(_read_slot);
+  _read_pending = true;
+
+  if(nrf_spi_mngr_schedule(_p_nrf_spi_mngr, &_read_transactions[_read_slot - _ads129x_raw_buffer][0]) != NRF_SUCCESS) {
+    _read_pending = false;
+    return false;
+  }
   return true;
 
 }
 
+
 /*
- * @brief Function to convert data from ADS1298 and ADS1296R to voltage
+ * @brief Function to set the sample index of a raw frame, and the RTC ticks on the anchors
  *
+ * @param[in] raw           Raw frame of the current DRDY
+ * @note                    The sample index gives the time, the RTC is only read every ADS129X_ANCHOR_PERIOD samples
  */
-void _ads129x_get_voltage(void) {
-  
-  uint32_t value_raw;
-  float lsb;
-  float voltage;
-  uint16_t addr = ADS129X_DATA_IDX;      
-  uint8_t actual_gain;
-  uint32_t uvoltage;
+void _ads129x_stamp(ads129x_data *raw) {
 
-  /* Get Updated Gain */
-  if(_test_mode) {
-    actual_gain = ADS129X_CHNSET_TEST_SIG_GAIN;
-  } else {
-    actual_gain = _ecg_gain;
+  raw->sample = _sample_index;
+  raw->anchor = !(_sample_index & (ADS129X_ANCHOR_PERIOD - 1));
+  if(raw->anchor) {
+    raw->anchor_ticks = rtc_get_ticks();
   }
+
+}
+
+
+/*
+ * @brief Function to prepare the SPI transactions of every raw frames ring slot and empty the ring
+ *
+ * @note                    Must be called with the DRDY interrupt disabled
+ */
+void _ads129x_read_pipeline_init(void) {
+
+  for(uint8_t slot = 0 ; slot < ADS129X_RAW_RING_SIZE ; slot++) {
+
+    #if ADS129X_DAISY_CHAIN
+    /* Formalizar transferncia para SPI manager, ADS1298 data followed by ADS1296R data */
+    nrf_spi_mngr_transfer_t transfer = ADS129X_TRANSFER(NULL, 0, _ads129x_raw_buffer[slot].ads1298_sw_buffer, ADS129X_DAISY_READ_SIZE);
+    _read_transfers[slot][0] = transfer;
+
+    _read_transactions[slot][0].begin_callback = _ads129x_read_daisy_begin_cb;
+    _read_transactions[slot][0].callback = _ads129x_read_daisy_end_cb;
+    _read_transactions[slot][0].p_user_data = NULL;
+    _read_transactions[slot][0].p_transfers = &_read_transfers[slot][0];
+    _read_transactions[slot][0].number_of_transfers = 1;
+    _read_transactions[slot][0].p_required_spi_cfg = NULL;
+    #else
+    /* Formalizar transferncias para SPI manager */
+    nrf_spi_mngr_transfer_t transfer_8 = ADS129X_TRANSFER(NULL, 0, _ads129x_raw_buffer[slot].ads1298_sw_buffer, ADS129X_SW_BUFFER_SIZE);
+    nrf_spi_mngr_transfer_t transfer_6r = ADS129X_TRANSFER(NULL, 0, _ads129x_raw_buffer[slot].ads1296r_sw_buffer, ADS129X_SW_BUFFER_SIZE);
+    _read_transfers[slot][0] = transfer_8;
+    _read_transfers[slot][1] = transfer_6r;
+
+    /* ADS1298 transaction */
+    _read_transactions[slot][0].begin_callback = _ads129x_read_begin_cb;
+    _read_transactions[slot][0].callback = _ads129x_read_8_end_cb;
+    _read_transactions[slot][0].p_user_data = (void *)(uintptr_t)ADS129X_8_CS_PIN;
+    _read_transactions[slot][0].p_transfers = &_read_transfers[slot][0];
+    _read_transactions[slot][0].number_of_transfers = 1;
+    _read_transactions[slot][0].p_required_spi_cfg = NULL;
+
+    /* ADS1296R transaction */
+    _read_transactions[slot][1].begin_callback = _ads129x_read_begin_cb;
+    _read_transactions[slot][1].callback = _ads129x_read_6r_end_cb;
+    _read_transactions[slot][1].p_user_data = (void *)(uintptr_t)ADS129X_6R_CS_PIN;
+    _read_transactions[slot][1].p_transfers = &_read_transfers[slot][1];
+    _read_transactions[slot][1].number_of_transfers = 1;
+    _read_transactions[slot][1].p_required_spi_cfg = NULL;
+    #endif
+  }
+
+  spsc_ring_init(&_raw_ring, _ads129x_raw_buffer, sizeof(ads129x_data), ADS129X_RAW_RING_SIZE);
+  ads129x_pace_rst(false);
+  _pace_rst_frames = 0;
+  _read_pending = false;
+  _dropped_frames = 0;
+  _sample_index = 0;
+
+}
+
+/*
+ * @brief Function to convert data from ADS1298 and ADS1296R to voltage
+ *
+ * @param[in] raw           Raw frame read from both ADS129x
+ * @param[out] frame        Converted frame
+ */
+void _ads129x_get_voltage(ads129x_data *raw, ads129x_frame *frame) {
+  
+  uint8_t *value_raw;
     
-  /* Update Timestamp */
-  utils_save_uint64_t_to_array_keep_endianness(&_ads129x_data_upload[0], _ads129x_data.timestamp);
+  /* Update sample index and anchor */
+  frame->sample = raw->sample;
+  frame->anchor = raw->anchor;
+  frame->anchor_ticks = raw->anchor_ticks;
 
   /* Verify Identifier */
-  if(!ADS129X_VERIFY_DATA_ID(_ads129x_data.ads1298_sw_buffer[0]) || !ADS129X_VERIFY_DATA_ID(_ads129x_data.ads1296r_sw_buffer[0])) {
+  if(!ADS129X_VERIFY_DATA_ID(raw->ads1298_sw_buffer[0]) || !ADS129X_VERIFY_DATA_ID(raw->ads1296r_sw_buffer[0])) {
     debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
     debug_print_string(DEBUG_LEVEL_0, (uint8_t*)"[_ads129x_get_voltage] Measure ID invalid \n");
   }
   
   if(_lead_off) {
     /* Update LOFF status */
-    _ads129x_data_upload[ADS129X_STAT_IDX] = IS_SET(_ads129x_data.ads1298_sw_buffer[1], ADS129X_LA_BIT);
-    _ads129x_data_upload[ADS129X_STAT_IDX + 1] = IS_SET(_ads129x_data.ads1298_sw_buffer[2], ADS129X_RA_BIT);
-    _ads129x_data_upload[ADS129X_STAT_IDX + 2] = IS_SET(_ads129x_data.ads1298_sw_buffer[1], ADS129X_LL_BIT);
-    _ads129x_data_upload[ADS129X_STAT_IDX + 3] = IS_SET(_ads129x_data.ads1298_sw_buffer[1], ADS129X_V1_BIT);
-    _ads129x_data_upload[ADS129X_STAT_IDX + 4] = IS_SET(_ads129x_data.ads1298_sw_buffer[0], ADS129X_V2_BIT);
-    _ads129x_data_upload[ADS129X_STAT_IDX + 5] = IS_SET(_ads129x_data.ads1298_sw_buffer[1], ADS129X_V3_BIT);
-    _ads129x_data_upload[ADS129X_STAT_IDX + 6] = IS_SET(_ads129x_data.ads1298_sw_buffer[1], ADS129X_V4_BIT);
-    _ads129x_data_upload[ADS129X_STAT_IDX + 7] = IS_SET(_ads129x_data.ads1298_sw_buffer[1], ADS129X_V5_BIT); 
-    _ads129x_data_upload[ADS129X_STAT_IDX + 8] = IS_SET(_ads129x_data.ads1298_sw_buffer[0], ADS129X_V6_BIT);
+    frame->lead_off[0] = IS_SET(raw->ads1298_sw_buffer[1], ADS129X_LA_BIT);
+    frame->lead_off[1] = IS_SET(raw->ads1298_sw_buffer[2], ADS129X_RA_BIT);
+    frame->lead_off[2] = IS_SET(raw->ads1298_sw_buffer[1], ADS129X_LL_BIT);
+    frame->lead_off[3] = IS_SET(raw->ads1298_sw_buffer[1], ADS129X_V1_BIT);
+    frame->lead_off[4] = IS_SET(raw->ads1298_sw_buffer[0], ADS129X_V2_BIT);
+    frame->lead_off[5] = IS_SET(raw->ads1298_sw_buffer[1], ADS129X_V3_BIT);
+    frame->lead_off[6] = IS_SET(raw->ads1298_sw_buffer[1], ADS129X_V4_BIT);
+    frame->lead_off[7] = IS_SET(raw->ads1298_sw_buffer[1], ADS129X_V5_BIT); 
+    frame->lead_off[8] = IS_SET(raw->ads1298_sw_buffer[0], ADS129X_V6_BIT);
   } else {
-    memset(&_ads129x_data_upload[ADS129X_STAT_IDX], 0, ADS129X_ELECT_NUMB - 1);
+    memset(frame->lead_off, 0, ADS129X_ELECT_NUMB - 1);
   }
   
   /* Update Pace Detection Status based on the hardware jumper */
-  if(ADS129X_PACE_DEVICE == ADS129X_8) {
-    _ads129x_data_upload[ADS129X_STAT_IDX + 9] = IS_SET(_ads129x_data.ads1298_sw_buffer[2], ADS129X_PACE_BIT);
-  } else {
-    _ads129x_data_upload[ADS129X_STAT_IDX + 9] = IS_SET(_ads129x_data.ads1296r_sw_buffer[2], ADS129X_PACE_BIT);
-  }      
+  frame->pace = _ads129x_get_pace(raw);
   
   /* Convert data of ADS1298 */
-  for(int idx = ADS129X_CH1_IDX ; idx < ADS129X_8_SW_BUFFER_SIZE + 1 ; idx+=ADS129X_3BYTE) {
+  value_raw = &raw->ads1298_sw_buffer[ADS129X_CH1_IDX];
+  for(uint8_t ch = 0 ; ch < ADS129X_8_CHANNELS ; ch++) {
+    frame->channels[ch] = ADS129X_CONVERT_UV(_ads129x_utils_get_uint32_from_array_of_16bit(value_raw), _ads129x_scale[ch]);
+    value_raw += ADS129X_3BYTE;
+  }
 
-    value_raw = _ads129x_utils_get_uint32_from_array_of_16bit(&_ads129x_data.ads1298_sw_buffer[idx]);
-    lsb = ((2*(float)ADS129X_REF)/(float)actual_gain)/(float)(pow(2, ADS129X_RES) - 1);
-    
-    /* Verificar se a medida  negativa */
-    if(ADS129X_VERIFY_POL(value_raw)) {
-      voltage = (value_raw - pow(2, ADS129X_RES)) * lsb;
-    } else {
-      voltage = value_raw * lsb;
-    }
-    
-    #if ADS129X_MEAS_DEBUG
-    /* Converts charge voltage to string */
-    char voltage_string[10];
-    memset(voltage_string, '\0', 10);
-    utils_ftoa(voltage_string, (float)voltage * 1000, 0.00000001);
+  /* Convert data of ADS1296R */
+  value_raw = &raw->ads1296r_sw_buffer[ADS129X_CH1_IDX];
+  for(uint8_t ch = ADS129X_8_CHANNELS ; ch < ADS129X_CHANNELS ; ch++) {
+    frame->channels[ch] = ADS129X_CONVERT_UV(_ads129x_utils_get_uint32_from_array_of_16bit(value_raw), _ads129x_scale[ch]);
+    value_raw += ADS129X_3BYTE;
+  }
 
+  #if ADS129X_MEAS_DEBUG
+  for(uint8_t ch = 0 ; ch < ADS129X_CHANNELS ; ch++) {
     debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-    debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[_ads129x_get_voltage] Measure converted ADS1298: %s\n", voltage_string);
-    #endif
+    debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[_ads129x_get_voltage] Measure converted channel %d: %ld uV\n", ch, frame->channels[ch]);
+  }
+  #endif
 
-    /* Upload to array */    
-    uvoltage = voltage*ADS129x_INTEGER_CONVERT;
-    utils_save_uint32_t_to_array(&_ads129x_data_upload[addr], uvoltage);    
-    addr += ADS129X_4BYTE;
+  #if ADS129X_CONVERSION_CHECK
+  value_raw = &raw->ads1298_sw_buffer[ADS129X_CH1_IDX];
+  for(uint8_t ch = 0 ; ch < ADS129X_8_CHANNELS ; ch++, value_raw += ADS129X_3BYTE) {
+    _ads129x_check_conversion(_ads129x_utils_get_uint32_from_array_of_16bit(value_raw), (_test_mode ? ADS129X_CHNSET_TEST_SIG_GAIN : _ecg_gain), frame->channels[ch]);
   }
+  value_raw = &raw->ads1296r_sw_buffer[ADS129X_CH1_IDX];
+  for(uint8_t ch = ADS129X_8_CHANNELS ; ch < ADS129X_CHANNELS ; ch++, value_raw += ADS129X_3BYTE) {
+    _ads129x_check_conversion(_ads129x_utils_get_uint32_from_array_of_16bit(value_raw), (ch == ADS129X_RESP_CHANNEL ? _resp_gain : (_test_mode ? ADS129X_CHNSET_TEST_SIG_GAIN : _ecg_gain)), frame->channels[ch]);
+  }
+  #endif
 
-  /* Convert data of ADS1296R */
-  for(int idx = ADS129X_CH1_IDX ; idx < ADS129X_6R_SW_BUFFER_SIZE ; idx+=ADS129X_3BYTE) {
+}
 
-    value_raw = _ads129x_utils_get_uint32_from_array_of_16bit(&_ads129x_data.ads1296r_sw_buffer[idx]);
-    
-    if(addr == ADS129X_CH1_IDX) {
-      lsb = ((2*(float)ADS129X_REF)/(float)_resp_gain)/(float)(pow(2, ADS129X_RES) - 1);
-    } else {
-      lsb = ((2*(float)ADS129X_REF)/(float)actual_gain)/(float)(pow(2, ADS129X_RES) - 1);
-    }   
-    
-    /* Verificar se a medida  negativa */
-    if(ADS129X_VERIFY_POL(value_raw)) {
-      voltage = (value_raw - pow(2, ADS129X_RES)) * lsb;
-    } else {
-      voltage = value_raw * lsb;
+
+/*
+ * @brief Function to get the pace detection status of a raw frame, from the device of the hardware jumper
+ *
+ * @param[in] raw           Raw frame read from both ADS129x
+ * @retval                  Returns 1 if the pace latch was set at the DRDY of the frame
+ */
+uint8_t _ads129x_get_pace(const ads129x_data *raw) {
+
+  if(ADS129X_PACE_DEVICE == ADS129X_8) {
+    return IS_SET(raw->ads1298_sw_buffer[2], ADS129X_PACE_BIT);
+  }
+  return IS_SET(raw->ads1296r_sw_buffer[2], ADS129X_PACE_BIT);
+
+}
+
+
+/*
+ * @brief Function to reset the pace latch after a pulse, called at the end of the read of each frame
+ *
+ * @param[in] raw           Raw frame just read
+ * @note                    The reset is held for ADS129X_PACE_RST_FRAMES frames, well past the minimum reset pulse
+ *                          of the latch, and released at the end of a read so the next pulse is latched. A pulse is
+ *                          seen at the first DRDY after it whatever the main loop is doing
+ */
+void _ads129x_pace_rearm(const ads129x_data *raw) {
+
+  if(_pace_rst_frames) {
+    if(--_pace_rst_frames == 0) {
+      ads129x_pace_rst(false);
     }
-    
-    #if ADS129X_MEAS_DEBUG
-    /* Converts charge voltage to string */
-    char voltage_string[10];
-    memset(voltage_string, '\0', 10);
-    utils_ftoa(voltage_string, (float)voltage * 1000, 0.00000001);
+  } else if(_ads129x_get_pace(raw)) {
+    ads129x_pace_rst(true);
+    _pace_rst_frames = ADS129X_PACE_RST_FRAMES;
+  }
+
+}
+
 
+/*
+ * @brief Function to update the conversion scale table, must be called every time the gains change
+ *
+ */
+void _ads129x_update_scale(void) {
+
+  int32_t ecg_scale;
+  
+  /* Get Updated Gain */
+  if(_test_mode) {
+    ecg_scale = _ads129x_get_scale(ADS129X_CHNSET_TEST_SIG_GAIN);
+  } else {
+    ecg_scale = _ads129x_get_scale(_ecg_gain);
+  }
+
+  for(uint8_t ch = 0 ; ch < ADS129X_CHANNELS ; ch++) {
+    _ads129x_scale[ch] = ecg_scale;
+  }
+  _ads129x_scale[ADS129X_RESP_CHANNEL] = _ads129x_get_scale(_resp_gain);        /* ADS1296R channel 1 has the RESP PGA */
+
+}
+
+
+/*
+ * @brief Function to compute the size of one LSB for a PGA gain
+ *
+ * @param[in] gain          PGA gain, must be 1,2,3,4,6,8 or 12
+ * @return                  Returns the LSB size in Q31 microvolts, 0 if the gain is invalid
+ * @note                    LSB = 2 * VREF / gain / (2^24 - 1), computed with integers only
+ */
+int32_t _ads129x_get_scale(uint8_t gain) {
+
+  if(!gain) {
+    return 0;
+  }
+
+  uint64_t den = (uint64_t)gain * ADS129X_FULL_SCALE_CODES;
+  return (int32_t)(((((uint64_t)2 * ADS129X_REF_UV) << ADS129X_SCALE_SHIFT) + den / 2) / den);
+
+}
+
+
+#if ADS129X_CONVERSION_CHECK
+/*
+ * @brief Function to compare the fixed-point conversion with the previous float conversion
+ *
+ * @param[in] value_raw     Raw 24-bit sample
+ * @param[in] gain          PGA gain used in the sample
+ * @param[in] uvoltage      Fixed-point conversion result in microvolts
+ */
+void _ads129x_check_conversion(uint32_t value_raw, uint8_t gain, int32_t uvoltage) {
+
+  float lsb = ((2*(float)ADS129X_REF)/(float)gain)/(float)(pow(2, ADS129X_RES) - 1);
+  float voltage;
+  
+  /* Verificar se a medida  negativa */
+  if(ADS129X_VERIFY_POL(value_raw)) {
+    voltage = (value_raw - pow(2, ADS129X_RES)) * lsb;
+  } else {
+    voltage = value_raw * lsb;
+  }
+
+  int32_t reference = (int32_t)lroundf(voltage * ADS129x_INTEGER_CONVERT);
+  if(reference - uvoltage > 1 || uvoltage - reference > 1) {
     debug_print_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
-    debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[_ads129x_get_voltage] Measure converted ADS1296R: %s\n", voltage_string);
-    #endif
-    
-    /* Upload to array */
-    uvoltage = voltage*ADS129x_INTEGER_CONVERT;
-    utils_save_uint32_t_to_array(&_ads129x_data_upload[addr], uvoltage);    
-    addr += ADS129X_4BYTE;
+    debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[_ads129x_check_conversion] Raw 0x%06lx: %ld uV, float %ld uV\n", value_raw, uvoltage, reference);
   }
 
 }
+#endif
 
 bool _ads129x_standby(void) {
 
@@ -15,12 +15,13 @@
 /********************************** Includes ***********************************/
 /* Utilities */
 #include "spi_mngr.h"
+#include "cycle_counter.h"
 
 /* SDK */
 #include "nrf_spi_mngr.h"
 
 /* Config */
-//#include "config.h"
+#include "config.h"
 
 /********************************** Definies ***********************************/
 /* Pinos ADS129x  **************** Colocar no config.h **************** */  
@@ -97,6 +98,7 @@
 #define ADS129X_CONFIG3_INIT            0xC0      /* CONFIG3 */
 #define ADS129X_CONFIG1_HP_VALUE        0x86//0x86      /* CONFIG 1 - High resolution for 500 SPS */
 #define ADS129X_CONFIG1_LP_VALUE        0x06      /* CONFIG 1 - Low Power for 250 SPS */
+#define ADS129X_CONFIG1_MULTI_READBACK  0x40      /* CONFIG 1 - DAISY_EN bit, 0 = Daisy-chain mode, 1 = Multiple readback mode */
 #define ADS129X_CONFIG2_VALUE           0x30      /* CONFIG 2 - Deve ser varivel na config inicial */
 #define ADS129X_LOFF_VALUE              0x07      /* LOFF - Predefinio DC */
 typedef enum {                                    /* CHNSET - normal input - deve ser varivel pelo utilizador ToDo */      
@@ -134,7 +136,7 @@ typedef enum {                                    /* CHNSET - normal input - dev
 #define ADS129X_8_PACE_VALUE            0x19      /* PACE - ativado */ 
 #define ADS129X_8_CONFIG4_ON_VALUE      0x06      /* CONFIG4 - comp. leadoff on */ 
 #define ADS129X_8_CONFIG4_OFF_VALUE     0x04      /* CONFIG4 - comp. leadoff off */ 
-#define ADS129X_8_WCT1_VALUE            0xEC      /* WCT1 */
+#define ADS129X_8_WCT1_VALUE            0x0C      /* WCT1 - WCTA on, aVR, aVL and aVF are derived and not routed to CH4 to CH7 */
 #define ADS129X_8_WCT2_VALUE            0xC8      /* WCT2 */
 
 /* Configuraes ADS1296R */
@@ -167,6 +169,8 @@ typedef enum {                                    /* CHNSET - normal input - dev
 #define ADS129X_SW_BUFFER_SIZE          216/8                       /* Status Word Size 27 bytes */
 #define ADS129X_8_SW_BUFFER_SIZE        ADS129X_SW_BUFFER_SIZE - 3  /* Status Word Size 27 bytes */
 #define ADS129X_6R_SW_BUFFER_SIZE       ADS129X_SW_BUFFER_SIZE - 72/8 /* Status Word Size 27 bytes */
+#define ADS129X_6R_DAISY_SIZE           168/8                       /* ADS1296R Status Word and 6 channels in daisy-chain 21 bytes */
+#define ADS129X_DAISY_READ_SIZE         (ADS129X_SW_BUFFER_SIZE + ADS129X_6R_DAISY_SIZE)
 #define ADS129X_NUMBER_REG              25-1      /* Nmero de registos total */
 #define ADS129X_8_NUMBER_REG_ECG        8         /* Nmero de registos total */
 #define ADS129X_6_NUMBER_REG_ECG        4         /* Nmero de registos total */
@@ -200,28 +204,28 @@ typedef enum {
 * Concatenar o nmero de registos para fazer leitura 
 * n - nmero de registos a fazer leitura -1
 */
-#define ADS129X_RREG_CMD_1BYTE_CONCAT(ads129x_reg)                        (ADS129X_RREG_1BYTE_CMD | (ads129x_reg & ADS129X_REG_MASK))
+#define ADS129X_RREG_CMD_1BYTE_CONCAT(ads129x_reg)                        (ADS129X_RREG_1BYTE_CMD | ((ads129x_reg) & ADS129X_REG_MASK))
 
 /* Obter 1Byte do comando efetivo de REGISTER READ */
 /*
 * Concatenar o registo inicial para comear a fazer leitura
 * ads129x_reg - registo para realizar leitura (5 bits)
 */
-#define ADS129X_RREG_CMD_2BYTE_CONCAT(ads129x_n_reg)                      (ADS129X_RREG_2BYTE_CMD | (ads129x_n_reg & ADS129X_REG_MASK))
+#define ADS129X_RREG_CMD_2BYTE_CONCAT(ads129x_n_reg)                      (ADS129X_RREG_2BYTE_CMD | ((ads129x_n_reg) & ADS129X_REG_MASK))
 
 /* Obter comando de REGISTER WRITE */
 /*
 * Concatenar o nmero de registos para fazer escrita
 * n - nmero de registos a fazer escrita -1
 */
-#define ADS129X_WREG_CMD_1BYTE_CONCAT(ads129x_reg)                        (ADS129X_WREG_1BYTE_CMD | (ads129x_reg & ADS129X_REG_MASK))
+#define ADS129X_WREG_CMD_1BYTE_CONCAT(ads129x_reg)                        (ADS129X_WREG_1BYTE_CMD | ((ads129x_reg) & ADS129X_REG_MASK))
 
 /* Obter comando de REGISTER WRITE */
 /*
 * Concatenar o registo inicial para comear a fazer escrita
 * ads129x_reg - registo para realizar escrita (5 bits)
 */
-#define ADS129X_WREG_CMD_2BYTE_CONCAT(ads129x_n_reg)                      (ADS129X_WREG_2BYTE_CMD | (ads129x_n_reg & ADS129X_REG_MASK))
+#define ADS129X_WREG_CMD_2BYTE_CONCAT(ads129x_n_reg)                      (ADS129X_WREG_2BYTE_CMD | ((ads129x_n_reg) & ADS129X_REG_MASK))
 
 /* Transferncia SPI */
 /*
@@ -238,24 +242,24 @@ typedef enum {
 /* 
 * accuracy      - true for high resolution or false for low power resolution
 * lead_off      - true for lead off detection on, or false otherwise
-* chnset_value  - valor de configurao dos registos CH[1:8]SET
+* chnset_value  - valor de configurao dos registos CH1SET, CH2SET e CH7SET, leads I, II and V2, the others off
 */
 #define ADS129X_8_CONFIG_CMD(accuracy, lead_off, chnset_value)                    \
   {                                                                               \
     ADS129X_WREG_CMD_1BYTE_CONCAT(ADS129X_REG_CONFIG1),                           \
     ADS129X_WREG_CMD_2BYTE_CONCAT(ADS129X_NUMBER_REG),                            \
-    (accuracy ? ADS129X_CONFIG1_HP_VALUE : ADS129X_CONFIG1_LP_VALUE),             \
+    ADS129X_CONFIG1_VALUE(accuracy),                                              \
     ADS129X_CONFIG2_VALUE,                                                        \
     ADS129X_8_CONFIG3_VALUE,                                                      \
     ADS129X_LOFF_VALUE,                                                           \
     chnset_value,                                                                 \
     chnset_value,                                                                 \
+    ADS129X_CHNSET_OFF,                                                           \
+    ADS129X_CHNSET_OFF,                                                           \
+    ADS129X_CHNSET_OFF,                                                           \
+    ADS129X_CHNSET_OFF,                                                           \
     chnset_value,                                                                 \
-    ADS129X_CHNSET_OFF,                                                                 \
-    ADS129X_CHNSET_OFF,                                                                 \
-    ADS129X_CHNSET_OFF,                                                                 \
-    ADS129X_CHNSET_OFF,                                                                 \
-    ADS129X_CHNSET_OFF,                                                                 \
+    ADS129X_CHNSET_OFF,                                                           \
     ADS129X_RLD_SENSP_VALUE,                                                      \
     ADS129X_RLD_SENSN_VALUE,                                                      \
     (lead_off ? ADS129X_8_LOFF_SENSP_ON_VALUE : ADS129X_8_LOFF_SENSP_OFF_VALUE),  \
@@ -270,28 +274,28 @@ typedef enum {
     ADS129X_8_WCT1_VALUE,                                                         \
     ADS129X_8_WCT2_VALUE                                                          \
   }
-//ADS129X_8_PACE_VALUE,                                                         \
+//ADS129X_8_PACE_VALUE,
 
 /* Comando de configurao dos registos do ADS1296R */
 /* 
 * accuracy      - true for high resolution or false for low power resolution
 * lead_off      - true for lead off detection on, or false otherwise
-* chnset_value  - valor de configurao dos registos CH[1:8]SET
-* chnset_value  - valor de configurao dos registos CH[1:8]SET dedicado ao Resp
+* chnset_value  - valor de configurao dos registos CH2SET a CH5SET, leads V3 to V6, CH6 shorted
+* chnset_resp   - valor de configurao do registo CH1SET dedicado ao Resp
 */
 #define ADS129X_6R_CONFIG_CMD(accuracy, lead_off, chnset_value, chnset_resp)        \
   {                                                                                 \
     ADS129X_WREG_CMD_1BYTE_CONCAT(ADS129X_REG_CONFIG1),                             \
     ADS129X_WREG_CMD_2BYTE_CONCAT(ADS129X_NUMBER_REG),                              \
-    (accuracy ? ADS129X_CONFIG1_HP_VALUE : ADS129X_CONFIG1_LP_VALUE),               \
+    ADS129X_CONFIG1_VALUE(accuracy),                                                \
     ADS129X_CONFIG2_VALUE,                                                          \
     ADS129X_6R_CONFIG3_VALUE,                                                       \
     ADS129X_LOFF_VALUE,                                                             \
     chnset_resp,                                                                    \
-    ADS129X_CHNSET_OFF,                                                                   \
-    ADS129X_CHNSET_OFF,                                                                   \
-    ADS129X_CHNSET_OFF,                                                                   \
-    ADS129X_CHNSET_OFF,                                                                   \
+    chnset_value,                                                                   \
+    chnset_value,                                                                   \
+    chnset_value,                                                                   \
+    chnset_value,                                                                   \
     ADS129X_6R_CHNSET_SHORT_VALUE,                                                  \
     ADS129X_6R_CHNSET_OFF_VALUE,                                                    \
     ADS129X_6R_CHNSET_OFF_VALUE,                                                    \
@@ -340,16 +344,19 @@ typedef enum {
 #define ADS129X_V5_BIT                7
 #define ADS129X_V6_BIT                0
 #define ADS129X_PACE_BIT              0
+#define ADS129X_PACE_RST_FRAMES       1                 /* Frames the pace latch is held in reset after a pulse is read */
 #define ADS129X_ELECT_NUMB            10
-#define ADS129X_STAT_IDX              8
-#define ADS129X_DATA_IDX              18
-#define ADS129x_INTEGER_CONVERT       100000000
+#define ADS129x_INTEGER_CONVERT       1000000           /* Samples are uploaded as int32 microvolts */
 
-/* Estrutura de dados com o valor da Status Word do ADS129x e o respetivo timestamp */
+/* Estrutura de dados com o valor da Status Word do ADS129x e o respetivo ndice de amostra
+ * In daisy-chain mode the ADS1296R data is received right after the ADS1298 data, so both
+ * buffers must stay contiguous and in this order, checked at build time in ads129x.c */
 typedef struct {
   uint8_t   ads1298_sw_buffer[ADS129X_SW_BUFFER_SIZE];
   uint8_t   ads1296r_sw_buffer[ADS129X_SW_BUFFER_SIZE];
-  uint64_t  timestamp;
+  uint32_t  sample;
+  bool      anchor;
+  uint64_t  anchor_ticks;
 } ads129x_data; 
 
 #define ADS129X_VERIFY_POL(value)   (value & 0x00800000) ? 1 : 0
@@ -367,36 +374,116 @@ typedef struct {
 #define ADS129X_CH8_IDX               192/8             /* Channel 8 data - ADS1298 only */
 #define ADS129X_3BYTE                 3  
 #define ADS129X_4BYTE                 4  
-#define ADS129X_MEAS_DEBUG            1
-
-/* Array with content order of ADS129x data */
-#define ADS129X_DATA_ORDER  \
-  {                         \
-    MEAS_TIMESTAMP,         \
-    MEAS_ECG_LOFF_LA,       \
-    MEAS_ECG_LOFF_RA,       \
-    MEAS_ECG_LOFF_LL,       \
-    MEAS_ECG_LOFF_V1,       \
-    MEAS_ECG_LOFF_V2,       \
-    MEAS_ECG_LOFF_V3,       \
-    MEAS_ECG_LOFF_V4,       \
-    MEAS_ECG_LOFF_V5,       \
-    MEAS_ECG_LOFF_V6,       \
-    MEAS_ECG_PACE,          \
-    MEAS_ECG_I,             \
-    MEAS_ECG_II,            \
-    MEAS_ECG_III,           \
-    MEAS_ECG_AVR,           \
-    MEAS_ECG_AVL,           \
-    MEAS_ECG_AVF,           \
-    MEAS_ECG_V2,            \
-    MEAS_RESP,              \
-    MEAS_ECG_V3,            \
-    MEAS_ECG_V4,            \
-    MEAS_ECG_V5,            \
-    MEAS_ECG_V6             \
-  }
-#define ADS129X_DATA_SIZE   66
+#define ADS129X_MEAS_DEBUG            0
+#define ADS129X_CONVERSION_CHECK      0                 /* Compare the fixed-point conversion with the float reference */
+
+/* Converso em vrgula fixa */
+#define ADS129X_8_CHANNELS            8
+#define ADS129X_6R_CHANNELS           6
+#define ADS129X_CHANNELS              (ADS129X_8_CHANNELS + ADS129X_6R_CHANNELS)
+#define ADS129X_REF_UV                2400000                                             /* ADS129X_REF in microvolts */
+#define ADS129X_FULL_SCALE_CODES      0xFFFFFF                                            /* 2^ADS129X_RES - 1 */
+#define ADS129X_SCALE_SHIFT           31                                                  /* Scale table in Q31 */
+#define ADS129X_SIGN_EXTEND(raw)      ((int32_t)((raw) ^ 0x800000) - 0x800000)            /* 24-bit two's complement to int32 */
+#define ADS129X_CONVERT_UV(raw, scale)                                                                        \
+  ((int32_t)(((int64_t)ADS129X_SIGN_EXTEND(raw) * (scale) + (1 << (ADS129X_SCALE_SHIFT - 1))) >> ADS129X_SCALE_SHIFT))
+
+/* Frames serialized in the meas_ecg_layout of MEASURES_SCHEMA, ADS129X_DATA_SIZE bytes followed
+ * by the vital signs fields (HR, RR, R-peak offset and respiration rate) written by app_ecg.
+ * Frames carry the sample index of the DRDY, the time of a sample comes from the last
+ * timebase anchor record stored by app_ecg. Without ECG_STORE_DERIVED_LEADS only the independent
+ * leads are stored, III, aVR, aVL and aVF are rebuilt by the readers with ecg_leads */
+#define ADS129X_DATA_SIZE   MEAS_ECG_OFFSET(ECG_HR)
+
+/* Channels of the frames, ADS1298 CH1 to CH8 followed by ADS1296R CH1 to CH6, as the board is wired
+ * and the CHnSET of ADS129X_8_CONFIG_CMD and ADS129X_6R_CONFIG_CMD power them */
+#define ADS129X_LEAD_I_CHANNEL        0                                 /* ADS1298 CH1 */
+#define ADS129X_LEAD_II_CHANNEL       1                                 /* ADS1298 CH2 */
+#define ADS129X_LEAD_III_CHANNEL      2                                 /* ADS1298 CH3 to CH6 are powered down, with ECG_STORE_DERIVED_LEADS */
+#define ADS129X_LEAD_AVR_CHANNEL      3                                 /* app_ecg writes in them III, aVR, aVL and aVF derived from I and II */
+#define ADS129X_LEAD_AVL_CHANNEL      4
+#define ADS129X_LEAD_AVF_CHANNEL      5
+#define ADS129X_LEAD_V2_CHANNEL       6                                 /* ADS1298 CH7, CH8 is powered down */
+#define ADS129X_RESP_CHANNEL          ADS129X_8_CHANNELS                /* ADS1296R CH1, the only one with the RESP PGA */
+#define ADS129X_LEAD_V3_CHANNEL       (ADS129X_8_CHANNELS + 1)          /* ADS1296R CH2 to CH5, CH6 is shorted */
+#define ADS129X_LEAD_V4_CHANNEL       (ADS129X_8_CHANNELS + 2)
+#define ADS129X_LEAD_V5_CHANNEL       (ADS129X_8_CHANNELS + 3)
+#define ADS129X_LEAD_V6_CHANNEL       (ADS129X_8_CHANNELS + 4)
+
+/* Source channel of each lead field of MEASURES_SCHEMA, in the order of the schema
+ *   X(field, channel)
+ * ADS129X_DERIVED_MAP are the leads app_ecg derives, the others are inputs of the devices. ADS1298 CH8
+ * and ADS1296R CH6 have no field and are not stored. ads129x checks at build time that every lead
+ * field has exactly one channel and that no channel feeds two fields */
+#if ECG_STORE_DERIVED_LEADS
+#define ADS129X_DERIVED_MAP(X)                                          \
+  X(ECG_III,  ADS129X_LEAD_III_CHANNEL)                                 \
+  X(ECG_AVR,  ADS129X_LEAD_AVR_CHANNEL)                                 \
+  X(ECG_AVL,  ADS129X_LEAD_AVL_CHANNEL)                                 \
+  X(ECG_AVF,  ADS129X_LEAD_AVF_CHANNEL)
+#else
+#define ADS129X_DERIVED_MAP(X)
+#endif
+
+#define ADS129X_CHANNEL_MAP(X)                                          \
+  X(ECG_I,    ADS129X_LEAD_I_CHANNEL)                                   \
+  X(ECG_II,   ADS129X_LEAD_II_CHANNEL)                                  \
+  ADS129X_DERIVED_MAP(X)                                                \
+  X(ECG_V2,   ADS129X_LEAD_V2_CHANNEL)                                  \
+  X(RESP,     ADS129X_RESP_CHANNEL)                                     \
+  X(ECG_V3,   ADS129X_LEAD_V3_CHANNEL)                                  \
+  X(ECG_V4,   ADS129X_LEAD_V4_CHANNEL)                                  \
+  X(ECG_V5,   ADS129X_LEAD_V5_CHANNEL)                                  \
+  X(ECG_V6,   ADS129X_LEAD_V6_CHANNEL)
+
+/* Generators */
+#define ADS129X_X_INDEX(field, channel)       ADS129X_MAP_##field,
+#define ADS129X_X_CHANNEL(field, channel)     channel,
+#define ADS129X_X_OFFSET(field, channel)      MEAS_ECG_OFFSET(field),
+
+/* Position of each field in the map, also the channel of the field in the ecg_codec frames */
+typedef enum {
+  ADS129X_CHANNEL_MAP(ADS129X_X_INDEX)
+  ADS129X_MAPPED_CHANNELS
+} ads129x_map_index;
+
+/* Tables indexed by the positions in the map */
+#define ADS129X_MAP_CHANNELS          { ADS129X_CHANNEL_MAP(ADS129X_X_CHANNEL) }
+#define ADS129X_MAP_OFFSETS           { ADS129X_CHANNEL_MAP(ADS129X_X_OFFSET) }
+
+/* Frame convertido pelo ADS129x */
+typedef struct {
+  uint32_t  sample;                                 /* Sequence number of the DRDY since the start of sampling */
+  bool      anchor;                                 /* The RTC was read at the DRDY of this frame */
+  uint64_t  anchor_ticks;                           /* RTC ticks of the DRDY, only valid in anchor frames */
+  uint8_t   lead_off[ADS129X_ELECT_NUMB - 1];       /* Lead-off status of LA, RA, LL, V1 to V6 */
+  uint8_t   pace;                                   /* Pace detection status */
+  int32_t   channels[ADS129X_CHANNELS];             /* ADS1298 channels followed by ADS1296R channels, in microvolts */
+} ads129x_frame;
+
+/* Pipeline de aquisio DRDY -> SPI -> converso */
+#define ADS129X_RAW_RING_SIZE         16                  /* Number of raw frames between DRDY and conversion, must be power of 2 */
+
+/* Modo de leitura dos ADS129x
+ * 0 - One transaction per chip select, the ADS1296R read is chained to the ADS1298 read
+ * 1 - Daisy-chain, ADS1296R DOUT connected to ADS1298 DAISY_IN, both chip selects asserted
+ *     together and both devices read in one transfer of ADS129X_DAISY_READ_SIZE bytes */
+#define ADS129X_DAISY_CHAIN           0
+#if ADS129X_DAISY_CHAIN
+#define ADS129X_READ_TRANSACTIONS     1
+#else
+#define ADS129X_READ_TRANSACTIONS     2
+#endif
+#define ADS129X_CONFIG1_VALUE(accuracy) \
+  (accuracy ? ADS129X_CONFIG1_HP_VALUE : ADS129X_CONFIG1_LP_VALUE)       /* Both have DAISY_EN clear, daisy-chain mode */
+#define ADS129X_ISR_BUDGET_US         20                  /* Maximum time allowed in the DRDY interrupt */
+#define ADS129X_ANCHOR_PERIOD         256                 /* Samples between RTC reads in the DRDY interrupt, must be power of 2 */
+
+/* Replay de frames gravados
+ * 1 - ads129x_replay_feed() adds recorded frames to the raw frames ring instead of the DRDY reads, so the
+ *     conversion, app_ecg and meas_mngr run on known data with the real timings */
+#define ADS129X_REPLAY                0
+#define ADS129X_REPLAY_FRAME_SIZE     (2 * ADS129X_SW_BUFFER_SIZE)  /* ADS1298 data followed by ADS1296R data */
 
 /* Estados das funes com temporizao ou mais do que um estado */
 typedef enum {
@@ -413,8 +500,18 @@ uint8_t ads129x_start_sample(void);
 bool ads129x_start_datac(void);
 bool ads129x_stop_datac(void);
 uint8_t *ads129x_get_data(void);
+uint16_t ads129x_read_frames(ads129x_frame *frames, uint16_t max);
+uint16_t ads129x_get_frames_count(void);
+void ads129x_frame_to_array(const ads129x_frame *frame, uint8_t *array);
 bool ads129x_user_configs(bool accuracy, bool lead_off, uint8_t ecg_gain, uint8_t resp_gain, uint8_t test_mode);
 void ads129x_pace_rst(bool state);
+uint32_t ads129x_get_dropped_frames(void);
+uint32_t ads129x_get_overruns(void);
+cycle_counter_stats *ads129x_get_isr_stats(void);
+#if ADS129X_REPLAY
+void ads129x_replay_start(bool lead_off, uint8_t ecg_gain, uint8_t resp_gain);
+bool ads129x_replay_feed(const uint8_t *frame);
+#endif
 
 #endif /* ADS129X_H_ */
 
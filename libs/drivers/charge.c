@@ -35,6 +35,7 @@
 #include "sense_library/utils/debug.h"
 #include "sense_library/utils/externs.h"
 #include "sense_library/utils/utils.h"
+#include "fmt.h"
 
 
 /********************************** Private ************************************/
@@ -233,9 +234,8 @@ void charge_loop(void) {
         _last_timestamp = saadc_get_data()->timestamp;
 
         /* Converts charge voltage to string */
-        char voltage_string[10];
-        memset(voltage_string, '\0', 10);
-        utils_ftoa(voltage_string, _charge_data.voltage, 0.001);
+        char voltage_string[FMT_FIXED_SIZE];
+        fmt_float(voltage_string, _charge_data.voltage, 3);
         
         _current_state = CHARGE_UPLOAD_DATA;
 
@@ -367,9 +367,8 @@ bool charge_add_measurement(charge_data* charge_data) {
   /* Convert floats to string to be printed out. Note
    * that printed value might be slightly different from
    * the real float values in the last decimal case */
-  char voltage_string[10];
-  memset(voltage_string, '\0', 10);
-  utils_ftoa(voltage_string, voltage, 0.001);
+  char voltage_string[FMT_FIXED_SIZE];
+  fmt_float(voltage_string, voltage, 3);
 
   if(measurements_v2_manager_add_measurement(&measurement_fields)) {
     debug_print_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
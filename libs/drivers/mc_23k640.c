@@ -21,6 +21,7 @@
 #include "nrf_drv_saadc.h"
 #include "nrf_spi_mngr.h"
 #include "nrf_delay.h"
+#include "app_util_platform.h"
 
 /* Utilities */
 #include "spi_mngr.h"
@@ -62,42 +63,85 @@ static bool _init_started = false;
 static uint8_t _mc_23k640_buffer[MC_23K640_BUFFER_SIZE];
 
 /*
-* Stores the number rof bytes written on RAM.
+* Circular buffer indexes. The producer (MCU1) owns the head and the consumer (MCU2) owns the tail,
+* the index of the peer is a cached copy, only read again from RAM when the ring looks full or empty.
 */
-static uint8_t _current_index[MC_23K640_INDEX_SIZE];
+static circular_struct circular_buffer;
 
 /*
-* Circualr buffer structure.
+* Head last written to RAM, MCU1. The bytes appended after it are not seen by MCU2 until published.
 */
-static circular_struct circular_buffer;
+static uint16_t _published_head = 0;
+
+/*
+* Number of CS framed SPI transactions.
+*/
+static uint32_t _transactions = 0;
 
-static uint16_t _last_index;
+/*
+* Data bytes written and read through the circular buffer, for the throughput.
+*/
+static uint32_t _bytes_written = 0;
+static uint32_t _bytes_read = 0;
+
+#if MC_23K640_FAULT_INJECTION
+/*
+* Faults injected so far, and state of the random generator deciding them.
+*/
+static mc_23k640_fault_stats _fault_stats;
+static uint32_t _fault_seed = 0;
+#endif
+
+/*
+* Bus arbitration statistics, and start of the current access.
+*/
+static mc_23k640_arb_stats _arb_stats;
+static uint32_t _hold_start;
+
+#if MC_23K640_ARBITRATION && MICROCONTROLER_1
+/*
+* Set during the accesses of MCU1, a request is only granted after them.
+*/
+static volatile bool _arb_busy = false;
+#endif
 
 
 /********************************** Private ************************************/
 /* Private functions list */
 uint16_t circular_buffer_free_space(void);
 uint16_t circular_buffer_occupied_space(void);
-bool mc_23k640_read_circular_idx(void);
+bool mc_23k640_read_index(uint16_t addr, uint16_t *index);
+bool mc_23k640_write_index(uint16_t addr, uint16_t index);
+bool mc_23k640_read_segment(uint16_t index, uint8_t *data, uint16_t nbytes);
+bool mc_23k640_write_segment(uint16_t index, uint8_t *data, uint16_t nbytes);
+#if MC_23K640_FAULT_INJECTION
+uint32_t mc_23k640_fault_random(void);
+#endif
+bool mc_23k640_perform(nrf_spi_mngr_transfer_t const *transfers, uint8_t count);
+bool mc_23k640_init_perform(nrf_spi_mngr_transfer_t const *transfers, uint8_t count);
+bool mc_23k640_get_ring(const uint8_t *state, circular_struct *ring);
+uint16_t mc_23k640_write_ring(uint8_t *data, uint16_t bytes, bool publish);
+uint16_t mc_23k640_read_ring(uint8_t *data, uint16_t max_bytes, mc_23k640_status *status);
+void mc_23k640_arb_init(void);
+bool mc_23k640_bus_acquire(void);
+void mc_23k640_bus_release(void);
+#if MC_23K640_ARBITRATION && MICROCONTROLER_1
+void mc_23k640_arb_grant(void);
+void mc_23k640_arb_req_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+#endif
 void mc_23k640_cs_init(void);
 void mc_23k640_cs_deactivate(void);
 void mc_23k640_cs_activate(void);
 
 /*
- * @brief 
+ * @brief Function to get the free space of the circular buffer, one byte is kept free to tell full from empty.
  */
 uint16_t circular_buffer_free_space(void) {
-  if(circular_buffer.head >= circular_buffer.tail) {
-    /* Tail is before the head */
-    return (DATA_MEMORY_SIZE - (circular_buffer.head - circular_buffer.tail));
-  } else {
-    /* Head is before the tail */
-    return circular_buffer.tail - circular_buffer.head;
-  }
+  return (DATA_MEMORY_SIZE - 1) - circular_buffer_occupied_space();
 }
 
 /*
- * @brief 
+ * @brief Function to get the bytes written and not yet read of the circular buffer.
  */
 uint16_t circular_buffer_occupied_space(void){
   if(circular_buffer.head < circular_buffer.tail) {
@@ -137,51 +181,336 @@ void mc_23k640_cs_deactivate(void) {
 }
 
 /*
- * @brief Function to read the indexes from external RAM.
+ * @brief Function to initialize the bus arbitration lines and statistics.
+ */
+void mc_23k640_arb_init(void) {
+  cycle_counter_init();
+  cycle_counter_stats_init(&_arb_stats.wait, CYCLE_COUNTER_US_TO_CYCLES(MC_23K640_ARB_HOLD_US));
+  cycle_counter_stats_init(&_arb_stats.hold, CYCLE_COUNTER_US_TO_CYCLES(MC_23K640_ARB_HOLD_US));
+  _arb_stats.grants = 0;
+  _arb_stats.timeouts = 0;
+
+#if MC_23K640_ARBITRATION && MICROCONTROLER_1
+  nrf_drv_gpiote_in_config_t in_config = 
+  {
+    .sense = NRF_GPIOTE_POLARITY_TOGGLE,
+    .pull = NRF_GPIO_PIN_PULLDOWN,                      /* No requests without MCU2 */
+    .is_watcher = false,
+    .hi_accuracy = false,
+    .skip_gpio_setup = false
+  };
+
+  nrf_gpio_pin_clear(MC_23K640_ARB_GNT_PIN);
+  nrf_gpio_cfg_output(MC_23K640_ARB_GNT_PIN);
+  if(!nrf_drv_gpiote_is_init()) {
+    nrf_drv_gpiote_init();
+  }
+  if(!nrf_drv_gpiote_in_init(MC_23K640_ARB_REQ_PIN, &in_config, mc_23k640_arb_req_handler)) {
+    nrf_drv_gpiote_in_event_enable(MC_23K640_ARB_REQ_PIN, true);
+  }
+#endif
+#if MC_23K640_ARBITRATION && MICROCONTROLER_2
+  nrf_gpio_pin_clear(MC_23K640_ARB_REQ_PIN);
+  nrf_gpio_cfg_output(MC_23K640_ARB_REQ_PIN);
+  nrf_gpio_cfg_input(MC_23K640_ARB_GNT_PIN, NRF_GPIO_PIN_PULLDOWN);
+#endif
+}
+
+#if MC_23K640_ARBITRATION && MICROCONTROLER_1
+/*
+ * @brief Function to grant the bus to MCU2, MCU1 is the arbiter.
+ */
+void mc_23k640_arb_grant(void) {
+  if(!nrf_gpio_pin_out_read(MC_23K640_ARB_GNT_PIN)) {
+    nrf_gpio_pin_set(MC_23K640_ARB_GNT_PIN);
+    _arb_stats.grants++;
+  }
+}
+
+/*
+ * @brief Function to handle the edges of the request line of MCU2.
  *
- * @retval True if read was successful. 
+ * @param[in] pin Pin of the request, MC_23K640_ARB_REQ_PIN.
+ * @param[in] action Edge of the pin, the level is read again.
  */
-bool mc_23k640_read_circular_idx(void) {
-  static uint8_t tmp_buffer[2];
+void mc_23k640_arb_req_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+  if(pin != MC_23K640_ARB_REQ_PIN) {
+    return;
+  }
 
-  /* Read cmd tail addr */
-  _mc_23k640_buffer[0] = MC_23K640_READ_CMD;
-  utils_save_uint16_t_to_array(&_mc_23k640_buffer[1], TAIL_INDEX_MEMORY_ADDR);
+  if(!nrf_gpio_pin_read(MC_23K640_ARB_REQ_PIN)) {
+    /* Access of MCU2 ended */
+    nrf_gpio_pin_clear(MC_23K640_ARB_GNT_PIN);
+  } else if(!_arb_busy) {
+    /* During an access of MCU1 the grant waits for mc_23k640_bus_release() */
+    mc_23k640_arb_grant();
+  }
+}
+#endif
 
-  /* Read cmd head addr */
-  _mc_23k640_buffer[3] = MC_23K640_READ_CMD;
-  utils_save_uint16_t_to_array(&_mc_23k640_buffer[4], HEAD_INDEX_MEMORY_ADDR);
+/*
+ * @brief Function to get the bus for one access, waits for the access of the peer in progress.
+ *
+ * @retval True if the bus is ours, false if the peer did not answer within MC_23K640_ARB_TIMEOUT_US.
+ * @note On a timeout nothing is sent, the caller retries or drops the access. On MCU1 the grant of MCU2
+ *       stays up, its access ends on REQ as any other.
+ */
+bool mc_23k640_bus_acquire(void) {
+  uint32_t start = cycle_counter_get();
+#if MC_23K640_ARBITRATION
+  uint32_t timeout = CYCLE_COUNTER_US_TO_CYCLES(MC_23K640_ARB_TIMEOUT_US);
+#endif
+
+#if MC_23K640_ARBITRATION && MICROCONTROLER_1
+  /* No grants from here on, MCU2 ends the access it may have started. The end is seen
+   * on REQ or, if MCU2 already requested again, on the GNT dropped by the REQ interrupt */
+  _arb_busy = true;
+  if(nrf_gpio_pin_out_read(MC_23K640_ARB_GNT_PIN)) {
+    while(nrf_gpio_pin_out_read(MC_23K640_ARB_GNT_PIN) && nrf_gpio_pin_read(MC_23K640_ARB_REQ_PIN)) {
+      if(cycle_counter_get() - start > timeout) {
+        /* MCU2 may still be driving the bus */
+        _arb_busy = false;
+        _arb_stats.timeouts++;
+        return false;
+      }
+    }
+    nrf_gpio_pin_clear(MC_23K640_ARB_GNT_PIN);
+  }
+#endif
+#if MC_23K640_ARBITRATION && MICROCONTROLER_2
+  /* The grant of the previous access is dropped first */
+  while(nrf_gpio_pin_read(MC_23K640_ARB_GNT_PIN)) {
+    if(cycle_counter_get() - start > timeout) {
+      _arb_stats.timeouts++;
+      return false;
+    }
+  }
+
+  nrf_gpio_pin_set(MC_23K640_ARB_REQ_PIN);
+  while(!nrf_gpio_pin_read(MC_23K640_ARB_GNT_PIN)) {
+    if(cycle_counter_get() - start > timeout) {
+      nrf_gpio_pin_clear(MC_23K640_ARB_REQ_PIN);
+      _arb_stats.timeouts++;
+      return false;
+    }
+  }
+  _arb_stats.grants++;
+#endif
+
+  cycle_counter_stats_add(&_arb_stats.wait, start);
+  _hold_start = cycle_counter_get();
+  return true;
+}
+
+/*
+ * @brief Function to give the bus back after an access.
+ */
+void mc_23k640_bus_release(void) {
+  cycle_counter_stats_add(&_arb_stats.hold, _hold_start);
+
+#if MC_23K640_ARBITRATION && MICROCONTROLER_1
+  /* A request made during the access goes before the next access of MCU1 */
+  CRITICAL_REGION_ENTER();
+  _arb_busy = false;
+  if(nrf_gpio_pin_read(MC_23K640_ARB_REQ_PIN)) {
+    mc_23k640_arb_grant();
+  }
+  CRITICAL_REGION_EXIT();
+#endif
+#if MC_23K640_ARBITRATION && MICROCONTROLER_2
+  nrf_gpio_pin_clear(MC_23K640_ARB_REQ_PIN);
+#endif
+}
+
+/*
+ * @brief Function to perform transfers with the chip select active.
+ *
+ * @param[in] transfers Transfers of the transaction.
+ * @param[in] count Number of transfers.
+ * @retval True if the transfers were successful.
+ */
+bool mc_23k640_perform(nrf_spi_mngr_transfer_t const *transfers, uint8_t count) {
+  ret_code_t err;
+
+  mc_23k640_cs_activate();
+  err = nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, transfers, count, NULL);
+  mc_23k640_cs_deactivate();
+  _transactions++;
+
+  return err == NRF_SUCCESS;
+}
+
+/*
+ * @brief Function to perform the transfers of the init, in one access of the bus.
+ *
+ * @param[in] transfers Transfers of the transaction.
+ * @param[in] count Number of transfers.
+ * @retval True if the transfers were successful.
+ * @note At boot the peer may not grant yet or be in an access, the bus is tried for MC_23K640_ARB_INIT_RETRIES times.
+ */
+bool mc_23k640_init_perform(nrf_spi_mngr_transfer_t const *transfers, uint8_t count) {
+  bool performed;
+
+  for(uint8_t retries = 0 ; !mc_23k640_bus_acquire() ; retries++) {
+    if(retries >= MC_23K640_ARB_INIT_RETRIES) {
+      return false;
+    }
+    nrf_delay_ms(MC_23K640_ARB_INIT_DELAY_MS);
+  }
+  performed = mc_23k640_perform(transfers, count);
+  mc_23k640_bus_release();
+  return performed;
+}
+
+/*
+ * @brief Function to get the indexes of the ring state read from RAM.
+ *
+ * @param[in] state Bytes from TAIL_INDEX_MEMORY_ADDR, MC_23K640_RING_STATE_SIZE of them.
+ * @param[out] ring Indexes, unchanged if not valid.
+ * @retval True if the marker is in RAM and both indexes are in the data region.
+ * @note Random after a power-up, and in byte mode only the first byte is read, so the marker does not match.
+ */
+bool mc_23k640_get_ring(const uint8_t *state, circular_struct *ring) {
+  uint16_t tail = utils_get_uint16_from_array((uint8_t *)&state[TAIL_INDEX_MEMORY_ADDR]);
+  uint16_t head = utils_get_uint16_from_array((uint8_t *)&state[HEAD_INDEX_MEMORY_ADDR]);
+
+  if(utils_get_uint32_from_array((uint8_t *)&state[RING_MARKER_MEMORY_ADDR]) != MC_23K640_RING_MARKER ||
+     tail >= DATA_MEMORY_SIZE || head >= DATA_MEMORY_SIZE) {
+    return false;
+  }
+  ring->tail = tail;
+  ring->head = head;
+  return true;
+}
+
+/*
+ * @brief Function to read one index from external RAM.
+ *
+ * @param[in] addr Address of the index, TAIL_INDEX_MEMORY_ADDR or HEAD_INDEX_MEMORY_ADDR.
+ * @param[out] index Index read, unchanged on error.
+ * @retval True if read was successful. 
+ */
+bool mc_23k640_read_index(uint16_t addr, uint16_t *index) {
+  uint8_t tmp_buffer[MC_23K640_INDEX_SIZE];
+  uint8_t cmd[MC_23K640_CMD_TRANSFER_SIZE];
+  uint16_t value;
+
+  cmd[0] = MC_23K640_READ_CMD;
+  utils_save_uint16_t_to_array(&cmd[1], addr);
 
   nrf_spi_mngr_transfer_t transfers[] = {                      
-    MC_23K640_TRANSFER(&_mc_23k640_buffer[0], MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),
-    MC_23K640_TRANSFER(NULL, 0, tmp_buffer, MC_23K640_INDEX_SIZE),
-    MC_23K640_TRANSFER(&_mc_23k640_buffer[3], MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),
+    MC_23K640_TRANSFER(cmd, MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),
     MC_23K640_TRANSFER(NULL, 0, tmp_buffer, MC_23K640_INDEX_SIZE)
   };
 
-  /* Read tail from RAM */
-  mc_23k640_cs_activate();
-  if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[0], 2, NULL) != NRF_SUCCESS) {
-    mc_23k640_cs_deactivate();
+  if(!mc_23k640_perform(transfers, 2)) {
     return false;
-  } 
-  mc_23k640_cs_deactivate();
-  
-  circular_buffer.tail = utils_get_uint16_from_array(tmp_buffer);
+  }
 
-  /* Read head from RAM */
-  mc_23k640_cs_activate();
-  if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[2], 2, NULL) != NRF_SUCCESS) {
-    mc_23k640_cs_deactivate();
+  /* An index out of the data region can only come from a torn write */
+  value = utils_get_uint16_from_array(tmp_buffer);
+  if(value >= DATA_MEMORY_SIZE) {
     return false;
-  } 
-  mc_23k640_cs_deactivate();
+  }
+  *index = value;
+  return true;
+}
 
-  circular_buffer.head = utils_get_uint16_from_array(tmp_buffer);
+/*
+ * @brief Function to write one index in external RAM, a single 2-byte write.
+ *
+ * @param[in] addr Address of the index, TAIL_INDEX_MEMORY_ADDR or HEAD_INDEX_MEMORY_ADDR.
+ * @param[in] index Index to write.
+ * @retval True if write was successful. 
+ */
+bool mc_23k640_write_index(uint16_t addr, uint16_t index) {
+  uint8_t cmd[MC_23K640_CMD_TRANSFER_SIZE + MC_23K640_INDEX_SIZE];
 
-  
+  cmd[0] = MC_23K640_WRITE_CMD;
+  utils_save_uint16_t_to_array(&cmd[1], addr);
+  utils_save_uint16_t_to_array(&cmd[3], index);
+
+  nrf_spi_mngr_transfer_t transfers[] = {                      
+    MC_23K640_TRANSFER(cmd, MC_23K640_CMD_TRANSFER_SIZE + MC_23K640_INDEX_SIZE, NULL, 0)
+  };
+
+  return mc_23k640_perform(transfers, 1);
+}
+
+/*
+ * @brief Function to write a contiguous segment of the data region in one burst.
+ *
+ * @param[in] index Index of the first byte in the data region.
+ * @param[in] data Pointer to the data, must be in RAM for the EasyDMA.
+ * @param[in] nbytes Number of bytes, up to MC_23K640_MAX_TRANSFER_SIZE.
+ * @retval True if write was successful. 
+ */
+bool mc_23k640_write_segment(uint16_t index, uint8_t *data, uint16_t nbytes) {
+  uint8_t cmd[MC_23K640_CMD_TRANSFER_SIZE];
+  uint16_t first;
+
+#if MC_23K640_FAULT_INJECTION
+  /* Torn write, only the first bytes reach the RAM and the write still succeeds */
+  if(MC_23K640_FAULT_TORN_RATE && !(mc_23k640_fault_random() % MC_23K640_FAULT_TORN_RATE)) {
+    nbytes = mc_23k640_fault_random() % nbytes;
+    _fault_stats.torn_writes++;
+    if(!nbytes) {
+      return true;
+    }
+  }
+#endif
+  first = (nbytes > MC_23K640_SINGLE_TRANSFER_SIZE) ? MC_23K640_SINGLE_TRANSFER_SIZE : nbytes;
+
+  /* Store cmd and address */
+  cmd[0] = MC_23K640_WRITE_CMD;
+  utils_save_uint16_t_to_array(&cmd[1], DATA_MEMORY_ADDR + index);
+
+  /* Sequential mode, the data transfers continue from the next address without a new cmd */
+  nrf_spi_mngr_transfer_t transfers[] = {                      
+    MC_23K640_TRANSFER(cmd, MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),           /* Write cmd */
+    MC_23K640_TRANSFER(data, first, NULL, 0),                                /* Data */
+    MC_23K640_TRANSFER(&data[first], nbytes - first, NULL, 0)                /* Data */
+  };
+
+  return mc_23k640_perform(transfers, (nbytes > first) ? 3 : 2);
+}
+
+/*
+ * @brief Function to read a contiguous segment of the data region.
+ *
+ * @param[in] index Index of the first byte in the data region.
+ * @param[out] data Pointer to the data buffer.
+ * @param[in] nbytes Number of bytes, up to MC_23K640_MAX_TRANSFER_SIZE.
+ * @retval True if read was successful. 
+ */
+bool mc_23k640_read_segment(uint16_t index, uint8_t *data, uint16_t nbytes) {
+  uint8_t cmd[MC_23K640_CMD_TRANSFER_SIZE];
+  uint16_t first = (nbytes > MC_23K640_SINGLE_TRANSFER_SIZE) ? MC_23K640_SINGLE_TRANSFER_SIZE : nbytes;
+
+  cmd[0] = MC_23K640_READ_CMD;
+  utils_save_uint16_t_to_array(&cmd[1], DATA_MEMORY_ADDR + index);
+
+  /* Sequential mode, a second transfer in the same transaction continues from the next address */
+  nrf_spi_mngr_transfer_t transfers[] = {                      
+    MC_23K640_TRANSFER(cmd, MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),           /* Write a read cmd */
+    MC_23K640_TRANSFER(NULL, 0, data, first),                                /* Read data */ 
+    MC_23K640_TRANSFER(NULL, 0, &data[first], nbytes - first)                /* Read data */ 
+  };
+
+  if(!mc_23k640_perform(transfers, (nbytes > first) ? 3 : 2)) {
+    return false;
+  }
+
+#if MC_23K640_FAULT_INJECTION
+  /* Bit flip, one bit of the data read is inverted */
+  if(MC_23K640_FAULT_FLIP_RATE && !(mc_23k640_fault_random() % MC_23K640_FAULT_FLIP_RATE)) {
+    data[mc_23k640_fault_random() % nbytes] ^= 1 << (mc_23k640_fault_random() % 8);
+    _fault_stats.bit_flips++;
+  }
+#endif
   return true;
 }
+
 /********************************** Public ***********************************/
 /*
  * @brief Function to initialize the external RAM.
@@ -204,12 +533,28 @@ bool mc_23k640_init(void) {
   ///* Initicialize Circular Indexes */
   circular_buffer.head = 0;
   circular_buffer.tail = 0;
+  _published_head = 0;
 
 
   mc_23k640_cs_init();
+  mc_23k640_arb_init();
 
   /* Get SPI manager */
   _p_spi_mngr = spi_mngr_get_instance(SPI_MNGR_CONFIG3_INSTANCE); 
+
+  /* Read the indexes and the marker, in one access */
+  uint8_t ring_state[MC_23K640_CMD_TRANSFER_SIZE + MC_23K640_RING_STATE_SIZE];
+  circular_struct ring;
+  bool resumed;
+
+  ring_state[0] = MC_23K640_READ_CMD;
+  utils_save_uint16_t_to_array(&ring_state[1], TAIL_INDEX_MEMORY_ADDR);
+
+  nrf_spi_mngr_transfer_t ring_transfers[] =
+  {
+    MC_23K640_TRANSFER(ring_state, MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),
+    MC_23K640_TRANSFER(NULL, 0, &ring_state[MC_23K640_CMD_TRANSFER_SIZE], MC_23K640_RING_STATE_SIZE)
+  };
             
 #if MICROCONTROLER_2  
   /* Store status cmd and address */
@@ -229,6 +574,11 @@ bool mc_23k640_init(void) {
   /* Store status cmd and address */
   _mc_23k640_buffer[12] = MC_23K640_READ_STAT_CMD;
 
+  /* Store the marker */
+  _mc_23k640_buffer[14] = MC_23K640_WRITE_CMD;
+  utils_save_uint16_t_to_array(&_mc_23k640_buffer[15], RING_MARKER_MEMORY_ADDR);
+  utils_save_uint32_t_to_array(&_mc_23k640_buffer[17], MC_23K640_RING_MARKER);
+
   nrf_spi_mngr_transfer_t transfers[] = 
   {                      
     MC_23K640_TRANSFER(_mc_23k640_buffer, MC_23K640_STAT_SIZE, NULL, 0),
@@ -236,46 +586,57 @@ bool mc_23k640_init(void) {
     MC_23K640_TRANSFER(&_mc_23k640_buffer[7], MC_23K640_INDEX_SIZE + MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),
     MC_23K640_TRANSFER(&_mc_23k640_buffer[12], 1, NULL, 0),
     MC_23K640_TRANSFER(NULL, 0, &_mc_23k640_buffer[13], 1),
+    MC_23K640_TRANSFER(&_mc_23k640_buffer[14], MC_23K640_MARKER_SIZE + MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),
   };
   
   /* Write status to RAM */
-  mc_23k640_cs_activate();
-  if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[0], 1, NULL) != NRF_SUCCESS) {
-    _init_started = false;
-    mc_23k640_cs_deactivate();
+  if(!mc_23k640_init_perform(&transfers[0], 1)) {
     return false;
   } 
-  mc_23k640_cs_deactivate();
   nrf_delay_ms(200);
 
-  /* Write tail to RAM */
-  mc_23k640_cs_activate();
-  if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[1], 1, NULL) != NRF_SUCCESS) {
-    _init_started = false;
-    mc_23k640_cs_deactivate();
-    return false;
-  } 
-  mc_23k640_cs_deactivate();
-  nrf_delay_ms(200);
+  /* A reboot of MCU2 only, MCU1 kept writing on the indexes in RAM: resume from the tail, the parser finds
+   * the first record again. Starting the ring again would have MCU1 write over the bytes not read yet */
+  resumed = mc_23k640_init_perform(ring_transfers, 2) &&
+            mc_23k640_get_ring(&ring_state[MC_23K640_CMD_TRANSFER_SIZE], &ring);
+  if(resumed) {
+    circular_buffer = ring;
+  } else {
+    /* Power-up, the ring starts empty and the marker is written last */
 
-  /* Write head to RAM */
-  mc_23k640_cs_activate();
-  if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[2], 1, NULL) != NRF_SUCCESS) {
-    _init_started = false;
-    mc_23k640_cs_deactivate();
-    return false;
-  } 
-  mc_23k640_cs_deactivate();
+    /* Write tail to RAM */
+    if(!mc_23k640_init_perform(&transfers[1], 1)) {
+      return false;
+    } 
+    nrf_delay_ms(200);
 
- /* Read status from RAM */
-  mc_23k640_cs_activate();
-  nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[3], 2, NULL);
-  if(_mc_23k640_buffer[13] != MC_23K640_STAT_REG) {
-    mc_23k640_cs_deactivate();
+    /* Write head to RAM */
+    if(!mc_23k640_init_perform(&transfers[2], 1)) {
+      return false;
+    } 
+
+    /* Write marker to RAM */
+    if(!mc_23k640_init_perform(&transfers[5], 1)) {
+      return false;
+    }
+  }
+
+  /* Read status from RAM */
+  if(!mc_23k640_init_perform(&transfers[3], 2) || _mc_23k640_buffer[13] != MC_23K640_STAT_REG) {
     return false;
   }
+#else
+  /* A reboot of MCU1 only, MCU2 kept reading on the indexes in RAM: resume from the head published, the bytes
+   * appended after it were never seen. Without the marker MCU2 has not started the ring yet and writes 0 to both */
+  if(!mc_23k640_init_perform(ring_transfers, 2)) {
+    return false;
+  }
+  resumed = mc_23k640_get_ring(&ring_state[MC_23K640_CMD_TRANSFER_SIZE], &ring);
+  if(resumed) {
+    circular_buffer = ring;
+    _published_head = ring.head;
+  }
 #endif
-  mc_23k640_cs_deactivate();
   _init_finished = true;
   return true;
         
@@ -289,6 +650,7 @@ bool mc_23k640_init(void) {
  * @retval True if write was successful, false otherwise. 
  */
 bool mc_23k640_write_config(uint8_t *data, uint16_t nbytes) {
+  bool written;
 
   if(!nbytes || data == NULL || nbytes > (MAX_MEMORY_ADDR - CONFIG_MEMORY_ADDR)) {
     return false;
@@ -306,13 +668,12 @@ bool mc_23k640_write_config(uint8_t *data, uint16_t nbytes) {
   };
 
   /* Write config to RAM */
-  mc_23k640_cs_activate();
-  if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[0], 1, NULL) != NRF_SUCCESS) {
-    mc_23k640_cs_deactivate();
+  if(!mc_23k640_bus_acquire()) {
     return false;
   }
-  mc_23k640_cs_deactivate();
-  return true;
+  written = mc_23k640_perform(transfers, 1);
+  mc_23k640_bus_release();
+  return written;
 }
 
 /*
@@ -323,6 +684,7 @@ bool mc_23k640_write_config(uint8_t *data, uint16_t nbytes) {
  * @retval True if read was successful, false otherwise. 
  */
 bool mc_23k640_read_config(uint8_t *data, uint16_t nbytes) {
+  bool read;
 
   if(!nbytes || data == NULL || nbytes > (MAX_MEMORY_ADDR - CONFIG_MEMORY_ADDR)) {
     return false;
@@ -339,186 +701,295 @@ bool mc_23k640_read_config(uint8_t *data, uint16_t nbytes) {
   };
 
   /* Read config from RAM */
-  mc_23k640_cs_activate();
-  if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[0], 2, NULL) != NRF_SUCCESS) {
-    mc_23k640_cs_deactivate();
+  if(!mc_23k640_bus_acquire()) {
     return false;
-  } 
-  mc_23k640_cs_deactivate();
-  return true;
+  }
+  read = mc_23k640_perform(transfers, 2);
+  mc_23k640_bus_release();
+  return read;
 }
 
 /*
- * @brief Function to write data in external RAM.
+ * @brief Function to write data in the circular buffer of external RAM, producer side.
  *
- * @param[in] data Pointer to data buffer to be written.
- * @param[in] nbytes Number of bytes of data to be written.
- * @retval The number of bytes written. 
+ * @param[in] data Pointer to data buffer to be written, must be in RAM for the EasyDMA.
+ * @param[in] bytes Number of bytes of data to be written.
+ * @retval The number of bytes written, up to MC_23K640_MAX_TRANSFER_SIZE, or 0 if there is no space.
+ * @note One access of the bus, see MC_23K640_ARBITRATION. The bytes appended before are published with them.
  */
-uint8_t mc_23k640_write_data(uint8_t *data, uint16_t bytes) {
-  uint8_t nbytes = bytes;
-  if(!bytes || data == NULL) {
+uint16_t mc_23k640_write_data(uint8_t *data, uint16_t bytes) {
+  uint16_t written;
+
+  if(!bytes || data == NULL || !mc_23k640_bus_acquire()) {
     return 0;
   }
-  
-  if(bytes >= MC_23K640_SINGLE_TRANSFER_SIZE) {
-    nbytes = MC_23K640_SINGLE_TRANSFER_SIZE;
-  } 
+  written = mc_23k640_write_ring(data, bytes, true);
+  mc_23k640_bus_release();
 
-  /* Get current head index */
-  if(!mc_23k640_read_circular_idx()) {
+  return written;
+}
+
+/*
+ * @brief Function to append data in the circular buffer of external RAM without publishing the head, producer side.
+ *
+ * @param[in] data Pointer to data buffer to be written, must be in RAM for the EasyDMA.
+ * @param[in] bytes Number of bytes of data to be written.
+ * @retval The number of bytes written, up to MC_23K640_MAX_TRANSFER_SIZE, or 0 if there is no space.
+ * @note One access of the bus. MCU2 sees the bytes after mc_23k640_publish_data() or the next
+ *       mc_23k640_write_data(), so a record written in several accesses is seen whole or not at all.
+ */
+uint16_t mc_23k640_append_data(uint8_t *data, uint16_t bytes) {
+  uint16_t written;
+
+  if(!bytes || data == NULL || !mc_23k640_bus_acquire()) {
     return 0;
   }
-  uint16_t current_index = circular_buffer.head;
+  written = mc_23k640_write_ring(data, bytes, false);
+  mc_23k640_bus_release();
 
-  /* If we reach the end of the buffer, turn around */
-  if((nbytes + circular_buffer.head >=  CONFIG_MEMORY_ADDR) && (circular_buffer.tail > nbytes)) { 
-    current_index = 0;
-  } else if ((nbytes + circular_buffer.head >=  CONFIG_MEMORY_ADDR) && (circular_buffer.tail <= nbytes)) {
-    /* We don't have space to write */
-    return 0;
+  return written;
+}
+
+/*
+ * @brief Function to publish the head after the bytes appended, producer side.
+ *
+ * @retval True if the head was written.
+ * @note One access of the bus.
+ */
+bool mc_23k640_publish_data(void) {
+  bool written;
+
+  if(circular_buffer.head == _published_head) {
+    return true;
+  }
+  if(!mc_23k640_bus_acquire()) {
+    return false;
+  }
+  written = mc_23k640_write_index(HEAD_INDEX_MEMORY_ADDR, circular_buffer.head);
+  mc_23k640_bus_release();
+  if(written) {
+    _published_head = circular_buffer.head;
   }
 
-  ///* In case the circular buffer is full */
-  //if(circular_buffer_free_space() < nbytes) {
-  //  return 0;
-  //}
-  
-  /* Write Head */
-  _mc_23k640_buffer[0] = MC_23K640_WRITE_CMD;
-  utils_save_uint16_t_to_array(&_mc_23k640_buffer[1], HEAD_INDEX_MEMORY_ADDR);
+  return written;
+}
 
-  /* Write the head index on RAM */
-  utils_save_uint16_t_to_array(&_mc_23k640_buffer[3], current_index + nbytes);
+/*
+ * @brief Function to drop the bytes appended and not published, producer side.
+ *
+ * @note Their space is written again by the next data, MCU2 never saw them.
+ */
+void mc_23k640_discard_data(void) {
+  _bytes_written -= (circular_buffer.head + DATA_MEMORY_SIZE - _published_head) % DATA_MEMORY_SIZE;
+  circular_buffer.head = _published_head;
+}
 
-  /* Write data CMD */
-  _mc_23k640_buffer[5] = MC_23K640_WRITE_CMD;
-  utils_save_uint16_t_to_array(&_mc_23k640_buffer[6], DATA_MEMORY_ADDR + current_index);
+/*
+ * @brief Function to write data in the circular buffer with the bus acquired.
+ *
+ * @param[in] data Pointer to data buffer to be written, must be in RAM for the EasyDMA.
+ * @param[in] bytes Number of bytes of data to be written.
+ * @param[in] publish True to write the head after the data, false to leave the data unpublished.
+ * @retval The number of bytes written, up to MC_23K640_MAX_TRANSFER_SIZE, or 0 if there is no space.
+ * @note The tail is only read from RAM when the cached one says the ring is full. The head is written after the
+ *       data, so the consumer never reads bytes not yet written.
+ */
+uint16_t mc_23k640_write_ring(uint8_t *data, uint16_t bytes, bool publish) {
+  uint16_t nbytes = bytes;
+  uint16_t first;
+  uint16_t head;
 
-  /* Copy data to internal buffer */
-  memcpy(&_mc_23k640_buffer[8], data, nbytes);
-  
-  nrf_spi_mngr_transfer_t transfers[] = {                      
-    MC_23K640_TRANSFER(_mc_23k640_buffer, MC_23K640_INDEX_SIZE + MC_23K640_CMD_TRANSFER_SIZE, NULL, 0), /* Index */
-    MC_23K640_TRANSFER(&_mc_23k640_buffer[5], nbytes + MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),   /* Data + cmd */
-  };
+  if(bytes >= MC_23K640_MAX_TRANSFER_SIZE) {
+    nbytes = MC_23K640_MAX_TRANSFER_SIZE;
+  } 
 
-  /* Write current index in RAM */
-  mc_23k640_cs_activate();
-  nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[0], 1, NULL);
-  mc_23k640_cs_deactivate();
+  /* In case the circular buffer looks full, the consumer may have read since */
+  if(circular_buffer_free_space() < nbytes) {
+    if(!mc_23k640_read_index(TAIL_INDEX_MEMORY_ADDR, &circular_buffer.tail) || circular_buffer_free_space() < nbytes) {
+      return 0;
+    }
+  }
 
-  /* Write data in RAM */
-  mc_23k640_cs_activate();
-  nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[1], 1, NULL);
-  mc_23k640_cs_deactivate();
- 
+  /* If we reach the end of the buffer, turn around */
+  first = DATA_MEMORY_SIZE - circular_buffer.head;
+  if(first > nbytes) {
+    first = nbytes;
+  }
+  if(!mc_23k640_write_segment(circular_buffer.head, data, first)) {
+    return 0;
+  }
+  if(first < nbytes && !mc_23k640_write_segment(0, &data[first], nbytes - first)) {
+    return 0;
+  }
 
-  /* Clear static indexes */
-  circular_buffer.tail = 0;
-  circular_buffer.head = 0;
-  
+  /* Publish the new head */
+  head = (circular_buffer.head + nbytes) % DATA_MEMORY_SIZE;
+  if(publish) {
+    if(!mc_23k640_write_index(HEAD_INDEX_MEMORY_ADDR, head)) {
+      return 0;
+    }
+    _published_head = head;
+  }
+  circular_buffer.head = head;
+  _bytes_written += nbytes;
 
   return nbytes;
 }
 
 /*
- * @brief Function to read data from external RAM.
+ * @brief Function to read data from the circular buffer of external RAM, consumer side.
  *
- * @param[in] data Pointer to data buffer to be read.
- * @retval Number of bytes read, -1 on error.
+ * @param[out] data Pointer to data buffer to be read.
+ * @param[in] max_bytes Size of the data buffer.
+ * @param[out] status MC_23K640_DONE if bytes were read, or why none were.
+ * @retval Number of bytes read, up to MC_23K640_MAX_TRANSFER_SIZE, or 0 if none.
+ * @note One access of the bus, see MC_23K640_ARBITRATION. Only MC_23K640_EMPTY says the ring is empty.
  */
-uint16_t mc_23k640_read_data(uint8_t *data) {
-
-  uint16_t remaining_bytes = 0;
-  uint16_t read_size;
+uint16_t mc_23k640_read_data(uint8_t *data, uint16_t max_bytes, mc_23k640_status *status) {
+  uint16_t read;
 
-  if(data == NULL) {
+  if(data == NULL || !max_bytes) {
+    *status = MC_23K640_FAILED;
     return 0;
   }
-  /* Get current index */
-  if(!mc_23k640_read_circular_idx()) {
+  if(!mc_23k640_bus_acquire()) {
+    *status = MC_23K640_BUSY;
     return 0;
   }
-  uint16_t current_index = circular_buffer.tail;
+  read = mc_23k640_read_ring(data, max_bytes, status);
+  mc_23k640_bus_release();
+
+  return read;
+}
+
+/*
+ * @brief Function to read data from the circular buffer with the bus acquired.
+ *
+ * @param[out] data Pointer to data buffer to be read.
+ * @param[in] max_bytes Size of the data buffer.
+ * @param[out] status MC_23K640_DONE, MC_23K640_EMPTY or MC_23K640_FAILED.
+ * @retval Number of bytes read, up to MC_23K640_MAX_TRANSFER_SIZE, or 0 if none.
+ * @note The head is only read from RAM when the cached one says the ring is empty.
+ */
+uint16_t mc_23k640_read_ring(uint8_t *data, uint16_t max_bytes, mc_23k640_status *status) {
+  uint16_t nbytes;
+  uint16_t first;
+  uint16_t tail;
+
+  *status = MC_23K640_FAILED;
+
+  /* In case the circular buffer looks empty, the producer may have written since */
+  if(!circular_buffer_occupied_space()) {
+    if(!mc_23k640_read_index(HEAD_INDEX_MEMORY_ADDR, &circular_buffer.head)) {
+      return 0;
+    }
+    if(!circular_buffer_occupied_space()) {
+      *status = MC_23K640_EMPTY;
+      return 0;
+    }
+  }
+
+  nbytes = circular_buffer_occupied_space();
+  if(nbytes > max_bytes) {
+    nbytes = max_bytes;
+  }
+  if(nbytes > MC_23K640_MAX_TRANSFER_SIZE) {
+    nbytes = MC_23K640_MAX_TRANSFER_SIZE;
+  }
 
   /* We're on the end of the buffer, and we have data on the beginning */
-  if((CONFIG_MEMORY_ADDR - current_index) < circular_buffer_occupied_space()) {
-    read_size = (CONFIG_MEMORY_ADDR - current_index) + 1;
-    remaining_bytes = circular_buffer_occupied_space() - read_size;
-    current_index = 0;
-  } else if(MC_23K640_MAX_TRANSFER_SIZE <= circular_buffer_occupied_space()) {
-    read_size = MC_23K640_MAX_TRANSFER_SIZE;
-    remaining_bytes = circular_buffer_occupied_space() - read_size;
-    current_index += read_size;
-  } else {
-    read_size = circular_buffer_occupied_space();
-    current_index += read_size;
+  first = DATA_MEMORY_SIZE - circular_buffer.tail;
+  if(first > nbytes) {
+    first = nbytes;
+  }
+  if(!mc_23k640_read_segment(circular_buffer.tail, data, first)) {
+    return 0;
+  }
+  if(first < nbytes && !mc_23k640_read_segment(0, &data[first], nbytes - first)) {
+    return 0;
   }
 
-  /* Store tail index */
-  _mc_23k640_buffer[0] = MC_23K640_WRITE_CMD;
-  utils_save_uint16_t_to_array(&_mc_23k640_buffer[1], TAIL_INDEX_MEMORY_ADDR);
-
-  /* Index value */
-  utils_save_uint16_t_to_array(&_mc_23k640_buffer[3], current_index);
-
-  /* Read cmd and address */
-  _mc_23k640_buffer[5] = MC_23K640_READ_CMD;
-  utils_save_uint16_t_to_array(&_mc_23k640_buffer[6], DATA_MEMORY_ADDR + circular_buffer.tail);
-
-  if(read_size <= MC_23K640_SINGLE_TRANSFER_SIZE) {
-    nrf_spi_mngr_transfer_t transfers[] = {                      
-      MC_23K640_TRANSFER(&_mc_23k640_buffer[0], MC_23K640_INDEX_SIZE + MC_23K640_CMD_TRANSFER_SIZE, NULL, 0), /* Write index */
-      MC_23K640_TRANSFER(&_mc_23k640_buffer[5], MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),                        /* Write a read cmd */
-      MC_23K640_TRANSFER(NULL, 0, data, read_size)                                                            /* Read data */ 
-    };
-
-   /* Write current index in RAM */
-    mc_23k640_cs_activate();
-    if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[0], 1, NULL) != NRF_SUCCESS) {
-      mc_23k640_cs_deactivate();
-      return -1;
-    } 
-    mc_23k640_cs_deactivate();
+  /* Release the space to the producer */
+  tail = (circular_buffer.tail + nbytes) % DATA_MEMORY_SIZE;
+  if(!mc_23k640_write_index(TAIL_INDEX_MEMORY_ADDR, tail)) {
+    return 0;
+  }
+  circular_buffer.tail = tail;
+  _bytes_read += nbytes;
 
-    /* Read data in RAM */
-    mc_23k640_cs_activate();
-    if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[1], 2, NULL) != NRF_SUCCESS) {
-      mc_23k640_cs_deactivate();
-      return -1;
-    } 
+  *status = MC_23K640_DONE;
+  return nbytes;
+}
 
-  /* In case we need to perform 2 transfers */
-  } else {
-    nrf_spi_mngr_transfer_t transfers[] = {                      
-      MC_23K640_TRANSFER(&_mc_23k640_buffer[0], MC_23K640_INDEX_SIZE + MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),   /* Write index */
-      MC_23K640_TRANSFER(&_mc_23k640_buffer[5], MC_23K640_CMD_TRANSFER_SIZE, NULL, 0),                          /* Write a read cmd */
-      MC_23K640_TRANSFER(NULL, 0, data, MC_23K640_SINGLE_TRANSFER_SIZE),                                        /* Read data */ 
-      MC_23K640_TRANSFER(NULL, 0, &data[MC_23K640_SINGLE_TRANSFER_SIZE], read_size - MC_23K640_SINGLE_TRANSFER_SIZE)  /* Read data */ 
-    };
-
-   /* Write current index in RAM */
-    mc_23k640_cs_activate();
-    if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[0], 1, NULL) != NRF_SUCCESS) {
-      mc_23k640_cs_deactivate();
-      return -1;
-    } 
-    mc_23k640_cs_deactivate();
+/*
+ * @brief Function to get the number of SPI transactions with external RAM.
+ *
+ * @retval Number of CS framed transactions of the data and index accesses.
+ */
+uint32_t mc_23k640_get_transactions(void) {
+  return _transactions;
+}
 
-    /* Read data in RAM */
-    mc_23k640_cs_activate();
-    if(nrf_spi_mngr_perform(_p_spi_mngr, &_spi_config_8m, &transfers[1], 3, NULL) != NRF_SUCCESS) {
-      mc_23k640_cs_deactivate();
-      return -1;
-    } 
+/*
+ * @brief Function to get the throughput of the circular buffer while this MCU holds the bus.
+ *
+ * @retval Data bytes written and read per second of bus hold time, 0 before the first access.
+ * @note The hold time has the index and config accesses too, the result is the effective throughput.
+ */
+uint32_t mc_23k640_get_throughput(void) {
+  if(!_arb_stats.hold.total) {
+    return 0;
   }
-  mc_23k640_cs_deactivate();
-  
-  /* Clear static indexes */
-  circular_buffer.tail = 0;
-  circular_buffer.head = 0;
+  return (uint32_t)((uint64_t)(_bytes_written + _bytes_read) * CYCLE_COUNTER_CPU_FREQ_MHZ * 1000000 / _arb_stats.hold.total);
+}
+
+/*
+ * @brief Function to get the statistics of the bus arbitration.
+ *
+ * @retval Wait and hold times of the accesses of this MCU, in cycles, grants and timeouts.
+ */
+mc_23k640_arb_stats *mc_23k640_get_arb_stats(void) {
+  return &_arb_stats;
+}
+
+/*
+ * @brief Function to get the free space of the circular buffer, producer side.
+ *
+ * @retval Free bytes, a lower bound since the consumer may have read since.
+ * @note The tail is read from RAM when the cached one leaves less than MC_23K640_FREE_REFRESH bytes, so a
+ *       producer that backed off sees the space freed by the consumer.
+ */
+uint16_t mc_23k640_get_free_space(void) {
+  if(circular_buffer_free_space() < MC_23K640_FREE_REFRESH && mc_23k640_bus_acquire()) {
+    mc_23k640_read_index(TAIL_INDEX_MEMORY_ADDR, &circular_buffer.tail);
+    mc_23k640_bus_release();
+  }
+  return circular_buffer_free_space();
+}
+
+#if MC_23K640_FAULT_INJECTION
+/*
+ * @brief Function to get the faults injected so far.
+ *
+ * @retval Torn writes and bit flips.
+ */
+mc_23k640_fault_stats *mc_23k640_get_fault_stats(void) {
+  return &_fault_stats;
+}
 
-  /* Return the remaining data size in RAM */
-  return remaining_bytes;
-}
\ No newline at end of file
+/*
+ * @brief Function to get the next number of the random generator of the faults, xorshift32.
+ *
+ * @retval Random number.
+ * @note Seeded from the cycle counter on the first call, so each run injects different faults.
+ */
+uint32_t mc_23k640_fault_random(void) {
+  if(!_fault_seed) {
+    _fault_seed = cycle_counter_get() | 1;
+  }
+  _fault_seed ^= _fault_seed << 13;
+  _fault_seed ^= _fault_seed >> 17;
+  _fault_seed ^= _fault_seed << 5;
+  return _fault_seed;
+}
+#endif
@@ -21,6 +21,9 @@
 /* Config */
 #include "config.h"
 
+/* Utilities */
+#include "cycle_counter.h"
+
 /* standard library */
 #include <stdint.h>
 #include <stdbool.h>
@@ -29,11 +32,54 @@
 /********************************** Definitions ***********************************/
 #define MC_23k640_CS1                  NRF_GPIO_PIN_MAP(0, 30)        /* */
 
+/* Bus arbitration between the MCUs, MCU1 is the arbiter and owns the bus when idle.
+ * MCU2 raises REQ and waits for GNT, does one access and drops REQ, then MCU1 drops GNT.
+ * MCU1 does not grant during its own accesses, and grants a pending REQ right after each
+ * of them, so neither side waits for more than one access of the other.
+ * Only for the boards with the REQ/GNT wires between the MCUs on P0.27/P0.28, 0 on the others */
+#define MC_23K640_ARBITRATION          0
+#define MC_23K640_ARB_REQ_PIN          NRF_GPIO_PIN_MAP(0, 27)        /* MCU2 output, MCU1 input */
+#define MC_23K640_ARB_GNT_PIN          NRF_GPIO_PIN_MAP(0, 28)        /* MCU1 output, MCU2 input */
+#define MC_23K640_ARB_HOLD_US          1000                           /* Longest access, MC_23K640_MAX_TRANSFER_SIZE and the index at 8 MHz */
+#define MC_23K640_ARB_TIMEOUT_US       (2 * MC_23K640_ARB_HOLD_US)    /* Wait for the peer before giving up */
+#define MC_23K640_ARB_INIT_RETRIES     100                            /* Init, waits for the bus of a booting MCU1 or an access of MCU2 */
+#define MC_23K640_ARB_INIT_DELAY_MS    10
+
+/* Fault injection, to stress the ring and the records framing on target, 0 in production.
+ * A torn write stores only the first part of a data segment and still succeeds, so the head covers stale bytes.
+ * A bit flip inverts one bit of a data segment read, as noise on the bus would */
+#define MC_23K640_FAULT_INJECTION      0
+#define MC_23K640_FAULT_TORN_RATE      1000                           /* One torn write in N data segments, 0 for none */
+#define MC_23K640_FAULT_FLIP_RATE      1000                           /* One bit flip in N data segments read, 0 for none */
+
+/* Faults injected */
+typedef struct {
+  uint32_t  torn_writes;
+  uint32_t  bit_flips;
+} mc_23k640_fault_stats;
+
+/* Bus arbitration statistics */
+typedef struct {
+  cycle_counter_stats wait;       /* Wait for the bus, MC_23K640_ARB_HOLD_US as budget */
+  cycle_counter_stats hold;       /* Own accesses, MC_23K640_ARB_HOLD_US as budget */
+  uint32_t            grants;     /* MCU1: grants given, MCU2: grants received */
+  uint32_t            timeouts;   /* Waits above MC_23K640_ARB_TIMEOUT_US */
+} mc_23k640_arb_stats;
+
+
+/* Status of an access of the circular buffer */
+typedef enum {
+  MC_23K640_DONE,                 /* Bytes moved */
+  MC_23K640_EMPTY,                /* Read: nothing written since, after reading the head again */
+  MC_23K640_BUSY,                 /* Bus not granted within MC_23K640_ARB_TIMEOUT_US, nothing sent */
+  MC_23K640_FAILED                /* SPI transfer failed or an index out of the data region */
+} mc_23k640_status;
 
-/* Circular buffer struct */
+
+/* Circular buffer struct, indexes in the data region */
 typedef struct {
-  uint16_t  head;       /* Head index */
-  uint16_t  tail;       /* Tail index */
+  uint16_t  head;       /* Head index, next byte to write, owned by MCU1 */
+  uint16_t  tail;       /* Tail index, next byte to read, owned by MCU2 */
 } circular_struct;
 
 
@@ -43,12 +89,20 @@ typedef struct {
 #define DATA_MEMORY_ADDR               (0x0010)    /* Address of device data region */
 #define TAIL_INDEX_MEMORY_ADDR         (0x0000)    /* Address of device written bytes region */
 #define HEAD_INDEX_MEMORY_ADDR         (0x0005)    /* Address of device written bytes region */
+#define RING_MARKER_MEMORY_ADDR        (0x000A)    /* Address of the ring marker, written by MCU2 after the indexes */
 #define DATA_MEMORY_SIZE               (CONFIG_MEMORY_ADDR - DATA_MEMORY_ADDR)
 /* Sizes */
 #define MC_23K640_INDEX_SIZE           (2)         /*    */
+#define MC_23K640_MARKER_SIZE          (4)         /* Ring marker */
+#define MC_23K640_RING_STATE_SIZE      (RING_MARKER_MEMORY_ADDR + MC_23K640_MARKER_SIZE)  /* Indexes and marker, read in one access */
 #define MC_23K640_BUFFER_SIZE          (520)       /* Size in bytes of a Page */
 #define MC_23K640_MAX_TRANSFER_SIZE    (500)       /* Maximum size in bytes of a dual transfer */
 #define MC_23K640_SINGLE_TRANSFER_SIZE (250)       /* Size in bytes of a single transfer */
+#define MC_23K640_FREE_REFRESH         (2 * MC_23K640_MAX_TRANSFER_SIZE)  /* Free space under which the tail is read again */
+
+/* Ring marker, random after a power-up. With it in RAM the indexes are valid and an MCU that reboots takes them
+ * back instead of starting the ring again under the other one */
+#define MC_23K640_RING_MARKER          (0x2364A55AUL)
 
 /* Commands */
 #define MC_23K640_READ_CMD             (0x03)                 /* */
@@ -70,10 +124,20 @@ typedef struct {
 
 /********************************** Functions ***********************************/
 bool mc_23k640_init(void);
-uint16_t mc_23k640_read_data(uint8_t *data);
-uint8_t mc_23k640_write_data(uint8_t *data, uint16_t bytes);
+uint16_t mc_23k640_read_data(uint8_t *data, uint16_t max_bytes, mc_23k640_status *status);
+uint16_t mc_23k640_write_data(uint8_t *data, uint16_t bytes);
+uint16_t mc_23k640_append_data(uint8_t *data, uint16_t bytes);
+bool mc_23k640_publish_data(void);
+void mc_23k640_discard_data(void);
 bool mc_23k640_read_config(uint8_t *data, uint16_t nbytes);
 bool mc_23k640_write_config(uint8_t *data, uint16_t nbytes);
+uint32_t mc_23k640_get_transactions(void);
+mc_23k640_arb_stats *mc_23k640_get_arb_stats(void);
+uint16_t mc_23k640_get_free_space(void);
+uint32_t mc_23k640_get_throughput(void);
+#if MC_23K640_FAULT_INJECTION
+mc_23k640_fault_stats *mc_23k640_get_fault_stats(void);
+#endif
 #endif /* MC_23K640_H_ */
 
 
@@ -0,0 +1,415 @@
+/*
+* @file           ecg_codec.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the lossless ECG frames codec, second-order
+*                 prediction per lead, zig-zag and adaptive Rice coding in
+*                 self-contained blocks.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "ecg_codec.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* ----------------------------------------------------------------------
+** Frame bit stream
+**   sample index   0 if it follows the previous frame, otherwise 1 and 32 bits
+**   status         0 if equal to the previous frame, otherwise 1 and ECG_CODEC_STATUS_BITS bits
+**   fields         0 if all 0, otherwise 1 and for each field 0, or 1 and 16 bits
+**   channels       Rice code of the zig-zag prediction residual, in order
+** The prediction is 0 on the first frame of a block, the previous sample on
+** the second one and 2 * x[n-1] - x[n-2] from then on. The Rice parameter
+** of each channel follows the running mean of its residuals, the same way
+** in the encoder and in the decoder.
+** ------------------------------------------------------------------- */
+
+/* Private functions list */
+static void _ecg_codec_restart(ecg_codec *codec);
+static int32_t _ecg_codec_predict(const ecg_codec *codec, const ecg_codec_channel *channel);
+static uint8_t _ecg_codec_update(ecg_codec_channel *channel, int32_t value, uint32_t residual);
+static uint8_t _ecg_codec_get_k(const ecg_codec_channel *channel);
+static void _ecg_codec_put(ecg_codec *codec, uint32_t value, uint8_t count);
+static uint32_t _ecg_codec_get(ecg_codec *codec, uint8_t count);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to start an encoder on a block buffer
+*
+* @param[in]   codec                  Pointer to the codec structure
+* @param[in]   type                   Record type, first byte of each block
+* @param[in]   channels               Channels in each frame, up to ECG_CODEC_MAX_CHANNELS
+* @param[out]  block                  Block buffer
+* @param[in]   size                   Block buffer size, at least ECG_CODEC_HEADER_SIZE + ECG_CODEC_FRAME_MAX(channels)
+* @retval                             Returns true if successful, or false if the parameters are invalid
+*/
+bool ecg_codec_encoder_init(ecg_codec *codec, uint8_t type, uint8_t channels, uint8_t *block, uint16_t size) {
+
+  if(!channels || channels > ECG_CODEC_MAX_CHANNELS || size < ECG_CODEC_HEADER_SIZE + ECG_CODEC_FRAME_MAX(channels) + 1) {
+    return false;
+  }
+
+  codec->type = type;
+  codec->channels_count = channels;
+  codec->out = block;
+  codec->in = NULL;
+  codec->size = size;
+  codec->error = false;
+  _ecg_codec_restart(codec);
+  return true;
+
+}
+
+
+/*
+* @brief Function to add one frame to the block
+*
+* @param[in]   codec                  Pointer to the codec structure
+* @param[in]   frame                  Frame, only the configured channels are used
+* @retval                             Returns true when the block is complete, it must then be closed with
+*                                     ecg_codec_finish() before the next frame
+*/
+bool ecg_codec_encode(ecg_codec *codec, const ecg_codec_frame *frame) {
+
+  bool fields = false;
+
+  /* Header of a new block, the frames count and size are written by ecg_codec_finish() */
+  if(!codec->frames) {
+    codec->out[0] = codec->type;
+    codec->out[1] = codec->channels_count;
+    for(uint8_t i = 0 ; i < 4 ; i++) {
+      codec->out[5 + i] = (uint8_t)(frame->sample >> (24 - 8 * i));
+    }
+    codec->pos = ECG_CODEC_HEADER_SIZE;
+    codec->sample = frame->sample - 1;
+  }
+
+  /* Sample index, a gap means dropped frames */
+  if(frame->sample == codec->sample + 1) {
+    _ecg_codec_put(codec, 0, 1);
+  } else {
+    _ecg_codec_put(codec, 1, 1);
+    _ecg_codec_put(codec, frame->sample >> 16, 16);
+    _ecg_codec_put(codec, frame->sample & 0xFFFF, 16);
+  }
+  codec->sample = frame->sample;
+
+  /* Status */
+  if(frame->status == codec->status) {
+    _ecg_codec_put(codec, 0, 1);
+  } else {
+    _ecg_codec_put(codec, (1 << ECG_CODEC_STATUS_BITS) | frame->status, ECG_CODEC_STATUS_BITS + 1);
+    codec->status = frame->status;
+  }
+
+  /* Sparse fields */
+  for(uint8_t i = 0 ; i < ECG_CODEC_FIELDS ; i++) {
+    fields |= (frame->fields[i] != 0);
+  }
+  _ecg_codec_put(codec, fields, 1);
+  for(uint8_t i = 0 ; fields && i < ECG_CODEC_FIELDS ; i++) {
+    if(frame->fields[i]) {
+      _ecg_codec_put(codec, 0x10000 | frame->fields[i], 17);
+    } else {
+      _ecg_codec_put(codec, 0, 1);
+    }
+  }
+
+  /* Channels */
+  for(uint8_t ch = 0 ; ch < codec->channels_count ; ch++) {
+    ecg_codec_channel *channel = &codec->channels[ch];
+    int32_t residual = frame->channels[ch] - _ecg_codec_predict(codec, channel);
+    uint32_t zigzag = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+    uint8_t k = _ecg_codec_update(channel, frame->channels[ch], zigzag);
+    uint32_t quotient = zigzag >> k;
+
+    if(quotient < ECG_CODEC_ESCAPE) {
+      _ecg_codec_put(codec, ((1UL << quotient) - 1) << 1, quotient + 1);
+      if(k > 16) {
+        _ecg_codec_put(codec, (zigzag >> 16) & ((1UL << (k - 16)) - 1), k - 16);
+        _ecg_codec_put(codec, zigzag & 0xFFFF, 16);
+      } else if(k) {
+        _ecg_codec_put(codec, zigzag & ((1UL << k) - 1), k);
+      }
+    } else {
+      _ecg_codec_put(codec, (1UL << ECG_CODEC_ESCAPE) - 1, ECG_CODEC_ESCAPE);
+      _ecg_codec_put(codec, zigzag >> 16, 16);
+      _ecg_codec_put(codec, zigzag & 0xFFFF, 16);
+    }
+  }
+
+  codec->frames++;
+  return codec->frames == ECG_CODEC_BLOCK_FRAMES || codec->size - codec->pos < ECG_CODEC_FRAME_MAX(codec->channels_count) + 1;
+
+}
+
+
+/*
+* @brief Function to close the block, the next frame starts a new one
+*
+* @param[in]   codec                  Pointer to the codec structure
+* @return                             Returns the block size in bytes, or 0 if the block has no frames
+*/
+uint16_t ecg_codec_finish(ecg_codec *codec) {
+
+  uint16_t size;
+
+  if(!codec->frames) {
+    return 0;
+  }
+
+  /* Pad the last byte */
+  if(codec->bits_count) {
+    codec->out[codec->pos++] = (uint8_t)(codec->bits << (8 - codec->bits_count));
+  }
+
+  size = codec->pos;
+  codec->out[2] = codec->frames;
+  codec->out[3] = (uint8_t)(size >> 8);
+  codec->out[4] = (uint8_t)size;
+
+  _ecg_codec_restart(codec);
+  return size;
+
+}
+
+
+/*
+* @brief Function to start a decoder on a block
+*
+* @param[in]   codec                  Pointer to the codec structure
+* @param[in]   block                  Block, starting with its header
+* @param[in]   size                   Bytes available, at least the block size
+* @retval                             Returns true if successful, or false if the header is invalid
+*/
+bool ecg_codec_decoder_init(ecg_codec *codec, const uint8_t *block, uint16_t size) {
+
+  uint16_t block_size;
+
+  if(size < ECG_CODEC_HEADER_SIZE) {
+    return false;
+  }
+
+  block_size = ((uint16_t)block[3] << 8) | block[4];
+  if(!block[1] || block[1] > ECG_CODEC_MAX_CHANNELS || !block[2] || block[2] > ECG_CODEC_BLOCK_FRAMES ||
+     block_size < ECG_CODEC_HEADER_SIZE || block_size > size) {
+    return false;
+  }
+
+  codec->type = block[0];
+  codec->channels_count = block[1];
+  codec->out = NULL;
+  codec->in = block;
+  codec->size = block_size;
+  codec->error = false;
+  _ecg_codec_restart(codec);
+
+  codec->block_frames = block[2];
+  codec->pos = ECG_CODEC_HEADER_SIZE;
+  codec->sample = (((uint32_t)block[5] << 24) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 8) | block[8]) - 1;
+  return true;
+
+}
+
+
+/*
+* @brief Function to get the next frame of the block
+*
+* @param[in]   codec                  Pointer to the codec structure
+* @param[out]  frame                  Frame, only the channels of the block are written
+* @retval                             Returns true if successful, or false at the end of the block or if it is corrupted
+*/
+bool ecg_codec_decode(ecg_codec *codec, ecg_codec_frame *frame) {
+
+  if(codec->frames == codec->block_frames || codec->error) {
+    return false;
+  }
+
+  /* Sample index */
+  if(_ecg_codec_get(codec, 1)) {
+    codec->sample = _ecg_codec_get(codec, 16) << 16;
+    codec->sample |= _ecg_codec_get(codec, 16);
+  } else {
+    codec->sample++;
+  }
+  frame->sample = codec->sample;
+
+  /* Status */
+  if(_ecg_codec_get(codec, 1)) {
+    codec->status = (uint16_t)_ecg_codec_get(codec, ECG_CODEC_STATUS_BITS);
+  }
+  frame->status = codec->status;
+
+  /* Sparse fields */
+  memset(frame->fields, 0, sizeof(frame->fields));
+  if(_ecg_codec_get(codec, 1)) {
+    for(uint8_t i = 0 ; i < ECG_CODEC_FIELDS ; i++) {
+      if(_ecg_codec_get(codec, 1)) {
+        frame->fields[i] = (uint16_t)_ecg_codec_get(codec, 16);
+      }
+    }
+  }
+
+  /* Channels */
+  for(uint8_t ch = 0 ; ch < codec->channels_count ; ch++) {
+    ecg_codec_channel *channel = &codec->channels[ch];
+    uint8_t k = _ecg_codec_get_k(channel);
+    uint32_t quotient = 0;
+    uint32_t zigzag;
+    int32_t value;
+
+    while(quotient < ECG_CODEC_ESCAPE && _ecg_codec_get(codec, 1)) {
+      quotient++;
+    }
+    if(quotient < ECG_CODEC_ESCAPE) {
+      zigzag = quotient << k;
+      if(k > 16) {
+        zigzag |= _ecg_codec_get(codec, k - 16) << 16;
+        zigzag |= _ecg_codec_get(codec, 16);
+      } else if(k) {
+        zigzag |= _ecg_codec_get(codec, k);
+      }
+    } else {
+      zigzag = _ecg_codec_get(codec, 16) << 16;
+      zigzag |= _ecg_codec_get(codec, 16);
+    }
+
+    value = _ecg_codec_predict(codec, channel) + (int32_t)((zigzag >> 1) ^ (0 - (zigzag & 1)));
+    _ecg_codec_update(channel, value, zigzag);
+    frame->channels[ch] = value;
+  }
+
+  codec->frames++;
+  return !codec->error;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to restart the predictors and the Rice parameters, at each block
+*
+* @param[in]   codec                  Pointer to the codec structure
+*/
+static void _ecg_codec_restart(ecg_codec *codec) {
+
+  for(uint8_t ch = 0 ; ch < ECG_CODEC_MAX_CHANNELS ; ch++) {
+    codec->channels[ch].x1 = 0;
+    codec->channels[ch].x2 = 0;
+    codec->channels[ch].mean = ECG_CODEC_MEAN_INIT;
+  }
+  codec->frames = 0;
+  codec->block_frames = 0;
+  codec->status = 0;
+  codec->pos = 0;
+  codec->bits = 0;
+  codec->bits_count = 0;
+
+}
+
+
+/*
+* @brief Function to predict the next sample of a channel
+*
+* @param[in]   codec                  Pointer to the codec structure
+* @param[in]   channel                Channel state
+* @return                             Returns the prediction in microvolts
+*/
+static int32_t _ecg_codec_predict(const ecg_codec *codec, const ecg_codec_channel *channel) {
+
+  if(codec->frames == 0) {
+    return 0;
+  } else if(codec->frames == 1) {
+    return channel->x1;
+  }
+  return 2 * channel->x1 - channel->x2;
+
+}
+
+
+/*
+* @brief Function to update a channel with a coded sample
+*
+* @param[in]   channel                Channel state
+* @param[in]   value                  Sample in microvolts
+* @param[in]   residual               Zig-zag residual of the sample
+* @return                             Returns the Rice parameter used for the sample
+*/
+static uint8_t _ecg_codec_update(ecg_codec_channel *channel, int32_t value, uint32_t residual) {
+
+  uint8_t k = _ecg_codec_get_k(channel);
+
+  channel->x2 = channel->x1;
+  channel->x1 = value;
+  channel->mean += (residual < ECG_CODEC_MEAN_LIMIT ? residual : ECG_CODEC_MEAN_LIMIT) - (channel->mean >> ECG_CODEC_MEAN_SHIFT);
+  return k;
+
+}
+
+
+/*
+* @brief Function to get the Rice parameter of a channel
+*
+* @param[in]   channel                Channel state
+* @return                             Returns the smallest k with 2^k above the mean residual
+*/
+static uint8_t _ecg_codec_get_k(const ecg_codec_channel *channel) {
+
+  uint8_t k = 0;
+
+  while(((uint32_t)1 << (k + ECG_CODEC_MEAN_SHIFT)) < channel->mean) {
+    k++;
+  }
+  return k;
+
+}
+
+
+/*
+* @brief Function to write bits to the block, MSB first
+*
+* @param[in]   codec                  Pointer to the codec structure
+* @param[in]   value                  Bits to write, right aligned
+* @param[in]   count                  Number of bits, up to 24
+*/
+static void _ecg_codec_put(ecg_codec *codec, uint32_t value, uint8_t count) {
+
+  codec->bits = (codec->bits << count) | (value & ((1UL << count) - 1));
+  codec->bits_count += count;
+  while(codec->bits_count >= 8) {
+    codec->bits_count -= 8;
+    codec->out[codec->pos++] = (uint8_t)(codec->bits >> codec->bits_count);
+  }
+
+}
+
+
+/*
+* @brief Function to read bits from the block, MSB first
+*
+* @param[in]   codec                  Pointer to the codec structure
+* @param[in]   count                  Number of bits, up to 24
+* @return                             Returns the bits right aligned, 0 past the end of the block
+*/
+static uint32_t _ecg_codec_get(ecg_codec *codec, uint8_t count) {
+
+  while(codec->bits_count < count) {
+    if(codec->pos < codec->size) {
+      codec->bits = (codec->bits << 8) | codec->in[codec->pos++];
+    } else {
+      codec->bits <<= 8;
+      codec->error = true;
+    }
+    codec->bits_count += 8;
+  }
+  codec->bits_count -= count;
+  return (codec->bits >> codec->bits_count) & ((1UL << count) - 1);
+
+}
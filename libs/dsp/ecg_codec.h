@@ -0,0 +1,91 @@
+/*
+* @file           ecg_codec.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the lossless ECG frames codec, second-order
+*                 prediction per lead, zig-zag and adaptive Rice coding in
+*                 self-contained blocks.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef ECG_CODEC_H
+#define ECG_CODEC_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+#define ECG_CODEC_MAX_CHANNELS        14        /* ADS1298 and ADS1296R channels */
+#define ECG_CODEC_STATUS_BITS         10        /* Lead-off flags of LA, RA, LL, V1 to V6 and pace */
+#define ECG_CODEC_FIELDS              4         /* Sparse 16-bit fields, mostly 0 (vital signs) */
+#define ECG_CODEC_BLOCK_FRAMES        64        /* Frames per block, the predictors restart on each block */
+
+/* Fields of the frames of app_ecg, its vital signs */
+#define ECG_CODEC_FIELD_HR            0         /* Heart rate in beats per minute */
+#define ECG_CODEC_FIELD_RR            1         /* RR interval in milliseconds, 0 if no beat */
+#define ECG_CODEC_FIELD_R_OFFSET      2         /* Time from the R peak to the frame in milliseconds */
+#define ECG_CODEC_FIELD_RESP          3         /* Breaths per minute, 0 if no new rate */
+
+/* Rice coding */
+#define ECG_CODEC_ESCAPE              16        /* Quotients from this on are sent as 32 raw bits */
+#define ECG_CODEC_MEAN_SHIFT          4         /* Running mean of the residuals over 2^4 samples */
+#define ECG_CODEC_MEAN_INIT           (16 << ECG_CODEC_MEAN_SHIFT)
+#define ECG_CODEC_MEAN_LIMIT          (1UL << 27)
+
+/* Block, big-endian header
+ *   type (1), channels (1), frames (1), block size in bytes (2), sample index of the first frame (4)
+ * followed by the bit stream of the frames, MSB first, padded to the byte */
+#define ECG_CODEC_HEADER_SIZE         9
+#define ECG_CODEC_FRAME_MAX_BITS(channels) \
+  (33 + 1 + ECG_CODEC_STATUS_BITS + 1 + ECG_CODEC_FIELDS * 17 + (channels) * (ECG_CODEC_ESCAPE + 32))
+#define ECG_CODEC_FRAME_MAX(channels) ((ECG_CODEC_FRAME_MAX_BITS(channels) + 7) / 8)
+
+/* Frame */
+typedef struct {
+  uint32_t  sample;                                 /* Sample index */
+  uint16_t  status;                                 /* Lead-off flags in bits 0 to 8, pace in bit 9 */
+  int32_t   channels[ECG_CODEC_MAX_CHANNELS];       /* Microvolts */
+  uint16_t  fields[ECG_CODEC_FIELDS];
+} ecg_codec_frame;
+
+/* Prediction and coding state of one channel */
+typedef struct {
+  int32_t   x1;
+  int32_t   x2;
+  uint32_t  mean;                                   /* Mean zig-zag residual with ECG_CODEC_MEAN_SHIFT bits */
+} ecg_codec_channel;
+
+/* Encoder or decoder of one block */
+typedef struct {
+  uint8_t           channels_count;
+  ecg_codec_channel channels[ECG_CODEC_MAX_CHANNELS];
+  uint32_t          sample;                         /* Sample index of the previous frame */
+  uint16_t          status;                         /* Status of the previous frame */
+  uint8_t           frames;                         /* Frames coded so far in the block */
+  uint8_t           block_frames;                   /* Frames of the block, decoder only */
+
+  /* Block */
+  uint8_t           *out;                           /* Encoder buffer */
+  const uint8_t     *in;                            /* Decoder block */
+  uint16_t          size;
+  uint16_t          pos;                            /* Next byte */
+  uint32_t          bits;                           /* Bits not yet in the buffer, or not yet read */
+  uint8_t           bits_count;
+  uint8_t           type;
+  bool              error;                          /* Decoder read past the end of the block */
+} ecg_codec;
+
+/********************************** Functions ***********************************/
+bool ecg_codec_encoder_init(ecg_codec *codec, uint8_t type, uint8_t channels, uint8_t *block, uint16_t size);
+bool ecg_codec_encode(ecg_codec *codec, const ecg_codec_frame *frame);
+uint16_t ecg_codec_finish(ecg_codec *codec);
+
+bool ecg_codec_decoder_init(ecg_codec *codec, const uint8_t *block, uint16_t size);
+bool ecg_codec_decode(ecg_codec *codec, ecg_codec_frame *frame);
+
+#endif /* ECG_CODEC_H */
@@ -0,0 +1,222 @@
+/*
+* @file           ecg_filter.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the streaming fixed-point ECG filter chain,
+*                 baseline wander high-pass, mains notch and low-pass, made
+*                 of biquads with the state kept per channel.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "ecg_filter.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* ----------------------------------------------------------------------
+** Biquad coefficients from the RBJ Audio EQ Cookbook (bilinear transform),
+** normalized to a0 = 1 and scaled by 2^30:
+**   High-pass  f0 = 0.05 Hz / 0.5 Hz, Q = 1 / sqrt(2) (2nd order Butterworth)
+**   Notch      f0 = 50 Hz / 60 Hz,    Q = 20 (2.5 Hz / 3 Hz stop band)
+**   Low-pass   f0 = 40 Hz / 100 Hz,   Q = 0.541196 and 1.306563 (4th order Butterworth)
+** Order of each row: b0, b1, b2, a1, a2
+** Generated by host/tools/ecg_filter_coeffs, which also checks them against this design
+** ------------------------------------------------------------------- */
+
+/*
+* High-pass coefficients [rate][0.05 Hz, 0.5 Hz]
+*/
+static const ecg_filter_biquad _hp_coeffs[ECG_FILTER_RATES_NUMBER][2] = {
+  { /* 250 SPS */
+    {1072788146, -2145576292, 1072788146, -2145575445, 1071835315},
+    {1064243069, -2128486138, 1064243069, -2128402107, 1054828346},
+  },
+  { /* 500 SPS */
+    {1073264879, -2146529758, 1073264879, -2146529546, 1072788146},
+    {1068981896, -2137963793, 1068981896, -2137942692, 1064243070},
+  },
+};
+
+/*
+* Notch coefficients [rate][50 Hz, 60 Hz]
+*/
+static const ecg_filter_biquad _notch_coeffs[ECG_FILTER_RATES_NUMBER][2] = {
+  { /* 250 SPS */
+    {1048805003, -648197140, 1048805003, -648197140, 1023868182},
+    {1047603419, -131559126, 1047603419, -131559126, 1021465013},
+  },
+  { /* 500 SPS */
+    {1058192082, -1712190755, 1058192082, -1712190755, 1042642339},
+    {1055675337, -1539108402, 1055675337, -1539108402, 1037608849},
+  },
+};
+
+/*
+* Low-pass coefficients [rate][40 Hz, 100 Hz][section]
+*/
+static const ecg_filter_biquad _lp_coeffs[ECG_FILTER_RATES_NUMBER][2][2] = {
+  { /* 250 SPS */
+    {
+      {139996108, 279992215, 139996108, -646428229, 132670835},
+      {188344910, 376689820, 188344910, -869677511, 549315327},
+    },
+    {
+      {629411333, 1258822667, 629411333, 1125925222, 317978288},
+      {792864982, 1585729963, 792864982, 1418319997, 679398106},
+    },
+  },
+  { /* 500 SPS */
+    {
+      {45954021, 91908043, 45954021, -1302247068, 412321330},
+      {56070277, 112140554, 56070277, -1588921964, 739461248},
+    },
+    {
+      {197464337, 394928673, 197464337, -353234944, 69350466},
+      {271980428, 543960856, 271980428, -486533381, 500713269},
+    },
+  },
+};
+
+/********************************** Public ************************************/
+/*
+* @brief Function to build the filter chain and clear its state
+*
+* @param[in]   filter                 Pointer to the filter structure
+* @param[in]   channels               Number of channels to filter, up to ECG_FILTER_MAX_CHANNELS
+* @param[in]   rate                   Sampling rate of the channels
+* @param[in]   hp                     Baseline wander high-pass
+* @param[in]   notch                  Mains notch
+* @param[in]   lp                     Low-pass
+* @retval                             Returns true if successful, or false if the parameters are invalid
+*/
+bool ecg_filter_init(ecg_filter *filter, uint8_t channels, ecg_filter_rate rate, ecg_filter_hp hp, ecg_filter_notch notch, ecg_filter_lp lp) {
+
+  if(channels > ECG_FILTER_MAX_CHANNELS || rate >= ECG_FILTER_RATES_NUMBER || hp > ECG_FILTER_HP_0_5HZ ||
+     notch > ECG_FILTER_NOTCH_60HZ || lp > ECG_FILTER_LP_100HZ) {
+    return false;
+  }
+
+  filter->channels = channels;
+  filter->stages_number = 0;
+
+  if(hp != ECG_FILTER_HP_OFF) {
+    filter->stages[filter->stages_number++] = &_hp_coeffs[rate][hp - ECG_FILTER_HP_0_05HZ];
+  }
+  if(notch != ECG_FILTER_NOTCH_OFF) {
+    filter->stages[filter->stages_number++] = &_notch_coeffs[rate][notch - ECG_FILTER_NOTCH_50HZ];
+  }
+  if(lp != ECG_FILTER_LP_OFF) {
+    filter->stages[filter->stages_number++] = &_lp_coeffs[rate][lp - ECG_FILTER_LP_40HZ][0];
+    filter->stages[filter->stages_number++] = &_lp_coeffs[rate][lp - ECG_FILTER_LP_40HZ][1];
+  }
+
+  ecg_filter_reset(filter);
+  return true;
+
+}
+
+
+/*
+* @brief Function to clear the state of every channel
+*
+* @param[in]   filter                 Pointer to the filter structure
+*/
+void ecg_filter_reset(ecg_filter *filter) {
+  memset(filter->state, 0, sizeof(filter->state));
+}
+
+
+/*
+* @brief Function to filter in place a block of samples of one channel
+*
+* @param[in]   filter                 Pointer to the filter structure
+* @param[in]   channel                Channel of the samples, selects the state
+* @param[in]   samples                Samples in microvolts, replaced by the filtered samples
+* @param[in]   count                  Number of samples
+* @param[in]   stride                 Distance between consecutive samples in int32_t, 1 if contiguous
+*/
+void ecg_filter_process(ecg_filter *filter, uint8_t channel, int32_t *samples, uint16_t count, uint16_t stride) {
+
+  if(channel >= filter->channels || !filter->stages_number) {
+    return;
+  }
+
+  /* Scale to the internal resolution */
+  for(uint16_t i = 0 ; i < count ; i++) {
+    samples[i * stride] *= (1 << ECG_FILTER_SIGNAL_SHIFT);
+  }
+
+  /* Run the whole block through one stage at a time, so the state stays in registers */
+  for(uint8_t stage = 0 ; stage < filter->stages_number ; stage++) {
+    ecg_filter_biquad_process(filter->stages[stage], &filter->state[channel][stage], samples, count, stride);
+  }
+
+  /* Back to microvolts with rounding */
+  for(uint16_t i = 0 ; i < count ; i++) {
+    samples[i * stride] = (samples[i * stride] + (1 << (ECG_FILTER_SIGNAL_SHIFT - 1))) >> ECG_FILTER_SIGNAL_SHIFT;
+  }
+
+}
+
+
+/*
+* @brief Function to run a block of samples through one biquad, direct form I
+*
+* @param[in]   coeffs                 Biquad coefficients
+* @param[in]   state                  Biquad state of the channel
+* @param[in]   samples                Samples to filter in place
+* @param[in]   count                  Number of samples
+* @param[in]   stride                 Distance between consecutive samples in int32_t
+* @note                               The rounding error of each output is added to the next one (error
+*                                     feedback), needed by the high-pass poles very close to 1. Also used by
+*                                     other modules with their own coefficients
+*/
+void ecg_filter_biquad_process(const ecg_filter_biquad *coeffs, ecg_filter_state *state, int32_t *samples, uint16_t count, uint16_t stride) {
+
+  int32_t x1 = state->x1;
+  int32_t x2 = state->x2;
+  int32_t y1 = state->y1;
+  int32_t y2 = state->y2;
+  int64_t error = state->error;
+
+  for(uint16_t i = 0 ; i < count ; i++) {
+
+    int32_t x0 = samples[i * stride];
+    int64_t acc = error;
+
+    acc += (int64_t)coeffs->b0 * x0;
+    acc += (int64_t)coeffs->b1 * x1;
+    acc += (int64_t)coeffs->b2 * x2;
+    acc -= (int64_t)coeffs->a1 * y1;
+    acc -= (int64_t)coeffs->a2 * y2;
+
+    int64_t y0 = acc >> ECG_FILTER_COEFF_SHIFT;
+    error = acc - (y0 << ECG_FILTER_COEFF_SHIFT);
+
+    /* Saturate */
+    if(y0 > INT32_MAX) {
+      y0 = INT32_MAX;
+    } else if(y0 < INT32_MIN) {
+      y0 = INT32_MIN;
+    }
+
+    x2 = x1;
+    x1 = x0;
+    y2 = y1;
+    y1 = (int32_t)y0;
+    samples[i * stride] = y1;
+  }
+
+  state->x1 = x1;
+  state->x2 = x2;
+  state->y1 = y1;
+  state->y2 = y2;
+  state->error = (int32_t)error;
+
+}
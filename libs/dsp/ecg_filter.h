@@ -0,0 +1,88 @@
+/*
+* @file           ecg_filter.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the streaming fixed-point ECG filter chain,
+*                 baseline wander high-pass, mains notch and low-pass, made
+*                 of biquads with the state kept per channel.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef ECG_FILTER_H
+#define ECG_FILTER_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+#define ECG_FILTER_MAX_CHANNELS       14        /* ADS1298 and ADS1296R channels */
+#define ECG_FILTER_MAX_STAGES         4         /* High-pass, notch and 4th order low-pass */
+#define ECG_FILTER_COEFF_SHIFT        30        /* Coefficients in Q2.30 */
+#define ECG_FILTER_SIGNAL_SHIFT       8         /* Extra fractional bits of the microvolts signal inside the chain */
+
+/* Sampling rates of the ADS129x (ADS129X_CONFIG1_LP_VALUE and ADS129X_CONFIG1_HP_VALUE) */
+typedef enum {
+  ECG_FILTER_250SPS,
+  ECG_FILTER_500SPS,
+  ECG_FILTER_RATES_NUMBER
+} ecg_filter_rate;
+
+/* High-pass for baseline wander */
+typedef enum {
+  ECG_FILTER_HP_OFF,
+  ECG_FILTER_HP_0_05HZ,       /* Diagnostic bandwidth */
+  ECG_FILTER_HP_0_5HZ,        /* Monitoring bandwidth */
+} ecg_filter_hp;
+
+/* Mains notch */
+typedef enum {
+  ECG_FILTER_NOTCH_OFF,
+  ECG_FILTER_NOTCH_50HZ,
+  ECG_FILTER_NOTCH_60HZ,
+} ecg_filter_notch;
+
+/* Low-pass, 4th order Butterworth */
+typedef enum {
+  ECG_FILTER_LP_OFF,
+  ECG_FILTER_LP_40HZ,         /* Monitoring bandwidth */
+  ECG_FILTER_LP_100HZ,        /* Diagnostic bandwidth */
+} ecg_filter_lp;
+
+/* Biquad coefficients in Q2.30, a0 = 1 */
+typedef struct {
+  int32_t   b0;
+  int32_t   b1;
+  int32_t   b2;
+  int32_t   a1;
+  int32_t   a2;
+} ecg_filter_biquad;
+
+/* Biquad state of one channel, direct form I */
+typedef struct {
+  int32_t   x1;
+  int32_t   x2;
+  int32_t   y1;
+  int32_t   y2;
+  int32_t   error;          /* Rounding error fed back to the next output */
+} ecg_filter_state;
+
+/* Filter chain */
+typedef struct {
+  const ecg_filter_biquad   *stages[ECG_FILTER_MAX_STAGES];
+  uint8_t                   stages_number;
+  uint8_t                   channels;
+  ecg_filter_state          state[ECG_FILTER_MAX_CHANNELS][ECG_FILTER_MAX_STAGES];
+} ecg_filter;
+
+/********************************** Functions ***********************************/
+bool ecg_filter_init(ecg_filter *filter, uint8_t channels, ecg_filter_rate rate, ecg_filter_hp hp, ecg_filter_notch notch, ecg_filter_lp lp);
+void ecg_filter_reset(ecg_filter *filter);
+void ecg_filter_process(ecg_filter *filter, uint8_t channel, int32_t *samples, uint16_t count, uint16_t stride);
+void ecg_filter_biquad_process(const ecg_filter_biquad *coeffs, ecg_filter_state *state, int32_t *samples, uint16_t count, uint16_t stride);
+
+#endif /* ECG_FILTER_H */
@@ -0,0 +1,62 @@
+/*
+* @file           ecg_leads.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the derived limb leads (III, aVR, aVL, aVF)
+*                 computed from leads I and II with integer arithmetic.
+*                 Used after the conversion and by readers of recordings
+*                 that only carry the independent leads.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "ecg_leads.h"
+
+/********************************** Public ************************************/
+/*
+* @brief Function to compute one derived limb lead
+*
+* @param[in]   lead                   Derived lead to compute
+* @param[in]   lead_i                 Lead I in microvolts
+* @param[in]   lead_ii                Lead II in microvolts
+* @return                             Returns the derived lead in microvolts
+* @note                               Einthoven and Goldberger relations:
+*                                     III = II - I, aVR = -(I + II) / 2,
+*                                     aVL = I - II / 2, aVF = II - I / 2
+*/
+int32_t ecg_leads_derive(ecg_leads_derived lead, int32_t lead_i, int32_t lead_ii) {
+
+  switch(lead) {
+    case ECG_LEADS_III:
+      return lead_ii - lead_i;
+    case ECG_LEADS_AVR:
+      return -ECG_LEADS_HALF(lead_i + lead_ii);
+    case ECG_LEADS_AVL:
+      return ECG_LEADS_HALF(2 * lead_i - lead_ii);
+    case ECG_LEADS_AVF:
+      return ECG_LEADS_HALF(2 * lead_ii - lead_i);
+    default:
+      return 0;
+  }
+
+}
+
+
+/*
+* @brief Function to compute all the derived limb leads
+*
+* @param[in]   lead_i                 Lead I in microvolts
+* @param[in]   lead_ii                Lead II in microvolts
+* @param[out]  derived                Array of ECG_LEADS_DERIVED_NUMBER leads, III, aVR, aVL and aVF
+*/
+void ecg_leads_derive_all(int32_t lead_i, int32_t lead_ii, int32_t *derived) {
+
+  for(uint8_t lead = 0 ; lead < ECG_LEADS_DERIVED_NUMBER ; lead++) {
+    derived[lead] = ecg_leads_derive((ecg_leads_derived)lead, lead_i, lead_ii);
+  }
+
+}
@@ -0,0 +1,38 @@
+/*
+* @file           ecg_leads.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the derived limb leads (III, aVR, aVL, aVF)
+*                 computed from leads I and II with integer arithmetic.
+*                 Used after the conversion and by readers of recordings
+*                 that only carry the independent leads.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef ECG_LEADS_H
+#define ECG_LEADS_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+
+/********************************** Definitions ***********************************/
+/* Derived limb leads, in the order of the measurements */
+typedef enum {
+  ECG_LEADS_III,
+  ECG_LEADS_AVR,
+  ECG_LEADS_AVL,
+  ECG_LEADS_AVF,
+  ECG_LEADS_DERIVED_NUMBER
+} ecg_leads_derived;
+
+#define ECG_LEADS_HALF(value)     (((value) + 1) >> 1)          /* Division by 2 rounded to nearest */
+
+/********************************** Functions ***********************************/
+int32_t ecg_leads_derive(ecg_leads_derived lead, int32_t lead_i, int32_t lead_ii);
+void ecg_leads_derive_all(int32_t lead_i, int32_t lead_ii, int32_t *derived);
+
+#endif /* ECG_LEADS_H */
@@ -0,0 +1,246 @@
+/*
+* @file           pace_capture.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the pace pulse event capture, edge detection
+*                 on the pace status of the frames, pre-trigger history and
+*                 a window of samples frozen around each event.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "pace_capture.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+#define PACE_CAPTURE_SAMPLE_MAX       ((1 << 23) - 1)       /* Limits of a 24-bit sample */
+#define PACE_CAPTURE_SAMPLE_MIN       (-(1 << 23))
+
+/* Private functions list */
+static void _pace_capture_append(pace_capture *capture, const int32_t *samples, bool pulse);
+static uint8_t *_pace_capture_save_u16(uint8_t *array, uint16_t value);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to configure the event window and clear the capture
+*
+* @param[in]   capture                Pointer to the capture structure
+* @param[in]   rate                   Sampling rate in SPS, stored in the records
+* @param[in]   pre                    Samples kept before the trigger, up to PACE_CAPTURE_MAX_PRE
+* @param[in]   post                   Samples kept from the trigger on, 1 to PACE_CAPTURE_MAX_POST
+* @retval                             Returns true if successful, or false if the window is invalid
+*/
+bool pace_capture_init(pace_capture *capture, uint16_t rate, uint16_t pre, uint16_t post) {
+
+  if(pre > PACE_CAPTURE_MAX_PRE || !post || post > PACE_CAPTURE_MAX_POST) {
+    return false;
+  }
+
+  capture->rate = rate;
+  capture->pre = pre;
+  capture->post = post;
+  pace_capture_reset(capture);
+  return true;
+
+}
+
+
+/*
+* @brief Function to drop the history and any event in progress
+*
+* @param[in]   capture                Pointer to the capture structure
+*/
+void pace_capture_reset(pace_capture *capture) {
+
+  capture->state = PACE_CAPTURE_ARMED;
+  capture->last_pace = false;
+  capture->history_count = 0;
+  capture->window_count = 0;
+  capture->window_pre = 0;
+  capture->pulses = 0;
+  capture->events = 0;
+  capture->missed = 0;
+
+}
+
+
+/*
+* @brief Function to run one sample through the capture
+*
+* @param[in]   capture                Pointer to the capture structure
+* @param[in]   sample                 Sample index, its time comes from the timebase
+* @param[in]   pace                   Pace status of the sample
+* @param[in]   samples                PACE_CAPTURE_CHANNELS samples in microvolts
+* @return                             Returns PACE_CAPTURE_EDGE and/or PACE_CAPTURE_READY, or 0
+* @note                               The pace status is latched, ads129x resets the latch at the read after
+*                                     a pulse so the next pulse makes a new edge
+*/
+uint8_t pace_capture_process(pace_capture *capture, uint32_t sample, bool pace, const int32_t *samples) {
+
+  bool edge = pace && !capture->last_pace;
+  uint8_t result = edge ? PACE_CAPTURE_EDGE : 0;
+
+  capture->last_pace = pace;
+
+  switch(capture->state) {
+    case PACE_CAPTURE_ARMED:
+      if(!edge) {
+        break;
+      }
+
+      /* Trigger, the window starts with the pre-trigger history from the oldest sample */
+      capture->window_pre = (capture->history_count < capture->pre) ? capture->history_count : capture->pre;
+      capture->window_count = 0;
+      capture->pulses = 0;
+      capture->sample = sample;
+      memset(capture->window_pulses, 0, sizeof(capture->window_pulses));
+      for(uint32_t i = capture->history_count - capture->window_pre ; i < capture->history_count ; i++) {
+        _pace_capture_append(capture, capture->history[i & (PACE_CAPTURE_MAX_PRE - 1)],
+                             capture->history_pace[i & (PACE_CAPTURE_MAX_PRE - 1)]);
+      }
+      capture->pulses = 0;                                          /* Pulses before the trigger are only marked */
+      capture->state = PACE_CAPTURE_CAPTURING;
+
+      /* The trigger is the first sample after the history */
+      /* fall through */
+    case PACE_CAPTURE_CAPTURING:
+      _pace_capture_append(capture, samples, edge);
+      if(capture->window_count == capture->window_pre + capture->post) {
+        capture->state = PACE_CAPTURE_FROZEN;
+        capture->events++;
+        result |= PACE_CAPTURE_READY;
+      }
+      break;
+    case PACE_CAPTURE_FROZEN:
+      if(edge) {
+        capture->missed++;
+      }
+      break;
+  }
+
+  /* History is always kept, ready for the next trigger */
+  memcpy(capture->history[capture->history_count & (PACE_CAPTURE_MAX_PRE - 1)], samples, sizeof(capture->history[0]));
+  capture->history_pace[capture->history_count & (PACE_CAPTURE_MAX_PRE - 1)] = edge;
+  capture->history_count++;
+
+  return result;
+
+}
+
+
+/*
+* @brief Function to serialize the frozen event and arm the capture again
+*
+* @param[in]   capture                Pointer to the capture structure
+* @param[in]   type                   Record type, first byte of the record
+* @param[out]  record                 Buffer with PACE_CAPTURE_RECORD_MAX bytes
+* @return                             Returns the record size in bytes, or 0 if there is no frozen event
+*/
+uint16_t pace_capture_get_record(pace_capture *capture, uint8_t type, uint8_t *record) {
+
+  uint8_t *ptr = record;
+
+  if(capture->state != PACE_CAPTURE_FROZEN) {
+    return 0;
+  }
+
+  /* Header */
+  *ptr++ = type;
+  for(int8_t shift = 24 ; shift >= 0 ; shift -= 8) {
+    *ptr++ = (uint8_t)(capture->sample >> shift);
+  }
+  ptr = _pace_capture_save_u16(ptr, capture->rate);
+  *ptr++ = PACE_CAPTURE_CHANNELS;
+  ptr = _pace_capture_save_u16(ptr, capture->window_pre);
+  ptr = _pace_capture_save_u16(ptr, capture->window_count - capture->window_pre);
+  ptr = _pace_capture_save_u16(ptr, capture->pulses);
+
+  /* Pulses bitmap */
+  memcpy(ptr, capture->window_pulses, (capture->window_count + 7) / 8);
+  ptr += (capture->window_count + 7) / 8;
+
+  /* Samples, 24 bits saturated */
+  for(uint16_t i = 0 ; i < capture->window_count ; i++) {
+    for(uint8_t ch = 0 ; ch < PACE_CAPTURE_CHANNELS ; ch++) {
+      int32_t value = capture->window[i][ch];
+
+      if(value > PACE_CAPTURE_SAMPLE_MAX) {
+        value = PACE_CAPTURE_SAMPLE_MAX;
+      } else if(value < PACE_CAPTURE_SAMPLE_MIN) {
+        value = PACE_CAPTURE_SAMPLE_MIN;
+      }
+      *ptr++ = (uint8_t)(value >> 16);
+      *ptr++ = (uint8_t)(value >> 8);
+      *ptr++ = (uint8_t)value;
+    }
+  }
+
+  capture->state = PACE_CAPTURE_ARMED;
+  return (uint16_t)(ptr - record);
+
+}
+
+
+/*
+* @brief Function to get the number of events captured
+*
+* @param[in]   capture                Pointer to the capture structure
+* @return                             Returns the events counter
+*/
+uint32_t pace_capture_get_events(pace_capture *capture) {
+  return capture->events;
+}
+
+
+/*
+* @brief Function to get the number of pace edges lost because an event was not read yet
+*
+* @param[in]   capture                Pointer to the capture structure
+* @return                             Returns the missed counter
+*/
+uint32_t pace_capture_get_missed(pace_capture *capture) {
+  return capture->missed;
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to add one sample to the event window
+*
+* @param[in]   capture                Pointer to the capture structure
+* @param[in]   samples                PACE_CAPTURE_CHANNELS samples
+* @param[in]   pulse                  True if the sample has a pace edge
+*/
+static void _pace_capture_append(pace_capture *capture, const int32_t *samples, bool pulse) {
+
+  uint16_t idx = capture->window_count++;
+
+  memcpy(capture->window[idx], samples, sizeof(capture->window[0]));
+  if(pulse) {
+    capture->window_pulses[idx >> 3] |= 1 << (idx & 7);
+    capture->pulses++;
+  }
+
+}
+
+
+/*
+* @brief Function to save a uint16_t in big-endian
+*
+* @param[out]  array                  Destination
+* @param[in]   value                  Value to save
+* @return                             Returns the position after the value
+*/
+static uint8_t *_pace_capture_save_u16(uint8_t *array, uint16_t value) {
+
+  array[0] = (uint8_t)(value >> 8);
+  array[1] = (uint8_t)value;
+  return &array[2];
+
+}
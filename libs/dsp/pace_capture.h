@@ -0,0 +1,81 @@
+/*
+* @file           pace_capture.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the pace pulse event capture, edge detection
+*                 on the pace status of the frames, pre-trigger history and
+*                 a window of samples frozen around each event.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef PACE_CAPTURE_H
+#define PACE_CAPTURE_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+#define PACE_CAPTURE_CHANNELS         3         /* Channels kept in each sample */
+#define PACE_CAPTURE_MAX_PRE          64        /* Pre-trigger history in samples, must be power of 2 */
+#define PACE_CAPTURE_MAX_POST         192       /* Samples after the trigger */
+#define PACE_CAPTURE_MAX_SAMPLES      (PACE_CAPTURE_MAX_PRE + PACE_CAPTURE_MAX_POST)
+
+/* Record, big-endian
+ *   type (1), trigger sample index (4), rate in SPS (2), channels (1), pre samples (2),
+ *   post samples (2), pulses (2), pulses bitmap (1 bit per sample), samples (3 bytes per channel) */
+#define PACE_CAPTURE_HEADER_SIZE      14
+#define PACE_CAPTURE_SAMPLE_SIZE      3         /* 24-bit signed microvolts */
+#define PACE_CAPTURE_RECORD_SIZE(samples) \
+  (PACE_CAPTURE_HEADER_SIZE + ((samples) + 7) / 8 + (samples) * PACE_CAPTURE_CHANNELS * PACE_CAPTURE_SAMPLE_SIZE)
+#define PACE_CAPTURE_RECORD_MAX       PACE_CAPTURE_RECORD_SIZE(PACE_CAPTURE_MAX_SAMPLES)
+
+/* Result of pace_capture_process() */
+#define PACE_CAPTURE_EDGE             0x01      /* Rising edge of the pace status, a new pulse */
+#define PACE_CAPTURE_READY            0x02      /* Event window complete, read it with pace_capture_get_record() */
+
+/* Capture states */
+typedef enum {
+  PACE_CAPTURE_ARMED,
+  PACE_CAPTURE_CAPTURING,
+  PACE_CAPTURE_FROZEN,
+} pace_capture_states;
+
+/* Capture state */
+typedef struct {
+  uint16_t            rate;
+  uint16_t            pre;                                                /* Configured pre-trigger samples */
+  uint16_t            post;                                               /* Configured post-trigger samples */
+  pace_capture_states state;
+  bool                last_pace;
+
+  /* Pre-trigger history */
+  int32_t             history[PACE_CAPTURE_MAX_PRE][PACE_CAPTURE_CHANNELS];
+  uint8_t             history_pace[PACE_CAPTURE_MAX_PRE];
+  uint32_t            history_count;
+
+  /* Event window */
+  uint32_t            sample;                                             /* Sample index of the trigger */
+  int32_t             window[PACE_CAPTURE_MAX_SAMPLES][PACE_CAPTURE_CHANNELS];
+  uint8_t             window_pulses[(PACE_CAPTURE_MAX_SAMPLES + 7) / 8];  /* Samples with a pace edge */
+  uint16_t            window_pre;                                         /* Pre-trigger samples available */
+  uint16_t            window_count;
+  uint16_t            pulses;
+
+  uint32_t            events;                                             /* Events captured */
+  uint32_t            missed;                                             /* Edges while an event was frozen */
+} pace_capture;
+
+/********************************** Functions ***********************************/
+bool pace_capture_init(pace_capture *capture, uint16_t rate, uint16_t pre, uint16_t post);
+void pace_capture_reset(pace_capture *capture);
+uint8_t pace_capture_process(pace_capture *capture, uint32_t sample, bool pace, const int32_t *samples);
+uint16_t pace_capture_get_record(pace_capture *capture, uint8_t type, uint8_t *record);
+uint32_t pace_capture_get_events(pace_capture *capture);
+uint32_t pace_capture_get_missed(pace_capture *capture);
+
+#endif /* PACE_CAPTURE_H */
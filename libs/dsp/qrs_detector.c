@@ -0,0 +1,357 @@
+/*
+* @file           qrs_detector.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the streaming QRS detector and heart rate
+*                 estimator, Pan-Tompkins in fixed-point with constant memory
+*                 and a constant cost per sample.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "qrs_detector.h"
+
+/* Standard library */
+#include <string.h>
+
+/* ----------------------------------------------------------------------
+** Pan-Tompkins stages, all integer and without multiplications:
+**   Low-pass   y[n] = 2y[n-1] - y[n-2] + x[n] - 2x[n-L] + x[n-2L]
+**   High-pass  y[n] = x[n-M/2] - (x[n] + ... + x[n-M+1]) / M
+**   Derivative y[n] = (2x[n] + x[n-1] - x[n-3] - 2x[n-4]) / 8
+**   Squaring and moving window integration over W samples
+** L, M and W are powers of 2 chosen by rate, L = 8/16, M = 32/64 and
+** W = 32/64 for 250/500 SPS, for a 5 Hz to 11 Hz pass band and a
+** 128 ms window.
+** ------------------------------------------------------------------- */
+
+/********************************** Private ************************************/
+/* Private functions list */
+static uint32_t _qrs_detector_filter(qrs_detector *detector, int32_t sample);
+static bool _qrs_detector_classify(qrs_detector *detector, const qrs_detector_peak *peak);
+static bool _qrs_detector_search_back(qrs_detector *detector);
+static void _qrs_detector_add_qrs(qrs_detector *detector, const qrs_detector_peak *peak, uint8_t weight_shift);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to set up the detector for a sampling rate and clear its state
+*
+* @param[in]   detector               Pointer to the detector structure
+* @param[in]   rate                   Sampling rate in SPS, 250 or 500
+* @retval                             Returns true if successful, or false if the rate is not supported
+*/
+bool qrs_detector_init(qrs_detector *detector, uint16_t rate) {
+
+  if(rate != 250 && rate != 500) {
+    return false;
+  }
+
+  detector->rate = rate;
+  detector->lp_shift = (rate == 500) ? 4 : 3;
+  detector->hp_shift = (rate == 500) ? 6 : 5;
+  detector->mwi_shift = (rate == 500) ? 6 : 5;
+
+  /* Group delay of the low-pass and high-pass */
+  detector->delay = ((1 << detector->lp_shift) - 1) + (1 << (detector->hp_shift - 1));
+
+  detector->learning = (uint32_t)rate * QRS_DETECTOR_LEARNING_MS / 1000;
+  detector->refractory = (uint32_t)rate * QRS_DETECTOR_REFRACTORY_MS / 1000;
+  detector->t_wave = (uint32_t)rate * QRS_DETECTOR_T_WAVE_MS / 1000;
+
+  qrs_detector_reset(detector);
+  return true;
+
+}
+
+
+/*
+* @brief Function to clear the filters, thresholds and beats, and restart the learning phase
+*
+* @param[in]   detector               Pointer to the detector structure
+*/
+void qrs_detector_reset(qrs_detector *detector) {
+
+  memset(detector->lp_x, 0, sizeof(detector->lp_x));
+  memset(detector->hp_x, 0, sizeof(detector->hp_x));
+  memset(detector->deriv_x, 0, sizeof(detector->deriv_x));
+  memset(detector->mwi_x, 0, sizeof(detector->mwi_x));
+  memset(detector->rr, 0, sizeof(detector->rr));
+  memset(&detector->beat, 0, sizeof(detector->beat));
+  memset(&detector->peak, 0, sizeof(detector->peak));
+  memset(&detector->candidate, 0, sizeof(detector->candidate));
+  memset(&detector->qrs, 0, sizeof(detector->qrs));
+
+  detector->lp_y1 = 0;
+  detector->lp_y2 = 0;
+  detector->hp_sum = 0;
+  detector->mwi_sum = 0;
+  detector->sample = 0;
+
+  detector->slope = 0;
+  detector->amplitude = 0;
+  detector->amplitude_sample = 0;
+
+  detector->spki = 0;
+  detector->npki = 0;
+  detector->threshold = 0;
+  detector->learning_max = 0;
+
+  detector->has_qrs = false;
+  detector->rr_sum = 0;
+  detector->rr_idx = 0;
+  detector->rr_count = 0;
+
+}
+
+
+/*
+* @brief Function to run one sample through the detector
+*
+* @param[in]   detector               Pointer to the detector structure
+* @param[in]   sample                 Lead sample in microvolts, baseline removed
+* @retval                             Returns true if a beat was detected, read it with qrs_detector_get_beat()
+* @note                               The beat is reported about 0.2 s to 0.4 s after its R peak, when the
+*                                     integrated signal falls to half of its peak
+*/
+bool qrs_detector_process(qrs_detector *detector, int32_t sample) {
+
+  uint32_t mwi = _qrs_detector_filter(detector, sample);
+  uint32_t n = detector->sample++;
+  bool beat = false;
+
+  /* Learning phase, thresholds from the maximum and mean of the integrated signal */
+  if(n < detector->learning) {
+    if(mwi > detector->learning_max) {
+      detector->learning_max = mwi;
+    }
+    detector->npki += ((int32_t)(mwi - detector->npki)) >> 6;    /* Mean of the last ~64 samples */
+    if(n == detector->learning - 1) {
+      detector->spki = detector->learning_max / 3;
+      detector->npki >>= 1;
+      detector->threshold = detector->npki + ((detector->spki - detector->npki) >> 2);
+    }
+    return false;
+  }
+
+  /* Peak search, a peak ends when the signal falls to half of it */
+  if(mwi > detector->peak.value) {
+    detector->peak.value = mwi;
+    detector->peak.sample = n;
+    detector->peak.r_sample = detector->amplitude_sample;
+    detector->peak.slope = detector->slope;
+  } else if(detector->peak.value && mwi < (detector->peak.value >> 1)) {
+    beat = _qrs_detector_classify(detector, &detector->peak);
+    detector->peak.value = 0;
+    detector->slope = 0;
+    detector->amplitude = 0;
+  }
+
+  /* Missed beat */
+  if(!beat) {
+    beat = _qrs_detector_search_back(detector);
+  }
+  return beat;
+
+}
+
+
+/*
+* @brief Function to get the last detected beat
+*
+* @param[in]   detector               Pointer to the detector structure
+* @return                             Returns the beat, valid after qrs_detector_process() returns true
+*/
+const qrs_detector_beat *qrs_detector_get_beat(qrs_detector *detector) {
+  return &detector->beat;
+}
+
+
+/*
+* @brief Function to get the average of the last RR intervals
+*
+* @param[in]   detector               Pointer to the detector structure
+* @return                             Returns the RR average in samples, or 0 before the second beat
+*/
+uint16_t qrs_detector_get_rr_average(qrs_detector *detector) {
+
+  if(!detector->rr_count) {
+    return 0;
+  }
+  return (uint16_t)(detector->rr_sum / detector->rr_count);
+
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to run one sample through the band-pass, derivative, squaring and integration
+*
+* @param[in]   detector               Pointer to the detector structure
+* @param[in]   sample                 Lead sample in microvolts
+* @return                             Returns the integrated signal
+*/
+static uint32_t _qrs_detector_filter(qrs_detector *detector, int32_t sample) {
+
+  uint32_t n = detector->sample;
+  uint16_t lp_len = 1 << detector->lp_shift;
+  uint16_t hp_len = 1 << detector->hp_shift;
+  uint16_t mwi_len = 1 << detector->mwi_shift;
+
+  /* Clamp and scale to the internal resolution */
+  if(sample > QRS_DETECTOR_INPUT_LIMIT) {
+    sample = QRS_DETECTOR_INPUT_LIMIT;
+  } else if(sample < -QRS_DETECTOR_INPUT_LIMIT) {
+    sample = -QRS_DETECTOR_INPUT_LIMIT;
+  }
+  sample *= (1 << QRS_DETECTOR_SIGNAL_SHIFT);
+
+  /* Low-pass, the delay line holds 2L samples so x[n-2L] is the slot being replaced */
+  uint16_t lp_idx = n & (2 * lp_len - 1);
+  int32_t lp = 2 * detector->lp_y1 - detector->lp_y2 + sample
+               - 2 * detector->lp_x[(n - lp_len) & (2 * lp_len - 1)] + detector->lp_x[lp_idx];
+  detector->lp_x[lp_idx] = sample;
+  detector->lp_y2 = detector->lp_y1;
+  detector->lp_y1 = lp;
+  lp >>= 2 * detector->lp_shift;                                  /* DC gain of L^2 */
+
+  /* High-pass, all-pass delayed by M/2 minus the moving average of M samples */
+  uint16_t hp_idx = n & (hp_len - 1);
+  detector->hp_sum += lp - detector->hp_x[hp_idx];
+  detector->hp_x[hp_idx] = lp;
+  int32_t hp = detector->hp_x[(n - hp_len / 2) & (hp_len - 1)] - (detector->hp_sum >> detector->hp_shift);
+
+  /* Largest amplitude, locates the R peak within the QRS */
+  uint32_t amplitude = (uint32_t)(hp < 0 ? -hp : hp);
+  if(amplitude > detector->amplitude) {
+    detector->amplitude = amplitude;
+    detector->amplitude_sample = n - detector->delay;
+  }
+
+  /* Five point derivative */
+  uint16_t d_idx = n & (QRS_DETECTOR_DERIV_SIZE - 1);
+  int32_t deriv = (2 * hp + detector->deriv_x[(n - 1) & (QRS_DETECTOR_DERIV_SIZE - 1)]
+                  - detector->deriv_x[(n - 3) & (QRS_DETECTOR_DERIV_SIZE - 1)] - 2 * detector->deriv_x[d_idx]) / 8;
+  detector->deriv_x[d_idx] = hp;
+
+  if(deriv > QRS_DETECTOR_DERIV_LIMIT) {
+    deriv = QRS_DETECTOR_DERIV_LIMIT;
+  } else if(deriv < -QRS_DETECTOR_DERIV_LIMIT) {
+    deriv = -QRS_DETECTOR_DERIV_LIMIT;
+  }
+  uint16_t slope = (uint16_t)(deriv < 0 ? -deriv : deriv);
+  if(slope > detector->slope) {
+    detector->slope = slope;
+  }
+
+  /* Squaring and moving window integration */
+  uint16_t mwi_idx = n & (mwi_len - 1);
+  uint32_t square = (uint32_t)(deriv * deriv);
+  detector->mwi_sum += square - detector->mwi_x[mwi_idx];
+  detector->mwi_x[mwi_idx] = square;
+
+  return detector->mwi_sum >> detector->mwi_shift;
+
+}
+
+
+/*
+* @brief Function to classify a peak of the integrated signal as QRS or noise
+*
+* @param[in]   detector               Pointer to the detector structure
+* @param[in]   peak                   Peak that just ended
+* @retval                             Returns true if the peak is a QRS
+*/
+static bool _qrs_detector_classify(qrs_detector *detector, const qrs_detector_peak *peak) {
+
+  uint32_t since = peak->sample - detector->qrs.sample;
+
+  if(detector->has_qrs && since < detector->refractory) {
+    return false;
+  }
+
+  if(peak->value > detector->threshold) {
+
+    /* T wave, a peak close to the last QRS with less than half of its slope */
+    if(!detector->has_qrs || since >= detector->t_wave || peak->slope >= (detector->qrs.slope >> 1)) {
+      _qrs_detector_add_qrs(detector, peak, 3);
+      return true;
+    }
+  }
+
+  /* Noise peak, kept for the search back */
+  detector->npki = detector->npki - (detector->npki >> 3) + (peak->value >> 3);
+  detector->threshold = detector->npki + ((detector->spki - detector->npki) >> 2);
+  if(peak->value > detector->candidate.value) {
+    detector->candidate = *peak;
+  }
+  return false;
+
+}
+
+
+/*
+* @brief Function to take the largest noise peak as QRS when no beat is found for 166% of the RR average
+*
+* @param[in]   detector               Pointer to the detector structure
+* @retval                             Returns true if a missed beat was recovered
+*/
+static bool _qrs_detector_search_back(qrs_detector *detector) {
+
+  uint32_t rr_average = qrs_detector_get_rr_average(detector);
+
+  if(!rr_average || !detector->candidate.value) {
+    return false;
+  }
+  if(detector->sample - detector->qrs.r_sample < rr_average + (rr_average * 2) / 3) {
+    return false;
+  }
+
+  /* Second threshold, half of the first */
+  if(detector->candidate.value > (detector->threshold >> 1)) {
+    _qrs_detector_add_qrs(detector, &detector->candidate, 2);
+    return true;
+  }
+  detector->candidate.value = 0;
+  return false;
+
+}
+
+
+/*
+* @brief Function to register a QRS, update the signal level and the RR average
+*
+* @param[in]   detector               Pointer to the detector structure
+* @param[in]   peak                   Peak of the QRS
+* @param[in]   weight_shift           Weight of the peak in the signal level, 3 for 1/8 and 2 for 1/4 (search back)
+*/
+static void _qrs_detector_add_qrs(qrs_detector *detector, const qrs_detector_peak *peak, uint8_t weight_shift) {
+
+  detector->spki = detector->spki - (detector->spki >> weight_shift) + (peak->value >> weight_shift);
+  detector->threshold = detector->npki + ((detector->spki - detector->npki) >> 2);
+
+  /* RR average of the last QRS_DETECTOR_RR_SIZE intervals */
+  detector->beat.rr_ms = 0;
+  if(detector->has_qrs) {
+    uint16_t rr = (uint16_t)(peak->r_sample - detector->qrs.r_sample);
+
+    detector->rr_sum += rr - detector->rr[detector->rr_idx];
+    detector->rr[detector->rr_idx] = rr;
+    detector->rr_idx = (detector->rr_idx + 1) & (QRS_DETECTOR_RR_SIZE - 1);
+    if(detector->rr_count < QRS_DETECTOR_RR_SIZE) {
+      detector->rr_count++;
+    }
+    detector->beat.rr_ms = (uint16_t)((uint32_t)rr * 1000 / detector->rate);
+    detector->beat.hr_bpm = (uint16_t)((60 * (uint32_t)detector->rate * detector->rr_count + detector->rr_sum / 2) / detector->rr_sum);
+  }
+
+  detector->beat.r_sample = peak->r_sample;
+  detector->beat.delay_ms = (uint16_t)((detector->sample - 1 - peak->r_sample) * 1000 / detector->rate);
+  detector->has_qrs = true;
+  detector->qrs = *peak;
+  detector->candidate.value = 0;
+
+}
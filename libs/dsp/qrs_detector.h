@@ -0,0 +1,107 @@
+/*
+* @file           qrs_detector.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the streaming QRS detector and heart rate
+*                 estimator, Pan-Tompkins in fixed-point with constant memory
+*                 and a constant cost per sample.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef QRS_DETECTOR_H
+#define QRS_DETECTOR_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+/* Sizes of the delay lines for the highest sampling rate (500 SPS), must be powers of 2 */
+#define QRS_DETECTOR_LP_SIZE          32        /* Low-pass, 2 * 16 samples */
+#define QRS_DETECTOR_HP_SIZE          64        /* High-pass moving average */
+#define QRS_DETECTOR_MWI_SIZE         64        /* Moving window integration, 128 ms */
+#define QRS_DETECTOR_DERIV_SIZE       4         /* Five point derivative */
+#define QRS_DETECTOR_RR_SIZE          8         /* RR intervals in the average */
+
+#define QRS_DETECTOR_SIGNAL_SHIFT     2         /* Extra fractional bits of the microvolts signal */
+#define QRS_DETECTOR_INPUT_LIMIT      (1 << 18) /* Input clamp in microvolts, keeps the low-pass in 32 bits */
+#define QRS_DETECTOR_DERIV_LIMIT      8191      /* Derivative clamp, keeps the window sum in 32 bits */
+
+#define QRS_DETECTOR_LEARNING_MS      2000      /* Initial learning of the thresholds */
+#define QRS_DETECTOR_REFRACTORY_MS    200       /* No QRS can follow another one before this time */
+#define QRS_DETECTOR_T_WAVE_MS        360       /* Peaks before this time are checked for T waves */
+
+/* Peak of the integrated signal */
+typedef struct {
+  uint32_t  value;
+  uint32_t  sample;           /* Sample index of the integrated peak */
+  uint32_t  r_sample;         /* Sample index of the largest band-passed amplitude before it */
+  uint16_t  slope;            /* Maximum slope of the band-passed signal before it */
+} qrs_detector_peak;
+
+/* Last detected beat */
+typedef struct {
+  uint32_t  r_sample;         /* Sample index of the R peak */
+  uint16_t  rr_ms;            /* RR interval in milliseconds, 0 on the first beat */
+  uint16_t  hr_bpm;           /* Heart rate from the RR average in beats per minute, 0 until the second beat */
+  uint16_t  delay_ms;         /* Time from the R peak to the sample that reported the beat */
+} qrs_detector_beat;
+
+/* Detector state of one lead */
+typedef struct {
+  /* Parameters from the sampling rate */
+  uint16_t  rate;
+  uint8_t   lp_shift;         /* log2 of the low-pass length */
+  uint8_t   hp_shift;         /* log2 of the high-pass length */
+  uint8_t   mwi_shift;        /* log2 of the integration window */
+  uint16_t  delay;            /* Group delay of the band-pass in samples */
+  uint32_t  learning;         /* Samples of the learning phase */
+  uint32_t  refractory;       /* Samples of the refractory period */
+  uint32_t  t_wave;           /* Samples of the T wave check */
+
+  /* Filters delay lines */
+  int32_t   lp_x[QRS_DETECTOR_LP_SIZE];
+  int32_t   lp_y1;
+  int32_t   lp_y2;
+  int32_t   hp_x[QRS_DETECTOR_HP_SIZE];
+  int32_t   hp_sum;
+  int32_t   deriv_x[QRS_DETECTOR_DERIV_SIZE];
+  uint32_t  mwi_x[QRS_DETECTOR_MWI_SIZE];
+  uint32_t  mwi_sum;
+  uint32_t  sample;           /* Index of the next sample */
+
+  /* Peak search on the integrated signal */
+  qrs_detector_peak peak;
+  uint16_t  slope;            /* Maximum slope since the last peak */
+  uint32_t  amplitude;        /* Maximum band-passed amplitude since the last peak */
+  uint32_t  amplitude_sample;
+
+  /* Adaptive thresholds */
+  uint32_t  spki;             /* Signal peak level */
+  uint32_t  npki;             /* Noise peak level */
+  uint32_t  threshold;
+  uint32_t  learning_max;
+  qrs_detector_peak candidate;  /* Largest noise peak since the last QRS, for the search back */
+
+  /* Beats */
+  bool      has_qrs;
+  qrs_detector_peak qrs;      /* Last QRS */
+  uint16_t  rr[QRS_DETECTOR_RR_SIZE];
+  uint32_t  rr_sum;
+  uint8_t   rr_idx;
+  uint8_t   rr_count;
+  qrs_detector_beat beat;
+} qrs_detector;
+
+/********************************** Functions ***********************************/
+bool qrs_detector_init(qrs_detector *detector, uint16_t rate);
+void qrs_detector_reset(qrs_detector *detector);
+bool qrs_detector_process(qrs_detector *detector, int32_t sample);
+const qrs_detector_beat *qrs_detector_get_beat(qrs_detector *detector);
+uint16_t qrs_detector_get_rr_average(qrs_detector *detector);
+
+#endif /* QRS_DETECTOR_H */
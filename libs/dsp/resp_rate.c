@@ -0,0 +1,256 @@
+/*
+* @file           resp_rate.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the respiration rate extraction from the
+*                 ADS1296R RESP channel, symmetric FIR decimation to 25 Hz,
+*                 band-pass and breath detection with adaptive thresholds.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "resp_rate.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* ----------------------------------------------------------------------
+** Decimation low-pass, Hamming windowed sinc with fc = 3 Hz, DC gain of
+** exactly 2^15. Attenuation above 48 dB around the multiples of 25 Hz,
+** the bands that alias onto the breathing band after the decimation.
+** Only one output is computed every factor inputs, and the symmetric
+** taps are folded, so the cost is taps / (2 * factor) MACs per input.
+** ------------------------------------------------------------------- */
+
+/*
+* 250 SPS, decimation by 10
+*/
+static const int16_t _decimator_250sps_coeffs[40] = {
+  89, 100, 125, 166, 223, 295, 383, 483, 595, 715, 841, 969, 1095, 1215, 1326, 1425, 1508, 1573, 1617, 1641,
+  1641, 1617, 1573, 1508, 1425, 1326, 1215, 1095, 969, 841, 715, 595, 483, 383, 295, 223, 166, 125, 100, 89,
+};
+
+/*
+* 500 SPS, decimation by 20
+*/
+static const int16_t _decimator_500sps_coeffs[80] = {
+  44, 45, 49, 54, 61, 70, 81, 93, 108, 125, 143, 163, 185, 209, 234, 260, 288, 317, 346, 377,
+  407, 439, 470, 501, 532, 562, 591, 620, 647, 672, 696, 719, 739, 757, 773, 786, 797, 805, 810, 809,
+  809, 810, 805, 797, 786, 773, 757, 739, 719, 696, 672, 647, 620, 591, 562, 532, 501, 470, 439, 407,
+  377, 346, 317, 288, 260, 234, 209, 185, 163, 143, 125, 108, 93, 81, 70, 61, 54, 49, 45, 44,
+};
+
+static const resp_rate_decimator _decimator_250sps = {_decimator_250sps_coeffs, 40, 10};
+static const resp_rate_decimator _decimator_500sps = {_decimator_500sps_coeffs, 80, 20};
+
+/*
+* Band-pass at 25 SPS, 6 to 60 breaths per minute, RBJ cookbook in Q2.30:
+*   High-pass  f0 = 0.1 Hz, Q = 0.7071
+*   Low-pass   f0 = 1 Hz,   Q = 0.7071
+*/
+static const ecg_filter_biquad _band_pass_coeffs[2] = {
+  {1054828333, -2109656665, 1054828333, -2109323487, 1036248020},
+  {14344332, 28688664, 14344332, -1768946685, 752582188},
+};
+
+/* Private functions list */
+static int32_t _resp_rate_decimate(resp_rate *resp);
+static bool _resp_rate_detect(resp_rate *resp, int32_t sample);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to set up the respiration for a sampling rate and clear its state
+*
+* @param[in]   resp                   Pointer to the respiration structure
+* @param[in]   rate                   Sampling rate of the RESP channel in SPS, 250 or 500
+* @retval                             Returns true if successful, or false if the rate is not supported
+*/
+bool resp_rate_init(resp_rate *resp, uint16_t rate) {
+
+  if(rate == 250) {
+    resp->decimator = &_decimator_250sps;
+  } else if(rate == 500) {
+    resp->decimator = &_decimator_500sps;
+  } else {
+    return false;
+  }
+
+  resp_rate_reset(resp);
+  return true;
+
+}
+
+
+/*
+* @brief Function to clear the filters, thresholds and breaths
+*
+* @param[in]   resp                   Pointer to the respiration structure
+*/
+void resp_rate_reset(resp_rate *resp) {
+
+  memset(resp->delay, 0, sizeof(resp->delay));
+  memset(resp->band_pass, 0, sizeof(resp->band_pass));
+  memset(resp->intervals, 0, sizeof(resp->intervals));
+
+  resp->delay_idx = 0;
+  resp->phase = resp->decimator->factor;
+  resp->envelope = 0;
+  resp->armed = false;
+  resp->sample = 0;
+  resp->has_breath = false;
+  resp->breath_sample = 0;
+  resp->intervals_sum = 0;
+  resp->intervals_idx = 0;
+  resp->intervals_count = 0;
+  resp->apnea = false;
+  resp->bpm = 0;
+
+}
+
+
+/*
+* @brief Function to run one RESP sample through the respiration pipeline
+*
+* @param[in]   resp                   Pointer to the respiration structure
+* @param[in]   sample                 RESP sample in microvolts
+* @retval                             Returns true when the rate changes, on each breath and on apnea,
+*                                     read it with resp_rate_get_bpm()
+*/
+bool resp_rate_process(resp_rate *resp, int32_t sample) {
+
+  /* Delay line of the decimation filter */
+  resp->delay[resp->delay_idx] = sample;
+  if(++resp->delay_idx == resp->decimator->taps) {
+    resp->delay_idx = 0;
+  }
+
+  /* One output every factor inputs */
+  if(--resp->phase) {
+    return false;
+  }
+  resp->phase = resp->decimator->factor;
+
+  int32_t decimated = _resp_rate_decimate(resp);
+  ecg_filter_biquad_process(&_band_pass_coeffs[0], &resp->band_pass[0], &decimated, 1, 1);
+  ecg_filter_biquad_process(&_band_pass_coeffs[1], &resp->band_pass[1], &decimated, 1, 1);
+
+  return _resp_rate_detect(resp, decimated);
+
+}
+
+
+/*
+* @brief Function to get the respiration rate
+*
+* @param[in]   resp                   Pointer to the respiration structure
+* @return                             Returns the breaths per minute over the last breaths, or 0 before the
+*                                     second breath and on apnea
+*/
+uint16_t resp_rate_get_bpm(resp_rate *resp) {
+  return resp->bpm;
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to compute one output of the decimation filter
+*
+* @param[in]   resp                   Pointer to the respiration structure
+* @return                             Returns the low-passed sample in microvolts with RESP_RATE_SIGNAL_SHIFT fractional bits
+* @note                               The filter is symmetric, so the samples of the delay line that share a
+*                                     coefficient are added first, from the oldest and the newest inwards
+*/
+static int32_t _resp_rate_decimate(resp_rate *resp) {
+
+  const int16_t *coeffs = resp->decimator->coeffs;
+  uint8_t taps = resp->decimator->taps;
+  uint8_t oldest = resp->delay_idx;
+  uint8_t newest = (oldest ? oldest : taps) - 1;
+  int64_t acc = 0;
+
+  for(uint8_t i = 0 ; i < taps / 2 ; i++) {
+    acc += (int32_t)coeffs[i] * ((int64_t)resp->delay[oldest] + resp->delay[newest]);
+    if(++oldest == taps) {
+      oldest = 0;
+    }
+    newest = (newest ? newest : taps) - 1;
+  }
+
+  return (int32_t)((acc + (1 << (RESP_RATE_COEFF_SHIFT - RESP_RATE_SIGNAL_SHIFT - 1))) >> (RESP_RATE_COEFF_SHIFT - RESP_RATE_SIGNAL_SHIFT));
+
+}
+
+
+/*
+* @brief Function to detect breaths on the band-passed signal
+*
+* @param[in]   resp                   Pointer to the respiration structure
+* @param[in]   sample                 Band-passed sample at RESP_RATE_OUTPUT_RATE
+* @retval                             Returns true when the rate changes
+* @note                               A breath is the rising crossing of half of the envelope, after a crossing
+*                                     of minus half of the envelope (hysteresis)
+*/
+static bool _resp_rate_detect(resp_rate *resp, int32_t sample) {
+
+  uint32_t n = resp->sample++;
+  uint32_t magnitude = (uint32_t)(sample < 0 ? -sample : sample);
+  int32_t threshold;
+
+  /* Envelope, mean of the absolute signal */
+  resp->envelope += ((int32_t)(magnitude - resp->envelope)) >> RESP_RATE_ENVELOPE_SHIFT;
+  threshold = (int32_t)(resp->envelope >> 1);
+
+  /* Apnea */
+  if(resp->has_breath && !resp->apnea && n - resp->breath_sample >= RESP_RATE_APNEA_MS * RESP_RATE_OUTPUT_RATE / 1000) {
+    resp->apnea = true;
+    resp->intervals_sum = 0;
+    resp->intervals_count = 0;
+    memset(resp->intervals, 0, sizeof(resp->intervals));
+    resp->bpm = 0;
+    return true;
+  }
+
+  /* Signal too small to be breathing */
+  if(resp->envelope < (RESP_RATE_MIN_AMPLITUDE << RESP_RATE_SIGNAL_SHIFT)) {
+    resp->armed = false;
+    return false;
+  }
+
+  if(sample < -threshold) {
+    resp->armed = true;
+    return false;
+  }
+  if(!resp->armed || sample <= threshold) {
+    return false;
+  }
+  resp->armed = false;
+
+  /* Breath, faster breaths are noise */
+  uint32_t interval = n - resp->breath_sample;
+  if(resp->has_breath && interval < RESP_RATE_MIN_BREATH_MS * RESP_RATE_OUTPUT_RATE / 1000) {
+    return false;
+  }
+
+  bool first = !resp->has_breath || resp->apnea;
+  resp->has_breath = true;
+  resp->apnea = false;
+  resp->breath_sample = n;
+  if(first) {
+    return false;
+  }
+
+  resp->intervals_sum += interval - resp->intervals[resp->intervals_idx];
+  resp->intervals[resp->intervals_idx] = (uint16_t)interval;
+  resp->intervals_idx = (resp->intervals_idx + 1) & (RESP_RATE_BREATHS_SIZE - 1);
+  if(resp->intervals_count < RESP_RATE_BREATHS_SIZE) {
+    resp->intervals_count++;
+  }
+  resp->bpm = (uint16_t)((60 * RESP_RATE_OUTPUT_RATE * resp->intervals_count + resp->intervals_sum / 2) / resp->intervals_sum);
+  return true;
+
+}
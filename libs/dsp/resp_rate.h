@@ -0,0 +1,72 @@
+/*
+* @file           resp_rate.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the respiration rate extraction from the
+*                 ADS1296R RESP channel, symmetric FIR decimation to 25 Hz,
+*                 band-pass and breath detection with adaptive thresholds.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef RESP_RATE_H
+#define RESP_RATE_H
+
+/*********************************** Includes ***********************************/
+/* DSP */
+#include "ecg_filter.h"
+
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+#define RESP_RATE_OUTPUT_RATE         25        /* Sampling rate after the decimation in SPS */
+#define RESP_RATE_MAX_TAPS            80        /* Decimation filter taps for 500 SPS */
+#define RESP_RATE_COEFF_SHIFT         15        /* Decimation coefficients in Q15 */
+#define RESP_RATE_SIGNAL_SHIFT        4         /* Extra fractional bits of the microvolts signal after the decimation */
+#define RESP_RATE_BREATHS_SIZE        4         /* Breath intervals in the average, must be power of 2 */
+
+#define RESP_RATE_MIN_BREATH_MS       1000      /* Shortest breath, 60 breaths per minute */
+#define RESP_RATE_APNEA_MS            20000     /* No breath for this time is reported as apnea */
+#define RESP_RATE_MIN_AMPLITUDE       10        /* Smallest mean breath amplitude in microvolts */
+#define RESP_RATE_ENVELOPE_SHIFT      6         /* Envelope time constant, 2^6 samples at 25 Hz */
+
+/* Decimation of one sampling rate */
+typedef struct {
+  const int16_t   *coeffs;                      /* Symmetric, only the first taps / 2 are used */
+  uint8_t         taps;                         /* Must be even */
+  uint8_t         factor;
+} resp_rate_decimator;
+
+/* Respiration state */
+typedef struct {
+  const resp_rate_decimator *decimator;
+  int32_t           delay[RESP_RATE_MAX_TAPS];  /* Input delay line */
+  uint8_t           delay_idx;
+  uint8_t           phase;                      /* Inputs until the next output */
+
+  ecg_filter_state  band_pass[2];               /* High-pass and low-pass */
+
+  uint32_t          envelope;                   /* Mean absolute band-passed signal */
+  bool              armed;                      /* Signal went below the lower threshold */
+  uint32_t          sample;                     /* Index of the next output sample */
+  bool              has_breath;
+  uint32_t          breath_sample;              /* Output sample of the last breath */
+  uint16_t          intervals[RESP_RATE_BREATHS_SIZE];
+  uint32_t          intervals_sum;
+  uint8_t           intervals_idx;
+  uint8_t           intervals_count;
+  bool              apnea;
+  uint16_t          bpm;
+} resp_rate;
+
+/********************************** Functions ***********************************/
+bool resp_rate_init(resp_rate *resp, uint16_t rate);
+void resp_rate_reset(resp_rate *resp);
+bool resp_rate_process(resp_rate *resp, int32_t sample);
+uint16_t resp_rate_get_bpm(resp_rate *resp);
+
+#endif /* RESP_RATE_H */
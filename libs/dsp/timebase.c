@@ -0,0 +1,297 @@
+/*
+* @file           timebase.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the sample timebase, anchors mapping the
+*                 DRDY sample index to RTC ticks and the drift estimation of
+*                 the ADS129x clock against the 32.768 kHz RTC.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "timebase.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+#define TIMEBASE_RESYNC_ERROR         ((int64_t)TIMEBASE_RESYNC_TICKS << TIMEBASE_FRAC_BITS)
+
+/* Private functions list */
+static void _timebase_restart(timebase *tb, uint32_t sample, uint64_t ticks);
+static uint32_t _timebase_get_period(timebase *tb);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to set up the timebase for a sampling rate and drop the anchors
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @param[in]   rate                   Sampling rate in SPS
+* @retval                             Returns true if successful, or false if the rate is invalid
+*/
+bool timebase_init(timebase *tb, uint16_t rate) {
+
+  if(!rate) {
+    return false;
+  }
+
+  tb->nominal = (uint32_t)(((uint64_t)TIMEBASE_TICKS_PER_SECOND << TIMEBASE_FRAC_BITS) / rate);
+  timebase_reset(tb);
+  return true;
+
+}
+
+
+/*
+* @brief Function to drop the anchors, the period goes back to the nominal one
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @note                               Must be called when the sample index restarts
+*/
+void timebase_reset(timebase *tb) {
+
+  tb->has_anchor = false;
+  tb->idx = 0;
+  tb->count = 0;
+  tb->resyncs = 0;
+  tb->fit.sample = 0;
+  tb->fit.ticks = 0;
+  tb->fit.period = tb->nominal;
+
+}
+
+
+/*
+* @brief Function to add the RTC ticks read at the DRDY of a sample
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @param[in]   sample                 Sample index
+* @param[in]   ticks                  RTC ticks read in the DRDY interrupt
+* @note                               The period is measured over the anchors window, so the interrupt latency
+*                                     of a single anchor is divided by the window length. The offset follows
+*                                     the anchors with a weight of 1/2^TIMEBASE_OFFSET_SHIFT
+*/
+void timebase_add_anchor(timebase *tb, uint32_t sample, uint64_t ticks) {
+
+  uint64_t measured = ticks << TIMEBASE_FRAC_BITS;
+  uint64_t predicted;
+  int64_t error;
+
+  if(!tb->has_anchor) {
+    _timebase_restart(tb, sample, ticks);
+    return;
+  }
+
+  /* Jumps of the RTC (rtc_set_timer) or of the sample index can not be followed */
+  predicted = timebase_anchor_get_ticks(&tb->fit, sample);
+  error = (int64_t)(measured - predicted);
+  if((int32_t)(sample - tb->samples[(tb->idx - 1) & (TIMEBASE_ANCHORS_SIZE - 1)]) <= 0 ||
+     error > TIMEBASE_RESYNC_ERROR || error < -TIMEBASE_RESYNC_ERROR) {
+    _timebase_restart(tb, sample, ticks);
+    tb->resyncs++;
+    return;
+  }
+
+  /* Anchors window, the oldest is overwritten */
+  tb->samples[tb->idx] = sample;
+  tb->ticks[tb->idx] = ticks;
+  tb->idx = (tb->idx + 1) & (TIMEBASE_ANCHORS_SIZE - 1);
+  if(tb->count < TIMEBASE_ANCHORS_SIZE) {
+    tb->count++;
+  }
+
+  tb->fit.ticks = predicted + (error >> TIMEBASE_OFFSET_SHIFT);
+  tb->fit.sample = sample;
+  tb->fit.period = _timebase_get_period(tb);
+
+}
+
+
+/*
+* @brief Function to get the current line from sample index to RTC ticks
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @return                             Returns the anchor, only valid after the first timebase_add_anchor()
+*/
+const timebase_anchor *timebase_get_anchor(timebase *tb) {
+  return &tb->fit;
+}
+
+
+/*
+* @brief Function to get the timestamp of a sample
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @param[in]   sample                 Sample index, before or after the last anchor
+* @return                             Returns the RTC time of the sample in microseconds
+*/
+uint64_t timebase_get_us(timebase *tb, uint32_t sample) {
+  return timebase_ticks_to_us(timebase_anchor_get_ticks(&tb->fit, sample));
+}
+
+
+/*
+* @brief Function to get the drift of the sampling clock against the RTC
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @return                             Returns the drift in ppm, positive if the sampling is slower than nominal
+*/
+int32_t timebase_get_drift_ppm(timebase *tb) {
+  return (int32_t)(((int64_t)tb->fit.period - tb->nominal) * 1000000 / tb->nominal);
+}
+
+
+/*
+* @brief Function to get the number of restarts of the timebase
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @return                             Returns the resyncs counter
+*/
+uint32_t timebase_get_resyncs(timebase *tb) {
+  return tb->resyncs;
+}
+
+
+/*
+* @brief Function to serialize the current anchor
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @param[in]   type                   Record type, first byte of the record
+* @param[out]  record                 Buffer with TIMEBASE_RECORD_SIZE bytes
+* @return                             Returns the record size in bytes, or 0 if there is no anchor yet
+*/
+uint16_t timebase_get_record(timebase *tb, uint8_t type, uint8_t *record) {
+
+  if(!tb->has_anchor) {
+    return 0;
+  }
+
+  record[0] = type;
+  for(uint8_t i = 0 ; i < 4 ; i++) {
+    record[1 + i] = (uint8_t)(tb->fit.sample >> (24 - 8 * i));
+    record[13 + i] = (uint8_t)(tb->fit.period >> (24 - 8 * i));
+  }
+  for(uint8_t i = 0 ; i < 8 ; i++) {
+    record[5 + i] = (uint8_t)(tb->fit.ticks >> (56 - 8 * i));
+  }
+  return TIMEBASE_RECORD_SIZE;
+
+}
+
+
+/*
+* @brief Function to read an anchor record written by timebase_get_record()
+*
+* @param[in]   record                 Record with TIMEBASE_RECORD_SIZE bytes
+* @param[out]  anchor                 Anchor of the record
+* @retval                             Returns true if successful, or false if the period is invalid
+*/
+bool timebase_parse_record(const uint8_t *record, timebase_anchor *anchor) {
+
+  anchor->sample = 0;
+  anchor->period = 0;
+  anchor->ticks = 0;
+  for(uint8_t i = 0 ; i < 4 ; i++) {
+    anchor->sample = (anchor->sample << 8) | record[1 + i];
+    anchor->period = (anchor->period << 8) | record[13 + i];
+  }
+  for(uint8_t i = 0 ; i < 8 ; i++) {
+    anchor->ticks = (anchor->ticks << 8) | record[5 + i];
+  }
+  return anchor->period != 0;
+
+}
+
+
+/*
+* @brief Function to get the RTC ticks of a sample from an anchor
+*
+* @param[in]   anchor                 Anchor
+* @param[in]   sample                 Sample index, up to 2^31 samples before or after the anchor
+* @return                             Returns the RTC ticks with TIMEBASE_FRAC_BITS fractional bits
+*/
+uint64_t timebase_anchor_get_ticks(const timebase_anchor *anchor, uint32_t sample) {
+  return anchor->ticks + (uint64_t)((int64_t)(int32_t)(sample - anchor->sample) * anchor->period);
+}
+
+
+/*
+* @brief Function to get the sampling rate of an anchor
+*
+* @param[in]   anchor                 Anchor
+* @return                             Returns the rate in SPS, rounded to the whole SPS so the drift is not seen
+*/
+uint16_t timebase_anchor_get_rate(const timebase_anchor *anchor) {
+
+  if(!anchor->period) {
+    return 0;
+  }
+  return (uint16_t)((((uint64_t)TIMEBASE_TICKS_PER_SECOND << TIMEBASE_FRAC_BITS) + anchor->period / 2) / anchor->period);
+
+}
+
+
+/*
+* @brief Function to convert RTC ticks to microseconds
+*
+* @param[in]   ticks                  RTC ticks with TIMEBASE_FRAC_BITS fractional bits
+* @return                             Returns the time in microseconds
+* @note                               1000000 / 32768 = 15625 / 2^9, split in whole and fractional ticks to
+*                                     stay in 64 bits
+*/
+uint64_t timebase_ticks_to_us(uint64_t ticks) {
+
+  uint64_t whole = ticks >> TIMEBASE_FRAC_BITS;
+  uint64_t frac = ticks & ((1 << TIMEBASE_FRAC_BITS) - 1);
+
+  return ((whole * 15625) >> 9) + ((((whole * 15625) & 0x1FF) << TIMEBASE_FRAC_BITS) + frac * 15625) / (512 << TIMEBASE_FRAC_BITS);
+
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to start the timebase again from one anchor
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @param[in]   sample                 Sample index
+* @param[in]   ticks                  RTC ticks of the sample
+*/
+static void _timebase_restart(timebase *tb, uint32_t sample, uint64_t ticks) {
+
+  tb->samples[0] = sample;
+  tb->ticks[0] = ticks;
+  tb->idx = 1;
+  tb->count = 1;
+
+  tb->fit.sample = sample;
+  tb->fit.ticks = ticks << TIMEBASE_FRAC_BITS;
+  tb->fit.period = (tb->has_anchor ? tb->fit.period : tb->nominal);            /* Drift is kept over a restart */
+  tb->has_anchor = true;
+
+}
+
+
+/*
+* @brief Function to measure the sample period from the oldest to the newest anchor
+*
+* @param[in]   tb                     Pointer to the timebase structure
+* @return                             Returns the period with TIMEBASE_FRAC_BITS fractional bits
+*/
+static uint32_t _timebase_get_period(timebase *tb) {
+
+  uint8_t newest = (tb->idx - 1) & (TIMEBASE_ANCHORS_SIZE - 1);
+  uint8_t oldest = (tb->idx - tb->count) & (TIMEBASE_ANCHORS_SIZE - 1);
+  uint32_t samples = tb->samples[newest] - tb->samples[oldest];
+
+  if(tb->count < 2 || !samples) {
+    return tb->fit.period;
+  }
+
+  return (uint32_t)(((tb->ticks[newest] - tb->ticks[oldest]) << TIMEBASE_FRAC_BITS) / samples);
+
+}
@@ -0,0 +1,71 @@
+/*
+* @file           timebase.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the sample timebase, anchors mapping the
+*                 DRDY sample index to RTC ticks and the drift estimation of
+*                 the ADS129x clock against the 32.768 kHz RTC.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+#define TIMEBASE_TICKS_PER_SECOND     32768     /* RTC frequency */
+#define TIMEBASE_FRAC_BITS            16        /* Fractional bits of the ticks and of the period */
+#define TIMEBASE_ANCHORS_SIZE         8         /* Anchors in the drift window, must be power of 2 */
+#define TIMEBASE_OFFSET_SHIFT         2         /* Weight of a new anchor in the offset, 1/4 */
+#define TIMEBASE_RESYNC_TICKS         33        /* Anchors off the fit by more than 1 ms restart the timebase */
+
+/* Anchor record, big-endian
+ *   type (1), sample index (4), ticks with TIMEBASE_FRAC_BITS (8), period with TIMEBASE_FRAC_BITS (4) */
+#define TIMEBASE_RECORD_SIZE          17
+
+/* Line from a sample index to RTC ticks */
+typedef struct {
+  uint32_t  sample;                             /* Sample index of the anchor */
+  uint64_t  ticks;                              /* RTC ticks of the sample, TIMEBASE_FRAC_BITS fractional bits */
+  uint32_t  period;                             /* Sample period in RTC ticks, TIMEBASE_FRAC_BITS fractional bits */
+} timebase_anchor;
+
+/* Timebase state */
+typedef struct {
+  uint32_t        nominal;                      /* Nominal period from the sampling rate */
+  timebase_anchor fit;                          /* Current line, valid after the first anchor */
+  bool            has_anchor;
+
+  /* Anchors as measured, for the period over the window */
+  uint32_t        samples[TIMEBASE_ANCHORS_SIZE];
+  uint64_t        ticks[TIMEBASE_ANCHORS_SIZE];
+  uint8_t         idx;
+  uint8_t         count;
+
+  uint32_t        resyncs;                      /* Restarts because of a jump of the RTC or of the index */
+} timebase;
+
+/********************************** Functions ***********************************/
+bool timebase_init(timebase *tb, uint16_t rate);
+void timebase_reset(timebase *tb);
+void timebase_add_anchor(timebase *tb, uint32_t sample, uint64_t ticks);
+const timebase_anchor *timebase_get_anchor(timebase *tb);
+uint64_t timebase_get_us(timebase *tb, uint32_t sample);
+int32_t timebase_get_drift_ppm(timebase *tb);
+uint32_t timebase_get_resyncs(timebase *tb);
+uint16_t timebase_get_record(timebase *tb, uint8_t type, uint8_t *record);
+
+/* Readers of the stored frames, only the anchor and the sample index are needed, the rate of the frames is the one of their anchor */
+bool timebase_parse_record(const uint8_t *record, timebase_anchor *anchor);
+uint64_t timebase_anchor_get_ticks(const timebase_anchor *anchor, uint32_t sample);
+uint16_t timebase_anchor_get_rate(const timebase_anchor *anchor);
+uint64_t timebase_ticks_to_us(uint64_t ticks);
+
+#endif /* TIMEBASE_H */
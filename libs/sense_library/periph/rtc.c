@@ -106,6 +106,15 @@ void rtc_set_timer(uint64_t ts_now) {
  * @return Current RTC clock in milliseconds.
  */
 uint64_t rtc_get_milliseconds(void) {
+  return RTC_TICKS_TO_MS(rtc_get_ticks());
+}
+
+/**
+ * Get internal RTC ticks.
+ * @return Current RTC clock in ticks of 1 / RTC_FREQ seconds.
+ * @note Integer only, cheap enough to be called from interrupt context.
+ */
+uint64_t rtc_get_ticks(void) {
   uint64_t ticks;
 
   /* Read ticks */
@@ -118,7 +127,7 @@ uint64_t rtc_get_milliseconds(void) {
   if (ticks < _safe_stamp) {
     ticks += (RTC_OVERFLOW + 1);
   }
-  return RTC_TICKS_TO_MS(ticks);
+  return ticks;
 }
 
 /**
@@ -25,6 +25,7 @@
 
 #define RTC_BITS                (24)                                                        ///< RTC bits number.
 #define RTC_FREQ                ((float) 32768)                                             ///< RTC frequency.
+#define RTC_TICKS_PER_SECOND    (32768)                                                     ///< RTC frequency, integer.
 #define RTC_OVERFLOW            (RTC_COUNTER_COUNTER_Msk)                                   ///< RTC overflow ticks number.
 #define RTC_INTERRUPT_PRIORITY  (6)                                                         ///< RTC interrupt priority.
 #define RTC_SAFE_COUNTER_CC     (0)                                                         ///< CC safe counter number.
@@ -45,6 +46,8 @@ void rtc_set_timer(uint64_t ts_now);
 
 uint64_t rtc_get_milliseconds(void);
 
+uint64_t rtc_get_ticks(void);
+
 uint64_t rtc_get_seconds(void);
 
 #endif /* RTC_H_ */
\ No newline at end of file
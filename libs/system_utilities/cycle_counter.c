@@ -0,0 +1,106 @@
+/*
+* @file           cycle_counter.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the cycle counter utilities, based on the
+*                 Cortex-M4 DWT cycle counter, used to measure execution
+*                 time of interrupts and processing stages on target.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "cycle_counter.h"
+
+/* SDK */
+#include "nrf.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Public ************************************/
+/*
+* @brief Function to enable the DWT cycle counter
+*
+* @note  Can be called more than once, the counter is not restarted
+*/
+void cycle_counter_init(void) {
+
+  if(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+    return;
+  }
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;                /* Enable trace and debug blocks */
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;                            /* Enable cycle counter */
+
+}
+
+
+/*
+* @brief Function to get the current value of the cycle counter
+*
+* @return                             Returns the free running cycle counter
+*/
+uint32_t cycle_counter_get(void) {
+  return DWT->CYCCNT;
+}
+
+
+/*
+* @brief Function to reset execution time statistics
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @param[in]   budget                 Cycles budget of the section, 0 to disable
+*/
+void cycle_counter_stats_init(cycle_counter_stats *stats, uint32_t budget) {
+
+  memset(stats, 0, sizeof(cycle_counter_stats));
+  stats->budget = budget;
+
+}
+
+
+/*
+* @brief Function to add one execution to the statistics
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @param[in]   start                  Value of cycle_counter_get() at the section start
+* @note                               Unsigned subtraction handles the counter wrap around
+*/
+void cycle_counter_stats_add(cycle_counter_stats *stats, uint32_t start) {
+
+  uint32_t cycles = DWT->CYCCNT - start;
+
+  stats->count++;
+  stats->last = cycles;
+  stats->total += cycles;
+
+  if(cycles > stats->max) {
+    stats->max = cycles;
+  }
+
+  if(stats->budget && cycles > stats->budget) {
+    stats->over_budget++;
+  }
+
+}
+
+
+/*
+* @brief Function to get the mean execution cycles
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @return                             Returns the mean cycles, 0 if nothing measured
+*/
+uint32_t cycle_counter_stats_mean(cycle_counter_stats *stats) {
+
+  if(!stats->count) {
+    return 0;
+  }
+  return (uint32_t)(stats->total / stats->count);
+
+}
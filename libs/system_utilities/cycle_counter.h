@@ -0,0 +1,44 @@
+/*
+* @file           cycle_counter.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the cycle counter utilities, based on the
+*                 Cortex-M4 DWT cycle counter, used to measure execution
+*                 time of interrupts and processing stages on target.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+#define CYCLE_COUNTER_CPU_FREQ_MHZ        64                                        /* nRF52832 core clock in MHz */
+#define CYCLE_COUNTER_US_TO_CYCLES(us)    ((uint32_t)(us) * CYCLE_COUNTER_CPU_FREQ_MHZ)
+#define CYCLE_COUNTER_CYCLES_TO_US(cyc)   ((uint32_t)(cyc) / CYCLE_COUNTER_CPU_FREQ_MHZ)
+
+/* Execution time statistics of a code section */
+typedef struct {
+  uint32_t  count;          /* Number of measured executions */
+  uint32_t  last;           /* Cycles of the last execution */
+  uint32_t  max;            /* Worst case cycles */
+  uint32_t  budget;         /* Cycles budget, 0 if not used */
+  uint32_t  over_budget;    /* Number of executions above budget */
+  uint64_t  total;          /* Accumulated cycles, used for the mean */
+} cycle_counter_stats;
+
+/********************************** Functions ***********************************/
+void cycle_counter_init(void);
+uint32_t cycle_counter_get(void);
+void cycle_counter_stats_init(cycle_counter_stats *stats, uint32_t budget);
+void cycle_counter_stats_add(cycle_counter_stats *stats, uint32_t start);
+uint32_t cycle_counter_stats_mean(cycle_counter_stats *stats);
+
+#endif /* CYCLE_COUNTER_H */
@@ -0,0 +1,423 @@
+/*
+* @file           edf.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the EDF+ encoding of the recordings, the file
+*                 and signals headers, the scaling of the samples to 16-bit
+*                 and the time-stamped annotation lists (TAL).
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "edf.h"
+
+/* Utilities */
+#include "fmt.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* Header fields not in edf.h */
+#define EDF_RECORDING_LENGTH          80
+#define EDF_BYTES_OFFSET              184
+#define EDF_BYTES_LENGTH              8
+#define EDF_DURATION_LENGTH           8
+#define EDF_SIGNALS_LENGTH            4
+#define EDF_NUMBER_MAX                FMT_FIXED_SIZE
+
+/* Days from 1970-01-01 to 1985-01-01, start date of the header when the real one is unknown */
+#define EDF_CLIPPING_DAYS             5479
+#define EDF_MS_PER_DAY                86400000ULL
+
+/* Lengths of the signal headers, in the order of edf_signal_field */
+static const uint8_t _signal_lengths[EDF_SIGNAL_FIELDS] = {16, 80, 8, 8, 8, 8, 8, 80, 8, 32};
+
+static const char _months[12][4] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+
+/* Calendar date and time of the start */
+typedef struct {
+  uint16_t  year;
+  uint8_t   month;                                  /* 1 to 12 */
+  uint8_t   day;
+  uint8_t   hours;
+  uint8_t   minutes;
+  uint8_t   seconds;
+} edf_date;
+
+/* Private functions list */
+static void _edf_put_field(uint8_t *field, uint8_t length, const char *text, uint8_t text_length);
+static uint8_t _edf_format_decimal(char *text, int64_t value, uint8_t decimals);
+static uint8_t _edf_format_two_digits(char *text, uint8_t value, char separator);
+static void _edf_get_date(uint64_t unix_ms, edf_date *date);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to build the fixed part of the header
+*
+* @param[out]  header                 Buffer with EDF_HEADER_SIZE bytes
+* @param[in]   file                   Recording
+* @note                               The signal headers follow, from edf_get_signal_field()
+*/
+void edf_get_header(uint8_t *header, const edf_file *file) {
+
+  char text[EDF_RECORDING_LENGTH];
+  uint8_t length;
+  edf_date date;
+  bool known = file->start_ms != 0;
+
+  memset(header, ' ', EDF_HEADER_SIZE);
+
+  /* Version and patient */
+  header[0] = '0';
+  if(file->patient != NULL) {
+    _edf_put_field(&header[EDF_PATIENT_OFFSET], EDF_PATIENT_LENGTH, file->patient, strlen(file->patient));
+  } else {
+    _edf_put_field(&header[EDF_PATIENT_OFFSET], EDF_PATIENT_LENGTH, "X X X X", 7);
+  }
+
+  /* Recording, "Startdate dd-MMM-yyyy admincode technician equipment" */
+  _edf_get_date(known ? file->start_ms : 0, &date);
+  length = 0;
+  memcpy(text, "Startdate ", 10);
+  length += 10;
+  if(known) {
+    length += _edf_format_two_digits(&text[length], date.day, '-');
+    memcpy(&text[length], _months[date.month - 1], 3);
+    length += 3;
+    text[length++] = '-';
+    length += _edf_format_decimal(&text[length], date.year, 0);
+  } else {
+    text[length++] = 'X';
+  }
+  memcpy(&text[length], " X X ", 5);
+  length += 5;
+  if(file->equipment != NULL) {
+    uint8_t equipment = strlen(file->equipment);
+
+    if(equipment > EDF_RECORDING_LENGTH - length) {
+      equipment = EDF_RECORDING_LENGTH - length;
+    }
+    memcpy(&text[length], file->equipment, equipment);
+    length += equipment;
+  } else {
+    text[length++] = 'X';
+  }
+  _edf_put_field(&header[EDF_PATIENT_OFFSET + EDF_PATIENT_LENGTH], EDF_RECORDING_LENGTH, text, length);
+
+  /* Start date "dd.mm.yy" and time "hh.mm.ss" */
+  length = _edf_format_two_digits(text, date.day, '.');
+  length += _edf_format_two_digits(&text[length], date.month, '.');
+  length += _edf_format_two_digits(&text[length], date.year % 100, 0);
+  length += _edf_format_two_digits(&text[length], date.hours, '.');
+  length += _edf_format_two_digits(&text[length], date.minutes, '.');
+  length += _edf_format_two_digits(&text[length], date.seconds, 0);
+  memcpy(&header[EDF_PATIENT_OFFSET + EDF_PATIENT_LENGTH + EDF_RECORDING_LENGTH], text, length);
+
+  /* Header size */
+  length = _edf_format_decimal(text, EDF_HEADER_BYTES(file->signals_count), 0);
+  _edf_put_field(&header[EDF_BYTES_OFFSET], EDF_BYTES_LENGTH, text, length);
+
+  /* Reserved, data records and their duration in seconds, number of signals */
+  edf_get_reserved(&header[EDF_RESERVED_OFFSET], file->continuous);
+  edf_get_records(&header[EDF_RECORDS_OFFSET], file->records);
+  length = _edf_format_decimal(text, file->record_ms, 3);
+  _edf_put_field(&header[EDF_RECORDS_OFFSET + EDF_RECORDS_LENGTH], EDF_DURATION_LENGTH, text, length);
+  length = _edf_format_decimal(text, file->signals_count, 0);
+  _edf_put_field(&header[EDF_RECORDS_OFFSET + EDF_RECORDS_LENGTH + EDF_DURATION_LENGTH], EDF_SIGNALS_LENGTH, text, length);
+
+}
+
+
+/*
+* @brief Function to get one field of one signal header
+*
+* @param[out]  field                  Buffer with up to 80 bytes, the field padded with spaces
+* @param[in]   file                   Recording
+* @param[in]   id                     Field, the signal headers are written field by field for all the signals
+* @param[in]   signal                 Signal index
+* @retval                             Returns the field length in bytes
+*/
+uint8_t edf_get_signal_field(uint8_t *field, const edf_file *file, edf_signal_field id, uint8_t signal) {
+
+  const edf_signal *sig = &file->signals[signal];
+  char text[EDF_NUMBER_MAX];
+  const char *value = NULL;
+  uint8_t length = 0;
+
+  switch(id) {
+    case EDF_SIGNAL_LABEL:
+      value = sig->label;
+      break;
+    case EDF_SIGNAL_TRANSDUCER:
+      value = sig->transducer;
+      break;
+    case EDF_SIGNAL_DIMENSION:
+      value = sig->dimension;
+      break;
+    case EDF_SIGNAL_PHYSICAL_MIN:
+      length = _edf_format_decimal(text, sig->physical_min, sig->decimals);
+      break;
+    case EDF_SIGNAL_PHYSICAL_MAX:
+      length = _edf_format_decimal(text, sig->physical_max, sig->decimals);
+      break;
+    case EDF_SIGNAL_DIGITAL_MIN:
+      length = _edf_format_decimal(text, sig->digital_min, 0);
+      break;
+    case EDF_SIGNAL_DIGITAL_MAX:
+      length = _edf_format_decimal(text, sig->digital_max, 0);
+      break;
+    case EDF_SIGNAL_PREFILTERING:
+      value = sig->prefiltering;
+      break;
+    case EDF_SIGNAL_SAMPLES:
+      length = _edf_format_decimal(text, sig->samples, 0);
+      break;
+    default:
+      break;
+  }
+
+  if(value != NULL) {
+    _edf_put_field(field, _signal_lengths[id], value, strlen(value));
+  } else {
+    _edf_put_field(field, _signal_lengths[id], text, length);
+  }
+  return _signal_lengths[id];
+
+}
+
+
+/*
+* @brief Function to get the reserved field, with the EDF+ variant
+*
+* @param[out]  reserved               Buffer with EDF_RESERVED_LENGTH bytes, at EDF_RESERVED_OFFSET of the header
+* @param[in]   continuous             True if the data records have no gaps
+*/
+void edf_get_reserved(uint8_t *reserved, bool continuous) {
+  _edf_put_field(reserved, EDF_RESERVED_LENGTH, continuous ? "EDF+C" : "EDF+D", 5);
+}
+
+
+/*
+* @brief Function to get the number of data records field
+*
+* @param[out]  records                Buffer with EDF_RECORDS_LENGTH bytes, at EDF_RECORDS_OFFSET of the header
+* @param[in]   count                  Data records in the file, -1 if unknown
+*/
+void edf_get_records(uint8_t *records, int32_t count) {
+
+  char text[EDF_NUMBER_MAX];
+
+  _edf_put_field(records, EDF_RECORDS_LENGTH, text, _edf_format_decimal(text, count, 0));
+
+}
+
+
+/*
+* @brief Function to get the size of a data record
+*
+* @param[in]   file                   Recording
+* @retval                             Returns the data record size in bytes
+*/
+uint32_t edf_get_record_size(const edf_file *file) {
+
+  uint32_t samples = 0;
+
+  for(uint8_t i = 0 ; i < file->signals_count ; i++) {
+    samples += file->signals[i].samples;
+  }
+  return samples * EDF_SAMPLE_SIZE;
+
+}
+
+
+/*
+* @brief Function to scale a physical value to the digital range of a signal
+*
+* @param[in]   signal                 Signal
+* @param[in]   physical               Value in 10^-decimals of the dimension
+* @retval                             Returns the digital value, clipped to the signal range
+*/
+int16_t edf_get_digital(const edf_signal *signal, int32_t physical) {
+
+  int64_t span = (int64_t)signal->physical_max - signal->physical_min;
+  int64_t value;
+
+  if(physical <= signal->physical_min || span <= 0) {
+    return signal->digital_min;
+  }
+  if(physical >= signal->physical_max) {
+    return signal->digital_max;
+  }
+
+  value = ((int64_t)physical - signal->physical_min) * ((int32_t)signal->digital_max - signal->digital_min);
+  return (int16_t)(signal->digital_min + (value + span / 2) / span);
+
+}
+
+
+/*
+* @brief Function to store a sample in a data record
+*
+* @param[out]  samples                Samples of the signal in the data record
+* @param[in]   index                  Sample index in the data record
+* @param[in]   digital                Digital value
+*/
+void edf_set_sample(uint8_t *samples, uint16_t index, int16_t digital) {
+
+  samples[index * EDF_SAMPLE_SIZE] = (uint8_t)digital;
+  samples[index * EDF_SAMPLE_SIZE + 1] = (uint8_t)((uint16_t)digital >> 8);
+
+}
+
+
+/*
+* @brief Function to read a sample of a data record
+*
+* @param[in]   samples                Samples of the signal in the data record
+* @param[in]   index                  Sample index in the data record
+* @retval                             Returns the digital value
+*/
+int16_t edf_get_sample(const uint8_t *samples, uint16_t index) {
+  return (int16_t)((uint16_t)samples[index * EDF_SAMPLE_SIZE] | ((uint16_t)samples[index * EDF_SAMPLE_SIZE + 1] << 8));
+}
+
+
+/*
+* @brief Function to build a time-stamped annotations list
+*
+* @param[out]  tal                    Buffer for the TAL
+* @param[in]   size                   Buffer size in bytes
+* @param[in]   onset_ms               Time from the start of the recording
+* @param[in]   text                   Annotation, or NULL for the time-keeping TAL that starts each data record
+* @retval                             Returns the TAL length in bytes, or 0 if it does not fit
+*/
+uint8_t edf_get_tal(uint8_t *tal, uint8_t size, uint32_t onset_ms, const char *text) {
+
+  char onset[EDF_NUMBER_MAX];
+  uint8_t onset_length = _edf_format_decimal(onset, onset_ms, 3);
+  uint8_t text_length = (text != NULL) ? strlen(text) : 0;
+  uint16_t length = 1 + onset_length + 1 + text_length + 1 + 1;
+
+  if(length > size) {
+    return 0;
+  }
+
+  tal[0] = '+';
+  memcpy(&tal[1], onset, onset_length);
+  length = 1 + onset_length;
+  tal[length++] = EDF_TAL_SEPARATOR;
+  memcpy(&tal[length], text, text_length);
+  length += text_length;
+  tal[length++] = EDF_TAL_SEPARATOR;
+  tal[length++] = 0;
+  return (uint8_t)length;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to write a header field, left aligned and padded with spaces
+*
+* @param[out]  field                  Field in the header
+* @param[in]   length                 Field length in bytes
+* @param[in]   text                   Text, cut to the field length
+* @param[in]   text_length            Text length in bytes
+*/
+static void _edf_put_field(uint8_t *field, uint8_t length, const char *text, uint8_t text_length) {
+
+  if(text_length > length) {
+    text_length = length;
+  }
+  memcpy(field, text, text_length);
+  memset(&field[text_length], ' ', length - text_length);
+
+}
+
+
+/*
+* @brief Function to format a fixed point value in ASCII, without the trailing zeros of the decimals
+*
+* @param[out]  text                   Buffer with EDF_NUMBER_MAX bytes
+* @param[in]   value                  Value in 10^-decimals units
+* @param[in]   decimals               Number of decimals, up to FMT_MAX_DECIMALS
+* @retval                             Returns the text length in bytes
+*/
+static uint8_t _edf_format_decimal(char *text, int64_t value, uint8_t decimals) {
+
+  uint8_t length = fmt_fixed(text, value, decimals);
+
+  /* Decimals that are zero, and the point without decimals */
+  if(decimals) {
+    while(text[length - 1] == '0') {
+      length--;
+    }
+    if(text[length - 1] == '.') {
+      length--;
+    }
+  }
+  return length;
+
+}
+
+
+/*
+* @brief Function to format two decimal digits and a separator
+*
+* @param[out]  text                   Buffer with 3 bytes
+* @param[in]   value                  Value, 0 to 99
+* @param[in]   separator              Character after the digits, or 0 for none
+* @retval                             Returns the text length in bytes
+*/
+static uint8_t _edf_format_two_digits(char *text, uint8_t value, char separator) {
+
+  text[0] = '0' + (value / 10) % 10;
+  text[1] = '0' + value % 10;
+  if(!separator) {
+    return 2;
+  }
+  text[2] = separator;
+  return 3;
+
+}
+
+
+/*
+* @brief Function to get the calendar date of a Unix time
+*
+* @param[in]   unix_ms                Milliseconds since 1970-01-01, 0 for the 1985-01-01 of unknown starts
+* @param[out]  date                   Date and time in UTC
+*/
+static void _edf_get_date(uint64_t unix_ms, edf_date *date) {
+
+  uint32_t days = (uint32_t)(unix_ms / EDF_MS_PER_DAY);
+  uint32_t seconds = (uint32_t)((unix_ms % EDF_MS_PER_DAY) / 1000);
+  uint32_t era_day;
+  uint32_t year_of_era;
+  uint32_t day_of_year;
+  uint32_t month;
+
+  if(!unix_ms) {
+    days = EDF_CLIPPING_DAYS;
+  }
+
+  /* Civil date from the days, in eras of 400 years from 0000-03-01 */
+  days += 719468;
+  era_day = days % 146097;
+  year_of_era = (era_day - era_day / 1460 + era_day / 36524 - era_day / 146096) / 365;
+  day_of_year = era_day - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  month = (5 * day_of_year + 2) / 153;
+
+  date->day = day_of_year - (153 * month + 2) / 5 + 1;
+  date->month = (month < 10) ? month + 3 : month - 9;
+  date->year = year_of_era + (days / 146097) * 400 + (date->month <= 2);
+  date->hours = seconds / 3600;
+  date->minutes = (seconds / 60) % 60;
+  date->seconds = seconds % 60;
+
+}
@@ -0,0 +1,99 @@
+/*
+* @file           edf.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the EDF+ encoding of the recordings, the file
+*                 and signals headers, the scaling of the samples to 16-bit
+*                 and the time-stamped annotation lists (TAL).
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef EDF_H
+#define EDF_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+/* File, ASCII header of EDF_HEADER_SIZE bytes and one more EDF_HEADER_SIZE bytes per signal,
+ * followed by the data records, each with the samples of one signal after the other */
+#define EDF_HEADER_SIZE               256
+#define EDF_HEADER_BYTES(signals)     (EDF_HEADER_SIZE * (1 + (uint32_t)(signals)))
+#define EDF_MAX_SIGNALS               20
+#define EDF_SAMPLE_SIZE               2         /* Little-endian two's complement */
+#define EDF_DIGITAL_MIN               (-32768)
+#define EDF_DIGITAL_MAX               32767
+
+/* Offsets of the header fields updated when the recording grows */
+#define EDF_RESERVED_OFFSET           192
+#define EDF_RESERVED_LENGTH           44
+#define EDF_RECORDS_OFFSET            236
+#define EDF_RECORDS_LENGTH            8
+#define EDF_PATIENT_OFFSET            8
+#define EDF_PATIENT_LENGTH            80
+
+/* Annotations signal, one sample is two characters of TALs */
+#define EDF_ANNOTATIONS_LABEL         "EDF Annotations"
+#define EDF_TAL_SEPARATOR             0x14
+
+/* Signal headers, in the order they are in the file */
+typedef enum {
+  EDF_SIGNAL_LABEL,
+  EDF_SIGNAL_TRANSDUCER,
+  EDF_SIGNAL_DIMENSION,
+  EDF_SIGNAL_PHYSICAL_MIN,
+  EDF_SIGNAL_PHYSICAL_MAX,
+  EDF_SIGNAL_DIGITAL_MIN,
+  EDF_SIGNAL_DIGITAL_MAX,
+  EDF_SIGNAL_PREFILTERING,
+  EDF_SIGNAL_SAMPLES,
+  EDF_SIGNAL_RESERVED,
+  EDF_SIGNAL_FIELDS
+} edf_signal_field;
+
+/* Signal, the physical values are integers in 10^-decimals of the dimension */
+typedef struct {
+  const char  *label;                               /* Up to 16 characters */
+  const char  *transducer;                          /* Up to 80 characters, or NULL */
+  const char  *dimension;                           /* Up to 8 characters, or NULL */
+  const char  *prefiltering;                        /* Up to 80 characters, or NULL */
+  int32_t     physical_min;
+  int32_t     physical_max;
+  int16_t     digital_min;
+  int16_t     digital_max;
+  uint8_t     decimals;
+  uint16_t    samples;                              /* Samples in each data record */
+} edf_signal;
+
+/* Recording */
+typedef struct {
+  const char        *patient;                       /* EDF+ patient subfields "code sex birthdate name ...", or NULL */
+  const char        *equipment;                     /* Equipment code of the recording field */
+  uint64_t          start_ms;                       /* Unix time of the first sample, 0 if unknown */
+  int32_t           records;                        /* Data records in the file, -1 if unknown */
+  uint16_t          record_ms;                      /* Duration of a data record */
+  bool              continuous;                     /* EDF+C if the data records have no gaps, otherwise EDF+D */
+  uint8_t           signals_count;
+  const edf_signal  *signals;
+} edf_file;
+
+/********************************** Functions ***********************************/
+/* Headers */
+void edf_get_header(uint8_t *header, const edf_file *file);
+uint8_t edf_get_signal_field(uint8_t *field, const edf_file *file, edf_signal_field id, uint8_t signal);
+void edf_get_reserved(uint8_t *reserved, bool continuous);
+void edf_get_records(uint8_t *records, int32_t count);
+
+/* Data records */
+uint32_t edf_get_record_size(const edf_file *file);
+int16_t edf_get_digital(const edf_signal *signal, int32_t physical);
+void edf_set_sample(uint8_t *samples, uint16_t index, int16_t digital);
+int16_t edf_get_sample(const uint8_t *samples, uint16_t index);
+uint8_t edf_get_tal(uint8_t *tal, uint8_t size, uint32_t onset_ms, const char *text);
+
+#endif /* EDF_H */
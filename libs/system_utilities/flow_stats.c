@@ -0,0 +1,211 @@
+/*
+* @file           flow_stats.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the flow statistics of a stage of the
+*                 measurements pipeline, items produced, forwarded and
+*                 dropped, time in the stage and lowest free capacity.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "flow_stats.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* Private functions list */
+static void _flow_stats_save_uint32(uint8_t *array, uint32_t value);
+static void _flow_stats_save_uint16(uint8_t *array, uint32_t value);
+static uint32_t _flow_stats_get_uint32(const uint8_t *array);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to reset the statistics of a stage
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @param[in]   capacity               Capacity of the stage, the free capacity starts there
+*/
+void flow_stats_init(flow_stats *stats, uint32_t capacity) {
+
+  memset(stats, 0, sizeof(flow_stats));
+  stats->capacity = capacity;
+  stats->free_min = capacity;
+
+}
+
+
+/*
+* @brief Function to count items offered to the stage
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @param[in]   count                  Number of items
+* @param[in]   free                   Free capacity of the stage when the items arrived
+*/
+void flow_stats_produced(flow_stats *stats, uint32_t count, uint32_t free) {
+
+  stats->produced += count;
+  if(free < stats->free_min) {
+    stats->free_min = free;
+  }
+
+}
+
+
+/*
+* @brief Function to count items passed on to the next stage
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @param[in]   count                  Number of items
+* @param[in]   latency_ms             Time the oldest of the items spent in the stage
+*/
+void flow_stats_forwarded(flow_stats *stats, uint32_t count, uint32_t latency_ms) {
+
+  stats->forwarded += count;
+  stats->latency_count++;
+  stats->latency_total += latency_ms;
+  if(latency_ms > stats->latency_max) {
+    stats->latency_max = latency_ms;
+  }
+
+}
+
+
+/*
+* @brief Function to count items lost in the stage
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @param[in]   count                  Number of items
+*/
+void flow_stats_dropped(flow_stats *stats, uint32_t count) {
+  stats->dropped += count;
+}
+
+
+/*
+* @brief Function to get one value of the statistics
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @param[in]   value                  FLOW_STATS_PRODUCED to FLOW_STATS_FREE_MIN
+* @return                             Returns the value, latencies in ms
+*/
+uint32_t flow_stats_get_value(const flow_stats *stats, flow_stats_value value) {
+
+  switch(value) {
+    case FLOW_STATS_PRODUCED:
+      return stats->produced;
+    case FLOW_STATS_FORWARDED:
+      return stats->forwarded;
+    case FLOW_STATS_DROPPED:
+      return stats->dropped;
+    case FLOW_STATS_LATENCY_MEAN:
+      return stats->latency_count ? (uint32_t)(stats->latency_total / stats->latency_count) : 0;
+    case FLOW_STATS_LATENCY_MAX:
+      return stats->latency_max;
+    case FLOW_STATS_FREE_MIN:
+      return stats->free_min;
+    default:
+      return 0;
+  }
+
+}
+
+
+/*
+* @brief Function to serialize the statistics, to send them to the other MCU
+*
+* @param[in]   stats                  Pointer to the statistics structure
+* @param[in]   stage                  Stage of the statistics
+* @param[out]  array                  Buffer with FLOW_STATS_SIZE bytes
+* @note                               Latencies and free capacity saturate at 16 bits
+*/
+void flow_stats_to_array(const flow_stats *stats, uint8_t stage, uint8_t *array) {
+
+  array[0] = stage;
+  _flow_stats_save_uint32(&array[1], stats->produced);
+  _flow_stats_save_uint32(&array[5], stats->forwarded);
+  _flow_stats_save_uint32(&array[9], stats->dropped);
+  _flow_stats_save_uint16(&array[13], flow_stats_get_value(stats, FLOW_STATS_LATENCY_MEAN));
+  _flow_stats_save_uint16(&array[15], stats->latency_max);
+  _flow_stats_save_uint16(&array[17], stats->free_min);
+
+}
+
+
+/*
+* @brief Function to get the statistics serialized with flow_stats_to_array()
+*
+* @param[in]   array                  Serialized statistics
+* @param[in]   size                   Size in bytes
+* @param[out]  stage                  Stage of the statistics
+* @param[out]  stats                  Statistics, with the same values from flow_stats_get_value()
+* @retval                             Returns true if successful, or false if the size is too small
+*/
+bool flow_stats_from_array(const uint8_t *array, uint16_t size, uint8_t *stage, flow_stats *stats) {
+
+  if(size < FLOW_STATS_SIZE) {
+    return false;
+  }
+
+  memset(stats, 0, sizeof(flow_stats));
+  *stage = array[0];
+  stats->produced = _flow_stats_get_uint32(&array[1]);
+  stats->forwarded = _flow_stats_get_uint32(&array[5]);
+  stats->dropped = _flow_stats_get_uint32(&array[9]);
+  stats->latency_count = 1;
+  stats->latency_total = ((uint16_t)array[13] << 8) | array[14];
+  stats->latency_max = ((uint16_t)array[15] << 8) | array[16];
+  stats->free_min = ((uint16_t)array[17] << 8) | array[18];
+  return true;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to save a 32-bit value, big-endian
+*
+* @param[out]  array                  Buffer with 4 bytes
+* @param[in]   value                  Value
+*/
+static void _flow_stats_save_uint32(uint8_t *array, uint32_t value) {
+
+  array[0] = (uint8_t)(value >> 24);
+  array[1] = (uint8_t)(value >> 16);
+  array[2] = (uint8_t)(value >> 8);
+  array[3] = (uint8_t)value;
+
+}
+
+
+/*
+* @brief Function to save a value in 16 bits, big-endian, saturated
+*
+* @param[out]  array                  Buffer with 2 bytes
+* @param[in]   value                  Value
+*/
+static void _flow_stats_save_uint16(uint8_t *array, uint32_t value) {
+
+  if(value > UINT16_MAX) {
+    value = UINT16_MAX;
+  }
+  array[0] = (uint8_t)(value >> 8);
+  array[1] = (uint8_t)value;
+
+}
+
+
+/*
+* @brief Function to get a 32-bit value, big-endian
+*
+* @param[in]   array                  Buffer with 4 bytes
+* @return                             Returns the value
+*/
+static uint32_t _flow_stats_get_uint32(const uint8_t *array) {
+  return ((uint32_t)array[0] << 24) | ((uint32_t)array[1] << 16) | ((uint32_t)array[2] << 8) | array[3];
+}
@@ -0,0 +1,59 @@
+/*
+* @file           flow_stats.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the flow statistics of a stage of the
+*                 measurements pipeline, items produced, forwarded and
+*                 dropped, time in the stage and lowest free capacity.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef FLOW_STATS_H
+#define FLOW_STATS_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+/* Serialized statistics, big-endian
+ *   stage (1), produced (4), forwarded (4), dropped (4), mean latency in ms (2), max latency in ms (2), lowest free capacity (2) */
+#define FLOW_STATS_SIZE               19
+
+/* Values of the statistics, in the order of the diagnostic measurements */
+typedef enum {
+  FLOW_STATS_PRODUCED,
+  FLOW_STATS_FORWARDED,
+  FLOW_STATS_DROPPED,
+  FLOW_STATS_LATENCY_MEAN,
+  FLOW_STATS_LATENCY_MAX,
+  FLOW_STATS_FREE_MIN,
+  FLOW_STATS_VALUES
+} flow_stats_value;
+
+/* Flow statistics of a stage */
+typedef struct {
+  uint32_t  produced;       /* Items offered to the stage */
+  uint32_t  forwarded;      /* Items passed on to the next stage */
+  uint32_t  dropped;        /* Items lost in the stage */
+  uint32_t  latency_count;  /* Items with a time in the stage */
+  uint32_t  latency_max;    /* Worst time in the stage in ms */
+  uint64_t  latency_total;  /* Accumulated time in the stage in ms, used for the mean */
+  uint32_t  capacity;       /* Capacity of the stage, bytes or items */
+  uint32_t  free_min;       /* Lowest free capacity seen, the headroom left on the worst moment */
+} flow_stats;
+
+/********************************** Functions ***********************************/
+void flow_stats_init(flow_stats *stats, uint32_t capacity);
+void flow_stats_produced(flow_stats *stats, uint32_t count, uint32_t free);
+void flow_stats_forwarded(flow_stats *stats, uint32_t count, uint32_t latency_ms);
+void flow_stats_dropped(flow_stats *stats, uint32_t count);
+uint32_t flow_stats_get_value(const flow_stats *stats, flow_stats_value value);
+void flow_stats_to_array(const flow_stats *stats, uint8_t stage, uint8_t *array);
+bool flow_stats_from_array(const uint8_t *array, uint16_t size, uint8_t *stage, flow_stats *stats);
+
+#endif /* FLOW_STATS_H */
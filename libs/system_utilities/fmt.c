@@ -0,0 +1,305 @@
+/*
+* @file           fmt.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the formatting of integers, fixed point values
+*                 and floats in decimal and of integers in hexadecimal, into
+*                 the buffers of the caller, without sprintf, libm or heap.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "fmt.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* Digits of a 64-bit value beyond 32 bits, taken in chunks of 8 with a single 64-bit division each */
+#define FMT_CHUNK                     100000000UL
+#define FMT_CHUNK_DIGITS              8
+#define FMT_MAX_CHUNKS                2
+
+/* Fields of an IEEE 754 single precision float */
+#define FMT_FLOAT_SIGN_BIT            31
+#define FMT_FLOAT_MANTISSA_BITS       23
+#define FMT_FLOAT_MANTISSA_MASK       0x007FFFFFUL
+#define FMT_FLOAT_EXPONENT_MASK       0xFF
+#define FMT_FLOAT_EXPONENT_BIAS       127
+
+/* Two digits of every value from 0 to 99, two are written per division */
+static const char _digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+static const char _hex_digits[] = "0123456789abcdef";
+
+static const uint32_t _powers[FMT_MAX_DECIMALS + 1] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/* Private functions list */
+static uint8_t _fmt_count(uint32_t value);
+static void _fmt_put(char *end, uint32_t value, uint8_t count);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to format an unsigned 32-bit value in decimal
+*
+* @param[out]  text                   Buffer with FMT_U32_SIZE bytes
+* @param[in]   value                  Value
+* @retval                             Returns the text length in bytes, without the terminator
+*/
+uint8_t fmt_u32(char *text, uint32_t value) {
+
+  uint8_t count = _fmt_count(value);
+
+  _fmt_put(&text[count], value, count);
+  text[count] = '\0';
+  return count;
+
+}
+
+
+/*
+* @brief Function to format a signed 32-bit value in decimal
+*
+* @param[out]  text                   Buffer with FMT_I32_SIZE bytes
+* @param[in]   value                  Value
+* @retval                             Returns the text length in bytes, without the terminator
+*/
+uint8_t fmt_i32(char *text, int32_t value) {
+
+  if(value < 0) {
+    text[0] = '-';
+    return 1 + fmt_u32(&text[1], 0U - (uint32_t)value);
+  }
+  return fmt_u32(text, (uint32_t)value);
+
+}
+
+
+/*
+* @brief Function to format an unsigned 64-bit value in decimal
+*
+* @param[out]  text                   Buffer with FMT_U64_SIZE bytes
+* @param[in]   value                  Value
+* @retval                             Returns the text length in bytes, without the terminator
+*/
+uint8_t fmt_u64(char *text, uint64_t value) {
+
+  uint32_t chunks[FMT_MAX_CHUNKS];
+  uint8_t count = 0;
+  uint8_t length;
+
+  while(value > UINT32_MAX) {
+    chunks[count++] = (uint32_t)(value % FMT_CHUNK);
+    value /= FMT_CHUNK;
+  }
+
+  length = fmt_u32(text, (uint32_t)value);
+  while(count) {
+    length += FMT_CHUNK_DIGITS;
+    _fmt_put(&text[length], chunks[--count], FMT_CHUNK_DIGITS);
+  }
+  text[length] = '\0';
+  return length;
+
+}
+
+
+/*
+* @brief Function to format a fixed point value in decimal, with all its decimals
+*
+* @param[out]  text                   Buffer with FMT_FIXED_SIZE bytes
+* @param[in]   value                  Value in 10^-decimals units
+* @param[in]   decimals               Number of decimals, up to FMT_MAX_DECIMALS
+* @retval                             Returns the text length in bytes, without the terminator
+*/
+uint8_t fmt_fixed(char *text, int64_t value, uint8_t decimals) {
+
+  uint64_t magnitude = (value < 0) ? 0U - (uint64_t)value : (uint64_t)value;
+  uint64_t integer;
+  uint32_t fraction;
+  uint8_t length = 0;
+
+  if(decimals > FMT_MAX_DECIMALS) {
+    decimals = FMT_MAX_DECIMALS;
+  }
+
+  /* 32-bit division while it fits */
+  if(magnitude <= UINT32_MAX) {
+    integer = (uint32_t)magnitude / _powers[decimals];
+    fraction = (uint32_t)magnitude % _powers[decimals];
+  } else {
+    integer = magnitude / _powers[decimals];
+    fraction = (uint32_t)(magnitude % _powers[decimals]);
+  }
+
+  if(value < 0) {
+    text[length++] = '-';
+  }
+  length += fmt_u64(&text[length], integer);
+  if(decimals) {
+    text[length++] = '.';
+    length += decimals;
+    _fmt_put(&text[length], fraction, decimals);
+    text[length] = '\0';
+  }
+  return length;
+
+}
+
+
+/*
+* @brief Function to format a float in decimal, rounded to a number of decimals
+*
+* @param[out]  text                   Buffer with FMT_FIXED_SIZE bytes
+* @param[in]   value                  Value
+* @param[in]   decimals               Number of decimals, up to FMT_MAX_DECIMALS
+* @retval                             Returns the text length in bytes, without the terminator
+* @note                               Rounded from the exact value of the float, half to even, as printf.
+*                                     NaN is "nan" and values out of the fixed point range "inf", with
+*                                     the sign of the float as printf
+*/
+uint8_t fmt_float(char *text, float value, uint8_t decimals) {
+
+  uint32_t bits;
+  uint64_t mantissa;
+  uint64_t scaled;
+  int16_t exponent;
+  uint8_t length = 0;
+
+  if(decimals > FMT_MAX_DECIMALS) {
+    decimals = FMT_MAX_DECIMALS;
+  }
+  memcpy(&bits, &value, sizeof(bits));
+  mantissa = bits & FMT_FLOAT_MANTISSA_MASK;
+  exponent = (int16_t)((bits >> FMT_FLOAT_MANTISSA_BITS) & FMT_FLOAT_EXPONENT_MASK);
+  if(exponent == FMT_FLOAT_EXPONENT_MASK && mantissa) {
+    strcpy(text, "nan");
+    return 3;
+  }
+
+  if(bits >> FMT_FLOAT_SIGN_BIT) {
+    text[length++] = '-';
+  }
+  if(exponent == FMT_FLOAT_EXPONENT_MASK) {
+    strcpy(&text[length], "inf");
+    return length + 3;
+  }
+
+  /* Value as mantissa * 2^exponent, the subnormals without the implicit bit */
+  if(exponent) {
+    mantissa |= 1UL << FMT_FLOAT_MANTISSA_BITS;
+  } else {
+    exponent = 1;
+  }
+  exponent -= FMT_FLOAT_EXPONENT_BIAS + FMT_FLOAT_MANTISSA_BITS;
+
+  /* Scaled exactly, 24 bits times 10^9 fit in 64 bits, then shifted with the bits out rounded half to even */
+  mantissa *= _powers[decimals];
+  if(exponent >= 0 && (exponent >= 63 || mantissa > ((uint64_t)INT64_MAX >> exponent))) {
+    strcpy(&text[length], "inf");
+    return length + 3;
+  }
+  if(exponent >= 0) {
+    scaled = mantissa << exponent;
+  } else if(exponent > -64) {
+    uint64_t half = 1ULL << (-exponent - 1);
+    uint64_t rest = mantissa & ((half << 1) - 1);
+
+    scaled = mantissa >> -exponent;
+    if(rest > half || (rest == half && (scaled & 1))) {
+      scaled++;
+    }
+  } else {
+    scaled = 0;
+  }
+  return length + fmt_fixed(&text[length], (int64_t)scaled, decimals);
+
+}
+
+
+/*
+* @brief Function to format an unsigned 32-bit value in lowercase hexadecimal, without the "0x"
+*
+* @param[out]  text                   Buffer with FMT_HEX_SIZE bytes
+* @param[in]   value                  Value
+* @param[in]   digits                 Digits padded with zeros, up to 8, or 0 for the digits of the value
+* @retval                             Returns the text length in bytes, without the terminator
+*/
+uint8_t fmt_hex(char *text, uint32_t value, uint8_t digits) {
+
+  if(digits > 8) {
+    digits = 8;
+  }
+  if(!digits) {
+    for(digits = 1 ; digits < 8 && (value >> (4 * digits)) ; digits++);
+  }
+
+  text[digits] = '\0';
+  for(uint8_t i = digits ; i ; i--) {
+    text[i - 1] = _hex_digits[value & 0x0F];
+    value >>= 4;
+  }
+  return digits;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to count the decimal digits of a value
+*
+* @param[in]   value                  Value
+* @retval                             Returns the number of digits, 1 for zero
+*/
+static uint8_t _fmt_count(uint32_t value) {
+
+  uint8_t count = 1;
+
+  while(count <= FMT_MAX_DECIMALS && value >= _powers[count]) {
+    count++;
+  }
+  return count;
+
+}
+
+
+/*
+* @brief Function to write the decimal digits of a value backwards, two per division
+*
+* @param[out]  end                    Position after the last digit
+* @param[in]   value                  Value, with up to count digits
+* @param[in]   count                  Digits to write, padded with zeros
+*/
+static void _fmt_put(char *end, uint32_t value, uint8_t count) {
+
+  uint32_t pair;
+
+  while(count >= 2) {
+    pair = value % 100;
+    value /= 100;
+    end -= 2;
+    end[0] = _digit_pairs[2 * pair];
+    end[1] = _digit_pairs[2 * pair + 1];
+    count -= 2;
+  }
+  if(count) {
+    *--end = '0' + value % 10;
+  }
+
+}
@@ -0,0 +1,44 @@
+/*
+* @file           fmt.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the formatting of integers, fixed point values
+*                 and floats in decimal and of integers in hexadecimal, into
+*                 the buffers of the caller, without sprintf, libm or heap.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef FMT_H
+#define FMT_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+/* Buffer sizes of the largest text of each function, with the terminator */
+#define FMT_U32_SIZE                  11
+#define FMT_I32_SIZE                  12
+#define FMT_U64_SIZE                  21
+#define FMT_FIXED_SIZE                22        /* Sign, 19 digits, the point and a leading zero */
+#define FMT_HEX_SIZE                  9
+
+/* Decimals of the fixed point values and floats */
+#define FMT_MAX_DECIMALS              9
+
+/********************************** Functions ***********************************/
+/* Decimal */
+uint8_t fmt_u32(char *text, uint32_t value);
+uint8_t fmt_i32(char *text, int32_t value);
+uint8_t fmt_u64(char *text, uint64_t value);
+uint8_t fmt_fixed(char *text, int64_t value, uint8_t decimals);
+uint8_t fmt_float(char *text, float value, uint8_t decimals);
+
+/* Hexadecimal */
+uint8_t fmt_hex(char *text, uint32_t value, uint8_t digits);
+
+#endif /* FMT_H */
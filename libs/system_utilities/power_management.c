@@ -53,6 +53,7 @@
 #include "sense_library/utils/measurements_vector.h"
 #include "sense_library/utils/utils.h"
 #include "sense_library/utils/externs.h"
+#include "fmt.h"
 
 /* Gama queues */
 #include "sense_library/sensoroid/gama_queues.h"
@@ -194,9 +195,8 @@ void battery_saving_mode_check(void) {
     return;
   }
 
-  char battery_voltage_string[10];
-  memset(battery_voltage_string, '\0', 10);
-  utils_ftoa(battery_voltage_string, _current_battery_voltage, 0.001);
+  char battery_voltage_string[FMT_FIXED_SIZE];
+  fmt_float(battery_voltage_string, _current_battery_voltage, 3);
 
   debug_printf_time(DEBUG_LEVEL_0, rtc_get_milliseconds());
   debug_printf_string(DEBUG_LEVEL_0, (uint8_t*)"[battery_saving_mode_check] Current voltage = %sV\n", battery_voltage_string);
@@ -428,9 +428,8 @@ void power_management_loop(void) {
     debug_printf_string(DEBUG_LEVEL_1, 
         (uint8_t*)"[power_management_loop] Current power management state: %d\n", _current_power_state);
     
-    char battery_voltage_string[10];
-    memset(battery_voltage_string, '\0', 10);
-    utils_ftoa(battery_voltage_string, _current_battery_voltage, 0.001);
+    char battery_voltage_string[FMT_FIXED_SIZE];
+    fmt_float(battery_voltage_string, _current_battery_voltage, 3);
 
     if (_battery_saving_mode_active) {
       debug_printf_time(DEBUG_LEVEL_1, rtc_get_milliseconds());
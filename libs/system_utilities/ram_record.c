@@ -0,0 +1,241 @@
+/*
+* @file           ram_record.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the records framing of the byte stream between
+*                 the MCUs, with type, length, sequence number and CRC-16, and
+*                 the parser that finds the records again after torn writes.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "ram_record.h"
+
+/* SDK */
+#include "crc16.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* Private functions list */
+static void _ram_record_parser_drop(ram_record_parser *parser, uint16_t size);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to build the header of a record
+*
+* @param[out]  header                 Buffer with RAM_RECORD_HEADER_SIZE bytes
+* @param[in]   type                   Record type, RAM_RECORD_TEMPERATURE to RAM_RECORD_CONFIG
+* @param[in]   sequence               Sequence number, one more than the previous record
+* @param[in]   length                 Payload length in bytes
+*/
+void ram_record_get_header(uint8_t *header, uint8_t type, uint16_t sequence, uint16_t length) {
+
+  header[0] = RAM_RECORD_SYNC;
+  header[1] = type;
+  header[2] = (uint8_t)(sequence >> 8);
+  header[3] = (uint8_t)sequence;
+  header[4] = (uint8_t)(length >> 8);
+  header[5] = (uint8_t)length;
+
+}
+
+
+/*
+* @brief Function to get the CRC-16 closing a record
+*
+* @param[out]  crc                    Buffer with RAM_RECORD_CRC_SIZE bytes
+* @param[in]   header                 Header from ram_record_get_header()
+* @param[in]   payload                Payload
+* @param[in]   length                 Payload length in bytes
+*/
+void ram_record_get_crc(uint8_t *crc, const uint8_t *header, const uint8_t *payload, uint16_t length) {
+
+  uint16_t value = crc16_compute(&header[1], RAM_RECORD_HEADER_SIZE - 1, NULL);
+
+  value = crc16_compute(payload, length, &value);
+  crc[0] = (uint8_t)(value >> 8);
+  crc[1] = (uint8_t)value;
+
+}
+
+
+/*
+* @brief Function to initialize a parser
+*
+* @param[in]   parser                 Pointer to the parser structure
+* @param[in]   buffer                 Buffer for the bytes not parsed yet, fits the largest record
+* @param[in]   size                   Buffer size in bytes, more than RAM_RECORD_OVERHEAD
+* @retval                             Returns true if successful, or false if the buffer is too small
+*/
+bool ram_record_parser_init(ram_record_parser *parser, uint8_t *buffer, uint16_t size) {
+
+  if(buffer == NULL || size <= RAM_RECORD_OVERHEAD) {
+    return false;
+  }
+
+  parser->buffer = buffer;
+  parser->size = size;
+  ram_record_parser_reset(parser);
+  return true;
+
+}
+
+
+/*
+* @brief Function to drop the bytes not parsed yet and clear the statistics
+*
+* @param[in]   parser                 Pointer to the parser structure
+*/
+void ram_record_parser_reset(ram_record_parser *parser) {
+
+  parser->count = 0;
+  parser->consumed = 0;
+  parser->has_sequence = false;
+  parser->next_sequence = 0;
+  parser->records = 0;
+  parser->lost = 0;
+  parser->crc_errors = 0;
+  parser->stale = 0;
+  parser->skipped = 0;
+
+}
+
+
+/*
+* @brief Function to get where the next bytes of the stream go
+*
+* @param[in]   parser                 Pointer to the parser structure
+* @param[out]  size                   Free bytes from the returned position
+* @return                             Returns the position for the next bytes, to commit with ram_record_parser_commit()
+*/
+uint8_t *ram_record_parser_get_space(ram_record_parser *parser, uint16_t *size) {
+
+  _ram_record_parser_drop(parser, parser->consumed);
+  parser->consumed = 0;
+
+  *size = parser->size - parser->count;
+  return &parser->buffer[parser->count];
+
+}
+
+
+/*
+* @brief Function to add the bytes written in the position from ram_record_parser_get_space()
+*
+* @param[in]   parser                 Pointer to the parser structure
+* @param[in]   size                   Bytes written
+*/
+void ram_record_parser_commit(ram_record_parser *parser, uint16_t size) {
+  parser->count += size;
+}
+
+
+/*
+* @brief Function to get the next valid record of the stream
+*
+* @param[in]   parser                 Pointer to the parser structure
+* @param[out]  record                 Record found, its payload is valid until the next parser call
+* @retval                             Returns true if a record was found, or false if more bytes are needed
+* @note                               A header with an invalid length or a record with a bad CRC is a false
+*                                     sync or a torn write, the search goes on from the next byte. Records
+*                                     lost in between show as a gap in the sequence numbers. Records up to
+*                                     RAM_RECORD_STALE_WINDOW behind are stale and dropped, further behind
+*                                     is taken as a restart of the writer
+*/
+bool ram_record_parser_next(ram_record_parser *parser, ram_record *record) {
+
+  uint8_t *header;
+  uint8_t crc[RAM_RECORD_CRC_SIZE];
+  uint16_t length;
+  uint16_t sequence;
+  uint16_t start;
+
+  _ram_record_parser_drop(parser, parser->consumed);
+  parser->consumed = 0;
+
+  while(true) {
+
+    /* Sync */
+    for(start = 0 ; start < parser->count && parser->buffer[start] != RAM_RECORD_SYNC ; start++);
+    if(start) {
+      parser->skipped += start;
+      _ram_record_parser_drop(parser, start);
+    }
+    if(parser->count < RAM_RECORD_HEADER_SIZE) {
+      return false;
+    }
+
+    /* Header */
+    header = parser->buffer;
+    length = ((uint16_t)header[4] << 8) | header[5];
+    if(!header[1] || header[1] > RAM_RECORD_CONFIG || length > parser->size - RAM_RECORD_OVERHEAD) {
+      parser->skipped++;
+      _ram_record_parser_drop(parser, 1);
+      continue;
+    }
+    if(parser->count < RAM_RECORD_OVERHEAD + length) {
+      return false;
+    }
+
+    /* CRC */
+    ram_record_get_crc(crc, header, &header[RAM_RECORD_HEADER_SIZE], length);
+    if(memcmp(crc, &header[RAM_RECORD_HEADER_SIZE + length], RAM_RECORD_CRC_SIZE)) {
+      parser->crc_errors++;
+      parser->skipped++;
+      _ram_record_parser_drop(parser, 1);
+      continue;
+    }
+
+    /* Shortly behind the last record, left from the previous lap of the ring and uncovered by a torn write */
+    sequence = ((uint16_t)header[2] << 8) | header[3];
+    if(parser->has_sequence && sequence != parser->next_sequence &&
+       (uint16_t)(parser->next_sequence - sequence) <= RAM_RECORD_STALE_WINDOW) {
+      parser->stale++;
+      parser->skipped += RAM_RECORD_OVERHEAD + length;
+      _ram_record_parser_drop(parser, RAM_RECORD_OVERHEAD + length);
+      continue;
+    }
+    break;
+  }
+
+  /* Sequence */
+  if(parser->has_sequence) {
+    parser->lost += (uint16_t)(sequence - parser->next_sequence);
+  }
+  parser->next_sequence = sequence + 1;
+  parser->has_sequence = true;
+  parser->records++;
+
+  record->type = header[1];
+  record->sequence = sequence;
+  record->payload = &header[RAM_RECORD_HEADER_SIZE];
+  record->length = length;
+  parser->consumed = RAM_RECORD_OVERHEAD + length;
+  return true;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to drop bytes from the start of the parser buffer
+*
+* @param[in]   parser                 Pointer to the parser structure
+* @param[in]   size                   Bytes to drop
+*/
+static void _ram_record_parser_drop(ram_record_parser *parser, uint16_t size) {
+
+  if(!size) {
+    return;
+  }
+
+  parser->count -= size;
+  memmove(parser->buffer, &parser->buffer[size], parser->count);
+
+}
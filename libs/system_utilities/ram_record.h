@@ -0,0 +1,74 @@
+/*
+* @file           ram_record.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the records framing of the byte stream between
+*                 the MCUs, with type, length, sequence number and CRC-16, and
+*                 the parser that finds the records again after torn writes.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef RAM_RECORD_H
+#define RAM_RECORD_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+/* Record, big-endian
+ *   sync (1), type (1), sequence number (2), payload length (2), payload, CRC-16 of all but the sync (2) */
+#define RAM_RECORD_SYNC               0xA5
+#define RAM_RECORD_HEADER_SIZE        6
+#define RAM_RECORD_CRC_SIZE           2
+#define RAM_RECORD_OVERHEAD           (RAM_RECORD_HEADER_SIZE + RAM_RECORD_CRC_SIZE)
+#define RAM_RECORD_STALE_WINDOW       1024      /* Sequence numbers behind the next one taken as stale, over a lap of the ring */
+
+/* Record types */
+#define RAM_RECORD_TEMPERATURE        1         /* Body temperature measurement */
+#define RAM_RECORD_ECG                2         /* ECG frame in the meas_ecg_layout of MEASURES_SCHEMA */
+#define RAM_RECORD_ALERT              3         /* Event, the payload starts with its alert type */
+#define RAM_RECORD_CONFIG             4         /* Configuration */
+
+/* Record found by the parser, the payload is valid until the next parser call */
+typedef struct {
+  uint8_t         type;
+  uint16_t        sequence;
+  const uint8_t   *payload;
+  uint16_t        length;
+} ram_record;
+
+/* Parser of the byte stream */
+typedef struct {
+  uint8_t   *buffer;                            /* Bytes not parsed yet, from the oldest */
+  uint16_t  size;
+  uint16_t  count;
+  uint16_t  consumed;                           /* Bytes of the last record returned, dropped on the next call */
+  uint16_t  next_sequence;
+  bool      has_sequence;
+
+  /* Statistics */
+  uint32_t  records;
+  uint32_t  lost;                               /* Records missing from the sequence numbers */
+  uint32_t  crc_errors;
+  uint32_t  stale;                              /* Valid records of a previous lap of the ring, dropped */
+  uint32_t  skipped;                            /* Bytes dropped while looking for a record */
+} ram_record_parser;
+
+/********************************** Functions ***********************************/
+/* Writer */
+void ram_record_get_header(uint8_t *header, uint8_t type, uint16_t sequence, uint16_t length);
+void ram_record_get_crc(uint8_t *crc, const uint8_t *header, const uint8_t *payload, uint16_t length);
+
+/* Parser */
+bool ram_record_parser_init(ram_record_parser *parser, uint8_t *buffer, uint16_t size);
+void ram_record_parser_reset(ram_record_parser *parser);
+uint8_t *ram_record_parser_get_space(ram_record_parser *parser, uint16_t *size);
+void ram_record_parser_commit(ram_record_parser *parser, uint16_t size);
+bool ram_record_parser_next(ram_record_parser *parser, ram_record *record);
+
+#endif /* RAM_RECORD_H */
@@ -0,0 +1,218 @@
+/*
+* @file           seek_index.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the sidecar index of the recordings, the time
+*                 of a data record every few records and its offset in the
+*                 file, kept in whole sectors, and its binary search.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "seek_index.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Private ************************************/
+/* Private functions list */
+static void _seek_index_put(uint8_t *bytes, uint64_t value, uint8_t size);
+static uint64_t _seek_index_get(const uint8_t *bytes, uint8_t size);
+
+/********************************** Public ************************************/
+/*
+* @brief Function to initialize a writer for a new index
+*
+* @param[in]   writer                 Pointer to the writer structure
+*/
+void seek_index_writer_init(seek_index_writer *writer) {
+
+  writer->sectors = 0;
+  writer->timestamp = 0;
+  writer->count = 0;
+  memset(writer->sector, SEEK_INDEX_EMPTY, SEEK_INDEX_SECTOR_SIZE);
+
+}
+
+
+/*
+* @brief Function to add an entry to the sector being filled
+*
+* @param[in]   writer                 Pointer to the writer structure
+* @param[in]   entry                  Entry, not before the previous one
+* @retval                             Returns true if successful, or false if the sector is full or
+*                                     the entry is out of order
+*/
+bool seek_index_add(seek_index_writer *writer, const seek_index_entry *entry) {
+
+  uint8_t *bytes;
+
+  if(seek_index_is_full(writer) || entry->timestamp < writer->timestamp) {
+    return false;
+  }
+
+  bytes = &writer->sector[writer->count * SEEK_INDEX_ENTRY_SIZE];
+  _seek_index_put(bytes, entry->timestamp, 8);
+  _seek_index_put(&bytes[8], entry->offset, 4);
+  _seek_index_put(&bytes[12], entry->record, 4);
+  writer->timestamp = entry->timestamp;
+  writer->count++;
+  return true;
+
+}
+
+
+/*
+* @brief Function to check if the sector being filled is full, to write it and go to the next
+*
+* @param[in]   writer                 Pointer to the writer structure
+* @retval                             Returns true if it is full
+*/
+bool seek_index_is_full(const seek_index_writer *writer) {
+  return writer->count == SEEK_INDEX_ENTRIES;
+}
+
+
+/*
+* @brief Function to start the next sector, after the full one was written
+*
+* @param[in]   writer                 Pointer to the writer structure
+*/
+void seek_index_next_sector(seek_index_writer *writer) {
+
+  writer->sectors++;
+  writer->count = 0;
+  memset(writer->sector, SEEK_INDEX_EMPTY, SEEK_INDEX_SECTOR_SIZE);
+
+}
+
+
+/*
+* @brief Function to get the sectors of the index, with the one being filled
+*
+* @param[in]   writer                 Pointer to the writer structure
+* @retval                             Returns the number of sectors
+*/
+uint32_t seek_index_get_sectors(const seek_index_writer *writer) {
+  return writer->sectors + (writer->count ? 1 : 0);
+}
+
+
+/*
+* @brief Function to get an entry of a sector
+*
+* @param[in]   sector                 Sector of the index
+* @param[in]   index                  Entry, up to SEEK_INDEX_ENTRIES - 1
+* @param[out]  entry                  Entry, a timestamp of UINT64_MAX if it was not written
+*/
+void seek_index_get_entry(const uint8_t *sector, uint8_t index, seek_index_entry *entry) {
+
+  const uint8_t *bytes = &sector[index * SEEK_INDEX_ENTRY_SIZE];
+
+  entry->timestamp = _seek_index_get(bytes, 8);
+  entry->offset = (uint32_t)_seek_index_get(&bytes[8], 4);
+  entry->record = (uint32_t)_seek_index_get(&bytes[12], 4);
+
+}
+
+
+/*
+* @brief Function to find the entry to start reading a recording from a time
+*
+* @param[in]   read                   Reader of the sectors of the index
+* @param[in]   context                Context of the reader, such as the file
+* @param[in]   sectors                Number of sectors of the index
+* @param[in]   timestamp              Time to find
+* @param[in]   buffer                 Buffer with SEEK_INDEX_SECTOR_SIZE bytes
+* @param[out]  entry                  Last entry not after the time, or the first one if it is before them all
+* @retval                             Returns true if successful, or false if the index is empty or a read failed
+* @note                               A binary search of the sectors by their first entry and then of the
+*                                     entries of a sector, about log2(sectors) + 1 sector reads
+*/
+bool seek_index_find(seek_index_read read, void *context, uint32_t sectors, uint64_t timestamp,
+                     uint8_t *buffer, seek_index_entry *entry) {
+
+  uint32_t low = 0;
+  uint32_t high = sectors;
+  uint32_t middle;
+  uint32_t loaded = sectors;
+  uint8_t first = 0;
+  uint8_t last = SEEK_INDEX_ENTRIES;
+  uint8_t half;
+
+  if(!sectors) {
+    return false;
+  }
+
+  /* Last sector starting not after the time, among [low, high) */
+  while(high - low > 1) {
+    middle = low + (high - low) / 2;
+    if(!read(context, middle, buffer)) {
+      return false;
+    }
+    loaded = middle;
+    seek_index_get_entry(buffer, 0, entry);
+    if(entry->timestamp <= timestamp) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  if(loaded != low && !read(context, low, buffer)) {
+    return false;
+  }
+
+  /* Last entry not after the time, among [first, last) */
+  while(last - first > 1) {
+    half = first + (last - first) / 2;
+    seek_index_get_entry(buffer, half, entry);
+    if(entry->timestamp <= timestamp) {
+      first = half;
+    } else {
+      last = half;
+    }
+  }
+  seek_index_get_entry(buffer, first, entry);
+  return entry->timestamp != UINT64_MAX;
+
+}
+
+
+/********************************** Private ************************************/
+/*
+* @brief Function to put a value in little-endian
+*
+* @param[out]  bytes                  Buffer with size bytes
+* @param[in]   value                  Value
+* @param[in]   size                   Number of bytes
+*/
+static void _seek_index_put(uint8_t *bytes, uint64_t value, uint8_t size) {
+
+  for(uint8_t i = 0 ; i < size ; i++) {
+    bytes[i] = (uint8_t)(value >> (8 * i));
+  }
+
+}
+
+
+/*
+* @brief Function to get a value in little-endian
+*
+* @param[in]   bytes                  Buffer with size bytes
+* @param[in]   size                   Number of bytes
+* @retval                             Returns the value
+*/
+static uint64_t _seek_index_get(const uint8_t *bytes, uint8_t size) {
+
+  uint64_t value = 0;
+
+  for(uint8_t i = size ; i ; i--) {
+    value = (value << 8) | bytes[i - 1];
+  }
+  return value;
+
+}
@@ -0,0 +1,62 @@
+/*
+* @file           seek_index.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the sidecar index of the recordings, the time
+*                 of a data record every few records and its offset in the
+*                 file, kept in whole sectors, and its binary search.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+/* File, sectors of entries sorted by time, the rest of the last sector is SEEK_INDEX_EMPTY
+ * Entry, little-endian
+ *   timestamp in ms (8), offset of the data record in the recording (4), data record number (4) */
+#define SEEK_INDEX_SECTOR_SIZE        512
+#define SEEK_INDEX_ENTRY_SIZE         16
+#define SEEK_INDEX_ENTRIES            (SEEK_INDEX_SECTOR_SIZE / SEEK_INDEX_ENTRY_SIZE)
+#define SEEK_INDEX_EMPTY              0xFF      /* Bytes of the entries not written, a time after all the others */
+
+/* Entry */
+typedef struct {
+  uint64_t  timestamp;
+  uint32_t  offset;
+  uint32_t  record;
+} seek_index_entry;
+
+/* Writer, the sector being filled and the sectors before it */
+typedef struct {
+  uint8_t   sector[SEEK_INDEX_SECTOR_SIZE];
+  uint8_t   count;                                  /* Entries in the sector */
+  uint32_t  sectors;                                /* Sectors filled, the one being filled is the next */
+  uint64_t  timestamp;                              /* Time of the last entry */
+} seek_index_writer;
+
+/* Reader of a sector of the file, returns false on a read error */
+typedef bool (*seek_index_read)(void *context, uint32_t sector, uint8_t *buffer);
+
+/********************************** Functions ***********************************/
+/* Writer */
+void seek_index_writer_init(seek_index_writer *writer);
+bool seek_index_add(seek_index_writer *writer, const seek_index_entry *entry);
+bool seek_index_is_full(const seek_index_writer *writer);
+void seek_index_next_sector(seek_index_writer *writer);
+uint32_t seek_index_get_sectors(const seek_index_writer *writer);
+
+/* Reader */
+void seek_index_get_entry(const uint8_t *sector, uint8_t index, seek_index_entry *entry);
+bool seek_index_find(seek_index_read read, void *context, uint32_t sectors, uint64_t timestamp,
+                     uint8_t *buffer, seek_index_entry *entry);
+
+#endif /* SEEK_INDEX_H */
@@ -0,0 +1,221 @@
+/*
+* @file           spsc_ring.c
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the single producer, single consumer ring of
+*                 fixed size elements. The producer only writes the head and
+*                 the consumer only writes the tail, so no critical sections
+*                 are needed between an interrupt and the main loop.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+/*********************************** Includes ***********************************/
+/* Interface */
+#include "spsc_ring.h"
+
+/* SDK */
+#include "nrf.h"
+
+/* Standard library */
+#include <string.h>
+
+/********************************** Public ************************************/
+/*
+* @brief Function to initialize an empty ring
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @param[in]   buffer                 Elements storage with size * element_size bytes
+* @param[in]   element_size           Size of one element in bytes
+* @param[in]   size                   Number of elements, must be a power of 2
+* @retval                             Returns true if successful, or false if size is not a power of 2
+*/
+bool spsc_ring_init(spsc_ring *ring, void *buffer, uint16_t element_size, uint16_t size) {
+
+  if(!size || (size & (size - 1))) {
+    return false;
+  }
+
+  ring->buffer = buffer;
+  ring->element_size = element_size;
+  ring->size = size;
+  spsc_ring_reset(ring);
+  return true;
+
+}
+
+
+/*
+* @brief Function to empty the ring and clear the overruns counter
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @note                               Producer and consumer must be stopped
+*/
+void spsc_ring_reset(spsc_ring *ring) {
+
+  ring->head = 0;
+  ring->tail = 0;
+  ring->overruns = 0;
+
+}
+
+
+/*
+* @brief Function to get the number of elements ready to be read
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @return                             Returns the number of elements in the ring
+*/
+uint16_t spsc_ring_count(spsc_ring *ring) {
+  return (uint16_t)(ring->head - ring->tail);
+}
+
+
+/*
+* @brief Function to get the number of free elements
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @return                             Returns the number of elements that can still be written
+*/
+uint16_t spsc_ring_free(spsc_ring *ring) {
+  return ring->size - spsc_ring_count(ring);
+}
+
+
+/*
+* @brief Function to get the number of elements refused because the ring was full
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @return                             Returns the overruns counter
+*/
+uint32_t spsc_ring_get_overruns(spsc_ring *ring) {
+  return ring->overruns;
+}
+
+
+/*
+* @brief Function to get the next free element, to be filled in place by the producer
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @return                             Returns the element pointer, or NULL if the ring is full
+* @note                               The element is only visible to the consumer after spsc_ring_commit()
+*/
+void *spsc_ring_write_slot(spsc_ring *ring) {
+
+  uint32_t head = ring->head;
+
+  if((uint32_t)(head - ring->tail) >= ring->size) {
+    ring->overruns++;
+    return NULL;
+  }
+  return &ring->buffer[(head & (ring->size - 1)) * ring->element_size];
+
+}
+
+
+/*
+* @brief Function to publish the element returned by spsc_ring_write_slot()
+*
+* @param[in]   ring                   Pointer to the ring structure
+*/
+void spsc_ring_commit(spsc_ring *ring) {
+
+  __DMB();                                                        /* Release: element content is written before the head */
+  ring->head = ring->head + 1;
+
+}
+
+
+/*
+* @brief Function to copy one element into the ring
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @param[in]   element                Element to copy
+* @retval                             Returns true if successful, or false if the ring is full
+*/
+bool spsc_ring_push(spsc_ring *ring, const void *element) {
+
+  void *slot = spsc_ring_write_slot(ring);
+
+  if(slot == NULL) {
+    return false;
+  }
+  memcpy(slot, element, ring->element_size);
+  spsc_ring_commit(ring);
+  return true;
+
+}
+
+
+/*
+* @brief Function to get the oldest element, to be read in place by the consumer
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @return                             Returns the element pointer, or NULL if the ring is empty
+* @note                               The element belongs to the consumer until spsc_ring_release()
+*/
+void *spsc_ring_read_slot(spsc_ring *ring) {
+
+  uint32_t tail = ring->tail;
+
+  if(ring->head == tail) {
+    return NULL;
+  }
+  __DMB();                                                        /* Acquire: element content is read after the head */
+  return &ring->buffer[(tail & (ring->size - 1)) * ring->element_size];
+
+}
+
+
+/*
+* @brief Function to give back to the producer the element returned by spsc_ring_read_slot()
+*
+* @param[in]   ring                   Pointer to the ring structure
+*/
+void spsc_ring_release(spsc_ring *ring) {
+
+  __DMB();                                                        /* Release: element is fully read before the tail */
+  ring->tail = ring->tail + 1;
+
+}
+
+
+/*
+* @brief Function to copy up to max elements out of the ring
+*
+* @param[in]   ring                   Pointer to the ring structure
+* @param[out]  elements               Destination with room for max elements
+* @param[in]   max                    Maximum number of elements to copy
+* @return                             Returns the number of elements copied
+* @note                               Only one acquire and one release for the whole batch
+*/
+uint16_t spsc_ring_pop_batch(spsc_ring *ring, void *elements, uint16_t max) {
+
+  uint32_t tail = ring->tail;
+  uint16_t count = (uint16_t)(ring->head - tail);
+  uint8_t *dst = elements;
+
+  if(count > max) {
+    count = max;
+  }
+  if(!count) {
+    return 0;
+  }
+  __DMB();                                                        /* Acquire */
+
+  /* Copy in at most two segments, before and after the buffer wrap */
+  uint16_t idx = tail & (ring->size - 1);
+  uint16_t first = ring->size - idx;
+  if(first > count) {
+    first = count;
+  }
+  memcpy(dst, &ring->buffer[idx * ring->element_size], first * ring->element_size);
+  memcpy(&dst[first * ring->element_size], ring->buffer, (count - first) * ring->element_size);
+
+  __DMB();                                                        /* Release */
+  ring->tail = tail + count;
+  return count;
+
+}
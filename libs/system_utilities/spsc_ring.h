@@ -0,0 +1,52 @@
+/*
+* @file           spsc_ring.h
+* @date           October 2021
+* @author         PFaria & JAntunes
+*
+* @brief          This file has the single producer, single consumer ring of
+*                 fixed size elements. The producer only writes the head and
+*                 the consumer only writes the tail, so no critical sections
+*                 are needed between an interrupt and the main loop.
+*
+* Copyright(C)    2020-2021, PFaria & JAntunes
+* All rights reserved.
+*/
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+/*********************************** Includes ***********************************/
+/* Standard library */
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************** Definitions ***********************************/
+/* Ring of fixed size elements, the number of elements must be a power of 2 */
+typedef struct {
+  uint8_t             *buffer;        /* Elements storage with size * element_size bytes */
+  uint16_t            element_size;   /* Size of one element in bytes */
+  uint16_t            size;           /* Number of elements */
+  volatile uint32_t   head;           /* Free running write index, only written by the producer */
+  volatile uint32_t   tail;           /* Free running read index, only written by the consumer */
+  volatile uint32_t   overruns;       /* Elements refused by the producer because the ring was full */
+} spsc_ring;
+
+/********************************** Functions ***********************************/
+/* Common */
+bool spsc_ring_init(spsc_ring *ring, void *buffer, uint16_t element_size, uint16_t size);
+void spsc_ring_reset(spsc_ring *ring);
+uint16_t spsc_ring_count(spsc_ring *ring);
+uint16_t spsc_ring_free(spsc_ring *ring);
+uint32_t spsc_ring_get_overruns(spsc_ring *ring);
+
+/* Producer */
+void *spsc_ring_write_slot(spsc_ring *ring);
+void spsc_ring_commit(spsc_ring *ring);
+bool spsc_ring_push(spsc_ring *ring, const void *element);
+
+/* Consumer */
+void *spsc_ring_read_slot(spsc_ring *ring);
+void spsc_ring_release(spsc_ring *ring);
+uint16_t spsc_ring_pop_batch(spsc_ring *ring, void *elements, uint16_t max);
+
+#endif /* SPSC_RING_H */
@@ -15,7 +15,11 @@
 /* SDK */
 #include "nrf_drv_gpiote.h"
 
-/********************************** Tests ***********************************
+/* Standard library */
+#include <stdint.h>
+#include <stddef.h>
+
+/********************************** Tests ***********************************/
 
 /* ***************** */
 /*       Tests       */
@@ -167,39 +171,21 @@
 #define MEAS_ECG_LOFF_V4  "Lead-off V4"
 #define MEAS_ECG_LOFF_V5  "Lead-off V5"
 #define MEAS_ECG_LOFF_V6  "Lead-off V6"
+#define MEAS_ECG_HR       "Heart Rate"
+#define MEAS_ECG_RR       "RR Interval"
+#define MEAS_ECG_R_OFFSET "R-peak Offset"
+#define MEAS_RESP_RATE    "Respiration Rate"
+#define MEAS_SAMPLE_INDEX "Sample Index"
+#define MEAS_SAMPLE_RATE  "Sample Rate"
+
+/* Flag of the MEAS_RESP_RATE field when it carries a new rate, the field is 0 otherwise */
+#define MEAS_RESP_RATE_REPORTED        0x8000
+
+/* Store the derived limb leads (III, aVR, aVL, aVF), otherwise only the independent
+ * leads are stored and sent, and the readers rebuild the others with ecg_leads */
+#define ECG_STORE_DERIVED_LEADS        0
 
-/* Array with content measurements transfers */
-#define MEASURES_CONTENT    \
-  {                         \
-    MEAS_TIMESTAMP,         \
-    MEAS_TEMP,              \
-    MEAS_TIMESTAMP,         \
-    MEAS_ECG_LOFF_LA,       \
-    MEAS_ECG_LOFF_RA,       \
-    MEAS_ECG_LOFF_LL,       \
-    MEAS_ECG_LOFF_V1,       \
-    MEAS_ECG_LOFF_V2,       \
-    MEAS_ECG_LOFF_V3,       \
-    MEAS_ECG_LOFF_V4,       \
-    MEAS_ECG_LOFF_V5,       \
-    MEAS_ECG_LOFF_V6,       \
-    MEAS_ECG_PACE,          \
-    MEAS_ECG_I,             \
-    MEAS_ECG_II,            \
-    MEAS_ECG_III,           \
-    MEAS_ECG_AVR,           \
-    MEAS_ECG_AVL,           \
-    MEAS_ECG_AVF,           \
-    MEAS_ECG_V2,            \
-    MEAS_RESP,              \
-    MEAS_ECG_LOFF_V3,       \
-    MEAS_ECG_LOFF_V4,       \
-    MEAS_ECG_LOFF_V5,       \
-    MEAS_ECG_LOFF_V6        \
-  }
-#define DEVICE_MEASURES_NUMBER         25
-
-/* Size macros in bytes to use in MEASURES_CONTENT_SIZE */
+/* Size macros in bytes to use in MEASURES_SCHEMA */
 typedef enum {                                     
   MEAS_1BYTE  = (1),    /* uint8_t */
   MEAS_2BYTE  = (2),    /* uint16_t */
@@ -207,35 +193,99 @@ typedef enum {
   MEAS_8BYTE  = (8),    /* uint64_t */  
 } measures_size;
 
-/* Array with size of content measurements transfers */
-#define MEASURES_CONTENT_SIZE \
-  {                           \
-    MEAS_8BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_8BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_1BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE,               \
-    MEAS_4BYTE                \
-  }
+/* Derived limb leads, only in the schema with ECG_STORE_DERIVED_LEADS */
+#if ECG_STORE_DERIVED_LEADS
+#define MEAS_DERIVED_LEADS(X)                                 \
+  X(ECG_III,      MEAS_ECG_III,       MEAS_4BYTE, ECG)        \
+  X(ECG_AVR,      MEAS_ECG_AVR,       MEAS_4BYTE, ECG)        \
+  X(ECG_AVL,      MEAS_ECG_AVL,       MEAS_4BYTE, ECG)        \
+  X(ECG_AVF,      MEAS_ECG_AVF,       MEAS_4BYTE, ECG)
+#else
+#define MEAS_DERIVED_LEADS(X)
+#endif
+
+/* Schema of the measurements, the only list of the fields, in frame order
+ *   X(field, name, size, source)
+ * DEVICE fields are stored by the other apps (temperature records), ECG fields make the
+ * frames serialized by ads129x and app_ecg. ROW fields are set by the reader that builds the
+ * uSD rows, SAMPLE_RATE from the last timebase anchor of the frames (timebase_anchor_get_rate).
+ * Everything below is generated from it */
+#define MEASURES_SCHEMA(X)                                    \
+  X(TIMESTAMP,    MEAS_TIMESTAMP,     MEAS_8BYTE, DEVICE)     \
+  X(TEMP,         MEAS_TEMP,          MEAS_4BYTE, DEVICE)     \
+  X(SAMPLE_INDEX, MEAS_SAMPLE_INDEX,  MEAS_4BYTE, ECG)        \
+  X(SAMPLE_RATE,  MEAS_SAMPLE_RATE,   MEAS_2BYTE, ROW)        \
+  X(ECG_LOFF_LA,  MEAS_ECG_LOFF_LA,   MEAS_1BYTE, ECG)        \
+  X(ECG_LOFF_RA,  MEAS_ECG_LOFF_RA,   MEAS_1BYTE, ECG)        \
+  X(ECG_LOFF_LL,  MEAS_ECG_LOFF_LL,   MEAS_1BYTE, ECG)        \
+  X(ECG_LOFF_V1,  MEAS_ECG_LOFF_V1,   MEAS_1BYTE, ECG)        \
+  X(ECG_LOFF_V2,  MEAS_ECG_LOFF_V2,   MEAS_1BYTE, ECG)        \
+  X(ECG_LOFF_V3,  MEAS_ECG_LOFF_V3,   MEAS_1BYTE, ECG)        \
+  X(ECG_LOFF_V4,  MEAS_ECG_LOFF_V4,   MEAS_1BYTE, ECG)        \
+  X(ECG_LOFF_V5,  MEAS_ECG_LOFF_V5,   MEAS_1BYTE, ECG)        \
+  X(ECG_LOFF_V6,  MEAS_ECG_LOFF_V6,   MEAS_1BYTE, ECG)        \
+  X(ECG_PACE,     MEAS_ECG_PACE,      MEAS_1BYTE, ECG)        \
+  X(ECG_I,        MEAS_ECG_I,         MEAS_4BYTE, ECG)        \
+  X(ECG_II,       MEAS_ECG_II,        MEAS_4BYTE, ECG)        \
+  MEAS_DERIVED_LEADS(X)                                       \
+  X(ECG_V2,       MEAS_ECG_V2,        MEAS_4BYTE, ECG)        \
+  X(RESP,         MEAS_RESP,          MEAS_4BYTE, ECG)        \
+  X(ECG_V3,       MEAS_ECG_V3,        MEAS_4BYTE, ECG)        \
+  X(ECG_V4,       MEAS_ECG_V4,        MEAS_4BYTE, ECG)        \
+  X(ECG_V5,       MEAS_ECG_V5,        MEAS_4BYTE, ECG)        \
+  X(ECG_V6,       MEAS_ECG_V6,        MEAS_4BYTE, ECG)        \
+  X(ECG_HR,       MEAS_ECG_HR,        MEAS_2BYTE, ECG)        \
+  X(ECG_RR,       MEAS_ECG_RR,        MEAS_2BYTE, ECG)        \
+  X(ECG_R_OFFSET, MEAS_ECG_R_OFFSET,  MEAS_2BYTE, ECG)        \
+  X(RESP_RATE,    MEAS_RESP_RATE,     MEAS_2BYTE, ECG)
+
+/* Keeps an expansion only for the fields of one source */
+#define MEAS_IF_DEVICE_DEVICE(x)      x
+#define MEAS_IF_DEVICE_ECG(x)
+#define MEAS_IF_DEVICE_ROW(x)
+#define MEAS_IF_ECG_DEVICE(x)
+#define MEAS_IF_ECG_ECG(x)            x
+#define MEAS_IF_ECG_ROW(x)
+
+/* Generators */
+#define MEAS_X_ID(field, name, size, source)            MEAS_ID_##field,
+#define MEAS_X_NAME(field, name, size, source)          name,
+#define MEAS_X_SIZE(field, name, size, source)          size,
+#define MEAS_X_OFFSET(field, name, size, source)        offsetof(meas_frame_layout, field),
+#define MEAS_X_CSV(field, name, size, source)           name ";"
+#define MEAS_X_FIELD(field, name, size, source)         uint8_t field[size];
+#define MEAS_X_DEVICE_FIELD(field, name, size, source)  MEAS_IF_DEVICE_##source(uint8_t field[size];)
+#define MEAS_X_ECG_FIELD(field, name, size, source)     MEAS_IF_ECG_##source(uint8_t field[size];)
+
+/* Field IDs, index of each field in the tables below */
+typedef enum {
+  MEASURES_SCHEMA(MEAS_X_ID)
+  MEAS_ID_COUNT
+} meas_id;
+#define DEVICE_MEASURES_NUMBER        MEAS_ID_COUNT
+
+/* Layouts, only for the offsets and sizes, the frames are byte arrays in big-endian */
+typedef struct { MEASURES_SCHEMA(MEAS_X_FIELD) } meas_frame_layout;                 /* uSD rows, all fields */
+typedef struct { MEASURES_SCHEMA(MEAS_X_DEVICE_FIELD) } meas_device_layout;         /* Temperature records */
+typedef struct { MEASURES_SCHEMA(MEAS_X_ECG_FIELD) } meas_ecg_layout;               /* ECG frames, RAM_RECORD_ECG */
+
+/* Offsets of a field in bytes, the field is the first argument of MEASURES_SCHEMA */
+#define MEAS_OFFSET(field)            offsetof(meas_frame_layout, field)
+#define MEAS_DEVICE_OFFSET(field)     offsetof(meas_device_layout, field)
+#define MEAS_ECG_OFFSET(field)        offsetof(meas_ecg_layout, field)
+
+/* Frame sizes in bytes */
+#define MEAS_FRAME_SIZE               sizeof(meas_frame_layout)
+#define MEAS_DEVICE_FRAME_SIZE        sizeof(meas_device_layout)
+#define MEAS_ECG_FRAME_SIZE           sizeof(meas_ecg_layout)
+
+/* Tables indexed by the field IDs */
+#define MEASURES_CONTENT              { MEASURES_SCHEMA(MEAS_X_NAME) }
+#define MEASURES_CONTENT_SIZE         { MEASURES_SCHEMA(MEAS_X_SIZE) }
+#define MEASURES_CONTENT_OFFSET       { MEASURES_SCHEMA(MEAS_X_OFFSET) }
+
+/* Column headers of the uSD rows, one string literal */
+#define MEASURES_CSV_HEADER           MEASURES_SCHEMA(MEAS_X_CSV) "\n"
 
 /* Informao da configurao do equipamento do paciente a monitorizar */
 typedef struct {
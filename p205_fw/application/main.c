@@ -57,6 +57,7 @@
 /* Apps */
 #include "app_bodytemp.h"
 #include "app_ecg.h"
+#include "app_replay.h"
 #endif 
 
 #if MICROCONTROLER_2
@@ -234,10 +235,10 @@ bool is_gps_active(void) {
 
   /* Add here any pior init to use */
   #if MICROCONTROLER_1
-  spi_mngr_init(SPI_MNGR_CONFIG1_INSTANCE);                 /* Init SPI for ECG sensor */
+  spi_mngr_init(SPI_MNGR_CONFIG1);                          /* Init SPI for ECG sensor */
   #endif 
   #if !USD_ACTIVE
-  spi_mngr_init(SPI_MNGR_CONFIG3_INSTANCE);                 /* Init SPI for RAM and LDC */
+  spi_mngr_init(SPI_MNGR_CONFIG3);                          /* Init SPI for RAM and LDC */
   #endif 
   
   /* *** Sensefinity Company Code Init *** */
@@ -314,6 +315,9 @@ bool is_gps_active(void) {
   charge_init(APP_CHARGE_SAMPLING_RATE, app_extram_get_init_status_callback_dummy, app_extram_get_battery_data_callback_dummy);
   app_body_temperature_init(APP_BODY_TEMP_SAMPLING_RATE);
   app_ecg_init(power_management_is_battery_saving_mode_active);
+  #if ADS129X_REPLAY
+  app_replay_init(NULL);                                  /* Frames set with app_replay_set_buffer() */
+  #endif
   #endif 
   
   #if MICROCONTROLER_2    
@@ -343,9 +347,11 @@ bool is_gps_active(void) {
   while(app_body_temperature_is_busy()) {
     app_body_temperature_loop();
   }
+  #if !ADS129X_REPLAY
   while(app_ecg_is_busy()) {
     app_ecg_loop();
   }
+  #endif
   #endif 
   
   #if MICROCONTROLER_2      
@@ -363,9 +369,13 @@ bool is_gps_active(void) {
 
   /* ECG dummies */
   #if MICROCONTROLER_1
+  #if ADS129X_REPLAY
+  app_replay_start(APP_REPLAY_ACCURACY, APP_REPLAY_REAL_TIME);
+  #else
   app_ecg_config(false, false, 1, 1, ADS129X_SUPPLY);
   app_ecg_start_sample();
   #endif
+  #endif
 
   /* Main Loop */
   while(true) {
@@ -406,6 +416,9 @@ bool is_gps_active(void) {
     #if MICROCONTROLER_1
       app_body_temperature_loop();
       app_ecg_loop();
+      #if ADS129X_REPLAY
+      app_replay_loop();
+      #endif
     #endif 
     
     #if MICROCONTROLER_2    